@@ -0,0 +1,140 @@
+#!/usr/bin/env sh
+# Benchmark goaccess against synthetic logs, run through `make bench`.
+#
+# Each result is printed as one JSON object per line, e.g.,
+#   {"commit":"abc1234","bench":"parse","format":"COMBINED","lines":500000,
+#    "seconds":1.234567,"lines_per_sec":405186}
+# and appended to $BENCH_RESULTS when set, so runs can be compared across
+# commits.
+#
+# The log is parsed once for the persist, json and html benchmarks. They
+# run off the dataset persisted then and report their time less that of
+# restoring it.
+#
+# Tunables (environment):
+#   BENCH_LINES     lines per generated log (500000)
+#   BENCH_FORMATS   log formats to parse (COMBINED VCOMBINED W3C CLOUDFRONT CADDY)
+#   BENCH_IPS       distinct client IPs (50000)
+#   BENCH_URLS      distinct URLs (20000)
+#   BENCH_AGENTS    distinct user agents (1000)
+#   BENCH_SEED      generator seed (1)
+#   BENCH_PORT      WebSocket port for the broadcast benchmark (7899)
+#   BENCH_RESULTS   file to append results to
+set -o nounset
+set -o errexit
+
+GOACCESS=${GOACCESS:-./goaccess}
+GBENCH=${GBENCH:-./gbench}
+LINES=${BENCH_LINES:-500000}
+FORMATS=${BENCH_FORMATS:-"COMBINED VCOMBINED W3C CLOUDFRONT CADDY"}
+PORT=${BENCH_PORT:-7899}
+RESULTS=${BENCH_RESULTS:-}
+GENOPTS="-n $LINES -i ${BENCH_IPS:-50000} -u ${BENCH_URLS:-20000} -a ${BENCH_AGENTS:-1000} -s ${BENCH_SEED:-1}"
+COMMIT=$(git -C "$(dirname "$0")" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# parse-only keeps the general counters but skips every panel
+PANELS="VISITORS REQUESTS REQUESTS_STATIC NOT_FOUND HOSTS OS BROWSERS VISIT_TIMES
+VIRTUAL_HOSTS REFERRERS REFERRING_SITES KEYPHRASES STATUS_CODES REMOTE_USER
+CACHE_STATUS GEO_LOCATION ASN MIME_TYPE TLS_TYPE"
+NOPANELS=""
+for p in $PANELS; do
+  NOPANELS="$NOPANELS --ignore-panel=$p"
+done
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/goaccess-bench.XXXXXX")
+WSPID=""
+# stop the real-time server, it may take a while to notice the signal
+stop_ws () {
+  [ -n "$WSPID" ] || return 0
+  kill "$WSPID" 2>/dev/null || true
+  i=0
+  while [ $i -lt 50 ] && kill -0 "$WSPID" 2>/dev/null; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+  kill -9 "$WSPID" 2>/dev/null || true
+  wait "$WSPID" 2>/dev/null || true
+  WSPID=""
+}
+cleanup () {
+  stop_ws
+  rm -rf "$DIR"
+}
+trap cleanup EXIT INT TERM
+
+# report <bench> <format> <seconds> [extra json fields]
+report () {
+  line=$(awk -v c="$COMMIT" -v b="$1" -v f="$2" -v n="$LINES" -v s="$3" -v x="${4:-}" 'BEGIN {
+    printf "{\"commit\":\"%s\",\"bench\":\"%s\",\"format\":\"%s\",\"lines\":%d,", c, b, f, n
+    printf "\"seconds\":%.6f,\"lines_per_sec\":%d%s}\n", s, (s > 0 ? n / s : 0), x
+  }')
+  echo "$line"
+  [ -z "$RESULTS" ] || echo "$line" >> "$RESULTS"
+}
+
+# timed <bench> <format> <goaccess args...>
+timed () {
+  bench=$1 fmt=$2
+  shift 2
+  secs=$("$GBENCH" time "$GOACCESS" --no-global-config "$@") || {
+    echo "bench: $bench ($fmt) failed" >&2
+    exit 1
+  }
+}
+
+# run <bench> <format> <goaccess args...>
+run () {
+  timed "$@"
+  report "$bench" "$fmt" "$secs"
+}
+
+# stage <bench> <format> <goaccess args...>
+# time a stage run on top of a restore, less the time the restore alone took
+stage () {
+  timed "$@"
+  report "$bench" "$fmt" "$(awk -v s="$secs" -v r="$restore" 'BEGIN { print (s > r ? s - r : 0) }')"
+}
+
+for fmt in $FORMATS; do
+  # shellcheck disable=SC2086
+  "$GBENCH" gen -f "$fmt" $GENOPTS > "$DIR/$fmt.log"
+done
+
+for fmt in $FORMATS; do
+  # shellcheck disable=SC2086
+  run parse "$fmt" "$DIR/$fmt.log" --log-format="$fmt" --process-and-exit $NOPANELS
+  run aggregate "$fmt" "$DIR/$fmt.log" --log-format="$fmt" --process-and-exit
+done
+
+# everything below uses the first format
+set -- $FORMATS
+fmt=$1
+log="$DIR/$fmt.log"
+
+# the log is parsed once, untimed, the stages below start off its dataset
+mkdir "$DIR/db"
+timed dataset "$fmt" "$log" --log-format="$fmt" --process-and-exit --persist --db-path="$DIR/db"
+db="--log-format=$fmt --restore --db-path=$DIR/db"
+# shellcheck disable=SC2086
+run restore "$fmt" $db --process-and-exit
+restore=$secs
+# shellcheck disable=SC2086
+stage persist "$fmt" $db --process-and-exit --persist
+# shellcheck disable=SC2086
+stage json "$fmt" $db -o "$DIR/report.json"
+# shellcheck disable=SC2086
+stage html "$fmt" $db -o "$DIR/report.html"
+
+# broadcast: time from appending the log to a followed file until a
+# connected client receives a report that accounts for all of it
+: > "$DIR/live.log"
+"$GOACCESS" "$DIR/live.log" --no-global-config --log-format="$fmt" --real-time-html \
+  --port="$PORT" -o "$DIR/live.html" > /dev/null 2>&1 &
+WSPID=$!
+out=$("$GBENCH" ws -p "$PORT" -l "$DIR/live.log" -t "$LINES" < "$log") || {
+  echo "bench: broadcast ($fmt) failed" >&2
+  exit 1
+}
+stop_ws
+set -- $out
+report broadcast "$fmt" "$1" ",\"ws_bytes\":$2,\"ws_messages\":$3"
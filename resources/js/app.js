@@ -709,6 +709,67 @@ GoAccess.OverallStats = {
 	}
 };
 
+// RUNTIME STATS
+GoAccess.RuntimeStats = {
+	// Format the timings of a pipeline stage or module insert
+	getRow: function (name, timer) {
+		var util = GoAccess.Util;
+		var work = 'bytes' == timer.unit ?
+			util.fmtValue(timer.items, 'bytes') :
+			util.fmtValue(timer.items, 'numeric') + (timer.unit ? ' ' + timer.unit : '');
+
+		return {
+			'name': name,
+			'count': util.fmtValue(timer.count, 'numeric'),
+			'work': work,
+			'total': util.fmtValue(timer.total_us, 'utime'),
+			'avg': util.fmtValue(timer.avg_us, 'utime'),
+			'p50': util.fmtValue(timer.p50_us, 'utime'),
+			'p99': util.fmtValue(timer.p99_us, 'utime'),
+			'max': util.fmtValue(timer.max_us, 'utime'),
+		};
+	},
+
+	// Render the runtime stats of each stage, then the sampled insert
+	// timings of each panel
+	renderData: function (data) {
+		var ui = GoAccess.getPanelUI(), rows = [], x = null;
+
+		for (x in data.stages)
+			rows.push(this.getRow(x, data.stages[x]));
+		for (x in data.modules) {
+			if (!ui.hasOwnProperty(x) || !ui[x].head)
+				continue;
+			rows.push(this.getRow(GoAccess.i18n.runtime_insert + ': ' + ui[x].head, data.modules[x]));
+		}
+
+		$('#runtime').innerHTML = GoAccess.AppTpls.Runtime.render({
+			'labels': GoAccess.i18n,
+			'linesPerSec': GoAccess.Util.fmtValue(data.lines_per_sec, 'numeric'),
+			'bytes': GoAccess.Util.fmtValue(data.bytes, 'bytes'),
+			'clients': GoAccess.Util.fmtValue(data.websocket.clients, 'numeric'),
+			'wsBytes': GoAccess.Util.fmtValue(data.websocket.bytes, 'bytes'),
+			'rows': rows,
+		});
+	},
+
+	// Render the runtime section, only reported with --runtime-stats
+	initialize: function () {
+		var data = GoAccess.getPanelData('runtime');
+		var wrap = $('#runtime');
+
+		if (!wrap)
+			return;
+
+		wrap.classList.toggle('hide', !data);
+		if (!data) {
+			wrap.innerHTML = '';
+			return;
+		}
+		this.renderData(data);
+	}
+};
+
 // RENDER PANELS
 GoAccess.Nav = {
 	events: function () {
@@ -2338,6 +2399,7 @@ GoAccess.App = {
 				'wrap': this.tpl($('#tpl-general').innerHTML),
 				'items': this.tpl($('#tpl-general-items').innerHTML),
 			},
+			'Runtime': this.tpl($('#tpl-runtime').innerHTML),
 			'Tables': {
 				'colgroup': this.tpl($('#tpl-table-colgroup').innerHTML),
 				'head': this.tpl($('#tpl-table-thead').innerHTML),
@@ -2431,6 +2493,7 @@ GoAccess.App = {
 
 		this.verifySort();
 		GoAccess.OverallStats.initialize();
+		GoAccess.RuntimeStats.initialize();
 
 		// do not rerender tables/charts if data hasn't changed
 		if (!GoAccess.AppState.updated)
@@ -2446,6 +2509,7 @@ GoAccess.App = {
 		GoAccess.Panels.initialize();
 		GoAccess.Charts.initialize();
 		GoAccess.Tables.initialize();
+		GoAccess.RuntimeStats.initialize();
 	},
 
 	initialize: function () {
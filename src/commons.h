@@ -118,7 +118,7 @@ typedef enum MODULES {
 } GModule;
 
 /* Total number of per-module storage slots (first GSMetric entries) */
-#define GSMTRC_TOTAL 7
+#define GSMTRC_TOTAL 8
 /* Total number of per-date global storage metrics (MTRC_UNIQUE_KEYS..MTRC_CNT_VISITORS) */
 #define GLOBAL_METRICS_TOTAL 6
 
@@ -136,6 +136,7 @@ typedef enum GSMetric_ {
   MTRC_METRICS,
   MTRC_AGENTS,
   MTRC_METADATA,
+  MTRC_SKETCHES,
   MTRC_ROOT,
   MTRC_HITS,
   MTRC_VISITORS,
@@ -87,9 +87,9 @@ load_host_agents (const char *addr) {
   GAgents *agents = NULL;
   GSLList *keys = NULL, *list = NULL;
   void *data = NULL;
-  uint32_t items = 4, key = djb2 ((const unsigned char *) addr);
+  uint32_t items = 4;
 
-  keys = ht_get_keymap_list_from_key (HOSTS, key);
+  keys = ht_get_keymap_list_from_str (HOSTS, addr);
   if (!keys)
     return NULL;
 
@@ -0,0 +1,181 @@
+/**
+ * garena.c -- bump allocator for short-lived parsing data
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "garena.h"
+
+#include "xmalloc.h"
+
+/* Allocate a new arena block able to hold at least size bytes.
+ *
+ * On success, the newly allocated block is returned. */
+static GArenaBlock *
+new_arena_block (size_t size) {
+  GArenaBlock *block = xmalloc (sizeof (*block));
+
+  block->data = xmalloc (size);
+  block->size = size;
+  block->used = 0;
+  block->next = NULL;
+
+  return block;
+}
+
+/* Instantiate a new arena whose regular blocks are block_size bytes.
+ *
+ * On success, the newly allocated arena is returned. */
+GArena *
+new_arena (size_t block_size) {
+  GArena *arena = xmalloc (sizeof (*arena));
+
+  arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+  arena->head = arena->cur = new_arena_block (arena->block_size);
+
+  return arena;
+}
+
+/* Hand out size bytes from the arena. Requests larger than a regular
+ * block get a dedicated block which is released on reset.
+ *
+ * On success, a pointer aligned to ARENA_ALIGN is returned. */
+void *
+arena_alloc (GArena *arena, size_t size) {
+  GArenaBlock *block = arena->cur, *big = NULL;
+  size_t off = 0;
+
+  size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+  if (size == 0)
+    size = ARENA_ALIGN;
+
+  while (block) {
+    off = block->used;
+    if (block->size - off >= size) {
+      block->used = off + size;
+      arena->cur = block;
+      return block->data + off;
+    }
+    /* move to the next already allocated block, if any */
+    if (block->next == NULL)
+      break;
+    block = block->next;
+  }
+
+  /* oversized allocation, give it its own block */
+  if (size > arena->block_size) {
+    big = new_arena_block (size);
+    big->used = size;
+    big->next = block->next;
+    block->next = big;
+    return big->data;
+  }
+
+  block->next = new_arena_block (arena->block_size);
+  arena->cur = block->next;
+  arena->cur->used = size;
+
+  return arena->cur->data;
+}
+
+/* Copy at most n bytes of the given string into the arena.
+ *
+ * On success, the NUL-terminated copy is returned. */
+char *
+arena_strndup (GArena *arena, const char *s, size_t n) {
+  char *p = arena_alloc (arena, n + 1);
+
+  memcpy (p, s, n);
+  p[n] = '\0';
+
+  return p;
+}
+
+/* Copy the given string into the arena.
+ *
+ * On success, the NUL-terminated copy is returned. */
+char *
+arena_strdup (GArena *arena, const char *s) {
+  return arena_strndup (arena, s, strlen (s));
+}
+
+/* Rewind the arena so its memory can be handed out again. Oversized
+ * blocks are released, regular blocks are kept for reuse. */
+void
+arena_reset (GArena *arena) {
+  GArenaBlock *block = arena->head, *prev = NULL, *next = NULL;
+
+  while (block) {
+    next = block->next;
+    if (block->size > arena->block_size) {
+      prev->next = next;
+      free (block->data);
+      free (block);
+    } else {
+      block->used = 0;
+      prev = block;
+    }
+    block = next;
+  }
+  arena->cur = arena->head;
+}
+
+/* Number of bytes held by the arena, including its bookkeeping. */
+size_t
+arena_size (const GArena *arena) {
+  const GArenaBlock *block = NULL;
+  size_t size = 0;
+
+  if (arena == NULL)
+    return 0;
+
+  size = sizeof (*arena);
+  for (block = arena->head; block; block = block->next)
+    size += sizeof (*block) + block->size;
+
+  return size;
+}
+
+/* Free all blocks owned by the arena and the arena itself. */
+void
+free_arena (GArena *arena) {
+  GArenaBlock *block = NULL, *next = NULL;
+
+  if (arena == NULL)
+    return;
+
+  for (block = arena->head; block; block = next) {
+    next = block->next;
+    free (block->data);
+    free (block);
+  }
+  free (arena);
+}
@@ -0,0 +1,62 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GARENA_H_INCLUDED
+#define GARENA_H_INCLUDED
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (256 * 1024)   /* default arena block size */
+#define ARENA_ALIGN      16     /* alignment of every allocation */
+
+/* A single chunk of arena memory */
+typedef struct GArenaBlock_ {
+  struct GArenaBlock_ *next;
+  size_t size;                  /* usable bytes in data */
+  size_t used;                  /* bytes handed out so far */
+  char *data;
+} GArenaBlock;
+
+/* Bump allocator. Allocations are never freed individually; the whole
+ * arena is rewound with arena_reset() and its blocks are reused. */
+typedef struct GArena_ {
+  GArenaBlock *head;            /* first block */
+  GArenaBlock *cur;             /* block currently handing out memory */
+  size_t block_size;            /* size of each regular block */
+} GArena;
+
+GArena *new_arena (size_t block_size);
+char *arena_strdup (GArena * arena, const char *s);
+char *arena_strndup (GArena * arena, const char *s, size_t n);
+void *arena_alloc (GArena * arena, size_t size);
+void arena_reset (GArena * arena);
+size_t arena_size (const GArena * arena);
+void free_arena (GArena * arena);
+
+#endif // for #ifndef GARENA_H
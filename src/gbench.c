@@ -0,0 +1,684 @@
+/**
+ * gbench.c -- synthetic log generator and timing helpers for `make bench`
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* first request of a generated log, 2024-01-01 00:00:00 UTC */
+#define GEN_START_TS 1704067200
+#define WS_TIMEOUT_MS 60000
+
+enum {
+  FMT_COMBINED,
+  FMT_VCOMBINED,
+  FMT_W3C,
+  FMT_CLOUDFRONT,
+  FMT_CADDY,
+};
+
+typedef struct GGenConf_ {
+  int format;
+  uint64_t lines;
+  uint32_t ips;
+  uint32_t urls;
+  uint32_t agents;
+  uint32_t referrers;
+  uint32_t days;
+  uint64_t seed;
+} GGenConf;
+
+/* A single generated request */
+typedef struct GGenReq_ {
+  time_t ts;
+  struct tm tm;
+  uint32_t msec;
+  char ip[16];
+  char vhost[32];
+  const char *method;
+  char path[64];
+  char query[32];
+  char ref[64];
+  char agent[256];
+  int status;
+  uint64_t bytes;
+  uint32_t ms;
+  uint64_t id;
+} GGenReq;
+
+/* *INDENT-OFF* */
+static const char *const formats[] = {
+  "COMBINED", "VCOMBINED", "W3C", "CLOUDFRONT", "CADDY",
+};
+
+static const char *const sections[] = {
+  "blog", "shop", "api", "docs", "news", "account", "search", "media",
+};
+
+static const char *const statics[] = {
+  "css", "js", "png", "jpg", "svg", "woff2",
+};
+
+static const char *const platforms[] = {
+  "Windows NT 10.0; Win64; x64",
+  "Macintosh; Intel Mac OS X 10_15_7",
+  "X11; Linux x86_64",
+  "Linux; Android 14; Pixel 8",
+  "iPhone; CPU iPhone OS 17_4 like Mac OS X",
+};
+/* *INDENT-ON* */
+
+static uint64_t rng_state;
+
+static void
+usage (const char *prog) {
+  fprintf (stderr, "Usage: %s gen [-f FORMAT] [-n LINES] [-i IPS] [-u URLS] [-a AGENTS]\n"
+           "                [-r REFERRERS] [-d DAYS] [-s SEED]\n"
+           "       %s time COMMAND [ARGS...]\n"
+           "       %s ws -p PORT -l LOG -t TOTAL < LINES\n\n"
+           "FORMAT is one of COMBINED, VCOMBINED, W3C, CLOUDFRONT or CADDY (JSON).\n",
+           prog, prog, prog);
+  exit (EXIT_FAILURE);
+}
+
+/* Deterministic 64-bit generator (splitmix64). */
+static uint64_t
+rng_next (void) {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Pick an index out of n, skewed towards the low end so that a few
+ * values are frequent and most are rare, as in real traffic. */
+static uint32_t
+rng_skewed (uint32_t n) {
+  double u = (double) (rng_next () >> 11) / (double) (1ULL << 53);
+  uint32_t idx = (uint32_t) (u * u * n);
+  return idx < n ? idx : n - 1;
+}
+
+static uint32_t
+rng_range (uint32_t n) {
+  return (uint32_t) (rng_next () % n);
+}
+
+/* Format the IPv4 address for the given client index. The multiplier is
+ * odd, so the first 2^24 indices map to distinct addresses. */
+static void
+gen_ip (char *buf, size_t len, uint32_t k) {
+  uint32_t v = (k * 2654435761u) & 0xffffff;
+  snprintf (buf, len, "%u.%u.%u.%u", 20 + (v % 200), (v >> 16) & 0xff, (v >> 8) & 0xff,
+            v & 0xff);
+}
+
+/* Format the request path for the given URL index. One out of five URLs
+ * is a static file. */
+static void
+gen_path (char *buf, size_t len, uint32_t k) {
+  size_t ns = sizeof (sections) / sizeof (sections[0]);
+  size_t nx = sizeof (statics) / sizeof (statics[0]);
+
+  if (k % 5 == 0)
+    snprintf (buf, len, "/static/%s/%u.%s", sections[k % ns], k, statics[(k / 5) % nx]);
+  else
+    snprintf (buf, len, "/%s/%u", sections[k % ns], k);
+}
+
+/* Format the user agent for the given agent index, a combination of a
+ * browser, a platform and a major version. */
+static void
+gen_agent (char *buf, size_t len, uint32_t k) {
+  size_t np = sizeof (platforms) / sizeof (platforms[0]);
+  const char *os = platforms[(k / 7) % np];
+  uint32_t ver = 60 + k / (7 * np);
+
+  switch (k % 7) {
+  case 0:
+    snprintf (buf, len, "Mozilla/5.0 (%s) AppleWebKit/537.36 (KHTML, like Gecko) "
+              "Chrome/%u.0.0.0 Safari/537.36", os, ver);
+    break;
+  case 1:
+    snprintf (buf, len, "Mozilla/5.0 (%s; rv:%u.0) Gecko/20100101 Firefox/%u.0", os, ver, ver);
+    break;
+  case 2:
+    snprintf (buf, len, "Mozilla/5.0 (%s) AppleWebKit/605.1.15 (KHTML, like Gecko) "
+              "Version/%u.0 Safari/605.1.15", os, ver % 20);
+    break;
+  case 3:
+    snprintf (buf, len, "Mozilla/5.0 (%s) AppleWebKit/537.36 (KHTML, like Gecko) "
+              "Chrome/%u.0.0.0 Safari/537.36 Edg/%u.0.0.0", os, ver, ver);
+    break;
+  case 4:
+    snprintf (buf, len, "curl/%u.%u.0", 7 + ver % 2, ver % 20);
+    break;
+  case 5:
+    snprintf (buf, len, "Mozilla/5.0 (compatible; Googlebot/2.%u; "
+              "+http://www.google.com/bot.html)", ver % 10);
+    break;
+  default:
+    snprintf (buf, len, "Mozilla/5.0 (compatible; bingbot/2.%u; "
+              "+http://www.bing.com/bingbot.htm)", ver % 10);
+    break;
+  }
+}
+
+/* Generate the i-th request of the log. */
+static void
+gen_request (const GGenConf *gc, uint64_t i, GGenReq *req) {
+  uint64_t span = (uint64_t) gc->days * 86400 * 1000;
+  uint64_t msec = gc->lines ? (i * span) / gc->lines : 0;
+  uint32_t r = rng_range (100);
+
+  req->ts = GEN_START_TS + (time_t) (msec / 1000);
+  gmtime_r (&req->ts, &req->tm);
+  req->msec = msec % 1000;
+  req->id = i;
+
+  gen_ip (req->ip, sizeof (req->ip), rng_skewed (gc->ips));
+  snprintf (req->vhost, sizeof (req->vhost), "www%u.example.com", rng_skewed (8));
+  req->method = rng_range (20) ? "GET" : "POST";
+  gen_path (req->path, sizeof (req->path), rng_skewed (gc->urls));
+  req->query[0] = '\0';
+  if (rng_range (4) == 0)
+    snprintf (req->query, sizeof (req->query), "id=%u", rng_range (1000));
+  gen_agent (req->agent, sizeof (req->agent), rng_skewed (gc->agents));
+
+  if (rng_range (2))
+    snprintf (req->ref, sizeof (req->ref), "-");
+  else
+    snprintf (req->ref, sizeof (req->ref), "https://www.site%u.com/", rng_skewed (gc->referrers));
+
+  req->status = r < 80 ? 200 : r < 88 ? 304 : r < 95 ? 404 : r < 98 ? 301 : 500;
+  req->bytes = req->status == 304 ? 0 : 200 + rng_range (50000);
+  req->ms = 1 + rng_range (2000);
+}
+
+/* Copy src into dst replacing spaces by the given string. */
+static const char *
+escape_spaces (char *dst, size_t len, const char *src, const char *with) {
+  size_t n = 0, wl = strlen (with);
+
+  for (; *src && n + wl < len; src++) {
+    if (*src == ' ') {
+      memcpy (dst + n, with, wl);
+      n += wl;
+    } else {
+      dst[n++] = *src;
+    }
+  }
+  dst[n] = '\0';
+
+  return dst;
+}
+
+static void
+write_combined (FILE *fp, const GGenReq *req, int vhost) {
+  char date[32];
+
+  strftime (date, sizeof (date), "%d/%b/%Y:%H:%M:%S +0000", &req->tm);
+  if (vhost)
+    fprintf (fp, "%s:443 ", req->vhost);
+  fprintf (fp, "%s - - [%s] \"%s %s%s%s HTTP/1.1\" %d %" PRIu64 " \"%s\" \"%s\"\n", req->ip,
+           date, req->method, req->path, *req->query ? "?" : "", req->query, req->status,
+           req->bytes, req->ref, req->agent);
+}
+
+static void
+write_w3c (FILE *fp, const GGenReq *req) {
+  char date[32], agent[512];
+
+  strftime (date, sizeof (date), "%Y-%m-%d %H:%M:%S", &req->tm);
+  fprintf (fp, "%s 10.0.0.1 %s %s %s 443 - %s %s %s %d 0 0 %u\n", date, req->method, req->path,
+           *req->query ? req->query : "-", req->ip,
+           escape_spaces (agent, sizeof (agent), req->agent, "+"), req->ref, req->status, req->ms);
+}
+
+static void
+write_cloudfront (FILE *fp, const GGenReq *req) {
+  char date[32], agent[768];
+
+  strftime (date, sizeof (date), "%Y-%m-%d\t%H:%M:%S", &req->tm);
+  fprintf (fp, "%s\tIAD89-C1\t%" PRIu64 "\t%s\t%s\t%s\t%s\t%d\t%s\t%s\t%s\t-\t%s\t"
+           "req%" PRIu64 "\t%s\thttps\t%u\t%.3f\t-\tTLSv1.3\tTLS_AES_128_GCM_SHA256\t%s\t"
+           "HTTP/2.0\t-\n", date, req->bytes, req->ip, req->method, req->vhost, req->path,
+           req->status, req->ref, escape_spaces (agent, sizeof (agent), req->agent, "%20"),
+           *req->query ? req->query : "-", req->id % 3 ? "Hit" : "Miss", req->id, req->vhost,
+           300 + (unsigned) (req->bytes % 500), req->ms / 1000.0, req->id % 3 ? "Hit" : "Miss");
+}
+
+static void
+write_caddy (FILE *fp, const GGenReq *req) {
+  fprintf (fp, "{\"level\":\"info\",\"ts\":%ld.%03u,\"logger\":\"http.log.access\","
+           "\"msg\":\"handled request\",\"request\":{\"remote_ip\":\"%s\",\"client_ip\":\"%s\","
+           "\"proto\":\"HTTP/2.0\",\"method\":\"%s\",\"host\":\"%s\",\"uri\":\"%s%s%s\","
+           "\"headers\":{\"User-Agent\":[\"%s\"],\"Referer\":[\"%s\"]},"
+           "\"tls\":{\"cipher_suite\":4865,\"proto\":772}},\"duration\":%.6f,\"size\":%" PRIu64
+           ",\"status\":%d,\"resp_headers\":{\"Content-Type\":[\"text/html; charset=utf-8\"]}}\n",
+           (long) req->ts, req->msec, req->ip, req->ip, req->method, req->vhost, req->path,
+           *req->query ? "?" : "", req->query, req->agent, req->ref, req->ms / 1000.0, req->bytes,
+           req->status);
+}
+
+/* Write the whole synthetic log to stdout. The same options and seed
+ * always produce the same log. */
+static int
+gen_log (const GGenConf *gc) {
+  GGenReq req;
+  uint64_t i;
+
+  rng_state = gc->seed;
+  if (gc->format == FMT_W3C)
+    printf ("#Software: Microsoft Internet Information Services 10.0\n#Version: 1.0\n"
+            "#Fields: date time s-ip cs-method cs-uri-stem cs-uri-query s-port cs-username "
+            "c-ip cs(User-Agent) cs(Referer) sc-status sc-substatus sc-win32-status "
+            "time-taken\n");
+
+  for (i = 0; i < gc->lines; ++i) {
+    gen_request (gc, i, &req);
+    switch (gc->format) {
+    case FMT_COMBINED:
+      write_combined (stdout, &req, 0);
+      break;
+    case FMT_VCOMBINED:
+      write_combined (stdout, &req, 1);
+      break;
+    case FMT_W3C:
+      write_w3c (stdout, &req);
+      break;
+    case FMT_CLOUDFRONT:
+      write_cloudfront (stdout, &req);
+      break;
+    case FMT_CADDY:
+      write_caddy (stdout, &req);
+      break;
+    }
+  }
+
+  return fflush (stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static uint32_t
+parse_count (const char *prog, const char *val) {
+  char *end = NULL;
+  unsigned long long n = strtoull (val, &end, 10);
+
+  if (end == val || *end != '\0' || n == 0 || n > UINT32_MAX)
+    usage (prog);
+  return (uint32_t) n;
+}
+
+static int
+cmd_gen (const char *prog, int argc, char **argv) {
+  GGenConf gc = { FMT_COMBINED, 100000, 10000, 5000, 500, 200, 7, 1 };
+  size_t i;
+  int o, found;
+
+  while ((o = getopt (argc, argv, "f:n:i:u:a:r:d:s:")) != -1) {
+    switch (o) {
+    case 'f':
+      found = 0;
+      for (i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+        if (strcmp (optarg, formats[i]) == 0) {
+          gc.format = (int) i;
+          found = 1;
+        }
+      }
+      if (strcmp (optarg, "JSON") == 0) {
+        gc.format = FMT_CADDY;
+        found = 1;
+      }
+      if (!found)
+        usage (prog);
+      break;
+    case 'n':
+      gc.lines = strtoull (optarg, NULL, 10);
+      break;
+    case 'i':
+      gc.ips = parse_count (prog, optarg);
+      if (gc.ips > 0xffffff)
+        gc.ips = 0xffffff;
+      break;
+    case 'u':
+      gc.urls = parse_count (prog, optarg);
+      break;
+    case 'a':
+      gc.agents = parse_count (prog, optarg);
+      break;
+    case 'r':
+      gc.referrers = parse_count (prog, optarg);
+      break;
+    case 'd':
+      gc.days = parse_count (prog, optarg);
+      break;
+    case 's':
+      gc.seed = strtoull (optarg, NULL, 10);
+      break;
+    default:
+      usage (prog);
+    }
+  }
+
+  return gen_log (&gc);
+}
+
+static double
+now_secs (void) {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Run the given command with its standard streams redirected to
+ * /dev/null and print the elapsed wall time in seconds. */
+static int
+cmd_time (int argc, char **argv) {
+  double start = now_secs ();
+  int status = 0, fd;
+  pid_t pid;
+
+  if (argc < 1)
+    return EXIT_FAILURE;
+
+  if ((pid = fork ()) == -1) {
+    perror ("fork");
+    return EXIT_FAILURE;
+  }
+
+  if (pid == 0) {
+    if ((fd = open ("/dev/null", O_RDWR)) != -1) {
+      dup2 (fd, STDIN_FILENO);
+      dup2 (fd, STDOUT_FILENO);
+      dup2 (fd, STDERR_FILENO);
+      close (fd);
+    }
+    execvp (argv[0], argv);
+    _exit (127);
+  }
+
+  while (waitpid (pid, &status, 0) == -1 && errno == EINTR);
+  printf ("%.6f\n", now_secs () - start);
+
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Read exactly len bytes from the socket, waiting at most until the given
+ * deadline.
+ *
+ * On error or timeout, -1 is returned.
+ * On success, 0 is returned. */
+static int
+read_full (int fd, void *buf, size_t len, double deadline) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  size_t n = 0;
+  ssize_t r;
+  int ms;
+
+  while (n < len) {
+    ms = (int) ((deadline - now_secs ()) * 1000);
+    if (ms <= 0 || poll (&pfd, 1, ms) <= 0)
+      return -1;
+    if ((r = read (fd, (char *) buf + n, len - n)) <= 0)
+      return -1;
+    n += (size_t) r;
+  }
+
+  return 0;
+}
+
+/* Read a whole WebSocket message, joining fragmented frames. Server
+ * frames are never masked.
+ *
+ * On error or timeout, NULL is returned.
+ * On success, the NUL-terminated payload is returned. */
+static char *
+ws_read_message (int fd, size_t *size, double deadline) {
+  unsigned char hdr[8];
+  uint64_t len;
+  size_t total = 0;
+  char *msg = NULL, *tmp;
+  int fin = 0, i;
+
+  while (!fin) {
+    if (read_full (fd, hdr, 2, deadline))
+      goto fail;
+    fin = hdr[0] & 0x80;
+    len = hdr[1] & 0x7f;
+    if (len == 126) {
+      if (read_full (fd, hdr, 2, deadline))
+        goto fail;
+      len = ((uint64_t) hdr[0] << 8) | hdr[1];
+    } else if (len == 127) {
+      if (read_full (fd, hdr, 8, deadline))
+        goto fail;
+      for (len = 0, i = 0; i < 8; ++i)
+        len = (len << 8) | hdr[i];
+    }
+    if ((tmp = realloc (msg, total + len + 1)) == NULL)
+      goto fail;
+    msg = tmp;
+    if (read_full (fd, msg + total, len, deadline))
+      goto fail;
+    total += len;
+    msg[total] = '\0';
+  }
+  *size = total + 2;
+
+  return msg;
+
+fail:
+  free (msg);
+  return NULL;
+}
+
+/* Connect to the local WebSocket server and complete the handshake,
+ * retrying until the server is up or the deadline passes.
+ *
+ * On error, -1 is returned.
+ * On success, the connected socket is returned. */
+static int
+ws_connect (int port, double deadline) {
+  static const char req[] =
+    "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+  struct timespec retry = { 0, 50000000 };
+  struct sockaddr_in addr;
+  char buf[1024];
+  size_t n = 0;
+  int fd;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons ((uint16_t) port);
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  for (;;) {
+    if ((fd = socket (AF_INET, SOCK_STREAM, 0)) == -1)
+      return -1;
+    if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+      break;
+    close (fd);
+    if (now_secs () > deadline)
+      return -1;
+    nanosleep (&retry, NULL);
+  }
+
+  if (write (fd, req, sizeof (req) - 1) != (ssize_t) (sizeof (req) - 1))
+    goto fail;
+
+  /* response headers, byte by byte so no frame data is consumed */
+  while (n < sizeof (buf) - 1) {
+    if (read_full (fd, buf + n, 1, deadline))
+      goto fail;
+    buf[++n] = '\0';
+    if (n >= 4 && memcmp (buf + n - 4, "\r\n\r\n", 4) == 0)
+      break;
+  }
+  if (strstr (buf, " 101 ") != NULL)
+    return fd;
+
+fail:
+  close (fd);
+  return -1;
+}
+
+/* Read all of stdin into memory.
+ *
+ * On success, the buffer is returned and its length set. */
+static char *
+read_stdin (size_t *len) {
+  size_t cap = 1 << 20, n = 0;
+  char *buf = NULL, *tmp;
+  ssize_t r;
+
+  for (;;) {
+    if (buf == NULL || n == cap) {
+      cap = buf ? cap * 2 : cap;
+      if ((tmp = realloc (buf, cap)) == NULL) {
+        free (buf);
+        return NULL;
+      }
+      buf = tmp;
+    }
+    if ((r = read (STDIN_FILENO, buf + n, cap - n)) <= 0)
+      break;
+    n += (size_t) r;
+  }
+  *len = n;
+
+  return buf;
+}
+
+/* Connect to a real-time HTML server, append the lines read from stdin
+ * to the followed log and wait until a broadcast reports the given number
+ * of total requests. Prints the elapsed seconds, the bytes received and
+ * the number of messages received since appending. */
+static int
+cmd_ws (const char *prog, int argc, char **argv) {
+  const char *log = NULL, *p;
+  double start, deadline = now_secs () + WS_TIMEOUT_MS / 1000.0;
+  uint64_t total = 0, bytes = 0, msgs = 0;
+  size_t len = 0, size = 0, off = 0;
+  char *lines, *msg;
+  ssize_t w;
+  int o, port = 0, fd, lfd;
+
+  while ((o = getopt (argc, argv, "p:l:t:")) != -1) {
+    switch (o) {
+    case 'p':
+      port = atoi (optarg);
+      break;
+    case 'l':
+      log = optarg;
+      break;
+    case 't':
+      total = strtoull (optarg, NULL, 10);
+      break;
+    default:
+      usage (prog);
+    }
+  }
+  if (port <= 0 || log == NULL || total == 0)
+    usage (prog);
+
+  if ((lines = read_stdin (&len)) == NULL)
+    return EXIT_FAILURE;
+  if ((fd = ws_connect (port, deadline)) == -1) {
+    fprintf (stderr, "%s: unable to connect to port %d\n", prog, port);
+    return EXIT_FAILURE;
+  }
+
+  /* the current report is sent as soon as the client connects */
+  if ((msg = ws_read_message (fd, &size, deadline)) == NULL)
+    goto fail;
+  free (msg);
+
+  if ((lfd = open (log, O_WRONLY | O_APPEND)) == -1) {
+    perror (log);
+    goto fail;
+  }
+  start = now_secs ();
+  deadline = start + WS_TIMEOUT_MS / 1000.0;
+  while (off < len && (w = write (lfd, lines + off, len - off)) > 0)
+    off += (size_t) w;
+  close (lfd);
+
+  while ((msg = ws_read_message (fd, &size, deadline)) != NULL) {
+    bytes += size;
+    msgs++;
+    p = strstr (msg, "\"total_requests\":");
+    if (p && strtoull (p + 17, NULL, 10) >= total) {
+      free (msg);
+      printf ("%.6f %" PRIu64 " %" PRIu64 "\n", now_secs () - start, bytes, msgs);
+      close (fd);
+      free (lines);
+      return EXIT_SUCCESS;
+    }
+    free (msg);
+  }
+  fprintf (stderr, "%s: timed out waiting for %" PRIu64 " requests\n", prog, total);
+
+fail:
+  close (fd);
+  free (lines);
+  return EXIT_FAILURE;
+}
+
+int
+main (int argc, char **argv) {
+  if (argc < 2)
+    usage (argv[0]);
+
+  if (strcmp (argv[1], "gen") == 0)
+    return cmd_gen (argv[0], argc - 1, argv + 1);
+  if (strcmp (argv[1], "time") == 0)
+    return cmd_time (argc - 2, argv + 2);
+  if (strcmp (argv[1], "ws") == 0)
+    return cmd_ws (argv[0], argc - 1, argv + 1);
+
+  usage (argv[0]);
+  return EXIT_FAILURE;
+}
@@ -30,6 +30,7 @@
 
 #define _XOPEN_SOURCE 700
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,22 +50,60 @@
 
 static GFind find_t;
 
+/* The search thread builds the match index of find_t */
+static pthread_t find_thread;
+static pthread_mutex_t find_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t find_cond = PTHREAD_COND_INITIALIZER;
+static regex_t find_regex;
+
 /* Forward declarations */
 static int count_sub_items_recursive (GSubList * sl);
 static int count_visible_sub (GSubList * sl, uint8_t * node_exp, int node_exp_size, int *full_idx);
 
+/* Stop the search thread, if any, and drop its match index.
+ *
+ * This needs to be called before the holder being indexed is modified or
+ * freed. The pattern and the last visited match are kept, so the next
+ * search rebuilds the index and carries on after that match. */
+void
+invalidate_find (void) {
+  if (find_t.holder == NULL)
+    return;
+
+  pthread_mutex_lock (&find_mutex);
+  find_t.cancel = 1;
+  pthread_mutex_unlock (&find_mutex);
+
+  pthread_join (find_thread, NULL);
+  regfree (&find_regex);
+  free (find_t.matches);
+
+  find_t.holder = NULL;
+  find_t.matches = NULL;
+  find_t.matches_size = 0;
+  find_t.matches_idx = 0;
+  find_t.cur = 0;
+  find_t.done = 0;
+  find_t.cancel = 0;
+  find_t.error = 0;
+  find_t.resume = find_t.last.parent_idx >= 0;
+}
+
 /* Reset find indices */
 void
 reset_find (void) {
+  invalidate_find ();
+
   if (find_t.pattern != NULL && *find_t.pattern != '\0')
     free (find_t.pattern);
 
-  find_t.look_in_sub = 0;
   find_t.module = 0;
   find_t.next_idx = 0; /* next total index    */
   find_t.next_parent_idx = 0; /* next parent index   */
   find_t.next_sub_idx = 0; /* next sub item index */
   find_t.pattern = NULL;
+  find_t.last.parent_idx = -1;
+  find_t.resume = 0;
 }
 
 /* Allocate memory for a new GDash instance.
@@ -207,16 +246,13 @@ set_module_from_mouse_event (GScroll *gscroll, GDash *dash, int y) {
   return 0;
 }
 
-/* Allocate a new string for a sub item on the terminal dashboard.
+/* Set into the given buffer the tree prefix drawn before a sub item on the
+ * terminal dashboard.
  *
- * On error, NULL is returned.
- * On success, the newly allocated string is returned. */
-static char *
-render_child_node (const char *data, int depth, uint32_t parent_state, int is_last) {
-  char *buf;
-  int len = 0;
+ * On success, the length of the prefix is returned. */
+static size_t
+set_child_node_prefix (char *prefix, int depth, uint32_t parent_state, int is_last) {
   int i;
-  char prefix[512] = "";
 
   /* chars to use based on encoding used */
 #ifdef HAVE_LIBNCURSESW
@@ -231,9 +267,7 @@ render_child_node (const char *data, int depth, uint32_t parent_state, int is_la
   const char *space = "  ";
 #endif
 
-  if (data == NULL || *data == '\0')
-    return NULL;
-
+  *prefix = '\0';
   /* Build the prefix by examining parent_state bits
    * For each ancestor level, draw either │ or space */
   for (i = 1; i < depth; i++) {
@@ -249,6 +283,23 @@ render_child_node (const char *data, int depth, uint32_t parent_state, int is_la
   strcat (prefix, is_last ? last : branch);
   strcat (prefix, " ");
 
+  return strlen (prefix);
+}
+
+/* Allocate a new string for a sub item on the terminal dashboard.
+ *
+ * On error, NULL is returned.
+ * On success, the newly allocated string is returned. */
+static char *
+render_child_node (const char *data, int depth, uint32_t parent_state, int is_last) {
+  char *buf;
+  int len = 0;
+  char prefix[512] = "";
+
+  if (data == NULL || *data == '\0')
+    return NULL;
+
+  set_child_node_prefix (prefix, depth, parent_state, is_last);
   len = snprintf (NULL, 0, "%s%s", prefix, data);
   buf = xmalloc (len + 1);
   sprintf (buf, "%s%s", prefix, data);
@@ -256,24 +307,69 @@ render_child_node (const char *data, int depth, uint32_t parent_state, int is_la
   return buf;
 }
 
+/* Set the numeric metrics of a dashboard row given the holder's metrics. */
+static void
+set_dash_row_numbers (GMetrics *dst, const GMetrics *src, GPercTotals totals) {
+  dst->hits = src->hits;
+  dst->hits_perc = get_percentage (totals.hits, src->hits);
+  dst->visitors = src->visitors;
+  dst->visitors_perc = get_percentage (totals.visitors, src->visitors);
+  dst->nbw = src->nbw;
+  dst->bw_perc = get_percentage (totals.bw, src->nbw);
+
+  if (conf.append_method && src->method)
+    dst->method = src->method;
+  if (conf.append_protocol && src->protocol)
+    dst->protocol = src->protocol;
+}
+
+/* Format the metrics of a dashboard row out of the holder the first time
+ * the row is drawn. Rows out of view are never formatted.
+ *
+ * On success, the formatted metrics of the row are returned. */
+static GMetrics *
+get_dash_row_metrics (GDashModule *data, int idx) {
+  GDashData *idata = &data->data[idx];
+  GMetrics *src = idata->src;
+  char *node = NULL;
+
+  if (idata->metrics)
+    return idata->metrics;
+
+  idata->metrics = new_gmetrics ();
+  set_dash_row_numbers (idata->metrics, src, data->totals);
+
+  if (idata->is_subitem)
+    node = render_child_node (src->data, idata->is_subitem, idata->parent_state, idata->is_last);
+  idata->metrics->data = node ? node : xstrdup (src->data);
+
+  if (conf.serve_usecs) {
+    idata->metrics->avgts.sts = usecs_to_str (src->avgts.nts);
+    idata->metrics->cumts.sts = usecs_to_str (src->cumts.nts);
+    idata->metrics->maxts.sts = usecs_to_str (src->maxts.nts);
+  }
+
+  return idata->metrics;
+}
+
 /* Get largest hits metric.
  *
  * On error, 0 is returned.
  * On success, largest hits metric is returned. */
 static void
-set_max_metrics (GDashMeta *meta, GDashData *idata) {
-  if (meta->max_hits < idata->metrics->hits)
-    meta->max_hits = idata->metrics->hits;
-  if (meta->max_visitors < idata->metrics->visitors)
-    meta->max_visitors = idata->metrics->visitors;
-  if (meta->max_bw < idata->metrics->nbw)
-    meta->max_bw = idata->metrics->nbw;
+set_max_metrics (GDashMeta *meta, GMetrics *metrics) {
+  if (meta->max_hits < metrics->hits)
+    meta->max_hits = metrics->hits;
+  if (meta->max_visitors < metrics->visitors)
+    meta->max_visitors = metrics->visitors;
+  if (meta->max_bw < metrics->nbw)
+    meta->max_bw = metrics->nbw;
 }
 
 /* Set largest hits metric (length of the integer). */
 static void
-set_max_hit_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = intlen (idata->metrics->hits);
+set_max_hit_len (GDashMeta *meta, GMetrics *metrics) {
+  int vlen = intlen (metrics->hits);
   int llen = strlen (MTRC_HITS_LBL);
 
   if (vlen > meta->hits_len)
@@ -286,8 +382,8 @@ set_max_hit_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length. */
 static void
-set_max_hit_perc_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = intlen (idata->metrics->hits_perc);
+set_max_hit_perc_len (GDashMeta *meta, GMetrics *metrics) {
+  int vlen = intlen (metrics->hits_perc);
   int llen = strlen (MTRC_HITS_PERC_LBL);
 
   if (vlen > meta->hits_perc_len)
@@ -300,8 +396,8 @@ set_max_hit_perc_len (GDashMeta *meta, GDashData *idata) {
 
 /* Set largest hits metric (length of the integer). */
 static void
-set_max_visitors_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = intlen (idata->metrics->visitors);
+set_max_visitors_len (GDashMeta *meta, GMetrics *metrics) {
+  int vlen = intlen (metrics->visitors);
   int llen = strlen (MTRC_VISITORS_SHORT_LBL);
 
   if (vlen > meta->visitors_len)
@@ -314,8 +410,8 @@ set_max_visitors_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length. */
 static void
-set_max_visitors_perc_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = intlen (idata->metrics->visitors_perc);
+set_max_visitors_perc_len (GDashMeta *meta, GMetrics *metrics) {
+  int vlen = intlen (metrics->visitors_perc);
   int llen = strlen (MTRC_VISITORS_PERC_LBL);
 
   if (vlen > meta->visitors_perc_len)
@@ -328,8 +424,8 @@ set_max_visitors_perc_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length for bandwidth percentage. */
 static void
-set_max_bw_perc_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = intlen (idata->metrics->bw_perc);
+set_max_bw_perc_len (GDashMeta *meta, GMetrics *metrics) {
+  int vlen = intlen (metrics->bw_perc);
   int llen = strlen (MTRC_BW_PERC_LBL); // You need to define this label
 
   if (vlen > meta->bw_perc_len)
@@ -341,10 +437,16 @@ set_max_bw_perc_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length. */
 static void
-set_max_bw_len (GDashMeta *meta, GDashData *idata) {
-  char *bw_str = filesize_str (idata->metrics->nbw);
-  int vlen = strlen (bw_str);
-  int llen = strlen (MTRC_BW_LBL);
+set_max_bw_len (GDashMeta *meta, GMetrics *metrics) {
+  char *bw_str = NULL;
+  int vlen = 0, llen = 0;
+
+  if (!conf.bandwidth)
+    return;
+
+  bw_str = filesize_str (metrics->nbw);
+  vlen = strlen (bw_str);
+  llen = strlen (MTRC_BW_LBL);
 
   if (vlen > meta->bw_len)
     meta->bw_len = vlen;
@@ -356,67 +458,13 @@ set_max_bw_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length. */
 static void
-set_max_avgts_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = 0, llen = 0;
-
-  if (!conf.serve_usecs || !idata->metrics->avgts.sts)
-    return;
-
-  vlen = strlen (idata->metrics->avgts.sts);
-  llen = strlen (MTRC_AVGTS_LBL);
-  if (vlen > meta->avgts_len)
-    meta->avgts_len = vlen;
-  /* if outputting with column names, then determine if the value is
-   * longer than the length of the column name */
-  if (llen > meta->avgts_len)
-    meta->avgts_len = llen;
-}
-
-/* Get the percent integer length. */
-static void
-set_max_cumts_len (GDashMeta *meta, GDashData *idata) {
+set_max_method_len (GDashMeta *meta, GMetrics *metrics) {
   int vlen = 0, llen = 0;
 
-  if (!conf.serve_usecs || !idata->metrics->cumts.sts)
+  if (!conf.append_method || !metrics->method)
     return;
 
-  vlen = strlen (idata->metrics->cumts.sts);
-  llen = strlen (MTRC_AVGTS_LBL);
-  if (vlen > meta->cumts_len)
-    meta->cumts_len = vlen;
-  /* if outputting with column names, then determine if the value is
-   * longer than the length of the column name */
-  if (llen > meta->cumts_len)
-    meta->cumts_len = llen;
-}
-
-/* Get the percent integer length. */
-static void
-set_max_maxts_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = 0, llen = 0;
-
-  if (!conf.serve_usecs || !idata->metrics->maxts.sts)
-    return;
-
-  vlen = strlen (idata->metrics->maxts.sts);
-  llen = strlen (MTRC_AVGTS_LBL);
-  if (vlen > meta->maxts_len)
-    meta->maxts_len = vlen;
-  /* if outputting with column names, then determine if the value is
-   * longer than the length of the column name */
-  if (llen > meta->maxts_len)
-    meta->maxts_len = llen;
-}
-
-/* Get the percent integer length. */
-static void
-set_max_method_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = 0, llen = 0;
-
-  if (!conf.append_method || !idata->metrics->method)
-    return;
-
-  vlen = strlen (idata->metrics->method);
+  vlen = strlen (metrics->method);
   llen = strlen (MTRC_METHODS_SHORT_LBL);
   if (vlen > meta->method_len)
     meta->method_len = vlen;
@@ -428,13 +476,13 @@ set_max_method_len (GDashMeta *meta, GDashData *idata) {
 
 /* Get the percent integer length. */
 static void
-set_max_protocol_len (GDashMeta *meta, GDashData *idata) {
+set_max_protocol_len (GDashMeta *meta, GMetrics *metrics) {
   int vlen = 0, llen = 0;
 
-  if (!conf.append_protocol || !idata->metrics->protocol)
+  if (!conf.append_protocol || !metrics->protocol)
     return;
 
-  vlen = strlen (idata->metrics->protocol);
+  vlen = strlen (metrics->protocol);
   llen = strlen (MTRC_PROTOCOLS_SHORT_LBL);
   if (vlen > meta->protocol_len)
     meta->protocol_len = vlen;
@@ -444,13 +492,12 @@ set_max_protocol_len (GDashMeta *meta, GDashData *idata) {
     meta->protocol_len = llen;
 }
 
-/* Get the percent integer length. */
+/* Set the largest length of the data column given the length of a row's
+ * data, including its tree prefix. */
 static void
-set_max_data_len (GDashMeta *meta, GDashData *idata) {
-  int vlen = 0, llen = 0;
+set_max_data_len (GDashMeta *meta, int vlen) {
+  int llen = strlen (MTRC_DATA_LBL);
 
-  vlen = strlen (idata->metrics->data);
-  llen = strlen (MTRC_DATA_LBL);
   if (vlen > meta->data_len)
     meta->data_len = vlen;
   /* if outputting with column names, then determine if the value is
@@ -459,23 +506,22 @@ set_max_data_len (GDashMeta *meta, GDashData *idata) {
     meta->data_len = llen;
 }
 
+/* Update the column widths of a panel with the given row's metrics, so they
+ * are maintained as rows are added rather than over the formatted rows. */
 static void
-set_metrics_len (GDashMeta *meta, GDashData *idata) {
+set_metrics_len (GDashMeta *meta, GMetrics *metrics, int data_len) {
   /* integer-based length */
-  set_max_hit_len (meta, idata);
-  set_max_hit_perc_len (meta, idata);
-  set_max_visitors_len (meta, idata);
-  set_max_visitors_perc_len (meta, idata);
-  set_max_bw_len (meta, idata);
-  set_max_bw_perc_len (meta, idata); // ← NEW
+  set_max_hit_len (meta, metrics);
+  set_max_hit_perc_len (meta, metrics);
+  set_max_visitors_len (meta, metrics);
+  set_max_visitors_perc_len (meta, metrics);
+  set_max_bw_len (meta, metrics);
+  set_max_bw_perc_len (meta, metrics); // ← NEW
 
   /* string-based length */
-  set_max_avgts_len (meta, idata);
-  set_max_cumts_len (meta, idata);
-  set_max_maxts_len (meta, idata);
-  set_max_method_len (meta, idata);
-  set_max_protocol_len (meta, idata);
-  set_max_data_len (meta, idata);
+  set_max_method_len (meta, metrics);
+  set_max_protocol_len (meta, metrics);
+  set_max_data_len (meta, data_len);
 }
 
 /* Render host's panel selected row */
@@ -928,6 +974,7 @@ render_data_line (WINDOW *win, GDashModule *data, int *y, int j, GScroll *gscrol
     goto out;
 
   sel = expanded && j == gscroll->module[module].scroll ? 1 : 0;
+  get_dash_row_metrics (data, j);
 
   /* Render +/- expand indicator for items with children */
   if (expanded && data->data[j].has_children) {
@@ -1339,8 +1386,9 @@ perform_find_dash_scroll (GScroll *gscroll, GModule module, GHolder *h) {
 
   /* Expand ancestors of the found item and compute flat index.
    *
-   * find_t.next_sub_idx is set to (1 + i) by find_next_sub_item as a resume
-   * position. A value > 0 means the match is a sub-item at position (next_sub_idx - 1).
+   * find_t.next_sub_idx is set by perform_next_find to the sub_idx of the
+   * indexed match, which index_find_sub_items numbers from 1 in display order.
+   * A value > 0 means the match is a sub-item at position (next_sub_idx - 1).
    * A value of 0 means the match is at the root level. */
   if (h != NULL) {
     int is_sub_match = (find_t.next_sub_idx > 0) ? 1 : 0;
@@ -1363,124 +1411,217 @@ perform_find_dash_scroll (GScroll *gscroll, GModule module, GHolder *h) {
   find_t.module = module;
 }
 
-/* Find the searched item within the given sub list.
+/* Compare two search matches by their position in the dashboard.
  *
- * If not found, the GFind structure is reset and 1 is returned.
- * If found, a GFind structure is set and 0 is returned. */
+ * Returns a negative, zero or positive value if a comes before, is the same
+ * as, or comes after b. */
 static int
-find_next_sub_item (GSubList *sub_list, regex_t *regex) {
-  GSubItem *iter;
+cmp_find_match (const GFindMatch *a, const GFindMatch *b) {
+  int ma = get_module_index (a->module), mb = get_module_index (b->module);
+
+  if (ma != mb)
+    return ma - mb;
+  if (a->parent_idx != b->parent_idx)
+    return a->parent_idx - b->parent_idx;
+  return a->sub_idx - b->sub_idx;
+}
+
+/* Append a match to the index and wake up whoever is waiting for it.
+ *
+ * Note: the caller must hold the find_mutex. */
+static void
+push_find_match (GModule module, int parent_idx, int sub_idx) {
+  GFindMatch *match;
+
+  if (find_t.matches_idx == find_t.matches_size) {
+    find_t.matches_size = find_t.matches_size ? find_t.matches_size * 2 : 64;
+    find_t.matches = xrealloc (find_t.matches, find_t.matches_size * sizeof (GFindMatch));
+  }
+
+  match = &find_t.matches[find_t.matches_idx++];
+  match->module = module;
+  match->parent_idx = parent_idx;
+  match->sub_idx = sub_idx;
+  pthread_cond_broadcast (&find_cond);
+}
+
+/* Match the given string and add it to the index if it matches.
+ *
+ * On error, the regexec(3) error code is returned.
+ * Otherwise, 0 is returned. */
+static int
+index_find_match (const char *data, GModule module, int parent_idx, int sub_idx) {
+  int rc = regexec (&find_regex, data, 0, NULL, 0);
+
+  if (rc == REG_NOMATCH)
+    return 0;
+  if (rc != 0)
+    return rc;
+
+  pthread_mutex_lock (&find_mutex);
+  push_find_match (module, parent_idx, sub_idx);
+  pthread_mutex_unlock (&find_mutex);
+
+  return 0;
+}
+
+/* Match all sub items (two levels deep) of a root item, in the order in
+ * which they are displayed.
+ *
+ * On error, the regexec(3) error code is returned.
+ * Otherwise, 0 is returned. */
+static int
+index_find_sub_items (GSubList *sub_list, GModule module, int parent_idx) {
+  GSubItem *iter, *nested;
   int i = 0, rc;
 
   if (sub_list == NULL)
-    goto out;
+    return 0;
 
   for (iter = sub_list->head; iter; iter = iter->next) {
-    if (i >= find_t.next_sub_idx) {
-      rc = regexec (regex, iter->metrics->data, 0, NULL, 0);
-      if (rc == 0) {
-        find_t.next_idx++;
-        find_t.next_sub_idx = (1 + i);
-        return 0;
-      }
-      find_t.next_idx++;
+    if ((rc = index_find_match (iter->metrics->data, module, parent_idx, ++i)))
+      return rc;
+    if (iter->sub_list == NULL)
+      continue;
+    for (nested = iter->sub_list->head; nested; nested = nested->next) {
+      if ((rc = index_find_match (nested->metrics->data, module, parent_idx, ++i)))
+        return rc;
     }
-    i++;
-    /* recurse into nested sub-items */
-    if (iter->sub_list != NULL) {
-      GSubItem *nested;
-      for (nested = iter->sub_list->head; nested; nested = nested->next) {
-        if (i >= find_t.next_sub_idx) {
-          rc = regexec (regex, nested->metrics->data, 0, NULL, 0);
-          if (rc == 0) {
-            find_t.next_idx++;
-            find_t.next_sub_idx = (1 + i);
-            return 0;
-          }
-          find_t.next_idx++;
-        }
-        i++;
-      }
+  }
+
+  return 0;
+}
+
+/* Entry point of the search thread. Match the pattern against every item
+ * and sub item across all panels and build the match index. */
+static void *
+find_index_worker (void *arg) {
+  GHolder *h = arg;
+  GModule module;
+  size_t idx = 0;
+  int j, n, rc = 0, cancel = 0;
+
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    n = h[module].idx;
+    for (j = 0; j < n; j++) {
+      pthread_mutex_lock (&find_mutex);
+      cancel = find_t.cancel;
+      pthread_mutex_unlock (&find_mutex);
+      if (cancel)
+        return NULL;
+
+      if ((rc = index_find_match (h[module].items[j].metrics->data, module, j, 0)))
+        goto out;
+      if ((rc = index_find_sub_items (h[module].items[j].sub_list, module, j)))
+        goto out;
     }
   }
 
 out:
-  find_t.next_parent_idx++;
-  find_t.next_sub_idx = 0;
-  find_t.look_in_sub = 0;
+  pthread_mutex_lock (&find_mutex);
+  find_t.error = rc;
+  find_t.done = 1;
+  pthread_cond_broadcast (&find_cond);
+  pthread_mutex_unlock (&find_mutex);
 
-  return 1;
+  return NULL;
+}
+
+/* Compile the current pattern and start indexing the given holder in the
+ * background.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+start_find_index (GHolder *h) {
+  if (regexp_init (&find_regex, find_t.pattern))
+    return 1;
+
+  find_t.holder = h;
+  if (pthread_create (&find_thread, NULL, find_index_worker, h) != 0)
+    FATAL ("Failed to create search thread");
+
+  return 0;
 }
 
 /* Perform a forward search across all modules.
+ *
+ * The first search over a holder starts indexing it in the background,
+ * then every search steps to the next indexed match, waiting for the
+ * search thread only if it hasn't gotten that far yet. Once past the last
+ * match, panels are collapsed and the search starts over.
+ *
+ * Note: as it may wait for the search thread, the caller must not hold the
+ * gdns_thread.mutex. The search only reads the given holder.
  *
  * On error or if not found, 1 is returned.
  * On success or if found, a GFind structure is set and 0 is returned. */
 int
 perform_next_find (GHolder *h, GScroll *gscroll) {
-  GModule module;
-  GSubList *sub_list;
-  regex_t regex;
-  char buf[REGEX_ERROR], *data;
-  int y, x, j, n, rc;
-  size_t idx = 0;
+  GFindMatch match;
+  char buf[REGEX_ERROR];
+  int y, x, found = 0, error = 0;
 
   getmaxyx (stdscr, y, x);
 
   if (find_t.pattern == NULL || *find_t.pattern == '\0')
     return 1;
 
-  /* compile and initialize regexp */
-  if (regexp_init (&regex, find_t.pattern))
+  /* the holder was rebuilt since the last search, index it again */
+  if (find_t.holder != h) {
+    invalidate_find ();
+    if (start_find_index (h))
+      return 1;
+  }
+
+  pthread_mutex_lock (&find_mutex);
+  for (;;) {
+    /* re-indexed, carry on after the last visited match */
+    while (find_t.resume && find_t.cur < find_t.matches_idx &&
+           cmp_find_match (&find_t.matches[find_t.cur], &find_t.last) <= 0)
+      find_t.cur++;
+    if (find_t.cur < find_t.matches_idx || find_t.done)
+      break;
+    pthread_cond_wait (&find_cond, &find_mutex);
+  }
+
+  if (find_t.cur < find_t.matches_idx) {
+    match = find_t.matches[find_t.cur++];
+    found = 1;
+  } else if (find_t.error) {
+    error = find_t.error;
+  }
+  pthread_mutex_unlock (&find_mutex);
+
+  /* error matching against the precompiled pattern buffer */
+  if (error) {
+    regerror (error, &find_regex, buf, sizeof (buf));
+    draw_header (stdscr, buf, "%s", y - 1, 0, x, color_error);
+    refresh ();
     return 1;
+  }
 
-  /* use last find_t.module and start search */
-  idx = find_t.module;
-  FOREACH_MODULE (idx, module_list) {
-    module = module_list[idx];
-    n = h[module].idx;
-    for (j = find_t.next_parent_idx; j < n; j++, find_t.next_idx++) {
-      data = h[module].items[j].metrics->data;
-      rc = regexec (&regex, data, 0, NULL, 0);
-      /* error matching against the precompiled pattern buffer */
-      if (rc != 0 && rc != REG_NOMATCH) {
-        regerror (rc, &regex, buf, sizeof (buf));
-        draw_header (stdscr, buf, "%s", y - 1, 0, x, color_error);
-        refresh ();
-        regfree (&regex);
-        return 1;
-      }
-      /* a match was found (data level) */
-      else if (rc == 0 && !find_t.look_in_sub) {
-        find_t.look_in_sub = 1;
-        perform_find_dash_scroll (gscroll, module, h);
-        goto out;
-      }
-      /* look at sub list nodes */
-      else {
-        sub_list = h[module].items[j].sub_list;
-        if (find_next_sub_item (sub_list, &regex) == 0) {
-          perform_find_dash_scroll (gscroll, module, h);
-          goto out;
-        }
-      }
-    }
-    /* reset find */
+  /* no more matches, start over */
+  if (!found) {
+    find_t.cur = 0;
+    find_t.resume = 0;
+    find_t.last.parent_idx = -1;
+    find_t.module = 0;
     find_t.next_idx = 0;
     find_t.next_parent_idx = 0;
     find_t.next_sub_idx = 0;
-    if (find_t.module != module) {
-      reset_scroll_offsets (gscroll);
-      gscroll->expanded = 0;
-    }
-    if (module == TOTAL_MODULES - 1) {
-      find_t.module = 0;
-      goto out;
-    }
+    reset_scroll_offsets (gscroll);
+    gscroll->expanded = 0;
+    return 0;
   }
 
-out:
-  regfree (&regex);
+  find_t.last = match;
+  find_t.resume = 0;
+  find_t.next_parent_idx = match.parent_idx;
+  find_t.next_sub_idx = match.sub_idx;
+  perform_find_dash_scroll (gscroll, match.module, h);
+
   return 0;
 }
 
@@ -1522,54 +1663,40 @@ render_find_dialog (WINDOW *main_win, GScroll *gscroll) {
   return valid;
 }
 
-static void
-set_dash_metrics (GDash **dash, GMetrics *metrics, GModule module, GPercTotals totals, int depth,
-                  uint32_t parent_state, int is_last) {
+/* Add a row referencing the given holder's metrics to a panel and update
+ * the panel's column widths. The row is formatted once drawn.
+ *
+ * If the row has no data, 0 is returned.
+ * On success, 1 is returned. */
+static int
+set_dash_metrics (GDashModule *dmod, GMetrics *metrics, int depth, uint32_t parent_state,
+                  int is_last, int full_idx, int has_children) {
   GDashData *idata = NULL;
-  GDashMeta *meta = NULL;
-  char *data = NULL;
-  int *idx;
+  GMetrics row = { 0 };
+  char prefix[512] = "";
+  int data_len = 0;
 
-  /* Call render_child_node with parent_state and is_last parameters */
-  data = depth ? render_child_node (metrics->data, depth, parent_state, is_last) : metrics->data;
-  if (!data)
-    return;
+  if (metrics->data == NULL || (depth && *metrics->data == '\0'))
+    return 0;
 
-  idx = &(*dash)->module[module].idx_data;
-  idata = &(*dash)->module[module].data[(*idx)];
-  meta = &(*dash)->module[module].meta;
+  data_len = strlen (metrics->data);
+  if (depth)
+    data_len += set_child_node_prefix (prefix, depth, parent_state, is_last);
 
-  idata->metrics = new_gmetrics ();
+  idata = &dmod->data[dmod->idx_data++];
+  idata->metrics = NULL;
+  idata->src = metrics;
   idata->is_subitem = depth;
-  idata->has_children = 0;
-  idata->node_full_idx = -1;
-  idata->metrics->hits = metrics->hits;
-  idata->metrics->hits_perc = get_percentage (totals.hits, metrics->hits);
-  idata->metrics->visitors = metrics->visitors;
-  idata->metrics->visitors_perc = get_percentage (totals.visitors, metrics->visitors);
-  idata->metrics->nbw = metrics->nbw;
-  idata->metrics->bw_perc = get_percentage (totals.bw, metrics->nbw);
-  idata->metrics->data = xstrdup (data);
-
-  if (conf.append_method && metrics->method)
-    idata->metrics->method = metrics->method;
-  if (conf.append_protocol && metrics->protocol)
-    idata->metrics->protocol = metrics->protocol;
-
-  if (!conf.serve_usecs)
-    goto out;
+  idata->is_last = is_last;
+  idata->parent_state = parent_state;
+  idata->has_children = has_children;
+  idata->node_full_idx = full_idx;
 
-  idata->metrics->avgts.sts = usecs_to_str (metrics->avgts.nts);
-  idata->metrics->cumts.sts = usecs_to_str (metrics->cumts.nts);
-  idata->metrics->maxts.sts = usecs_to_str (metrics->maxts.nts);
+  set_dash_row_numbers (&row, metrics, dmod->totals);
+  set_metrics_len (&dmod->meta, &row, data_len);
+  set_max_metrics (&dmod->meta, &row);
 
-out:
-  if (depth)
-    free (data);
-
-  set_metrics_len (meta, idata);
-  set_max_metrics (meta, idata);
-  (*idx)++;
+  return 1;
 }
 
 /* Recursively count all sub-items in a sub-list tree. */
@@ -1595,11 +1722,10 @@ count_sub_items_recursive (GSubList *sl) {
  * parent_state: bit array tracking which ancestor levels have more siblings
  */
 static void
-add_sub_item_to_dash_recursive (GDash **dash, GSubList *sub_list, GModule module,
-                                GPercTotals totals, uint32_t *i, int depth, int *full_idx,
-                                uint8_t *node_exp, int node_exp_size, uint32_t parent_state) {
+add_sub_item_to_dash_recursive (GDashModule *dmod, GSubList *sub_list, uint32_t *i, int depth,
+                                int *full_idx, uint8_t *node_exp, int node_exp_size,
+                                uint32_t parent_state) {
   GSubItem *iter;
-  int *didx;
   int count = 0;
   int total_items = 0;
   GSubItem *temp;
@@ -1630,12 +1756,8 @@ add_sub_item_to_dash_recursive (GDash **dash, GSubList *sub_list, GModule module
     }
 
     /* Add this item to dashboard with proper parent_state and is_last flag */
-    set_dash_metrics (dash, iter->metrics, module, totals, depth, parent_state, is_last_child);
-
-    /* Set node metadata on the just-added item */
-    didx = &(*dash)->module[module].idx_data;
-    (*dash)->module[module].data[(*didx) - 1].node_full_idx = my_full_idx;
-    (*dash)->module[module].data[(*didx) - 1].has_children = has_kids;
+    set_dash_metrics (dmod, iter->metrics, depth, parent_state, is_last_child, my_full_idx,
+                      has_kids);
     (*full_idx)++;
 
     /* Recurse into nested sub-items only if this node is expanded */
@@ -1645,8 +1767,8 @@ add_sub_item_to_dash_recursive (GDash **dash, GSubList *sub_list, GModule module
         should_expand = node_exp[my_full_idx];
       if (should_expand) {
         /* Pass new_parent_state to children so they know about our sibling status */
-        add_sub_item_to_dash_recursive (dash, iter->sub_list, module, totals, i, depth + 1,
-                                        full_idx, node_exp, node_exp_size, new_parent_state);
+        add_sub_item_to_dash_recursive (dmod, iter->sub_list, i, depth + 1, full_idx, node_exp,
+                                        node_exp_size, new_parent_state);
       } else {
         /* Skip all descendants in full_idx counting */
         *full_idx += count_sub_items_recursive (iter->sub_list);
@@ -1656,23 +1778,6 @@ add_sub_item_to_dash_recursive (GDash **dash, GSubList *sub_list, GModule module
   }
 }
 
-/* Add a first level item to dashboard.
- *
- * On success, data is set into the dashboard structure. */
-static void
-add_item_to_dash (GDash **dash, GHolderItem item, GModule module, GPercTotals totals, int full_idx) {
-  int *idx;
-
-  /* Root level items: depth=0, no parent_state, not last (doesn't matter for roots) */
-  set_dash_metrics (dash, item.metrics, module, totals, 0, 0, 0);
-
-  /* set node metadata (idx was already incremented by set_dash_metrics) */
-  idx = &(*dash)->module[module].idx_data;
-  (*dash)->module[module].data[(*idx) - 1].node_full_idx = full_idx;
-  (*dash)->module[module].data[(*idx) - 1].has_children =
-    (item.sub_list != NULL && item.sub_list->size > 0) ? 1 : 0;
-}
-
 /* Count visible sub-items recursively given per-node expand state. */
 static int
 count_visible_sub (GSubList *sl, uint8_t *node_exp, int node_exp_size, int *full_idx) {
@@ -1725,10 +1830,10 @@ count_visible_items (GHolder *h, uint8_t *node_exp, int node_exp_size) {
 /* Load holder's data into the dashboard structure. */
 void
 load_data_to_dash (GHolder *h, GDash *dash, GModule module, GScroll *gscroll) {
+  GDashModule *dmod = &dash->module[module];
   uint32_t alloc_size = 0;
   uint32_t i, j;
   int full_idx = 0;
-  GPercTotals totals;
   uint8_t *node_exp = NULL;
   int node_exp_size = 0;
 
@@ -1750,7 +1855,7 @@ load_data_to_dash (GHolder *h, GDash *dash, GModule module, GScroll *gscroll) {
   dash->module[module].holder_size = h->holder_size;
   memset (&dash->module[module].meta, 0, sizeof (GDashMeta));
 
-  set_module_totals (&totals);
+  set_module_totals (&dmod->totals);
 
   for (i = 0, j = 0; i < alloc_size; i++) {
     if (h->items[j].metrics->data == NULL)
@@ -1759,7 +1864,9 @@ load_data_to_dash (GHolder *h, GDash *dash, GModule module, GScroll *gscroll) {
     {
       int my_full_idx = full_idx;
       full_idx++;
-      add_item_to_dash (&dash, h->items[j], module, totals, my_full_idx);
+      /* root level items: depth=0, no parent_state */
+      set_dash_metrics (dmod, h->items[j].metrics, 0, 0, 0, my_full_idx,
+                        (h->items[j].sub_list != NULL && h->items[j].sub_list->size > 0));
 
       if (gscroll->expanded && module == gscroll->current && h->items[j].sub_list &&
           h->items[j].sub_list->size > 0) {
@@ -1769,8 +1876,8 @@ load_data_to_dash (GHolder *h, GDash *dash, GModule module, GScroll *gscroll) {
 
         if (should_expand) {
           uint32_t parent_state = 0; /* Root level has no parent state */
-          add_sub_item_to_dash_recursive (&dash, h->items[j].sub_list, module, totals, &i, 1,
-                                          &full_idx, node_exp, node_exp_size, parent_state);
+          add_sub_item_to_dash_recursive (dmod, h->items[j].sub_list, &i, 1, &full_idx, node_exp,
+                                          node_exp_size, parent_state);
         } else {
           full_idx += count_sub_items_recursive (h->items[j].sub_list);
         }
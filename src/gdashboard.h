@@ -95,10 +95,14 @@ typedef struct GDashRender_ {
   int sel;
 } GDashRender;
 
-/* Dashboard panel item */
+/* Dashboard panel item. It references the holder's metrics and is only
+ * formatted once drawn */
 typedef struct GDashData_ {
-  GMetrics *metrics;
+  GMetrics *metrics;            /* formatted metrics, NULL until drawn */
+  GMetrics *src;                /* holder's metrics */
+  uint32_t parent_state;        /* ancestor levels with siblings below */
   short is_subitem;
+  short is_last;                /* 1 if last child of its parent */
   short has_children;           /* 1 if this node has sub-items */
   int node_full_idx;            /* index into node_expanded[] (full DFS position) */
 } GDashData;
@@ -117,9 +121,6 @@ typedef struct GDashMeta_ {
   int visitors_perc_len;
   int bw_len;
   int bw_perc_len;
-  int avgts_len;
-  int cumts_len;
-  int maxts_len;
   int method_len;
   int protocol_len;
   int data_len;
@@ -130,6 +131,7 @@ typedef struct GDashModule_ {
   GDashData *data;              /* data metrics */
   GModule module;               /* module */
   GDashMeta meta;               /* meta data */
+  GPercTotals totals;           /* totals the percentages are based on */
 
   const char *head;             /* panel header */
   const char *desc;             /* panel description */
@@ -161,6 +163,7 @@ int set_module_from_mouse_event (GScroll * scroll, GDash * dash, int y);
 uint32_t get_ht_size_by_module (GModule module);
 void display_content (WINDOW * win, GDash * dash, GScroll * gscroll, GHolder * holder);
 void free_dashboard (GDash * dash);
+void invalidate_find (void);
 void load_data_to_dash (GHolder * h, GDash * dash, GModule module, GScroll * scroll);
 void reset_find (void);
 void reset_scroll_offsets (GScroll * scroll);
@@ -53,11 +53,16 @@
 #include "error.h"
 #include "gkhash.h"
 #include "goaccess.h"
+#include "gstats.h"
+#include "settings.h"
 #include "util.h"
 #include "xmalloc.h"
 
 GDnsThread gdns_thread;
 static GDnsQueue *gdns_queue;
+/* IPs queued or being resolved (0), or whose lookup failed temporarily,
+ * mapped to the time they may be retried */
+static khash_t (su64) * gdns_pending;
 
 /* Initialize the queue. */
 void
@@ -125,7 +130,7 @@ gqueue_find (GDnsQueue *q, const char *item) {
     return 0;
 
   for (i = 0; i < q->size; i++) {
-    if (strcmp (item, q->buffer[i]) == 0)
+    if (strcmp (item, q->buffer[(q->head + i) % q->capacity]) == 0)
       return 1;
   }
   return 0;
@@ -148,31 +153,36 @@ gqueue_dequeue (GDnsQueue *q) {
 }
 
 /* Get the corresponding hostname given an IP address.
+ *
+ * If not NULL, the getnameinfo(3) status is set to st.
  *
  * On error, a string error message is returned.
  * On success, a malloc'd hostname is returned. */
 static char *
-reverse_host (const struct sockaddr *a, socklen_t length) {
+reverse_host (const struct sockaddr *a, socklen_t length, int *st) {
   char h[H_SIZE] = { 0 };
-  int flags, st;
+  int flags, ret;
 
   flags = NI_NAMEREQD;
-  st = getnameinfo (a, length, h, H_SIZE, NULL, 0, flags);
-  if (!st) {
+  ret = getnameinfo (a, length, h, H_SIZE, NULL, 0, flags);
+  if (st)
+    *st = ret;
+  if (!ret) {
     /* BSD returns \0 while Linux . on solve lookups */
     if (*h == '\0')
       return alloc_string (".");
     return alloc_string (h);
   }
-  return alloc_string (gai_strerror (st));
+  return alloc_string (gai_strerror (ret));
 }
 
-/* Determine if IPv4 or IPv6 and resolve.
+/* Determine if IPv4 or IPv6 and resolve, setting the getnameinfo(3)
+ * status to st if not NULL.
  *
  * On error, NULL is returned.
  * On success, a malloc'd hostname is returned. */
-char *
-reverse_ip (char *str) {
+static char *
+reverse_ip_st (const char *str, int *st) {
   union {
     struct sockaddr addr;
     struct sockaddr_in6 addr6;
@@ -185,59 +195,130 @@ reverse_ip (char *str) {
   memset (&a, 0, sizeof (a));
   if (1 == inet_pton (AF_INET, str, &a.addr4.sin_addr)) {
     a.addr4.sin_family = AF_INET;
-    return reverse_host (&a.addr, sizeof (a.addr4));
+    return reverse_host (&a.addr, sizeof (a.addr4), st);
   } else if (1 == inet_pton (AF_INET6, str, &a.addr6.sin6_addr)) {
     a.addr6.sin6_family = AF_INET6;
-    return reverse_host (&a.addr, sizeof (a.addr6));
+    return reverse_host (&a.addr, sizeof (a.addr6), st);
   }
   return NULL;
 }
 
-/* Producer - Resolve an IP address and add it to the queue. */
+/* Determine if IPv4 or IPv6 and resolve.
+ *
+ * On error, NULL is returned.
+ * On success, a malloc'd hostname is returned. */
+char *
+reverse_ip (char *str) {
+  return reverse_ip_st (str, NULL);
+}
+
+/* Determine if the given getnameinfo(3) status may not hold on a retry,
+ * e.g., the nameserver timed out. */
+static int
+is_transient_dns_error (int st) {
+  return st == EAI_AGAIN || st == EAI_MEMORY || st == EAI_SYSTEM;
+}
+
+/* Acquire the gdns_thread.mutex, guarding the storage as well. Only a
+ * contended lock is timed, see STAT_LOCK_WAIT. */
 void
-dns_resolver (char *addr) {
+gdns_lock (void) {
+  uint64_t start = 0;
+
+  if (pthread_mutex_trylock (&gdns_thread.mutex) == 0)
+    return;
+
+  start = stat_now ();
   pthread_mutex_lock (&gdns_thread.mutex);
-  /* queue is not full and the IP address is not in the queue */
-  if (!gqueue_full (gdns_queue) && !gqueue_find (gdns_queue, addr)) {
-    /* add the IP to the queue */
-    gqueue_enqueue (gdns_queue, addr);
-    pthread_cond_broadcast (&gdns_thread.not_empty);
-  }
+  stat_time (STAT_LOCK_WAIT, start, 1);
+}
+
+/* Release the gdns_thread.mutex taken by gdns_lock(). */
+void
+gdns_unlock (void) {
   pthread_mutex_unlock (&gdns_thread.mutex);
 }
 
+/* Producer - Resolve an IP address and add it to the queue.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
+void
+dns_resolver (char *addr) {
+  khint_t k;
+  int ret;
+
+  if (!gdns_pending || gqueue_full (gdns_queue))
+    return;
+
+  /* already queued, being resolved, or failed not long ago */
+  k = kh_get (su64, gdns_pending, addr);
+  if (k != kh_end (gdns_pending)) {
+    if (kh_val (gdns_pending, k) == 0 || kh_val (gdns_pending, k) > (uint64_t) time (NULL))
+      return;
+  } else {
+    k = kh_put (su64, gdns_pending, xstrdup (addr), &ret);
+  }
+  kh_val (gdns_pending, k) = 0;
+
+  /* add the IP to the queue */
+  gqueue_enqueue (gdns_queue, addr);
+  pthread_cond_signal (&gdns_thread.not_empty);
+}
+
 /* Consumer - Once an IP has been resolved, add it to dwithe hostnames
- * hash structure. */
+ * hash structure.
+ *
+ * A lookup that failed temporarily is not added, the IP is retried once
+ * DNS_RETRY_SECS have elapsed. */
 static void
 dns_worker (void GO_UNUSED (*ptr_data)) {
-  char *ip = NULL, *host = NULL;
+  char ip[H_SIZE] = { 0 }, *host = NULL;
+  khint_t k;
+  int st = 0;
 
   while (1) {
-    pthread_mutex_lock (&gdns_thread.mutex);
+    gdns_lock ();
     /* wait until an item has been added to the queue */
-    while (gqueue_empty (gdns_queue))
+    while (active_gdns && gqueue_empty (gdns_queue))
       pthread_cond_wait (&gdns_thread.not_empty, &gdns_thread.mutex);
 
-    ip = gqueue_dequeue (gdns_queue);
+    if (!active_gdns) {
+      gdns_unlock ();
+      return;
+    }
 
-    pthread_mutex_unlock (&gdns_thread.mutex);
-    host = reverse_ip (ip);
-    pthread_mutex_lock (&gdns_thread.mutex);
+    /* the slot is reused as soon as the lock is released */
+    snprintf (ip, sizeof (ip), "%s", gqueue_dequeue (gdns_queue));
+    pthread_cond_signal (&gdns_thread.not_full);
+
+    gdns_unlock ();
+    host = reverse_ip_st (ip, &st);
+    gdns_lock ();
 
     if (!active_gdns) {
-      pthread_mutex_unlock (&gdns_thread.mutex);
+      gdns_unlock ();
       free (host);
       return;
     }
 
+    k = kh_get (su64, gdns_pending, ip);
+    if (host != NULL && is_transient_dns_error (st)) {
+      if (k != kh_end (gdns_pending))
+        kh_val (gdns_pending, k) = (uint64_t) time (NULL) + DNS_RETRY_SECS;
+      LOG_DEBUG (("Unable to resolve %s: %s\n", ip, host));
+      free (host);
+    }
     /* insert the corresponding IP -> hostname map */
-    if (host != NULL && active_gdns) {
+    else if (host != NULL) {
       ht_insert_hostname (ip, host);
       free (host);
     }
 
-    pthread_cond_signal (&gdns_thread.not_full);
-    pthread_mutex_unlock (&gdns_thread.mutex);
+    if (k != kh_end (gdns_pending) && kh_val (gdns_pending, k) == 0) {
+      free ((char *) kh_key (gdns_pending, k));
+      kh_del (su64, gdns_pending, k);
+    }
+    gdns_unlock ();
   }
 }
 
@@ -246,6 +327,7 @@ void
 gdns_init (void) {
   gdns_queue = xmalloc (sizeof (GDnsQueue));
   gqueue_init (gdns_queue, QUEUE_SIZE);
+  gdns_pending = new_su64_ht ();
 
   if (pthread_cond_init (&(gdns_thread.not_empty), NULL))
     FATAL ("Failed init thread condition");
@@ -257,20 +339,50 @@ gdns_init (void) {
     FATAL ("Failed init thread mutex");
 }
 
-/* Destroy (free) queue */
+/* Destroy (free) queue and stop the resolver threads.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
 void
 gdns_free_queue (void) {
+  active_gdns = 0;
+  pthread_cond_broadcast (&gdns_thread.not_empty);
+
   gqueue_destroy (gdns_queue);
+  gdns_queue = NULL;
+  des_su64_free (gdns_pending, 1);
+  gdns_pending = NULL;
+  free (gdns_thread.threads);
+  gdns_thread.threads = NULL;
+}
+
+/* Bound a reverse lookup to --dns-timeout seconds, unless the resolver
+ * options were already given through the environment.
+ *
+ * Note: as it changes the environment, it must be called before any other
+ * thread is started. */
+void
+gdns_set_timeout (void) {
+  char opts[64] = { 0 };
+
+  if (!conf.dns_timeout || getenv ("RES_OPTIONS"))
+    return;
+
+  snprintf (opts, sizeof (opts), "timeout:%d attempts:1", conf.dns_timeout);
+  setenv ("RES_OPTIONS", opts, 0);
 }
 
-/* Create a DNS thread and make it active */
+/* Create the pool of DNS threads and make it active */
 void
 gdns_thread_create (void) {
-  int th;
+  int th, i;
 
   active_gdns = 1;
-  th = pthread_create (&(gdns_thread.thread), NULL, (void *) &dns_worker, NULL);
-  if (th)
-    FATAL ("Return code from pthread_create(): %d", th);
-  pthread_detach (gdns_thread.thread);
+  gdns_thread.nthreads = conf.dns_threads > 0 ? conf.dns_threads : DNS_THREADS;
+  gdns_thread.threads = xcalloc (gdns_thread.nthreads, sizeof (pthread_t));
+  for (i = 0; i < gdns_thread.nthreads; i++) {
+    th = pthread_create (&gdns_thread.threads[i], NULL, (void *) &dns_worker, NULL);
+    if (th)
+      FATAL ("Return code from pthread_create(): %d", th);
+    pthread_detach (gdns_thread.threads[i]);
+  }
 }
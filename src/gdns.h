@@ -33,11 +33,20 @@
 #define H_SIZE     1025
 #define QUEUE_SIZE 400
 
+/* Default number of resolver threads, see --dns-threads */
+#define DNS_THREADS     4
+#define DNS_MAX_THREADS 32
+/* Seconds before retrying an IP whose lookup failed temporarily */
+#define DNS_RETRY_SECS  300
+/* Default days a persisted hostname is kept, see --dns-cache-ttl */
+#define DNS_CACHE_TTL   7
+
 typedef struct GDnsThread_ {
   pthread_cond_t not_empty;     /* not empty queue condition */
   pthread_cond_t not_full;      /* not full queue condition */
   pthread_mutex_t mutex;
-  pthread_t thread;
+  pthread_t *threads;           /* resolver pool */
+  int nthreads;                 /* threads in the pool */
 } GDnsThread;
 
 typedef struct GDnsQueue_ {
@@ -60,7 +69,10 @@ int gqueue_size (GDnsQueue * q);
 void dns_resolver (char *addr);
 void gdns_free_queue (void);
 void gdns_init (void);
+void gdns_lock (void);
+void gdns_unlock (void);
 void gdns_queue_free (void);
+void gdns_set_timeout (void);
 void gdns_thread_create (void);
 void gqueue_destroy (GDnsQueue * q);
 void gqueue_init (GDnsQueue * q, int capacity);
@@ -0,0 +1,315 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GFLAT_H_INCLUDED
+#define GFLAT_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Open-addressing hash tables for integer keys.
+ *
+ * Every slot has a one byte control entry holding either a marker (empty or
+ * deleted) or the low 7 bits of the key's hash. Control bytes are scanned a
+ * group at a time (a single SSE2 compare when available) and a slot is only
+ * read when its tag matches, so most lookups touch one control group and one
+ * slot. Keys and values are stored interleaved.
+ *
+ * The generated API mirrors khash.h: fl_get() returns fl_end() when the key
+ * is not found, fl_put() reports through ret -1 on allocation failure, 0 if
+ * the key was present, 1 if it landed on an empty slot and 2 if it reused a
+ * deleted one. Unlike khash, deleted slots are reclaimed on insertion. */
+
+#define FLAT_GROUP_WIDTH 16
+#define FLAT_MIN_CAPACITY FLAT_GROUP_WIDTH
+
+#define FLAT_EMPTY   ((int8_t) -128)
+#define FLAT_DELETED ((int8_t) -2)
+
+/* occupied plus deleted slots are kept at or below 7/8 of the capacity */
+#define FLAT_MAX_LOAD(cap) ((cap) - ((cap) >> 3))
+
+typedef uint32_t flint_t;
+
+static inline uint64_t
+flat_hash_u64 (uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+static inline unsigned
+flat_ctz (uint32_t mask) {
+#if defined(__GNUC__)
+  return (unsigned) __builtin_ctz (mask);
+#else
+  unsigned n = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* Bit i is set if control byte i of the group equals tag. */
+static inline uint32_t
+flat_match (const int8_t *grp, int8_t tag) {
+#if defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128 ((const __m128i *) grp);
+  return (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (ctrl, _mm_set1_epi8 (tag)));
+#else
+  uint32_t mask = 0;
+  int i;
+  for (i = 0; i < FLAT_GROUP_WIDTH; ++i)
+    if (grp[i] == tag)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+/* Bit i is set if slot i of the group is empty or deleted, i.e., both
+ * markers have their high bit set. */
+static inline uint32_t
+flat_match_free (const int8_t *grp) {
+#if defined(__SSE2__)
+  return (uint32_t) _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) grp));
+#else
+  uint32_t mask = 0;
+  int i;
+  for (i = 0; i < FLAT_GROUP_WIDTH; ++i)
+    if (grp[i] < 0)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+#define __FLAT_TYPE(name, fkey_t, fval_t)                                     \
+  typedef struct fl_##name##_slot_s {                                         \
+    fkey_t key;                                                               \
+    fval_t val;                                                               \
+  } fl_##name##_slot_t;                                                       \
+  typedef struct fl_##name##_s {                                              \
+    flint_t capacity, size, used;                                             \
+    int8_t *ctrl;                                                             \
+    fl_##name##_slot_t *slots;                                                \
+  } fl_##name##_t;
+
+/* Probing walks whole groups in triangular order, which visits every group
+ * once as the group count is a power of two. */
+#define __FLAT_IMPL(name, fkey_t, fval_t)                                     \
+  static inline fl_##name##_t *fl_init_##name (void) {                        \
+    return (fl_##name##_t *) calloc (1, sizeof (fl_##name##_t));              \
+  }                                                                           \
+  static inline void fl_destroy_##name (fl_##name##_t *h) {                   \
+    if (!h)                                                                   \
+      return;                                                                 \
+    free (h->ctrl);                                                           \
+    free (h->slots);                                                          \
+    free (h);                                                                 \
+  }                                                                           \
+  static inline void fl_clear_##name (fl_##name##_t *h) {                     \
+    if (!h || !h->ctrl)                                                       \
+      return;                                                                 \
+    memset (h->ctrl, FLAT_EMPTY, h->capacity);                                \
+    h->size = h->used = 0;                                                    \
+  }                                                                           \
+  static inline flint_t fl_get_##name (const fl_##name##_t *h, fkey_t key) {  \
+    uint64_t hv;                                                              \
+    flint_t gmask, g, step = 0, i;                                            \
+    uint32_t m;                                                               \
+    int8_t tag;                                                               \
+    if (!h->capacity)                                                         \
+      return 0;                                                               \
+    hv = flat_hash_u64 ((uint64_t) key);                                      \
+    tag = (int8_t) (hv & 0x7f);                                               \
+    gmask = h->capacity / FLAT_GROUP_WIDTH - 1;                               \
+    g = (flint_t) (hv >> 7) & gmask;                                          \
+    for (;;) {                                                                \
+      const int8_t *grp = h->ctrl + g * FLAT_GROUP_WIDTH;                     \
+      for (m = flat_match (grp, tag); m; m &= m - 1) {                        \
+        i = g * FLAT_GROUP_WIDTH + flat_ctz (m);                              \
+        if (h->slots[i].key == key)                                           \
+          return i;                                                           \
+      }                                                                       \
+      if (flat_match (grp, FLAT_EMPTY))                                       \
+        return h->capacity;                                                   \
+      g = (g + ++step) & gmask;                                               \
+    }                                                                         \
+  }                                                                           \
+  static inline int fl_resize_##name (fl_##name##_t *h, flint_t capacity) {   \
+    fl_##name##_slot_t *slots = NULL;                                         \
+    int8_t *ctrl = NULL;                                                      \
+    uint64_t hv;                                                              \
+    flint_t gmask, g, step, i, j;                                             \
+    uint32_t m;                                                               \
+    if (capacity < FLAT_MIN_CAPACITY)                                         \
+      capacity = FLAT_MIN_CAPACITY;                                           \
+    if (h->size > FLAT_MAX_LOAD (capacity))                                   \
+      return 0;                                                               \
+    if (!(ctrl = (int8_t *) malloc (capacity)))                               \
+      return -1;                                                              \
+    if (!(slots = (fl_##name##_slot_t *) malloc (capacity * sizeof *slots))) {\
+      free (ctrl);                                                            \
+      return -1;                                                              \
+    }                                                                         \
+    memset (ctrl, FLAT_EMPTY, capacity);                                      \
+    gmask = capacity / FLAT_GROUP_WIDTH - 1;                                  \
+    for (i = 0; i < h->capacity; ++i) {                                       \
+      if (h->ctrl[i] < 0)                                                     \
+        continue;                                                             \
+      hv = flat_hash_u64 ((uint64_t) h->slots[i].key);                        \
+      g = (flint_t) (hv >> 7) & gmask;                                        \
+      step = 0;                                                               \
+      while (!(m = flat_match_free (ctrl + g * FLAT_GROUP_WIDTH)))            \
+        g = (g + ++step) & gmask;                                             \
+      j = g * FLAT_GROUP_WIDTH + flat_ctz (m);                                \
+      ctrl[j] = h->ctrl[i];                                                   \
+      slots[j] = h->slots[i];                                                 \
+    }                                                                         \
+    free (h->ctrl);                                                           \
+    free (h->slots);                                                          \
+    h->ctrl = ctrl;                                                           \
+    h->slots = slots;                                                         \
+    h->capacity = capacity;                                                   \
+    h->used = h->size;                                                        \
+    return 0;                                                                 \
+  }                                                                           \
+  static inline flint_t fl_put_##name (fl_##name##_t *h, fkey_t key,          \
+                                       int *ret) {                            \
+    uint64_t hv;                                                              \
+    flint_t gmask, g, step = 0, i, ins;                                       \
+    uint32_t m;                                                               \
+    int8_t tag;                                                               \
+    if (h->used >= FLAT_MAX_LOAD (h->capacity)) {                             \
+      /* grow only if live entries fill half the table, otherwise it is */    \
+      /* rebuilt in place to drop the deleted markers */                      \
+      flint_t cap = h->capacity;                                              \
+      if (!cap || h->size >= FLAT_MAX_LOAD (cap) / 2)                         \
+        cap = cap ? cap << 1 : FLAT_MIN_CAPACITY;                             \
+      if (fl_resize_##name (h, cap) < 0) {                                    \
+        *ret = -1;                                                            \
+        return h->capacity;                                                   \
+      }                                                                       \
+    }                                                                         \
+    hv = flat_hash_u64 ((uint64_t) key);                                      \
+    tag = (int8_t) (hv & 0x7f);                                               \
+    gmask = h->capacity / FLAT_GROUP_WIDTH - 1;                               \
+    g = (flint_t) (hv >> 7) & gmask;                                          \
+    ins = h->capacity;                                                        \
+    for (;;) {                                                                \
+      const int8_t *grp = h->ctrl + g * FLAT_GROUP_WIDTH;                     \
+      for (m = flat_match (grp, tag); m; m &= m - 1) {                        \
+        i = g * FLAT_GROUP_WIDTH + flat_ctz (m);                              \
+        if (h->slots[i].key == key) {                                         \
+          *ret = 0;                                                           \
+          return i;                                                           \
+        }                                                                     \
+      }                                                                       \
+      if (ins == h->capacity && (m = flat_match_free (grp)))                  \
+        ins = g * FLAT_GROUP_WIDTH + flat_ctz (m);                            \
+      if (flat_match (grp, FLAT_EMPTY))                                       \
+        break;                                                                \
+      g = (g + ++step) & gmask;                                               \
+    }                                                                         \
+    if (h->ctrl[ins] == FLAT_EMPTY) {                                         \
+      h->used++;                                                              \
+      *ret = 1;                                                               \
+    } else {                                                                  \
+      *ret = 2;                                                               \
+    }                                                                         \
+    h->ctrl[ins] = tag;                                                       \
+    h->slots[ins].key = key;                                                  \
+    h->size++;                                                                \
+    return ins;                                                               \
+  }                                                                           \
+  /* A slot may go straight back to empty if its group still has an empty */  \
+  /* slot: no probe sequence has ever continued past such a group. */         \
+  static inline void fl_del_##name (fl_##name##_t *h, flint_t x) {            \
+    const int8_t *grp = NULL;                                                 \
+    if (x >= h->capacity || h->ctrl[x] < 0)                                   \
+      return;                                                                 \
+    grp = h->ctrl + (x & ~(flint_t) (FLAT_GROUP_WIDTH - 1));                  \
+    if (flat_match (grp, FLAT_EMPTY)) {                                       \
+      h->ctrl[x] = FLAT_EMPTY;                                                \
+      h->used--;                                                              \
+    } else {                                                                  \
+      h->ctrl[x] = FLAT_DELETED;                                              \
+    }                                                                         \
+    h->size--;                                                                \
+  }
+
+#define FLAT_INIT(name, fkey_t, fval_t)                                       \
+  __FLAT_TYPE(name, fkey_t, fval_t)                                           \
+  __FLAT_IMPL(name, fkey_t, fval_t)
+
+/* uint32_t keys */
+#define FLAT_MAP_INIT_INT(name, fval_t)                                       \
+  FLAT_INIT(name, uint32_t, fval_t)
+
+/* uint64_t keys */
+#define FLAT_MAP_INIT_INT64(name, fval_t)                                     \
+  FLAT_INIT(name, uint64_t, fval_t)
+
+#define flat_t(name) fl_##name##_t
+
+#define fl_init(name) fl_init_##name()
+#define fl_destroy(name, h) fl_destroy_##name(h)
+#define fl_clear(name, h) fl_clear_##name(h)
+#define fl_resize(name, h, s) fl_resize_##name(h, s)
+#define fl_put(name, h, k, r) fl_put_##name(h, k, r)
+#define fl_get(name, h, k) fl_get_##name(h, k)
+#define fl_del(name, h, k) fl_del_##name(h, k)
+
+#define fl_exist(h, x) ((h)->ctrl[x] >= 0)
+#define fl_key(h, x) ((h)->slots[x].key)
+#define fl_val(h, x) ((h)->slots[x].val)
+#define fl_begin(h) (flint_t)(0)
+#define fl_end(h) ((h)->capacity)
+#define fl_size(h) ((h)->size)
+/* bytes held by the table, excluding anything its values point to */
+#define fl_bytes(h) (sizeof (*(h)) + (size_t) (h)->capacity * (1 + sizeof (*(h)->slots)))
+
+#define fl_foreach(h, kvar, vvar, code) { flint_t __i;     \
+  for (__i = fl_begin(h); __i != fl_end(h); ++__i) {        \
+    if (!fl_exist(h,__i)) continue;                         \
+    (kvar) = fl_key(h,__i);                                 \
+    (vvar) = fl_val(h,__i);                                 \
+    code;                                                   \
+  } }
+
+#endif // for #ifndef GFLAT_H
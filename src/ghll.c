@@ -0,0 +1,378 @@
+/**
+ * ghll.c -- HyperLogLog sketches for approximate visitor counts
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "ghll.h"
+
+#include "xmalloc.h"
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+/* the sparse list addresses 2^24 registers, small sets are near exact */
+#define HLL_SPARSE_PRECISION 24
+
+#define HLL_ENC_SPARSE 0
+#define HLL_ENC_DENSE  1
+/* precision, encoding, count, entries */
+#define HLL_HEADER_LEN 10
+
+#define HLL_IDX(e)  ((e) >> 8)
+#define HLL_RANK(e) ((uint8_t) ((e) & 0xff))
+
+/* Spread the bits of an already hashed key so that both the register index
+ * (top bits) and the rank (remaining bits) are uniformly distributed. */
+static uint64_t
+hll_mix (uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static int
+hll_clz64 (uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll (x);
+#else
+  int n = 0;
+  while (!(x & 0x8000000000000000ULL)) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* Rank of a hash for 2^p registers: position of the first set bit after
+ * the p index bits. */
+static uint8_t
+hll_rank (uint64_t h, uint8_t p) {
+  return hll_clz64 ((h << p) | (1ULL << (p - 1))) + 1;
+}
+
+static double
+hll_alpha (uint32_t m) {
+  switch (m) {
+  case 16:
+    return 0.673;
+  case 32:
+    return 0.697;
+  case 64:
+    return 0.709;
+  }
+  return 0.7213 / (1.0 + 1.079 / m);
+}
+
+/* Account for a dense register going from old to new rank. */
+static void
+hll_account (GHLL *hll, uint8_t old, uint8_t new) {
+  if (old == 0)
+    hll->zeros--;
+  hll->sum += ldexp (1.0, -new) - ldexp (1.0, -old);
+}
+
+/* Recompute the zero count and harmonic sum from the dense registers. */
+static void
+hll_recount (GHLL *hll) {
+  uint32_t i, m = 1u << hll->p;
+
+  hll->zeros = m;
+  hll->sum = m;
+  for (i = 0; hll->regs && i < m; ++i)
+    if (hll->regs[i])
+      hll_account (hll, 0, hll->regs[i]);
+}
+
+/* Instantiate a new, empty sketch of 2^p registers. Sketches start out
+ * sparse.
+ *
+ * On success, the new sketch is returned. */
+GHLL *
+new_hll (uint8_t p) {
+  GHLL *hll = xcalloc (1, sizeof (GHLL));
+
+  if (p < HLL_MIN_PRECISION)
+    p = HLL_MIN_PRECISION;
+  if (p > HLL_MAX_PRECISION)
+    p = HLL_MAX_PRECISION;
+
+  hll->p = p;
+  hll->zeros = 1u << p;
+  hll->sum = hll->zeros;
+
+  return hll;
+}
+
+/* Free all memory held by the given sketch. */
+void
+free_hll (GHLL *hll) {
+  if (!hll)
+    return;
+  free (hll->sparse);
+  free (hll->regs);
+  free (hll);
+}
+
+/* Replace the sparse list with a full register array. Each sparse register
+ * folds into the dense register holding its top p bits; the bits dropped
+ * from its index count towards the rank. */
+static void
+hll_densify (GHLL *hll) {
+  uint32_t i, idx, low, shift = HLL_SPARSE_PRECISION - hll->p;
+  uint8_t rank;
+
+  hll->regs = xcalloc (1u << hll->p, sizeof (uint8_t));
+  for (i = 0; i < hll->nsparse; ++i) {
+    idx = HLL_IDX (hll->sparse[i]) >> shift;
+    low = HLL_IDX (hll->sparse[i]) & ((1u << shift) - 1);
+    if (low)
+      rank = shift - (63 - hll_clz64 (low));
+    else
+      rank = HLL_RANK (hll->sparse[i]) + shift;
+    if (rank > hll->regs[idx])
+      hll->regs[idx] = rank;
+  }
+
+  free (hll->sparse);
+  hll->sparse = NULL;
+  hll->nsparse = hll->capacity = 0;
+  hll_recount (hll);
+}
+
+/* Raise sparse register idx to rank, keeping the list sorted.
+ *
+ * Returns 1 if the register changed, else 0. */
+static int
+hll_sparse_set (GHLL *hll, uint32_t idx, uint8_t rank) {
+  uint32_t lo = 0, hi = hll->nsparse, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (HLL_IDX (hll->sparse[mid]) < idx)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo < hll->nsparse && HLL_IDX (hll->sparse[lo]) == idx) {
+    if (rank <= HLL_RANK (hll->sparse[lo]))
+      return 0;
+    hll->sparse[lo] = (idx << 8) | rank;
+    return 1;
+  }
+
+  if (hll->nsparse == hll->capacity) {
+    hll->capacity = hll->capacity ? hll->capacity * 2 : 8;
+    hll->sparse = xrealloc (hll->sparse, hll->capacity * sizeof (uint32_t));
+  }
+  memmove (hll->sparse + lo + 1, hll->sparse + lo, (hll->nsparse - lo) * sizeof (uint32_t));
+  hll->sparse[lo] = (idx << 8) | rank;
+  hll->nsparse++;
+
+  /* four bytes per entry; past 1/8 of the registers the dense array is
+   * at most twice the size of the list and a lot cheaper to update */
+  if (hll->nsparse >= (1u << hll->p) / 8)
+    hll_densify (hll);
+
+  return 1;
+}
+
+/* Add an already hashed element to the sketch.
+ *
+ * Returns 1 if a register changed (and thus the estimate may have moved),
+ * else 0. */
+int
+hll_add (GHLL *hll, uint64_t hash) {
+  uint64_t h = hll_mix (hash);
+  uint32_t idx = 0;
+  uint8_t rank = 0;
+
+  if (!hll->regs) {
+    idx = (uint32_t) (h >> (64 - HLL_SPARSE_PRECISION));
+    return hll_sparse_set (hll, idx, hll_rank (h, HLL_SPARSE_PRECISION));
+  }
+
+  idx = (uint32_t) (h >> (64 - hll->p));
+  rank = hll_rank (h, hll->p);
+  if (hll->regs[idx] >= rank)
+    return 0;
+  hll_account (hll, hll->regs[idx], rank);
+  hll->regs[idx] = rank;
+
+  return 1;
+}
+
+/* Estimate the number of distinct elements added to the sketch. Sparse
+ * sketches and small cardinalities use linear counting. */
+uint32_t
+hll_estimate (const GHLL *hll) {
+  double m = (double) (1u << hll->p), ms = (double) (1u << HLL_SPARSE_PRECISION);
+  double e = 0;
+
+  if (!hll->regs)
+    e = ms * log (ms / (ms - hll->nsparse));
+  else {
+    e = hll_alpha (1u << hll->p) * m * m / hll->sum;
+    if (e <= 2.5 * m && hll->zeros > 0)
+      e = m * log (m / hll->zeros);
+  }
+
+  return e >= UINT32_MAX ? UINT32_MAX : (uint32_t) (e + 0.5);
+}
+
+/* Add an already hashed element and advance the sketch count to the new
+ * estimate. The count never decreases, so the returned deltas of successive
+ * calls always add up to the current count.
+ *
+ * Returns the amount the count advanced by. */
+uint32_t
+hll_insert (GHLL *hll, uint64_t hash) {
+  uint32_t est = 0, inc = 0;
+
+  if (!hll_add (hll, hash))
+    return 0;
+
+  est = hll_estimate (hll);
+  /* the first element always counts, no matter how the estimate rounds */
+  if (est == 0)
+    est = 1;
+  if (est > hll->count) {
+    inc = est - hll->count;
+    hll->count = est;
+  }
+
+  return inc;
+}
+
+/* Number of bytes held by the given sketch. */
+size_t
+hll_size (const GHLL *hll) {
+  size_t size = sizeof (GHLL);
+
+  if (hll->regs)
+    return size + (1u << hll->p);
+  return size + hll->capacity * sizeof (uint32_t);
+}
+
+static void
+hll_put32 (uint8_t *buf, uint32_t v) {
+  buf[0] = v & 0xff;
+  buf[1] = (v >> 8) & 0xff;
+  buf[2] = (v >> 16) & 0xff;
+  buf[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t
+hll_get32 (const uint8_t *buf) {
+  return (uint32_t) buf[0] | ((uint32_t) buf[1] << 8) | ((uint32_t) buf[2] << 16) |
+    ((uint32_t) buf[3] << 24);
+}
+
+/* Serialize a sketch into a newly allocated, byte-order independent buffer.
+ * Sparse sketches are stored as their entry list, dense ones as their
+ * registers.
+ *
+ * On success, the buffer is returned and its length is set into len. */
+uint8_t *
+hll_pack (const GHLL *hll, size_t *len) {
+  uint32_t i, m = 1u << hll->p;
+  uint8_t *buf = NULL;
+
+  if (hll->regs) {
+    *len = HLL_HEADER_LEN + m;
+    buf = xmalloc (*len);
+    buf[1] = HLL_ENC_DENSE;
+    hll_put32 (buf + 6, m);
+    memcpy (buf + HLL_HEADER_LEN, hll->regs, m);
+  } else {
+    *len = HLL_HEADER_LEN + (size_t) hll->nsparse * 4;
+    buf = xmalloc (*len);
+    buf[1] = HLL_ENC_SPARSE;
+    hll_put32 (buf + 6, hll->nsparse);
+    for (i = 0; i < hll->nsparse; ++i)
+      hll_put32 (buf + HLL_HEADER_LEN + i * 4, hll->sparse[i]);
+  }
+  buf[0] = hll->p;
+  hll_put32 (buf + 2, hll->count);
+
+  return buf;
+}
+
+/* Rebuild a sketch out of a buffer produced by hll_pack().
+ *
+ * On error, NULL is returned.
+ * On success, the new sketch is returned. */
+GHLL *
+hll_unpack (const uint8_t *buf, size_t len) {
+  GHLL *hll = NULL;
+  uint32_t i, n, m, e;
+
+  if (len < HLL_HEADER_LEN || buf[0] < HLL_MIN_PRECISION || buf[0] > HLL_MAX_PRECISION)
+    return NULL;
+
+  m = 1u << buf[0];
+  n = hll_get32 (buf + 6);
+  if (buf[1] == HLL_ENC_DENSE && (n != m || len != HLL_HEADER_LEN + (size_t) m))
+    return NULL;
+  if (buf[1] == HLL_ENC_SPARSE && (n >= m / 8 || len != HLL_HEADER_LEN + (size_t) n * 4))
+    return NULL;
+  if (buf[1] != HLL_ENC_DENSE && buf[1] != HLL_ENC_SPARSE)
+    return NULL;
+
+  hll = new_hll (buf[0]);
+  hll->count = hll_get32 (buf + 2);
+  if (buf[1] == HLL_ENC_DENSE) {
+    hll->regs = xmalloc (m);
+    memcpy (hll->regs, buf + HLL_HEADER_LEN, m);
+    hll_recount (hll);
+    return hll;
+  }
+
+  if (n > 0) {
+    hll->sparse = xmalloc (n * sizeof (uint32_t));
+    hll->capacity = n;
+  }
+  for (i = 0; i < n; ++i) {
+    e = hll_get32 (buf + HLL_HEADER_LEN + i * 4);
+    if (i > 0 && HLL_IDX (e) <= HLL_IDX (hll->sparse[i - 1])) {
+      free_hll (hll);
+      return NULL;
+    }
+    hll->sparse[hll->nsparse++] = e;
+  }
+
+  return hll;
+}
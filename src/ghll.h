@@ -0,0 +1,62 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GHLL_H_INCLUDED
+#define GHLL_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HLL_DATE_PRECISION 14   /* 16384 registers, ~0.8% error */
+#define HLL_ITEM_PRECISION 12   /* 4096 registers, ~1.6% error */
+
+/* HyperLogLog sketch. Small sketches keep a sorted list of non-zero registers
+ * at a much finer precision, which keeps their counts near exact, and switch
+ * to a full register array once that list would take half its size. */
+typedef struct GHLL_ {
+  uint8_t p;                    /* precision, 2^p registers */
+  uint32_t nsparse;             /* entries in the sparse list */
+  uint32_t capacity;            /* allocated sparse entries */
+  uint32_t count;               /* highest estimate handed out */
+  uint32_t zeros;               /* dense registers still at zero */
+  double sum;                   /* sum of 2^-register, dense registers */
+  uint32_t *sparse;             /* (register << 8 | rank), sorted */
+  uint8_t *regs;                /* dense registers, NULL while sparse */
+} GHLL;
+
+GHLL *hll_unpack (const uint8_t * buf, size_t len);
+GHLL *new_hll (uint8_t p);
+int hll_add (GHLL * hll, uint64_t hash);
+size_t hll_size (const GHLL * hll);
+uint32_t hll_estimate (const GHLL * hll);
+uint32_t hll_insert (GHLL * hll, uint64_t hash);
+uint8_t *hll_pack (const GHLL * hll, size_t *len);
+void free_hll (GHLL * hll);
+
+#endif // for #ifndef GHLL_H
@@ -439,9 +439,7 @@ add_host_child_to_holder (GHolder *h) {
   /* add child nodes */
   set_host_sub_list (h, sub_list);
 
-  pthread_mutex_lock (&gdns_thread.mutex);
   hostname = ht_get_hostname (ip);
-  pthread_mutex_unlock (&gdns_thread.mutex);
 
   /* determine if we have the IP's hostname */
   if (!hostname) {
@@ -831,7 +829,9 @@ add_geo_to_holder (GRawDataItem item, GHolder *h, datatype type, GO_UNUSED const
 }
 #endif
 
-/* Load raw data into our holder structure */
+/* Load raw data into our holder structure
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
 void
 load_holder_data (GRawData *raw_data, GHolder *h, GModule module, GSort sort, uint32_t max_choices,
                   uint32_t max_choices_sub) {
@@ -846,13 +846,6 @@ load_holder_data (GRawData *raw_data, GHolder *h, GModule module, GSort sort, ui
 #endif
                          0);
 
-#ifdef _DEBUG
-  clock_t begin = clock ();
-  double taken;
-  const char *modstr = NULL;
-  LOG_DEBUG (("== load_holder_data ==\n"));
-#endif
-
   size = raw_data->size;
   /* For hierarchical data, we don't know how many root items we'll create,
    * but it can't be more than size or max_choices */
@@ -873,10 +866,4 @@ load_holder_data (GRawData *raw_data, GHolder *h, GModule module, GSort sort, ui
   if (h->sub_items_size)
     sort_sub_list (h, sort);
   free_raw_data (raw_data);
-
-#ifdef _DEBUG
-  modstr = get_module_str (module);
-  taken = (double) (clock () - begin) / CLOCKS_PER_SEC;
-  LOG_DEBUG (("== %-30s%f\n\n", modstr, taken));
-#endif
 }
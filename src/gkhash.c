@@ -35,15 +35,47 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #include "gkhash.h"
 
 #include "error.h"
+#include "garena.h"
 #include "persistence.h"
 #include "sort.h"
 #include "util.h"
 #include "xmalloc.h"
 
+/* Number of id slots to allocate when the string pool first grows. */
+#define STRPOOL_INIT_CAPACITY 1024
+/* Size of each arena block holding pooled strings. */
+#define STRPOOL_BLOCK_SIZE (1024 * 1024)
+/* Released bytes the pool must accumulate before it is compacted. */
+#define STRPOOL_COMPACT_MIN (4 * STRPOOL_BLOCK_SIZE)
+
+/* Rows to allocate when a metric columns table first grows. Kept small as
+ * there is one table per module and date. */
+#define IMTV_INIT_CAPACITY 16
+/* Bytes taken by a metric columns row across all of its columns. */
+#define IMTV_ROW_BYTES (4 * sizeof (uint32_t) + 3 * sizeof (uint64_t) + 3 * sizeof (uint8_t))
+
+/* Global string pool. Every distinct string referenced by the dated
+ * datamap, rootmap and agent value stores is copied once into a large
+ * arena and referred to by a 32-bit id. Ids are reference counted by the
+ * stores holding them and recycled once released. */
+struct GKStrPool_ {
+  khash_t (si32) * index;       /* string -> id, keys live in the arena */
+  GArena *arena;                /* backing memory of the strings */
+  char **strs;                  /* id -> string */
+  uint32_t *refs;               /* id -> reference count */
+  uint32_t *free_ids;           /* released ids available for reuse */
+  uint32_t nfree;               /* number of released ids */
+  uint32_t size;                /* highest assigned id */
+  uint32_t capacity;            /* allocated slots per id array */
+  uint64_t live_bytes;          /* bytes held by referenced strings */
+  uint64_t dead_bytes;          /* bytes held by released strings */
+};
+
 /* *INDENT-OFF* */
 /* Hash table that holds DB instances */
 static khash_t (igdb) * ht_db = NULL;
@@ -87,6 +119,7 @@ get_mtr_type_str (GSMetricType type) {
     {"IGLP", MTRC_TYPE_IGLP},
     {"IMTV", MTRC_TYPE_IMTV},
     {"U6432", MTRC_TYPE_U6432},
+    {"IHLL", MTRC_TYPE_IHLL},
   };
   return enum2str (enum_metric_types, ARRAY_SIZE (enum_metric_types), type);
 }
@@ -101,7 +134,7 @@ new_igsl_ht (void) {
 /* Initialize a new uint32_t key - uint32_t value hash table */
 void *
 new_ii32_ht (void) {
-  khash_t (ii32) * h = kh_init (ii32);
+  flat_t (ii32) * h = fl_init (ii32);
   return h;
 }
 
@@ -140,17 +173,25 @@ new_u648_ht (void) {
   return h;
 }
 
-/* Initialize a new uint32_t key - GKMetricVals value hash table */
+/* Initialize a new uint32_t key - metric columns table */
 void *
 new_imtv_ht (void) {
-  khash_t (imtv) * h = kh_init (imtv);
+  GKMetricCols *cols = xcalloc (1, sizeof (GKMetricCols));
+  cols->index = fl_init (ii32);
+  return cols;
+}
+
+/* Initialize a new uint32_t key - sketch value hash table */
+void *
+new_ihll_ht (void) {
+  flat_t (ihll) * h = fl_init (ihll);
   return h;
 }
 
 /* Initialize a new uint64_t key - uint32_t value hash table */
 void *
 new_u6432_ht (void) {
-  khash_t (u6432) * h = kh_init (u6432);
+  flat_t (u6432) * h = fl_init (u6432);
   return h;
 }
 
@@ -213,16 +254,11 @@ del_igsl_free (void *h, uint8_t free_data) {
 /* Deletes all entries from the hash table */
 void
 del_ii32 (void *h, GO_UNUSED uint8_t free_data) {
-  khint_t k;
-  khash_t (ii32) * hash = h;
+  flat_t (ii32) * hash = h;
   if (!hash)
     return;
 
-  for (k = 0; k < kh_end (hash); ++k) {
-    if (kh_exist (hash, k)) {
-      kh_del (ii32, hash, k);
-    }
-  }
+  fl_clear (ii32, hash);
 }
 
 /* Deletes both the hash entry and its string values */
@@ -242,6 +278,22 @@ del_is32_free (void *h, uint8_t free_data) {
   }
 }
 
+/* Deletes all entries from the hash table and releases the pooled strings
+ * they reference */
+void
+del_istr (void *h, uint8_t free_data) {
+  khint_t k;
+  flat_t (ii32) * hash = h;
+  if (!hash)
+    return;
+
+  for (k = 0; free_data && k < fl_end (hash); ++k) {
+    if (fl_exist (hash, k))
+      ht_release_str (fl_val (hash, k));
+  }
+  fl_clear (ii32, hash);
+}
+
 /* Deletes all entries from the hash table */
 void
 del_iu64 (void *h, GO_UNUSED uint8_t free_data) {
@@ -310,31 +362,38 @@ del_u648 (void *h, GO_UNUSED uint8_t free_data) {
 /* Deletes all entries from the hash table */
 void
 del_imtv (void *h, GO_UNUSED uint8_t free_data) {
+  GKMetricCols *cols = h;
+  if (!cols)
+    return;
+
+  fl_clear (ii32, cols->index);
+  cols->size = 0;
+}
+
+/* Deletes all entries from the hash table and frees the sketches they
+ * hold */
+void
+del_ihll (void *h, uint8_t free_data) {
   khint_t k;
-  khash_t (imtv) * hash = h;
+  flat_t (ihll) * hash = h;
   if (!hash)
     return;
 
-  for (k = 0; k < kh_end (hash); ++k) {
-    if (kh_exist (hash, k)) {
-      kh_del (imtv, hash, k);
-    }
+  for (k = 0; free_data && k < fl_end (hash); ++k) {
+    if (fl_exist (hash, k) && !IHLL_INLINE (fl_val (hash, k)))
+      free_hll (IHLL_SKETCH (fl_val (hash, k)));
   }
+  fl_clear (ihll, hash);
 }
 
 /* Deletes all entries from the hash table */
 void
 del_u6432 (void *h, GO_UNUSED uint8_t free_data) {
-  khint_t k;
-  khash_t (u6432) * hash = h;
+  flat_t (u6432) * hash = h;
   if (!hash)
     return;
 
-  for (k = 0; k < kh_end (hash); ++k) {
-    if (kh_exist (hash, k)) {
-      kh_del (u6432, hash, k);
-    }
-  }
+  fl_clear (u6432, hash);
 }
 
 /* Destroys both the hash structure and its GSLList
@@ -362,10 +421,10 @@ des:
 /* Destroys the hash structure */
 void
 des_ii32 (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (ii32) * hash = h;
+  flat_t (ii32) * hash = h;
   if (!hash)
     return;
-  kh_destroy (ii32, hash);
+  fl_destroy (ii32, hash);
 }
 
 /* Destroys both the hash structure and its string values */
@@ -388,6 +447,26 @@ des:
   kh_destroy (is32, hash);
 }
 
+/* Destroys the hash structure and releases the pooled strings it
+ * references */
+void
+des_istr (void *h, uint8_t free_data) {
+  khint_t k;
+  flat_t (ii32) * hash = h;
+  if (!hash)
+    return;
+
+  if (!free_data)
+    goto des;
+
+  for (k = 0; k < fl_end (hash); ++k) {
+    if (fl_exist (hash, k))
+      ht_release_str (fl_val (hash, k));
+  }
+des:
+  fl_destroy (ii32, hash);
+}
+
 /* Destroys the hash structure */
 void
 des_iu64 (void *h, GO_UNUSED uint8_t free_data) {
@@ -453,19 +532,46 @@ des_u648 (void *h, GO_UNUSED uint8_t free_data) {
 /* Destroys the hash structure */
 void
 des_imtv (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (imtv) * hash = h;
+  GKMetricCols *cols = h;
+  if (!cols)
+    return;
+
+  free (cols->keys);
+  free (cols->hits);
+  free (cols->visitors);
+  free (cols->root);
+  free (cols->bw);
+  free (cols->cumts);
+  free (cols->maxts);
+  free (cols->meth);
+  free (cols->proto);
+  free (cols->touched);
+  fl_destroy (ii32, cols->index);
+  free (cols);
+}
+
+/* Destroys the hash structure and frees the sketches it holds */
+void
+des_ihll (void *h, uint8_t free_data) {
+  khint_t k;
+  flat_t (ihll) * hash = h;
   if (!hash)
     return;
-  kh_destroy (imtv, hash);
+
+  for (k = 0; free_data && k < fl_end (hash); ++k) {
+    if (fl_exist (hash, k) && !IHLL_INLINE (fl_val (hash, k)))
+      free_hll (IHLL_SKETCH (fl_val (hash, k)));
+  }
+  fl_destroy (ihll, hash);
 }
 
 /* Destroys the hash structure */
 void
 des_u6432 (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (u6432) * hash = h;
+  flat_t (u6432) * hash = h;
   if (!hash)
     return;
-  kh_destroy (u6432, hash);
+  fl_destroy (u6432, hash);
 }
 
 /* Destroys both the hash structure and the keys for a
@@ -572,6 +678,7 @@ const GKHashMetric app_metrics[] = {
   { .metric.dbm=MTRC_METH_PROTO  , MTRC_TYPE_SI08 , new_si08_ht , des_si08_free , del_si08_free , 1 , NULL , "SI08_METH_PROTO.db"  } ,
   { .metric.dbm=MTRC_DB_PROPS    , MTRC_TYPE_SI32 , new_si32_ht , des_si32_free , del_si32_free , 1 , NULL , "SI32_DB_PROPS.db"    } ,
   { .metric.dbm=MTRC_COUNTRY_CONTINENT , MTRC_TYPE_SS32 , new_ss32_ht , des_ss32_free , del_ss32_free , 1 , NULL , "SS32_COUNTRY_CONTINENT.db" } ,
+  { .metric.dbm=MTRC_HOSTNAMES_TS , MTRC_TYPE_SU64 , new_su64_ht , des_su64_free , del_su64_free , 1 , NULL , NULL } ,
 };
 
 const size_t app_metrics_len = ARRAY_SIZE (app_metrics);
@@ -672,6 +779,315 @@ ins_iglp (khash_t (iglp) *hash, uint64_t key, const GLastParse *lp) {
   return 0;
 }
 
+/* Allocate memory for a new, empty string pool.
+ *
+ * On success, the newly allocated GKStrPool is returned . */
+static GKStrPool *
+new_strpool (void) {
+  GKStrPool *pool = xcalloc (1, sizeof (GKStrPool));
+
+  pool->index = new_si32_ht ();
+  pool->arena = new_arena (STRPOOL_BLOCK_SIZE);
+
+  return pool;
+}
+
+/* Free the string pool along with all of its strings. */
+static void
+free_strpool (GKStrPool *pool) {
+  if (!pool)
+    return;
+
+  kh_destroy (si32, pool->index);
+  free_arena (pool->arena);
+  free (pool->strs);
+  free (pool->refs);
+  free (pool->free_ids);
+  free (pool);
+}
+
+/* Get the string pool of the default DB instance.
+ *
+ * On error, NULL is returned.
+ * On success, the string pool is returned. */
+static GKStrPool *
+get_strpool (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  return db ? db->strpool : NULL;
+}
+
+/* Ensure the pool id arrays can hold one more id. */
+static void
+strpool_grow (GKStrPool *pool) {
+  uint32_t newcap = 0;
+
+  if (pool->size + 1 < pool->capacity)
+    return;
+
+  newcap = pool->capacity == 0 ? STRPOOL_INIT_CAPACITY : pool->capacity * 2;
+  pool->strs = xrealloc (pool->strs, newcap * sizeof (char *));
+  pool->refs = xrealloc (pool->refs, newcap * sizeof (uint32_t));
+  pool->free_ids = xrealloc (pool->free_ids, newcap * sizeof (uint32_t));
+  memset (pool->strs + pool->capacity, 0, (newcap - pool->capacity) * sizeof (char *));
+  memset (pool->refs + pool->capacity, 0, (newcap - pool->capacity) * sizeof (uint32_t));
+  pool->capacity = newcap;
+}
+
+/* Intern the given string into the string pool and take a reference to
+ * it. Every reference must eventually be dropped with ht_release_str().
+ *
+ * On error, 0 is returned.
+ * On success the pool id of the string is returned */
+uint32_t
+ht_intern_str (const char *str) {
+  GKStrPool *pool = get_strpool ();
+  uint32_t id = 0;
+  size_t len = 0;
+  khint_t k;
+  char *dup = NULL;
+  int ret;
+
+  if (!pool || !str)
+    return 0;
+
+  k = kh_get (si32, pool->index, str);
+  if (k != kh_end (pool->index)) {
+    id = kh_val (pool->index, k);
+    pool->refs[id]++;
+    return id;
+  }
+
+  if (pool->nfree) {
+    id = pool->free_ids[--pool->nfree];
+  } else {
+    strpool_grow (pool);
+    id = ++pool->size;
+  }
+
+  len = strlen (str) + 1;
+  dup = arena_strndup (pool->arena, str, len - 1);
+  k = kh_put (si32, pool->index, dup, &ret);
+  if (ret == -1) {
+    pool->free_ids[pool->nfree++] = id;
+    pool->dead_bytes += len;
+    return 0;
+  }
+
+  kh_val (pool->index, k) = id;
+  pool->strs[id] = dup;
+  pool->refs[id] = 1;
+  pool->live_bytes += len;
+
+  return id;
+}
+
+/* Drop a reference to a pooled string. Once unreferenced, its id is
+ * recycled and its bytes are reclaimed by ht_compact_strpool(). */
+void
+ht_release_str (uint32_t id) {
+  GKStrPool *pool = get_strpool ();
+  size_t len = 0;
+  khint_t k;
+
+  if (!pool || id == 0 || id > pool->size || pool->refs[id] == 0)
+    return;
+
+  if (--pool->refs[id])
+    return;
+
+  if ((k = kh_get (si32, pool->index, pool->strs[id])) != kh_end (pool->index))
+    kh_del (si32, pool->index, k);
+
+  len = strlen (pool->strs[id]) + 1;
+  pool->live_bytes -= len;
+  pool->dead_bytes += len;
+  pool->strs[id] = NULL;
+  pool->free_ids[pool->nfree++] = id;
+}
+
+/* Get the string for the given pool id. The string is borrowed and stays
+ * valid until released or until the pool is compacted.
+ *
+ * On error, NULL is returned.
+ * On success the pooled string is returned */
+const char *
+ht_get_str (uint32_t id) {
+  GKStrPool *pool = get_strpool ();
+
+  if (!pool || id == 0 || id > pool->size)
+    return NULL;
+  return pool->strs[id];
+}
+
+/* Get the pool id of the given string without taking a reference.
+ *
+ * If not pooled, 0 is returned.
+ * On success the string id is returned */
+uint32_t
+ht_find_str (const char *str) {
+  GKStrPool *pool = get_strpool ();
+  khint_t k;
+
+  if (!pool || !str)
+    return 0;
+  if ((k = kh_get (si32, pool->index, str)) == kh_end (pool->index))
+    return 0;
+  return kh_val (pool->index, k);
+}
+
+/* Determine whether released strings take up more room than the live ones,
+ * i.e., whether ht_compact_strpool() would move the pool.
+ *
+ * If compaction is due, 1 is returned.
+ * Otherwise, 0 is returned. */
+int
+ht_strpool_compactable (void) {
+  GKStrPool *pool = get_strpool ();
+
+  if (!pool || pool->dead_bytes < STRPOOL_COMPACT_MIN || pool->dead_bytes < pool->live_bytes)
+    return 0;
+  return 1;
+}
+
+/* Move the referenced strings into a fresh arena once released strings
+ * take up more room than the live ones. Ids are preserved but borrowed
+ * string pointers are not, so callers must re-resolve any they hold by
+ * id afterwards. */
+void
+ht_compact_strpool (void) {
+  GKStrPool *pool = get_strpool ();
+  GArena *arena = NULL;
+  uint32_t id = 0;
+  khint_t k;
+  int ret;
+
+  if (!ht_strpool_compactable ())
+    return;
+
+  arena = new_arena (STRPOOL_BLOCK_SIZE);
+  kh_clear (si32, pool->index);
+  for (id = 1; id <= pool->size; ++id) {
+    if (!pool->strs[id])
+      continue;
+    pool->strs[id] = arena_strdup (arena, pool->strs[id]);
+    k = kh_put (si32, pool->index, pool->strs[id], &ret);
+    if (ret != -1)
+      kh_val (pool->index, k) = id;
+  }
+  free_arena (pool->arena);
+  pool->arena = arena;
+  pool->dead_bytes = 0;
+}
+
+/* Number of bytes held by the string pool, its strings included. */
+uint64_t
+ht_mem_strpool (void) {
+  GKStrPool *pool = get_strpool ();
+
+  if (!pool)
+    return 0;
+
+  return sizeof (*pool) + HT_KH_BYTES (pool->index) + arena_size (pool->arena) +
+    (uint64_t) pool->capacity * (sizeof (*pool->strs) + sizeof (*pool->refs) +
+                                 sizeof (*pool->free_ids));
+}
+
+/* Number of bytes held by the string keys of a khash table. */
+#define HT_KH_KEY_BYTES(h, bytes) { khint_t __k;       \
+  for (__k = kh_begin(h); __k != kh_end(h); ++__k) {  \
+    if (kh_exist(h,__k)) (bytes) += strlen (kh_key(h,__k)) + 1; \
+  } }
+
+/* Number of bytes held by a hash table of the given type, including the
+ * strings, lists and sketches it owns. Pooled strings are accounted for by
+ * ht_mem_strpool().
+ *
+ * On success the number of bytes is returned. */
+uint64_t
+ht_mem_by_type (GSMetricType type, void *h) {
+  GSLList *node = NULL;
+  uint64_t bytes = 0, ref = 0;
+  khint_t k;
+
+  if (!h)
+    return 0;
+
+  switch (type) {
+  case MTRC_TYPE_II32:
+  case MTRC_TYPE_IS32:
+    return fl_bytes ((flat_t (ii32) *) h);
+  case MTRC_TYPE_U6432:
+    return fl_bytes ((flat_t (u6432) *) h);
+  case MTRC_TYPE_IMTV:
+    return sizeof (GKMetricCols) + fl_bytes (((GKMetricCols *) h)->index) +
+      (uint64_t) ((GKMetricCols *) h)->capacity * IMTV_ROW_BYTES;
+  case MTRC_TYPE_IHLL:
+    bytes = fl_bytes ((flat_t (ihll) *) h);
+    for (k = 0; k < fl_end ((flat_t (ihll) *) h); ++k) {
+      if (!fl_exist ((flat_t (ihll) *) h, k))
+        continue;
+      if (!IHLL_INLINE (ref = fl_val ((flat_t (ihll) *) h, k)))
+        bytes += hll_size (IHLL_SKETCH (ref));
+    }
+    return bytes;
+  case MTRC_TYPE_IU64:
+    return HT_KH_BYTES ((khash_t (iu64) *) h);
+  case MTRC_TYPE_U648:
+    return HT_KH_BYTES ((khash_t (u648) *) h);
+  case MTRC_TYPE_IGLP:
+    return HT_KH_BYTES ((khash_t (iglp) *) h);
+  case MTRC_TYPE_SI32:
+    bytes = HT_KH_BYTES ((khash_t (si32) *) h);
+    HT_KH_KEY_BYTES ((khash_t (si32) *) h, bytes);
+    return bytes;
+  case MTRC_TYPE_SI08:
+    bytes = HT_KH_BYTES ((khash_t (si08) *) h);
+    HT_KH_KEY_BYTES ((khash_t (si08) *) h, bytes);
+    return bytes;
+  case MTRC_TYPE_SU64:
+    bytes = HT_KH_BYTES ((khash_t (su64) *) h);
+    HT_KH_KEY_BYTES ((khash_t (su64) *) h, bytes);
+    return bytes;
+  case MTRC_TYPE_SS32:
+    bytes = HT_KH_BYTES ((khash_t (ss32) *) h);
+    HT_KH_KEY_BYTES ((khash_t (ss32) *) h, bytes);
+    for (k = kh_begin ((khash_t (ss32) *) h); k != kh_end ((khash_t (ss32) *) h); ++k) {
+      if (kh_exist ((khash_t (ss32) *) h, k))
+        bytes += strlen (kh_val ((khash_t (ss32) *) h, k)) + 1;
+    }
+    return bytes;
+  case MTRC_TYPE_IGSL:
+    bytes = HT_KH_BYTES ((khash_t (igsl) *) h);
+    for (k = kh_begin ((khash_t (igsl) *) h); k != kh_end ((khash_t (igsl) *) h); ++k) {
+      if (!kh_exist ((khash_t (igsl) *) h, k))
+        continue;
+      for (node = kh_val ((khash_t (igsl) *) h, k); node; node = node->next)
+        bytes += sizeof (GSLList) + sizeof (uint32_t);
+    }
+    return bytes;
+  default:
+    /* date stores are walked separately */
+    return 0;
+  }
+}
+
+/* Number of bytes held by the app-level tables, i.e., everything but the
+ * date stores, the module caches and the string pool. */
+uint64_t
+ht_mem_app (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  uint64_t bytes = 0;
+  size_t i;
+
+  if (!db)
+    return 0;
+
+  for (i = 0; i < app_metrics_len; ++i)
+    bytes += ht_mem_by_type (db->hdb->metrics[i].type, db->hdb->metrics[i].hash);
+
+  return bytes;
+}
+
 /* Create a new GKDB instance given a uint32_t key
  *
  * On error, -1 is returned.
@@ -699,6 +1115,7 @@ new_db (khash_t (igdb) *hash, uint32_t key) {
   db->cache = NULL;
   db->store = NULL;
   db->logs = NULL;
+  db->strpool = new_strpool ();
   kh_val (hash, k) = db;
 
   return db;
@@ -834,7 +1251,7 @@ ins_si32_inc (khash_t (si32) *hash, const char *key,
  * On error, 0 is returned.
  * On success or if the key exists, the value is returned */
 uint32_t
-ins_ii32_inc (khash_t (ii32) *hash, uint32_t key,
+ins_ii32_inc (flat_t (ii32) *hash, uint32_t key,
               uint32_t (*cb) (khash_t (si32) *, const char *), khash_t (si32) *seqs,
               const char *seqk) {
   khint_t k;
@@ -844,14 +1261,14 @@ ins_ii32_inc (khash_t (ii32) *hash, uint32_t key,
   if (!hash)
     return 0;
 
-  k = kh_put (ii32, hash, key, &ret);
+  k = fl_put (ii32, hash, key, &ret);
   /* operation failed, or key exists */
   if (ret == -1 || ret == 0)
     return 0;
 
   if ((value = cb (seqs, seqk)) == 0)
     return 0;
-  kh_val (hash, k) = value;
+  fl_val (hash, k) = value;
 
   return value;
 }
@@ -878,6 +1295,33 @@ ins_is32 (khash_t (is32) *hash, uint32_t key, char *value) {
   return 0;
 }
 
+/* Insert a uint32_t key mapped to the pool id of the given string.
+ * Note: If the key exists, the value is not replaced.
+ *
+ * On error, or if key exists, NULL is returned.
+ * On success the pooled string is returned */
+const char *
+ins_istr (flat_t (ii32) *hash, uint32_t key, const char *value) {
+  khint_t k;
+  uint32_t id = 0;
+  int ret;
+
+  if (!hash)
+    return NULL;
+
+  k = fl_put (ii32, hash, key, &ret);
+  if (ret == -1 || ret == 0)
+    return NULL;
+
+  if ((id = ht_intern_str (value)) == 0) {
+    fl_del (ii32, hash, k);
+    return NULL;
+  }
+  fl_val (hash, k) = id;
+
+  return ht_get_str (id);
+}
+
 /* Insert a string key and the corresponding string value.
  * Note: If the key exists, the value is not replaced.
  *
@@ -917,18 +1361,18 @@ ins_ss32 (khash_t (ss32) *hash, const char *key, const char *value) {
  * On error, -1 is returned.
  * On success 0 is returned */
 int
-ins_ii32 (khash_t (ii32) *hash, uint32_t key, uint32_t value) {
+ins_ii32 (flat_t (ii32) *hash, uint32_t key, uint32_t value) {
   khint_t k;
   int ret;
 
   if (!hash)
     return -1;
 
-  k = kh_put (ii32, hash, key, &ret);
+  k = fl_put (ii32, hash, key, &ret);
   if (ret == -1)
     return -1;
 
-  kh_val (hash, k) = value;
+  fl_val (hash, k) = value;
 
   return 0;
 }
@@ -1003,46 +1447,112 @@ ins_u648 (khash_t (u648) *hash, uint64_t key) {
   return 0;
 }
 
-/* Get the GKMetricVals of a given uint32_t key.
+/* Get the metric columns row of a given uint32_t key.
  *
- * If the key is not found, NULL is returned.
- * On success a pointer to the stored GKMetricVals is returned */
-GKMetricVals *
-get_imtv (khash_t (imtv) *hash, uint32_t key) {
+ * If the key is not found, 0 is returned.
+ * On success the row of the key is returned */
+uint32_t
+get_imtv (GKMetricCols *cols, uint32_t key) {
   khint_t k;
 
-  if (!hash)
-    return NULL;
+  if (!cols)
+    return 0;
 
-  k = kh_get (imtv, hash, key);
-  if (k == kh_end (hash))
-    return NULL;
+  k = fl_get (ii32, cols->index, key);
+  if (k == fl_end (cols->index))
+    return 0;
 
-  return &kh_val (hash, k);
+  return fl_val (cols->index, k);
 }
 
-/* Get the GKMetricVals of a given uint32_t key, creating a zeroed entry if
- * the key is not present.
+/* Grow every metric column to twice its rows. */
+static void
+imtv_grow (GKMetricCols *cols) {
+  uint32_t newcap = cols->capacity ? cols->capacity * 2 : IMTV_INIT_CAPACITY;
+
+  cols->keys = xrealloc (cols->keys, newcap * sizeof (*cols->keys));
+  cols->hits = xrealloc (cols->hits, newcap * sizeof (*cols->hits));
+  cols->visitors = xrealloc (cols->visitors, newcap * sizeof (*cols->visitors));
+  cols->root = xrealloc (cols->root, newcap * sizeof (*cols->root));
+  cols->bw = xrealloc (cols->bw, newcap * sizeof (*cols->bw));
+  cols->cumts = xrealloc (cols->cumts, newcap * sizeof (*cols->cumts));
+  cols->maxts = xrealloc (cols->maxts, newcap * sizeof (*cols->maxts));
+  cols->meth = xrealloc (cols->meth, newcap * sizeof (*cols->meth));
+  cols->proto = xrealloc (cols->proto, newcap * sizeof (*cols->proto));
+  cols->touched = xrealloc (cols->touched, newcap * sizeof (*cols->touched));
+  cols->capacity = newcap;
+}
+
+/* Get the metric columns row of a given uint32_t key, assigning the next
+ * zeroed row if the key is not present.
  *
- * On error, NULL is returned.
- * On success a pointer to the stored GKMetricVals is returned */
-GKMetricVals *
-ins_imtv (khash_t (imtv) *hash, uint32_t key) {
-  static const GKMetricVals zeroed = { 0 };
+ * On error, 0 is returned.
+ * On success the row of the key is returned */
+uint32_t
+ins_imtv (GKMetricCols *cols, uint32_t key) {
+  uint32_t row = 0;
   khint_t k;
   int ret;
 
-  if (!hash)
-    return NULL;
+  if (!cols)
+    return 0;
 
-  k = kh_put (imtv, hash, key, &ret);
+  k = fl_put (ii32, cols->index, key, &ret);
   if (ret == -1)
-    return NULL;
+    return 0;
+  if (ret == 0)
+    return fl_val (cols->index, k);
+
+  /* row 0 is never assigned */
+  if (cols->size + 1 >= cols->capacity)
+    imtv_grow (cols);
+  row = ++cols->size;
+  fl_val (cols->index, k) = row;
+
   /* newly inserted keys start from all-zero metrics */
-  if (ret != 0)
-    kh_val (hash, k) = zeroed;
+  cols->keys[row] = key;
+  cols->hits[row] = cols->visitors[row] = cols->root[row] = 0;
+  cols->bw[row] = cols->cumts[row] = cols->maxts[row] = 0;
+  cols->meth[row] = cols->proto[row] = cols->touched[row] = 0;
 
-  return &kh_val (hash, k);
+  return row;
+}
+
+/* Add a visitor fingerprint to the sketch of a given uint32_t key. The first
+ * fingerprint is kept inline; a 2^p register sketch is built once another
+ * one shows up.
+ *
+ * On error, 0 is returned.
+ * On success the amount the estimated visitors advanced by is returned */
+uint32_t
+ins_ihll (flat_t (ihll) *hash, uint32_t key, uint64_t value, uint8_t p) {
+  GHLL *hll = NULL;
+  khint_t k;
+  int ret;
+
+  if (!hash)
+    return 0;
+
+  /* the low bit tags inline fingerprints, so it takes no part in them */
+  value |= 1;
+  k = fl_put (ihll, hash, key, &ret);
+  if (ret == -1)
+    return 0;
+  if (ret != 0) {
+    fl_val (hash, k) = value;
+    return 1;
+  }
+
+  if (!IHLL_INLINE (fl_val (hash, k)))
+    return hll_insert (IHLL_SKETCH (fl_val (hash, k)), value);
+  if (fl_val (hash, k) == value)
+    return 0;
+
+  hll = new_hll (p);
+  hll_insert (hll, fl_val (hash, k));
+  fl_val (hash, k) = (uint64_t) (uintptr_t) hll;
+
+  return hll_insert (hll, value);
 }
 
 /* Increase an uint32_t value given an uint32_t key.
@@ -1050,24 +1560,24 @@ ins_imtv (khash_t (imtv) *hash, uint32_t key) {
  * On error, 0 is returned.
  * On success the increased value is returned */
 uint32_t
-inc_ii32 (khash_t (ii32) *hash, uint32_t key, uint32_t inc) {
+inc_ii32 (flat_t (ii32) *hash, uint32_t key, uint32_t inc) {
   khint_t k;
   int ret;
 
   if (!hash)
     return 0;
 
-  k = kh_get (ii32, hash, key);
+  k = fl_get (ii32, hash, key);
   /* key not found, put a new hash with val=0 */
-  if (k == kh_end (hash)) {
-    k = kh_put (ii32, hash, key, &ret);
+  if (k == fl_end (hash)) {
+    k = fl_put (ii32, hash, key, &ret);
     /* operation failed */
     if (ret == -1)
       return 0;
-    kh_val (hash, k) = 0;
+    fl_val (hash, k) = 0;
   }
 
-  return __atomic_add_fetch (&kh_val (hash, k), inc, __ATOMIC_SEQ_CST);
+  return __atomic_add_fetch (&fl_val (hash, k), inc, __ATOMIC_SEQ_CST);
 }
 
 /* Increase a uint64_t value given a string key.
@@ -1169,7 +1679,7 @@ inc_si32 (khash_t (si32) *hash, const char *key, uint32_t inc) {
  * On key found, the stored value is returned
  * On success the value of the key inserted is returned */
 uint32_t
-ins_ii32_ai (khash_t (ii32) *hash, uint32_t key) {
+ins_ii32_ai (flat_t (ii32) *hash, uint32_t key) {
   int size = 0, value = 0;
   int ret;
   khint_t k;
@@ -1177,19 +1687,19 @@ ins_ii32_ai (khash_t (ii32) *hash, uint32_t key) {
   if (!hash)
     return 0;
 
-  size = kh_size (hash);
+  size = fl_size (hash);
   /* the auto increment value starts at SIZE (hash table) + 1 */
   value = size > 0 ? size + 1 : 1;
 
-  k = kh_put (ii32, hash, key, &ret);
+  k = fl_put (ii32, hash, key, &ret);
   /* operation failed */
   if (ret == -1)
     return 0;
   /* key exists */
   if (ret == 0)
-    return kh_val (hash, k);
+    return fl_val (hash, k);
 
-  kh_val (hash, k) = value;
+  fl_val (hash, k) = value;
 
   return value;
 }
@@ -1296,6 +1806,25 @@ get_is32 (khash_t (is32) *hash, uint32_t key) {
   return NULL;
 }
 
+/* Get the pooled string of a given uint32_t key. The string is borrowed
+ * from the string pool and must not be freed.
+ *
+ * On error, or if key is not found, NULL is returned.
+ * On success the string value for the given key is returned */
+const char *
+get_istr (flat_t (ii32) *hash, uint32_t key) {
+  khint_t k;
+
+  if (!hash)
+    return NULL;
+
+  k = fl_get (ii32, hash, key);
+  if (k == fl_end (hash))
+    return NULL;
+
+  return ht_get_str (fl_val (hash, k));
+}
+
 /* Get the string value of a given string key.
  *
  * On error, NULL is returned.
@@ -1322,16 +1851,16 @@ get_ss32 (khash_t (ss32) *hash, const char *key) {
  * On error, -1 is returned.
  * On success the uint32_t value for the given key is returned */
 uint32_t
-get_ii32 (khash_t (ii32) *hash, uint32_t key) {
+get_ii32 (flat_t (ii32) *hash, uint32_t key) {
   khint_t k;
 
   if (!hash)
     return 0;
 
-  k = kh_get (ii32, hash, key);
+  k = fl_get (ii32, hash, key);
   /* key found, return current value */
-  if (k != kh_end (hash))
-    return __atomic_load_n (&kh_val (hash, k), __ATOMIC_SEQ_CST);
+  if (k != fl_end (hash))
+    return __atomic_load_n (&fl_val (hash, k), __ATOMIC_SEQ_CST);
 
   return 0;
 }
@@ -1492,19 +2021,34 @@ ht_ins_seq (khash_t (si32) *hash, const char *key) {
   return inc_si32 (hash, key, 1);
 }
 
-/* Insert an IP hostname mapped to the corresponding hostname.
+/* Insert an IP hostname mapped to the corresponding hostname along with
+ * the time it was resolved at, so it expires once persisted.
  *
  * On error, or if key exists, -1 is returned.
  * On success 0 is returned */
 int
-ht_insert_hostname (const char *ip, const char *host) {
+ht_insert_hostname_at (const char *ip, const char *host, uint64_t resolved) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (ss32) * hash = get_hdb (db, MTRC_HOSTNAMES);
+  khash_t (su64) * ts = get_hdb (db, MTRC_HOSTNAMES_TS);
+  int ret = 0;
 
   if (!hash)
     return -1;
 
-  return ins_ss32 (hash, ip, host);
+  if ((ret = ins_ss32 (hash, ip, host)) == 0)
+    ins_su64 (ts, ip, resolved);
+
+  return ret;
+}
+
+/* Insert an IP hostname mapped to the corresponding hostname.
+ *
+ * On error, or if key exists, -1 is returned.
+ * On success 0 is returned */
+int
+ht_insert_hostname (const char *ip, const char *host) {
+  return ht_insert_hostname_at (ip, host, (uint64_t) time (NULL));
 }
 
 /* Insert a JSON log format specification such as request.method => %m.
@@ -1633,6 +2177,9 @@ free_igdb (khash_t (igdb) *hash, khint_t k) {
   GKDB *db = NULL;
   db = kh_val (hash, k);
 
+  /* the whole pool goes away, no need to release each string */
+  free_strpool (db->strpool);
+  db->strpool = NULL;
   des_igkh (get_hdb (db, MTRC_DATES));
   free_logs (db->logs);
   free_cache (db->cache);
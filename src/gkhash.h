@@ -34,25 +34,30 @@
 
 #include "gslist.h"
 #include "gstorage.h"
+#include "gflat.h"
+#include "ghll.h"
 #include "khash.h"
 #include "parser.h"
 
 #include "gkmhash.h"
 
-#define DB_VERSION  3
+#define DB_VERSION  5
 #define DB_INSTANCE 1
 
 typedef struct GKDB_ GKDB;
 
 typedef struct GKHashStorage_ GKHashStorage;
 
+/* Global string pool, defined privately in gkhash.c */
+typedef struct GKStrPool_ GKStrPool;
+
 /* *INDENT-OFF* */
 /* uint32_t keys           , GKDB payload */
 KHASH_MAP_INIT_INT (igdb   , GKDB *);
 /* uint32_t keys           , GKHashStorage payload */
 KHASH_MAP_INIT_INT (igkh   , GKHashStorage *);
 /* uint32_t keys           , uint32_t payload */
-KHASH_MAP_INIT_INT (ii32   , uint32_t);
+FLAT_MAP_INIT_INT (ii32   , uint32_t);
 /* uint32_t keys           , string payload */
 KHASH_MAP_INIT_INT (is32   , char *);
 /* uint32_t keys           , uint64_t payload */
@@ -72,11 +77,37 @@ KHASH_MAP_INIT_STR (su64   , uint64_t);
 /* uint64_t keys           , no payload (set) */
 KHASH_SET_INIT_INT64 (u648)
 /* uint64_t keys           , uint32_t payload */
-KHASH_MAP_INIT_INT64 (u6432 , uint32_t);
-/* uint32_t keys           , GKMetricVals payload */
-KHASH_MAP_INIT_INT (imtv   , GKMetricVals);
+FLAT_MAP_INIT_INT64 (u6432 , uint32_t);
+/* uint32_t keys           , sketch payload (see IHLL_INLINE) */
+FLAT_MAP_INIT_INT (ihll   , uint64_t);
 /* *INDENT-ON* */
 
+/* A sketch payload holds a lone visitor fingerprint inline, tagged by its
+ * low bit, and only points to a GHLL once a second visitor shows up. */
+#define IHLL_INLINE(v) ((v) & 1)
+#define IHLL_SKETCH(v) ((GHLL *) (uintptr_t) (v))
+
+/* Numeric metrics of a module/date store laid out as dense columns, one per
+ * metric, indexed by row. A data key is assigned the next row on its first
+ * insert; rows start at 1 and are only released along with the whole
+ * table. An update thus only touches the key index and the column it
+ * changes, and whole columns can be walked sequentially. */
+typedef struct GKMetricCols_ {
+  flat_t (ii32) * index;        /* data key -> row */
+  uint32_t *keys;               /* row -> data key */
+  uint32_t *hits;
+  uint32_t *visitors;
+  uint32_t *root;
+  uint64_t *bw;
+  uint64_t *cumts;
+  uint64_t *maxts;
+  uint8_t *meth;
+  uint8_t *proto;
+  uint8_t *touched;             /* METRIC_TOUCHED_* bits */
+  uint32_t size;                /* highest assigned row */
+  uint32_t capacity;            /* allocated rows per column */
+} GKMetricCols;
+
 /* Whole App Data store */
 typedef struct GKHashDB_ {
   GKHashMetric metrics[GAMTRC_TOTAL];
@@ -88,6 +119,7 @@ struct GKDB_ {
   Logs *logs;                   /* logs parsing per db instance */
   GKCacheModule *cache;         /* cache modules */
   GKHashStorage *store;         /* per date OR module */
+  GKStrPool *strpool;           /* interned strings of the dated stores */
 };
 
 #define HT_FIRST_VAL(h, kvar, code) { khint_t __k;    \
@@ -104,6 +136,12 @@ struct GKDB_ {
     code;                                             \
   } }
 
+/* Bytes held by a khash table, excluding anything its keys or values point
+ * to. Sets carry no value array. */
+#define HT_KH_BYTES(h) (sizeof (*(h)) +                                        \
+  (size_t) (h)->n_buckets * (sizeof (*(h)->keys) + ((h)->vals ? sizeof (*(h)->vals) : 0)) + \
+  ((h)->flags ? ((h)->n_buckets < 16 ? 1 : (h)->n_buckets >> 4) * sizeof (khint32_t) : 0))
+
 #define HT_FOREACH_KEY(h, kvar, code) { khint_t __k; \
   for (__k = kh_begin(h); __k != kh_end(h); ++__k) {  \
     if (!kh_exist(h,__k)) continue;                   \
@@ -117,6 +155,7 @@ extern const size_t app_metrics_len;
 /* *INDENT-OFF* */
 void *new_igsl_ht (void);
 void *new_ii32_ht (void);
+void *new_ihll_ht (void);
 void *new_imtv_ht (void);
 void *new_is32_ht (void);
 void *new_iu64_ht (void);
@@ -127,8 +166,10 @@ void *new_u6432_ht (void);
 
 void del_igsl_free (void *h, uint8_t free_data);
 void del_ii32 (void *h, GO_UNUSED uint8_t free_data);
+void del_ihll (void *h, uint8_t free_data);
 void del_imtv (void *h, GO_UNUSED uint8_t free_data);
 void del_is32_free (void *h, uint8_t free_data);
+void del_istr (void *h, uint8_t free_data);
 void del_iu64 (void *h, GO_UNUSED uint8_t free_data);
 void del_si32_free (void *h, uint8_t free_data);
 void del_su64_free (void *h, uint8_t free_data);
@@ -136,8 +177,10 @@ void del_u648 (void *h, GO_UNUSED uint8_t free_data);
 void del_u6432 (void *h, GO_UNUSED uint8_t free_data);
 void des_igsl_free (void *h, uint8_t free_data);
 void des_ii32 (void *h, GO_UNUSED uint8_t free_data);
+void des_ihll (void *h, uint8_t free_data);
 void des_imtv (void *h, GO_UNUSED uint8_t free_data);
 void des_is32_free (void *h, uint8_t free_data);
+void des_istr (void *h, uint8_t free_data);
 void des_iu64 (void *h, GO_UNUSED uint8_t free_data);
 void des_si32_free (void *h, uint8_t free_data);
 void des_su64_free (void *h, uint8_t free_data);
@@ -148,22 +191,28 @@ int inc_iu64 (khash_t (iu64) * hash, uint32_t key, uint64_t inc);
 int inc_su64 (khash_t (su64) * hash, const char *key, uint64_t inc);
 int ins_iglp (khash_t (iglp) * hash, uint64_t key, const GLastParse *lp);
 int ins_igsl (khash_t (igsl) * hash, uint32_t key, uint32_t value);
-int ins_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t value);
+int ins_ii32 (flat_t (ii32) * hash, uint32_t key, uint32_t value);
 int ins_is32 (khash_t (is32) * hash, uint32_t key, char *value);
 int ins_iu64 (khash_t (iu64) * hash, uint32_t key, uint64_t value);
 int ins_si08 (khash_t (si08) * hash, const char *key, uint8_t value);
 int ins_si32 (khash_t (si32) * hash, const char *key, uint32_t value);
 int ins_su64 (khash_t (su64) * hash, const char *key, uint64_t value);
 int ins_u648 (khash_t (u648) * hash, uint64_t key);
-GKMetricVals *get_imtv (khash_t (imtv) * hash, uint32_t key);
-GKMetricVals *ins_imtv (khash_t (imtv) * hash, uint32_t key);
-uint32_t inc_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t inc);
-uint32_t ins_ii32_ai (khash_t (ii32) * hash, uint32_t key);
-uint32_t ins_ii32_inc (khash_t (ii32) * hash, uint32_t key, uint32_t (*cb) (khash_t (si32) *, const char *), khash_t (si32) * seqs, const char *seqk);
+uint32_t get_imtv (GKMetricCols * cols, uint32_t key);
+uint32_t ins_imtv (GKMetricCols * cols, uint32_t key);
+uint32_t ins_ihll (flat_t (ihll) * hash, uint32_t key, uint64_t value, uint8_t p);
+uint64_t ht_mem_app (void);
+uint64_t ht_mem_by_type (GSMetricType type, void *h);
+uint64_t ht_mem_strpool (void);
+const char *ins_istr (flat_t (ii32) * hash, uint32_t key, const char *value);
+uint32_t inc_ii32 (flat_t (ii32) * hash, uint32_t key, uint32_t inc);
+uint32_t ins_ii32_ai (flat_t (ii32) * hash, uint32_t key);
+uint32_t ins_ii32_inc (flat_t (ii32) * hash, uint32_t key, uint32_t (*cb) (khash_t (si32) *, const char *), khash_t (si32) * seqs, const char *seqk);
 uint32_t ins_si32_inc (khash_t (si32) * hash, const char *key, uint32_t (*cb) (khash_t (si32) *, const char *), khash_t (si32) * seqs, const char *seqk);
 
 char *get_is32 (khash_t (is32) * hash, uint32_t key);
-uint32_t get_ii32 (khash_t (ii32) * hash, uint32_t key);
+const char *get_istr (flat_t (ii32) * hash, uint32_t key);
+uint32_t get_ii32 (flat_t (ii32) * hash, uint32_t key);
 uint32_t get_si32 (khash_t (si32) * hash, const char *key);
 uint64_t get_iu64 (khash_t (iu64) * hash, uint32_t key);
 uint64_t get_su64 (khash_t (su64) * hash, const char *key);
@@ -171,12 +220,20 @@ uint8_t get_si08 (khash_t (si08) * hash, const char *key);
 
 int ht_insert_country_continent (const char *country, const char *continent);
 int ht_insert_hostname (const char *ip, const char *host);
+int ht_insert_hostname_at (const char *ip, const char *host, uint64_t resolved);
 int ht_insert_json_logfmt (GO_UNUSED void *userdata, char *key, char *spec);
 int ht_insert_last_parse (uint64_t key, const GLastParse *lp);
 uint32_t ht_inc_cnt_overall (const char *key, uint32_t val);
 uint32_t ht_ins_seq (khash_t (si32) * hash, const char *key);
 uint8_t ht_insert_meth_proto (const char *key);
 
+const char *ht_get_str (uint32_t id);
+uint32_t ht_find_str (const char *str);
+uint32_t ht_intern_str (const char *str);
+int ht_strpool_compactable (void);
+void ht_compact_strpool (void);
+void ht_release_str (uint32_t id);
+
 const char *ht_get_country_continent (const char *country);
 char *ht_get_hostname (const char *host);
 char *ht_get_json_logfmt (const char *key);
@@ -28,6 +28,7 @@
  * SOFTWARE.
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
@@ -48,13 +49,16 @@
 /* Per-module cache backed by dense arrays indexed by cache key (ckey).
  * ckeys are auto-incremented starting at 1, so every metric can live in a
  * plain array instead of a hash table; only the data-hash to ckey keymap
- * requires an actual hash table. String values are borrowed from the dated
- * stores and are never owned by the cache. */
+ * requires an actual hash table. Keymap hashes colliding with a different
+ * string are resolved by probing, as in the dated keymaps. String values
+ * are borrowed from the global string pool and are never owned by the
+ * cache. ckeys released when evicting a date are recycled. */
 struct GKCacheModule_ {
-  khash_t (ii32) * keymap;      /* data hash -> ckey */
-  char **datamap;               /* data ckey -> data string */
-  char **rootmap;               /* root ckey -> root string */
+  flat_t (u6432) * keymap;      /* data hash -> ckey */
+  const char **datamap;         /* data ckey -> data string */
+  const char **rootmap;         /* root ckey -> root string */
   uint32_t *root;               /* data ckey -> root ckey */
+  uint32_t *refs;               /* root ckey -> number of data ckeys under it */
   uint32_t *hits;
   uint32_t *visitors;
   uint64_t *bw;
@@ -65,16 +69,44 @@ struct GKCacheModule_ {
   uint32_t size;                /* highest assigned ckey */
   uint32_t capacity;            /* allocated entries per metric array */
   uint32_t datamap_size;        /* number of ckeys holding a data string */
+  uint32_t *free_ckeys;         /* released ckeys, reused before growing */
+  uint32_t nfree;
+  uint32_t free_capacity;
   uint8_t has_bw;               /* bw metrics have been recorded */
   uint8_t has_cumts;            /* cumts metrics have been recorded */
 };
 
+/* Last date store resolved for a module, global metrics use the trailing
+ * slot. Records of a log mostly arrive in date order, so this lets
+ * get_hash() skip both the DB instance and the date lookups. */
+typedef struct GKStoreCache_ {
+  uint64_t date;
+  GKHashStorage *store;
+} GKStoreCache;
+
+static GKStoreCache store_cache[TOTAL_MODULES + 1];
+
+/* Pool ids borrowed by the module caches when restored out of their
+ * persisted summaries. They are held until no date store is left to load
+ * lazily, as until then no date store references them. */
+static uint32_t *summary_strs = NULL;
+static uint32_t nsummary_strs = 0;
+static uint32_t summary_strs_cap = 0;
+/* Number of date stores whose tables are still on the restored dataset */
+static uint32_t lazy_stores = 0;
+/* Set once the module caches are restored out of their summaries, so they
+ * are not rebuilt out of the date stores */
+static int cache_summarized = 0;
+/* Bumped whenever cache keys may be recycled or their strings moved, so a
+ * reader holding a copy of the caches knows it went stale */
+static uint32_t cache_epoch = 0;
+
 /* *INDENT-OFF* */
 /* Per module - These metrics are not dated */
 const GKHashMetric global_metrics[] = {
   { .metric.storem=MTRC_UNIQUE_KEYS  , MTRC_TYPE_U6432 , new_u6432_ht , des_u6432    , del_u6432     , 0 , NULL , "U6432_UNIQUE_KEYS.db" } ,
-  { .metric.storem=MTRC_AGENT_KEYS   , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 0 , NULL , "II32_AGENT_KEYS.db"   } ,
-  { .metric.storem=MTRC_AGENT_VALS   , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , "IS32_AGENT_VALS.db"   } ,
+  { .metric.storem=MTRC_AGENT_KEYS   , MTRC_TYPE_U6432 , new_u6432_ht , des_u6432    , del_u6432     , 0 , NULL , "U6432_AGENT_KEYS.db"  } ,
+  { .metric.storem=MTRC_AGENT_VALS   , MTRC_TYPE_IS32 , new_ii32_ht , des_istr      , del_istr      , 1 , NULL , "IS32_AGENT_VALS.db"   } ,
   { .metric.storem=MTRC_CNT_VALID    , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , "II32_CNT_VALID.db"    } ,
   { .metric.storem=MTRC_CNT_BW       , MTRC_TYPE_IU64 , new_iu64_ht , des_iu64      , del_iu64      , 1 , NULL , "IU64_CNT_BW.db"       } ,
   { .metric.storem=MTRC_CNT_VISITORS , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , "II32_CNT_VISITORS.db" } ,
@@ -82,13 +114,14 @@ const GKHashMetric global_metrics[] = {
 
 /* Per module & per date - The order must match the GSMetric enum */
 const GKHashMetric module_metrics[] = {
-  { .metric.storem=MTRC_KEYMAP   , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_ROOTMAP  , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_DATAMAP  , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_KEYMAP   , MTRC_TYPE_U6432 , new_u6432_ht , des_u6432    , del_u6432     , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_ROOTMAP  , MTRC_TYPE_IS32 , new_ii32_ht , des_istr      , del_istr      , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_DATAMAP  , MTRC_TYPE_IS32 , new_ii32_ht , des_istr      , del_istr      , 1 , NULL , NULL } ,
   { .metric.storem=MTRC_UNIQMAP  , MTRC_TYPE_U648 , new_u648_ht , des_u648      , del_u648      , 1 , NULL , NULL } ,
   { .metric.storem=MTRC_METRICS  , MTRC_TYPE_IMTV , new_imtv_ht , des_imtv      , del_imtv      , 1 , NULL , NULL } ,
   { .metric.storem=MTRC_AGENTS   , MTRC_TYPE_IGSL , new_igsl_ht , des_igsl_free , del_igsl_free , 1 , NULL , NULL } ,
   { .metric.storem=MTRC_METADATA , MTRC_TYPE_SU64 , new_su64_ht , des_su64_free , del_su64_free , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_SKETCHES , MTRC_TYPE_IHLL , new_ihll_ht , des_ihll      , del_ihll      , 1 , NULL , NULL } ,
 };
 const size_t module_metrics_len = ARRAY_SIZE (module_metrics);
 const size_t global_metrics_len = ARRAY_SIZE (global_metrics);
@@ -209,6 +242,11 @@ static void
 free_stores (GKHashStorage *store) {
   GModule module;
   size_t idx = 0;
+  uint32_t i;
+
+  for (i = 0; i < store->nstrs; ++i)
+    ht_release_str (store->strs[i]);
+  free (store->strs);
 
   free_global_metrics (store->ghash);
   FOREACH_MODULE (idx, module_list) {
@@ -270,6 +308,12 @@ get_store (khash_t (igkh) *hash, uint32_t key) {
   return store;
 }
 
+/* Forget the cached date stores, must be called before freeing any store. */
+static void
+reset_store_cache (void) {
+  memset (store_cache, 0, sizeof (store_cache));
+}
+
 /* Given a store, a module and the metric, get the hash table
  *
  * On error or not found, NULL is returned.
@@ -311,13 +355,235 @@ get_hash_from_store (GKHashStorage *store, int module, GSMetric metric) {
  * On success, a pointer to that hash table is returned. */
 void *
 get_hash (int module, uint64_t key, GSMetric metric) {
-  GKHashStorage *store = NULL;
+  GKStoreCache *sc = &store_cache[module == -1 ? TOTAL_MODULES : module];
+  GKDB *db = NULL;
+
+  if (sc->store == NULL || sc->date != key) {
+    db = get_db_instance (DB_INSTANCE);
+    if ((sc->store = get_store (get_hdb (db, MTRC_DATES), key)) == NULL)
+      return NULL;
+    sc->date = key;
+  }
+  return get_hash_from_store (sc->store, module, metric);
+}
+
+/* Determine whether a metric stays in memory when its date store is
+ * spilled. These tables are tiny and read on every report: the per-date
+ * counters and the module metadata sums.
+ *
+ * If resident, 1 is returned, else 0. */
+int
+ht_is_resident_metric (int module, GSMetric metric) {
+  if (module == -1)
+    return metric == MTRC_CNT_VALID || metric == MTRC_CNT_BW || metric == MTRC_CNT_VISITORS;
+  return metric == MTRC_METADATA;
+}
+
+/* Take over the references an unloaded table held on its pooled strings,
+ * as the module caches may still borrow them. */
+static void
+hold_istr (GKHashStorage *store, flat_t (ii32) *hash) {
+  khint_t k;
+
+  if (!hash || fl_size (hash) == 0)
+    return;
+
+  store->strs = xrealloc (store->strs, (store->nstrs + fl_size (hash)) * sizeof (uint32_t));
+  for (k = fl_begin (hash); k != fl_end (hash); ++k) {
+    if (fl_exist (hash, k))
+      store->strs[store->nstrs++] = fl_val (hash, k);
+  }
+}
+
+/* Destroy a non-resident table of a date store being spilled. */
+static void
+unload_metric (GKHashStorage *store, GKHashMetric *mtrc) {
+  if (mtrc->type == MTRC_TYPE_IS32) {
+    hold_istr (store, mtrc->hash);
+    mtrc->des (mtrc->hash, 0);
+  } else {
+    mtrc->des (mtrc->hash, mtrc->free_data);
+  }
+  mtrc->hash = NULL;
+}
+
+/* Spill a date store: all but its resident tables are persisted to disk and
+ * unloaded. Its contributions remain in the module caches.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+spill_date_store (uint32_t date, GKHashStorage *store) {
+  GKHashMetric *mtrc = NULL;
+  GModule module;
+  size_t idx = 0, i;
+
+  if (store->spilled)
+    return 0;
+  if (persist_spilled_date (date) != 0)
+    return -1;
+
+  reset_store_cache ();
+  for (i = 0; i < global_metrics_len; ++i) {
+    mtrc = &store->ghash->metrics[i];
+    if (!ht_is_resident_metric (-1, mtrc->metric.storem))
+      unload_metric (store, mtrc);
+  }
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    for (i = 0; i < module_metrics_len; ++i) {
+      mtrc = &store->mhash[module].metrics[i];
+      if (!ht_is_resident_metric (module, mtrc->metric.storem))
+        unload_metric (store, mtrc);
+    }
+  }
+  store->spilled = 1;
+
+  return 0;
+}
+
+/* Release the string references held for the restored module caches. */
+static void
+release_summary_strs (void) {
+  uint32_t i;
+
+  for (i = 0; i < nsummary_strs; ++i)
+    ht_release_str (summary_strs[i]);
+  free (summary_strs);
+  summary_strs = NULL;
+  nsummary_strs = summary_strs_cap = 0;
+}
+
+/* A lazily restored date store has been loaded. Once none is left, the
+ * date stores reference every string the module caches borrow. */
+static void
+unmark_lazy_store (GKHashStorage *store) {
+  store->lazy = 0;
+  if (lazy_stores && --lazy_stores == 0)
+    release_summary_strs ();
+}
+
+/* Allocate back the unloaded tables of a date store. */
+static void
+alloc_date_store (GKHashStorage *store) {
+  GKHashMetric *mtrc = NULL;
+  GModule module;
+  size_t idx = 0, i;
+
+  for (i = 0; i < global_metrics_len; ++i) {
+    mtrc = &store->ghash->metrics[i];
+    if (!mtrc->hash)
+      mtrc->hash = mtrc->alloc ();
+  }
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    for (i = 0; i < module_metrics_len; ++i) {
+      mtrc = &store->mhash[module].metrics[i];
+      if (!mtrc->hash)
+        mtrc->hash = mtrc->alloc ();
+    }
+  }
+  store->spilled = 0;
+}
+
+/* Load a spilled date store back from disk and drop the string references
+ * held on its behalf. A lazily restored one is read out of the restored
+ * dataset instead.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+load_date_store (uint32_t date, GKHashStorage *store) {
+  uint8_t dirty = store->dirty;
+  uint32_t j;
+  int ret = 0;
+
+  if (!store->spilled)
+    return 0;
+
+  alloc_date_store (store);
+  if (store->lazy) {
+    if ((ret = restore_lazy_dates (&date, 1)) != 0)
+      LOG_DEBUG (("Unable to load restored date %u\n", date));
+    unmark_lazy_store (store);
+    /* loading back tables doesn't modify the date */
+    store->dirty = dirty;
+    return ret;
+  }
+
+  if ((ret = restore_spilled_date (date)) != 0)
+    LOG_DEBUG (("Unable to load spilled date %u\n", date));
+  store->dirty = dirty;
+
+  for (j = 0; j < store->nstrs; ++j)
+    ht_release_str (store->strs[j]);
+  free (store->strs);
+  store->strs = NULL;
+  store->nstrs = 0;
+
+  return ret;
+}
+
+/* Given a hash and a key (date), get the relevant store, loading it back
+ * from disk if it was spilled.
+ *
+ * On error or not found, NULL is returned.
+ * On success, a pointer to that store is returned. */
+static GKHashStorage *
+get_loaded_store (khash_t (igkh) *hash, uint32_t key) {
+  GKHashStorage *store = get_store (hash, key);
+
+  if (store && store->spilled)
+    load_date_store (key, store);
+  return store;
+}
+
+/* Load back every lazily restored date store in a single pass over the
+ * restored dataset. */
+static void
+load_lazy_dates (khash_t (igkh) *hash) {
+  uint32_t *dates = NULL, len = 0;
+  khint_t k;
+
+  if (!lazy_stores)
+    return;
+
+  dates = xcalloc (kh_size (hash), sizeof (uint32_t));
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (!kh_exist (hash, k) || !kh_val (hash, k)->lazy)
+      continue;
+    alloc_date_store (kh_val (hash, k));
+    dates[len++] = kh_key (hash, k);
+  }
+  if (restore_lazy_dates (dates, len) != 0)
+    LOG_DEBUG (("Unable to load the restored dates\n"));
+
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (!kh_exist (hash, k) || !kh_val (hash, k)->lazy)
+      continue;
+    /* restored unmodified */
+    kh_val (hash, k)->dirty = 0;
+    unmark_lazy_store (kh_val (hash, k));
+  }
+  free (dates);
+}
+
+/* Load back every spilled date store, e.g., before persisting the whole
+ * dataset. */
+void
+load_spilled_dates (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  khint_t k;
 
-  if ((store = get_store (hash, key)) == NULL)
-    return NULL;
-  return get_hash_from_store (store, module, metric);
+  if (!hash)
+    return;
+
+  load_lazy_dates (hash);
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (kh_exist (hash, k) && kh_val (hash, k)->spilled)
+      load_date_store (kh_key (hash, k), kh_val (hash, k));
+  }
 }
 
 /* Given a module, get its cache
@@ -359,6 +625,7 @@ cache_grow (GKCacheModule *cache, uint32_t ckey) {
   cache->datamap = cache_grow_arr (cache->datamap, oldcap, newcap, sizeof (char *));
   cache->rootmap = cache_grow_arr (cache->rootmap, oldcap, newcap, sizeof (char *));
   cache->root = cache_grow_arr (cache->root, oldcap, newcap, sizeof (uint32_t));
+  cache->refs = cache_grow_arr (cache->refs, oldcap, newcap, sizeof (uint32_t));
   cache->hits = cache_grow_arr (cache->hits, oldcap, newcap, sizeof (uint32_t));
   cache->visitors = cache_grow_arr (cache->visitors, oldcap, newcap, sizeof (uint32_t));
   cache->bw = cache_grow_arr (cache->bw, oldcap, newcap, sizeof (uint64_t));
@@ -369,38 +636,72 @@ cache_grow (GKCacheModule *cache, uint32_t ckey) {
   cache->capacity = newcap;
 }
 
-/* Insert a data hash key into the cache keymap, assigning a new dense cache
- * key if not present, and ensure the metric arrays can hold it.
+/* Determine whether the data or root string held for a key matches the
+ * given string. A key holding no string yet was just added while processing
+ * the current record, before its data/root string was set, hence it is
+ * considered a match.
+ *
+ * On match, non-zero is returned.
+ * Otherwise, 0 is returned. */
+static int
+key_str_match (const char *dstr, const char *rstr, const char *str) {
+  if ((!dstr && !rstr) || !str)
+    return 1;
+  return (dstr && strcmp (dstr, str) == 0) || (rstr && strcmp (rstr, str) == 0);
+}
+
+/* Hash a keymap string key, leaving its probe bits clear.
+ *
+ * On success, the 64-bit keymap hash is returned. */
+uint64_t
+ht_keymap_hash (const char *str) {
+  return hash64 (str, strlen (str)) & ~KEYMAP_PROBE_MASK;
+}
+
+/* Insert a keymap hash and its string into the cache keymap, assigning a new
+ * dense cache key if not present, and ensure the metric arrays can hold it.
+ * A hash taken by a different string moves on to the next probe slot.
  *
  * On error, 0 is returned.
  * On success or if the key exists, its cache key is returned */
 static uint32_t
-cache_ins_ckey (GKCacheModule *cache, uint32_t dhash) {
-  uint32_t ckey = 0;
+cache_ins_ckey (GKCacheModule *cache, uint64_t hash, const char *str) {
+  uint64_t key = hash & ~KEYMAP_PROBE_MASK;
+  uint32_t ckey = 0, i;
+  khint_t k;
+  int ret;
 
   if (!cache || !cache->keymap)
     return 0;
 
-  if ((ckey = ins_ii32_ai (cache->keymap, dhash)) == 0)
-    return 0;
+  for (i = 0; i <= KEYMAP_PROBE_MASK; ++i, ++key) {
+    k = fl_put (u6432, cache->keymap, key, &ret);
+    /* operation failed */
+    if (ret == -1)
+      return 0;
+    /* key exists, make sure it is not a collision */
+    if (ret == 0) {
+      ckey = fl_val (cache->keymap, k);
+      if (key_str_match (cache->datamap[ckey], cache->rootmap[ckey], str))
+        return ckey;
+      continue;
+    }
+
+    if (cache->nfree) {
+      ckey = cache->free_ckeys[--cache->nfree];
+      fl_val (cache->keymap, k) = ckey;
+      return ckey;
+    }
 
-  if (ckey > cache->size) {
+    ckey = cache->size + 1;
+    fl_val (cache->keymap, k) = ckey;
     cache->size = ckey;
     cache_grow (cache, ckey);
-  }
 
-  return ckey;
-}
+    return ckey;
+  }
 
-/* Look up the cache key assigned to the given data hash key.
- *
- * If not found, 0 is returned.
- * On success, the cache key is returned */
-static uint32_t
-cache_get_ckey (GKCacheModule *cache, uint32_t dhash) {
-  if (!cache)
-    return 0;
-  return get_ii32 (cache->keymap, dhash);
+  return 0;
 }
 
 /* Determine whether the given ckey indexes a valid cache entry.
@@ -415,7 +716,7 @@ cache_valid_ckey (const GKCacheModule *cache, uint32_t ckey) {
 /* Borrow a data string into the cache datamap. The value is only set once
  * per ckey, mirroring the non-replacing insert semantics of the store. */
 static void
-cache_set_datamap (GKCacheModule *cache, uint32_t ckey, char *value) {
+cache_set_datamap (GKCacheModule *cache, uint32_t ckey, const char *value) {
   if (!cache_valid_ckey (cache, ckey) || cache->datamap[ckey])
     return;
 
@@ -426,45 +727,27 @@ cache_set_datamap (GKCacheModule *cache, uint32_t ckey, char *value) {
 /* Borrow a root string into the cache rootmap. The value is only set once
  * per ckey, mirroring the non-replacing insert semantics of the store. */
 static void
-cache_set_rootmap (GKCacheModule *cache, uint32_t ckey, char *value) {
+cache_set_rootmap (GKCacheModule *cache, uint32_t ckey, const char *value) {
   if (!cache_valid_ckey (cache, ckey) || cache->rootmap[ckey])
     return;
 
   cache->rootmap[ckey] = value;
 }
 
-/* Map a data ckey to its root ckey. */
+/* Map a data ckey to its root ckey, keeping count of the data ckeys under
+ * each root. */
 static void
 cache_set_root (GKCacheModule *cache, uint32_t dkey, uint32_t rkey) {
-  if (!cache_valid_ckey (cache, dkey))
-    return;
-
-  cache->root[dkey] = rkey;
-}
+  uint32_t old = 0;
 
-/* Clear all cache entries for a module, keeping the allocated arrays for
- * later reuse. Borrowed strings belong to the dated stores and must not be
- * freed here. */
-static void
-cache_reset (GKCacheModule *cache) {
-  if (!cache || !cache->capacity)
+  if (!cache_valid_ckey (cache, dkey) || (old = cache->root[dkey]) == rkey)
     return;
 
-  del_ii32 (cache->keymap, 0);
-  memset (cache->datamap, 0, cache->capacity * sizeof (char *));
-  memset (cache->rootmap, 0, cache->capacity * sizeof (char *));
-  memset (cache->root, 0, cache->capacity * sizeof (uint32_t));
-  memset (cache->hits, 0, cache->capacity * sizeof (uint32_t));
-  memset (cache->visitors, 0, cache->capacity * sizeof (uint32_t));
-  memset (cache->bw, 0, cache->capacity * sizeof (uint64_t));
-  memset (cache->cumts, 0, cache->capacity * sizeof (uint64_t));
-  memset (cache->maxts, 0, cache->capacity * sizeof (uint64_t));
-  memset (cache->meth, 0, cache->capacity * sizeof (uint8_t));
-  memset (cache->proto, 0, cache->capacity * sizeof (uint8_t));
-  cache->size = 0;
-  cache->datamap_size = 0;
-  cache->has_bw = 0;
-  cache->has_cumts = 0;
+  if (old && cache->refs[old])
+    cache->refs[old]--;
+  if (cache_valid_ckey (cache, rkey))
+    cache->refs[rkey]++;
+  cache->root[dkey] = rkey;
 }
 
 /* Initialize the cache for all enabled modules.
@@ -479,7 +762,7 @@ init_cache_modules (void) {
 
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
-    cache[module].keymap = new_ii32_ht ();
+    cache[module].keymap = new_u6432_ht ();
   }
 
   return cache;
@@ -499,10 +782,11 @@ free_cache (GKCacheModule *cache) {
     module = module_list[idx];
     c = &cache[module];
 
-    des_ii32 (c->keymap, 0);
+    des_u6432 (c->keymap, 0);
     free (c->datamap);
     free (c->rootmap);
     free (c->root);
+    free (c->refs);
     free (c->hits);
     free (c->visitors);
     free (c->bw);
@@ -510,17 +794,94 @@ free_cache (GKCacheModule *cache) {
     free (c->maxts);
     free (c->meth);
     free (c->proto);
+    free (c->free_ckeys);
   }
   free (cache);
+  free (summary_strs);
+  summary_strs = NULL;
+  nsummary_strs = summary_strs_cap = 0;
+}
+
+/* Look up the keymap value of the given string key in a keymap, probing past
+ * colliding hashes whose data or root string differs.
+ *
+ * If not found, 0 is returned.
+ * On success, the value of the key is returned */
+static uint32_t
+get_keymap_str (flat_t (u6432) *hash, uint64_t key, const char *str, flat_t (ii32) *smap,
+                flat_t (ii32) *rmap) {
+  uint32_t val = 0, i;
+  khint_t k;
+
+  key &= ~KEYMAP_PROBE_MASK;
+  for (i = 0; i <= KEYMAP_PROBE_MASK; ++i, ++key) {
+    if ((k = fl_get (u6432, hash, key)) == fl_end (hash))
+      return 0;
+    val = fl_val (hash, k);
+    if (key_str_match (get_istr (smap, val), get_istr (rmap, val), str))
+      return val;
+  }
+
+  return 0;
+}
+
+/* Find or insert a string key into a keymap given its hash, probing past
+ * colliding hashes whose string held by smap/rmap differs. A new key is
+ * assigned newval, or the next value of the seqk sequence if 0.
+ *
+ * On error, 0 is returned.
+ * On success or if the key exists, the value of the key is returned */
+static uint32_t
+ins_keymap_str (flat_t (u6432) *hash, uint64_t key, const char *str, flat_t (ii32) *smap,
+                flat_t (ii32) *rmap, const char *seqk, uint32_t newval) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
+  uint32_t val = 0, i;
+  khint_t k;
+  int ret;
+
+  if (!hash)
+    return 0;
+
+  key &= ~KEYMAP_PROBE_MASK;
+  for (i = 0; i <= KEYMAP_PROBE_MASK; ++i, ++key) {
+    k = fl_put (u6432, hash, key, &ret);
+    /* operation failed */
+    if (ret == -1)
+      return 0;
+    /* key exists, make sure it is not a collision */
+    if (ret == 0) {
+      val = fl_val (hash, k);
+      if (key_str_match (get_istr (smap, val), get_istr (rmap, val), str))
+        return val;
+      continue;
+    }
+
+    if ((val = newval ? newval : ht_ins_seq (seqs, seqk)) == 0) {
+      fl_del (u6432, hash, k);
+      return 0;
+    }
+    fl_val (hash, k) = val;
+
+    return val;
+  }
+
+  return 0;
 }
 
+/* Get the keymap values of the given string key across all dates.
+ *
+ * On error, or if not found, NULL is returned.
+ * On success, a list of keymap values is returned. */
 GSLList *
-ht_get_keymap_list_from_key (GModule module, uint32_t key) {
+ht_get_keymap_list_from_str (GModule module, const char *str) {
   GKDB *db = get_db_instance (DB_INSTANCE);
+  GKHashStorage *store = NULL;
   GSLList *list = NULL;
-  khiter_t kv;
   khint_t k;
-  khash_t (ii32) * hash = NULL;
+  flat_t (u6432) * hash = NULL;
+  uint64_t key = ht_keymap_hash (str);
+  uint32_t val = 0;
 
   khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
 
@@ -530,11 +891,13 @@ ht_get_keymap_list_from_key (GModule module, uint32_t key) {
   for (k = kh_begin (dates); k != kh_end (dates); ++k) {
     if (!kh_exist (dates, k))
       continue;
-    if (!(hash = get_hash (module, kh_key (dates, k), MTRC_KEYMAP)))
+    store = get_loaded_store (dates, kh_key (dates, k));
+    if (!(hash = get_hash_from_store (store, module, MTRC_KEYMAP)))
       continue;
-    if ((kv = kh_get (ii32, hash, key)) == kh_end (hash))
+    if ((val = get_keymap_str (hash, key, str, get_hash_from_store (store, module, MTRC_DATAMAP),
+                               get_hash_from_store (store, module, MTRC_ROOTMAP))) == 0)
       continue;
-    list = list_insert_prepend (list, i322ptr (kh_val (hash, kv)));
+    list = list_insert_prepend (list, i322ptr (val));
   }
 
   return list;
@@ -542,13 +905,13 @@ ht_get_keymap_list_from_key (GModule module, uint32_t key) {
 
 /* Increases the unique visitors counter for the given date. */
 void
-ht_inc_cnt_visitors (uint32_t date) {
-  khash_t (ii32) * hash = get_hash (-1, date, MTRC_CNT_VISITORS);
+ht_inc_cnt_visitors (uint32_t date, uint32_t inc) {
+  flat_t (ii32) * hash = get_hash (-1, date, MTRC_CNT_VISITORS);
 
   if (!hash)
     return;
 
-  inc_ii32 (hash, 1, 1);
+  inc_ii32 (hash, 1, inc);
 }
 
 /* Insert a unique visitor fingerprint (IP/UA), mapped to an auto incremented
@@ -562,7 +925,7 @@ uint32_t
 ht_insert_unique_key (uint32_t date, uint64_t key, int countable, int *first_count) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (u6432) * hash = get_hash (-1, date, MTRC_UNIQUE_KEYS);
+  flat_t (u6432) * hash = get_hash (-1, date, MTRC_UNIQUE_KEYS);
   uint32_t val = 0;
   khint_t k;
   int ret;
@@ -571,25 +934,25 @@ ht_insert_unique_key (uint32_t date, uint64_t key, int countable, int *first_cou
   if (!hash)
     return 0;
 
-  k = kh_put (u6432, hash, key, &ret);
+  k = fl_put (u6432, hash, key, &ret);
   if (ret == -1)
     return 0;
 
   if (ret == 0) {
-    val = kh_val (hash, k);
+    val = fl_val (hash, k);
   } else {
     val = ht_ins_seq (seqs, "ht_unique_keys");
     /* the counted bit occupies the top sequence bit; reject an overflowing
      * sequence rather than corrupting counted state */
     if (val == 0 || (val & VISITOR_COUNTED_BIT)) {
-      kh_del (u6432, hash, k);
+      fl_del (u6432, hash, k);
       return 0;
     }
-    kh_val (hash, k) = val;
+    fl_val (hash, k) = val;
   }
 
   if (countable && !(val & VISITOR_COUNTED_BIT)) {
-    kh_val (hash, k) = val | VISITOR_COUNTED_BIT;
+    fl_val (hash, k) = val | VISITOR_COUNTED_BIT;
     *first_count = 1;
   }
 
@@ -602,19 +965,14 @@ ht_insert_unique_key (uint32_t date, uint64_t key, int countable, int *first_cou
  * On error, 0 is returned.
  * On success the value of the key inserted is returned */
 uint32_t
-ht_insert_agent_key (uint32_t date, uint32_t key) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (ii32) * hash = get_hash (-1, date, MTRC_AGENT_KEYS);
-  uint32_t val = 0;
+ht_insert_agent_key (uint32_t date, uint64_t key, const char *agent) {
+  flat_t (u6432) * hash = get_hash (-1, date, MTRC_AGENT_KEYS);
+  flat_t (ii32) * vals = get_hash (-1, date, MTRC_AGENT_VALS);
 
   if (!hash)
     return 0;
 
-  if ((val = get_ii32 (hash, key)) != 0)
-    return val;
-
-  return ins_ii32_inc (hash, key, ht_ins_seq, seqs, "ht_agent_keys");
+  return ins_keymap_str (hash, key, agent, vals, NULL, "ht_agent_keys", 0);
 }
 
 /* Insert a user agent uint32_t key, mapped to a user agent string value.
@@ -623,18 +981,12 @@ ht_insert_agent_key (uint32_t date, uint32_t key) {
  * On success 0 is returned */
 int
 ht_insert_agent_value (uint32_t date, uint32_t key, char *value) {
-  khash_t (is32) * hash = get_hash (-1, date, MTRC_AGENT_VALS);
-  char *dupval = NULL;
+  flat_t (ii32) * hash = get_hash (-1, date, MTRC_AGENT_VALS);
 
   if (!hash)
     return -1;
 
-  if ((kh_get (is32, hash, key)) != kh_end (hash))
-    return 0;
-
-  dupval = xstrdup (value);
-  if (ins_is32 (hash, key, dupval) != 0)
-    free (dupval);
+  ins_istr (hash, key, value);
   return 0;
 }
 
@@ -644,28 +996,22 @@ ht_insert_agent_value (uint32_t date, uint32_t key, char *value) {
  * On error, 0 is returned.
  * On success the value of the key inserted is returned */
 uint32_t
-ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t *ckey) {
+ht_insert_keymap (GModule module, uint32_t date, uint64_t key, const char *str, uint32_t *ckey) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (ii32) * hash = get_hash (module, date, MTRC_KEYMAP);
+  GKHashStorage *store = get_store (get_hdb (db, MTRC_DATES), date);
+  flat_t (u6432) * hash = get_hash_from_store (store, module, MTRC_KEYMAP);
+  flat_t (ii32) * dmap = get_hash_from_store (store, module, MTRC_DATAMAP);
+  flat_t (ii32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
   GKCacheModule *cache = get_cache_module (module);
 
   uint32_t val = 0;
-  const char *modstr;
 
   if (!hash)
     return 0;
 
-  if ((val = get_ii32 (hash, key)) != 0) {
-    *ckey = cache_get_ckey (cache, key);
-    return val;
-  }
-
-  modstr = get_module_str (module);
-  if ((val = ins_ii32_inc (hash, key, ht_ins_seq, seqs, modstr)) == 0) {
+  if ((val = ins_keymap_str (hash, key, str, dmap, rmap, get_module_str (module), 0)) == 0)
     return val;
-  }
-  *ckey = cache_ins_ckey (cache, key);
+  *ckey = cache_ins_ckey (cache, key, str);
 
   return val;
 }
@@ -677,21 +1023,19 @@ ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t *ckey) {
  * On success 0 is returned */
 int
 ht_insert_rootmap (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey) {
-  khash_t (is32) * hash = get_hash (module, date, MTRC_ROOTMAP);
+  flat_t (ii32) * hash = get_hash (module, date, MTRC_ROOTMAP);
   GKCacheModule *cache = get_cache_module (module);
-  char *dupval = NULL;
-  int ret = 0;
+  const char *str = NULL;
 
   if (!hash)
     return -1;
 
-  dupval = xstrdup (value);
-  if ((ret = ins_is32 (hash, key, dupval)) == 0)
-    cache_set_rootmap (cache, ckey, dupval);
-  else
-    free (dupval);
+  if ((str = ins_istr (hash, key, value)) == NULL)
+    return -1;
 
-  return ret;
+  cache_set_rootmap (cache, ckey, str);
+
+  return 0;
 }
 
 /* Insert a datamap uint32_t key and string value.
@@ -700,21 +1044,19 @@ ht_insert_rootmap (GModule module, uint32_t date, uint32_t key, const char *valu
  * On success 0 is returned */
 int
 ht_insert_datamap (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey) {
-  khash_t (is32) * hash = get_hash (module, date, MTRC_DATAMAP);
+  flat_t (ii32) * hash = get_hash (module, date, MTRC_DATAMAP);
   GKCacheModule *cache = get_cache_module (module);
-  char *dupval = NULL;
-  int ret = 0;
+  const char *str = NULL;
 
   if (!hash)
     return -1;
 
-  dupval = xstrdup (value);
-  if ((ret = ins_is32 (hash, key, dupval)) == 0)
-    cache_set_datamap (cache, ckey, dupval);
-  else
-    free (dupval);
+  if ((str = ins_istr (hash, key, value)) == NULL)
+    return -1;
+
+  cache_set_datamap (cache, ckey, str);
 
-  return ret;
+  return 0;
 }
 
 /* Insert a uniqmap uint64_t key into the set.
@@ -735,6 +1077,25 @@ ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value)
   return ins_u648 (hash, k) == 0 ? 1 : 0;
 }
 
+/* Add a visitor fingerprint to the HyperLogLog sketch of a data key. The
+ * VISITORS panel sketches double as the per-date totals and get a finer
+ * precision.
+ *
+ * On error, 0 is returned.
+ * On success the amount the estimated visitors advanced by is returned */
+uint32_t
+ht_insert_sketch (GModule module, uint32_t date, uint32_t key, uint64_t value) {
+  flat_t (ihll) * hash = get_hash (module, date, MTRC_SKETCHES);
+  uint8_t p = module == VISITORS ? HLL_DATE_PRECISION : HLL_ITEM_PRECISION;
+
+  if (!hash)
+    return 0;
+
+  /* fingerprints repeat across dates; salting them with the date keeps a
+   * register collision from recurring on every date of the panel sums */
+  return ins_ihll (hash, key, value ^ ((uint64_t) date * 0x9e3779b97f4a7c15ULL), p);
+}
+
 /* Insert a data uint32_t key mapped to the corresponding uint32_t root key.
  *
  * On error, -1 is returned.
@@ -742,17 +1103,17 @@ ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value)
 int
 ht_insert_root (GModule module, uint32_t date, uint32_t key, uint32_t value, uint32_t dkey,
                 uint32_t rkey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   cache_set_root (cache, dkey, rkey);
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  mv->root = value;
+  cols->root[row] = value;
 
   return 0;
 }
@@ -763,18 +1124,18 @@ ht_insert_root (GModule module, uint32_t date, uint32_t key, uint32_t value, uin
  * On success the inserted value is returned */
 uint32_t
 ht_insert_hits (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return 0;
 
   if (cache_valid_ckey (cache, ckey))
     __atomic_add_fetch (&cache->hits[ckey], inc, __ATOMIC_SEQ_CST);
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return 0;
-  return __atomic_add_fetch (&mv->hits, inc, __ATOMIC_SEQ_CST);
+  return __atomic_add_fetch (&cols->hits[row], inc, __ATOMIC_SEQ_CST);
 }
 
 /* Increases visitors counter from a uint32_t key.
@@ -783,18 +1144,18 @@ ht_insert_hits (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint3
  * On success the inserted value is returned */
 uint32_t
 ht_insert_visitor (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return 0;
 
   if (cache_valid_ckey (cache, ckey))
     __atomic_add_fetch (&cache->visitors[ckey], inc, __ATOMIC_SEQ_CST);
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return 0;
-  return __atomic_add_fetch (&mv->visitors, inc, __ATOMIC_SEQ_CST);
+  return __atomic_add_fetch (&cols->visitors[row], inc, __ATOMIC_SEQ_CST);
 }
 
 /* Increases bandwidth counter from a uint32_t key.
@@ -803,21 +1164,21 @@ ht_insert_visitor (GModule module, uint32_t date, uint32_t key, uint32_t inc, ui
  * On success 0 is returned */
 int
 ht_insert_bw (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   if (cache_valid_ckey (cache, ckey)) {
     cache->bw[ckey] += inc;
     cache->has_bw = 1;
   }
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  mv->bw += inc;
-  mv->touched |= METRIC_TOUCHED_BW;
+  cols->bw[row] += inc;
+  cols->touched[row] |= METRIC_TOUCHED_BW;
 
   return 0;
 }
@@ -828,21 +1189,21 @@ ht_insert_bw (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_
  * On success 0 is returned */
 int
 ht_insert_cumts (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   if (cache_valid_ckey (cache, ckey)) {
     cache->cumts[ckey] += inc;
     cache->has_cumts = 1;
   }
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  mv->cumts += inc;
-  mv->touched |= METRIC_TOUCHED_CUMTS;
+  cols->cumts[row] += inc;
+  cols->touched[row] |= METRIC_TOUCHED_CUMTS;
 
   return 0;
 }
@@ -854,19 +1215,19 @@ ht_insert_cumts (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint
  * On success 0 is returned */
 int
 ht_insert_maxts (GModule module, uint32_t date, uint32_t key, uint64_t value, uint32_t ckey) {
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   if (cache_valid_ckey (cache, ckey) && cache->maxts[ckey] < value)
     cache->maxts[ckey] = value;
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  if (mv->maxts < value)
-    mv->maxts = value;
+  if (cols->maxts[row] < value)
+    cols->maxts[row] = value;
 
   return 0;
 }
@@ -878,21 +1239,21 @@ ht_insert_maxts (GModule module, uint32_t date, uint32_t key, uint64_t value, ui
 int
 ht_insert_method (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
   uint8_t val = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   if (!(val = get_si08 (mtpr, value)))
     return -1;
 
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  mv->meth = val;
+  cols->meth[row] = val;
   if (cache_valid_ckey (cache, ckey))
     cache->meth[ckey] = val;
 
@@ -906,21 +1267,21 @@ ht_insert_method (GModule module, uint32_t date, uint32_t key, const char *value
 int
 ht_insert_protocol (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (imtv) * hash = get_hash (module, date, MTRC_METRICS);
+  GKMetricCols *cols = get_hash (module, date, MTRC_METRICS);
   GKCacheModule *cache = get_cache_module (module);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
-  GKMetricVals *mv = NULL;
+  uint32_t row = 0;
   uint8_t val = 0;
 
-  if (!hash)
+  if (!cols)
     return -1;
 
   if (!(val = get_si08 (mtpr, value)))
     return -1;
 
-  if (!(mv = ins_imtv (hash, key)))
+  if (!(row = ins_imtv (cols, key)))
     return -1;
-  mv->proto = val;
+  cols->proto[row] = val;
   if (cache_valid_ckey (cache, ckey))
     cache->proto[ckey] = val;
 
@@ -959,40 +1320,114 @@ int
 ht_insert_date (uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  int ret = 0;
 
   if (!hash)
     return -1;
 
-  return ins_igkh (hash, key);
-}
+  /* records for a spilled date need its tables back */
+  if ((ret = ins_igkh (hash, key)) == 1)
+    get_loaded_store (hash, key);
+  if ((store = get_store (hash, key)))
+    store->dirty = 1;
 
-uint32_t
-ht_inc_cnt_valid (uint32_t date, uint32_t inc) {
-  khash_t (ii32) * hash = get_hash (-1, date, MTRC_CNT_VALID);
+  return ret;
+}
 
-  if (!hash)
-    return 0;
+/* Determine whether the storage holds the given date.
+ *
+ * If it does, 1 is returned, else 0. */
+int
+ht_has_date (uint32_t date) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
 
-  return inc_ii32 (hash, 1, inc);
+  return hash && get_store (hash, date) != NULL;
 }
 
+/* Determine whether a date was modified since it was restored or last
+ * persisted.
+ *
+ * If it was, 1 is returned, else 0. */
 int
-ht_inc_cnt_bw (uint32_t date, uint64_t inc) {
-  khash_t (iu64) * hash = get_hash (-1, date, MTRC_CNT_BW);
+ht_is_dirty_date (uint32_t date) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
 
-  if (!hash)
+  if (!hash || !(store = get_store (hash, date)))
     return 0;
-
-  return inc_iu64 (hash, 1, inc);
+  return store->dirty;
 }
 
-uint32_t
-ht_sum_valid (void) {
+/* Load all tables of a date back, e.g., to persist a spilled date.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+ht_load_date (uint32_t date) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (ii32) * hash = NULL;
-  uint32_t k = 0;
-  uint32_t sum = 0;
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+
+  if (!hash || !(store = get_store (hash, date)))
+    return -1;
+  return load_date_store (date, store);
+}
+
+void
+ht_set_date_dirty (uint32_t date, int dirty) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+
+  if (hash && (store = get_store (hash, date)))
+    store->dirty = dirty;
+}
+
+/* Flag all dates as modified or not, e.g., once restored. */
+void
+ht_set_dates_dirty (int dirty) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  khint_t k;
+
+  if (!hash)
+    return;
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (kh_exist (hash, k))
+      kh_val (hash, k)->dirty = dirty;
+  }
+}
+
+uint32_t
+ht_inc_cnt_valid (uint32_t date, uint32_t inc) {
+  flat_t (ii32) * hash = get_hash (-1, date, MTRC_CNT_VALID);
+
+  if (!hash)
+    return 0;
+
+  return inc_ii32 (hash, 1, inc);
+}
+
+int
+ht_inc_cnt_bw (uint32_t date, uint64_t inc) {
+  khash_t (iu64) * hash = get_hash (-1, date, MTRC_CNT_BW);
+
+  if (!hash)
+    return 0;
+
+  return inc_iu64 (hash, 1, inc);
+}
+
+uint32_t
+ht_sum_valid (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  flat_t (ii32) * hash = NULL;
+  uint32_t k = 0;
+  uint32_t sum = 0;
 
   if (!dates)
     return 0;
@@ -1028,6 +1463,118 @@ ht_sum_bw (void) {
   return sum;
 }
 
+/* Number of bytes held by the cache of the given module. */
+uint64_t
+ht_mem_cache (GModule module) {
+  GKCacheModule *cache = get_cache_module (module);
+  uint64_t per = 0;
+
+  if (!cache)
+    return 0;
+
+  per = sizeof (*cache->datamap) + sizeof (*cache->rootmap) + sizeof (*cache->root) +
+    sizeof (*cache->refs) + sizeof (*cache->hits) + sizeof (*cache->visitors) +
+    sizeof (*cache->bw) + sizeof (*cache->cumts) + sizeof (*cache->maxts) +
+    sizeof (*cache->meth) + sizeof (*cache->proto);
+
+  return sizeof (*cache) + (cache->keymap ? fl_bytes (cache->keymap) : 0) +
+    per * cache->capacity + (uint64_t) cache->free_capacity * sizeof (*cache->free_ckeys);
+}
+
+/* Account for the bytes held by each global and module metric of a date
+ * store. */
+static void
+mem_date_store (GKHashStorage *store, GKMemDate *mem) {
+  GKHashMetric *mtrc = NULL;
+  GModule module;
+  size_t idx = 0, j;
+
+  mem->spilled = store->spilled;
+  mem->total = sizeof (*store) + sizeof (*store->ghash) + TOTAL_MODULES * sizeof (*store->mhash) +
+    (uint64_t) store->nstrs * sizeof (*store->strs);
+  for (j = 0; j < global_metrics_len; ++j) {
+    mtrc = &store->ghash->metrics[j];
+    mem->global[j] = ht_mem_by_type (mtrc->type, mtrc->hash);
+    mem->total += mem->global[j];
+  }
+
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    for (j = 0; j < module_metrics_len; ++j) {
+      mtrc = &store->mhash[module].metrics[j];
+      mem->module[module][j] = ht_mem_by_type (mtrc->type, mtrc->hash);
+      mem->total += mem->module[module][j];
+    }
+  }
+}
+
+/* Walk every date store and account for the bytes held by each of its
+ * global and module metrics.
+ *
+ * On success, an array sorted by date is returned and its length is set
+ * into len; the caller must free it. */
+GKMemDate *
+ht_mem_dates (uint32_t *len) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  GKMemDate *mem = NULL;
+  uint32_t *dates = NULL, i;
+
+  *len = 0;
+  if (!hash || !(dates = get_sorted_dates (len)) || *len == 0) {
+    free (dates);
+    return NULL;
+  }
+
+  mem = xcalloc (*len, sizeof (GKMemDate));
+  for (i = 0; i < *len; ++i) {
+    mem[i].date = dates[i];
+    if ((store = get_store (hash, dates[i])))
+      mem_date_store (store, &mem[i]);
+  }
+  free (dates);
+
+  return mem;
+}
+
+/* Spill the oldest date stores until the storage fits within --mem-limit.
+ * The latest date and the given one, e.g., the date being parsed, are
+ * never spilled. */
+void
+spill_cold_dates (uint32_t keep) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  GKMemDate *mem = NULL;
+  uint64_t total = 0, limit = conf.mem_limit << 20;
+  uint32_t len = 0, i;
+  size_t idx = 0;
+
+  if (!conf.mem_limit || !hash || kh_size (hash) < 2)
+    return;
+
+  mem = ht_mem_dates (&len);
+  for (i = 0; i < len; ++i)
+    total += mem[i].total;
+  FOREACH_MODULE (idx, module_list)
+    total += ht_mem_cache (module_list[idx]);
+  total += ht_mem_strpool () + ht_mem_app ();
+
+  for (i = 0; i + 1 < len && total > limit; ++i) {
+    if (mem[i].spilled || mem[i].date == keep || !(store = get_store (hash, mem[i].date)))
+      continue;
+    if (spill_date_store (mem[i].date, store) != 0) {
+      LOG_DEBUG (("Unable to spill date %u\n", mem[i].date));
+      break;
+    }
+    total -= mem[i].total;
+    mem_date_store (store, &mem[i]);
+    total += mem[i].total;
+  }
+  free (mem);
+}
+
 /* Get the number of elements in a dates hash.
  *
  * Return 0 if the operation fails, else number of elements. */
@@ -1066,7 +1613,7 @@ uint32_t
 ht_sum_uniq_visitors (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (ii32) * hash = NULL;
+  flat_t (ii32) * hash = NULL;
   uint32_t k = 0;
   uint32_t sum = 0;
 
@@ -1258,8 +1805,8 @@ char *
 ht_get_host_agent_val (uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (is32) * hash = NULL;
-  char *data = NULL;
+  flat_t (ii32) * hash = NULL;
+  const char *data = NULL;
   uint32_t k = 0;
 
   if (!dates)
@@ -1267,9 +1814,10 @@ ht_get_host_agent_val (uint32_t key) {
 
   /* *INDENT-OFF* */
   HT_FIRST_VAL (dates, k, {
+    get_loaded_store (dates, k);
     if ((hash = get_hash (-1, k, MTRC_AGENT_VALS)))
-      if ((data = get_is32 (hash, key)))
-        return data;
+      if ((data = get_istr (hash, key)))
+        return xstrdup (data);
   });
   /* *INDENT-ON* */
 
@@ -1297,6 +1845,7 @@ ht_get_host_agent_list (GModule module, uint32_t key) {
   for (k = kh_begin (dates); k != kh_end (dates); ++k) {
     if (!kh_exist (dates, k))
       continue;
+    get_loaded_store (dates, kh_key (dates, k));
     if (!(hash = get_hash (module, kh_key (dates, k), MTRC_AGENTS)))
       continue;
     if ((kv = kh_get (igsl, hash, key)) == kh_end (hash))
@@ -1492,92 +2041,336 @@ destroy_date_stores (int date) {
   khiter_t k;
 
   k = kh_get (igkh, hash, date);
+  reset_store_cache ();
   free_stores (kh_value (hash, k));
   kh_del (igkh, hash, k);
 }
 
+/* Find the cache key of a keymap hash and its string, probing past
+ * colliding hashes as cache_ins_ckey() does.
+ *
+ * If not found, 0 is returned.
+ * On success the cache key is returned */
+static uint32_t
+cache_find_ckey (const GKCacheModule *cache, uint64_t hash, const char *str) {
+  uint64_t key = hash & ~KEYMAP_PROBE_MASK;
+  uint32_t ckey = 0, i;
+  khint_t k;
+
+  if (!cache || !cache->keymap)
+    return 0;
+
+  /* evicted keys leave holes in a probe sequence, hence no early exit */
+  for (i = 0; i <= KEYMAP_PROBE_MASK; ++i, ++key) {
+    if ((k = fl_get (u6432, cache->keymap, key)) == fl_end (cache->keymap))
+      continue;
+    ckey = fl_val (cache->keymap, k);
+    if (key_str_match (cache->datamap[ckey], cache->rootmap[ckey], str))
+      return ckey;
+  }
+
+  return 0;
+}
+
+/* Remove a cache key from the keymap, clear its metrics and hand it over
+ * for reuse. */
+static void
+cache_drop_ckey (GKCacheModule *cache, uint64_t hash, uint32_t ckey) {
+  uint64_t key = hash & ~KEYMAP_PROBE_MASK;
+  uint32_t i;
+  khint_t k;
+
+  for (i = 0; i <= KEYMAP_PROBE_MASK; ++i, ++key) {
+    k = fl_get (u6432, cache->keymap, key);
+    if (k != fl_end (cache->keymap) && fl_val (cache->keymap, k) == ckey) {
+      fl_del (u6432, cache->keymap, k);
+      break;
+    }
+  }
+  /* not in the keymap, leave it be rather than recycle a live ckey */
+  if (i > KEYMAP_PROBE_MASK)
+    return;
+
+  if (cache->datamap[ckey])
+    cache->datamap_size--;
+  cache_epoch++;
+  cache->datamap[ckey] = NULL;
+  cache->rootmap[ckey] = NULL;
+  cache->root[ckey] = 0;
+  cache->refs[ckey] = 0;
+  cache->hits[ckey] = 0;
+  cache->visitors[ckey] = 0;
+  cache->bw[ckey] = 0;
+  cache->cumts[ckey] = 0;
+  cache->maxts[ckey] = 0;
+  cache->meth[ckey] = 0;
+  cache->proto[ckey] = 0;
+
+  if (cache->nfree == cache->free_capacity) {
+    cache->free_capacity = cache->free_capacity ? cache->free_capacity * 2 : CACHE_INIT_CAPACITY;
+    cache->free_ckeys =
+      xrealloc (cache->free_ckeys, cache->free_capacity * sizeof (*cache->free_ckeys));
+  }
+  cache->free_ckeys[cache->nfree++] = ckey;
+}
+
+/* A data key whose hits dropped to zero is no longer in any date. Drop it,
+ * unless it also serves as a root, and drop its root once no data key is
+ * left under it. */
+static void
+cache_unset_data (GKCacheModule *cache, uint64_t hash, uint32_t ckey) {
+  uint32_t rkey = cache->root[ckey];
+  const char *rstr = NULL;
+
+  if (cache->datamap[ckey])
+    cache->datamap_size--;
+  cache_epoch++;
+  cache->datamap[ckey] = NULL;
+  cache->root[ckey] = 0;
+  cache->visitors[ckey] = 0;
+  cache->bw[ckey] = 0;
+  cache->cumts[ckey] = 0;
+  cache->maxts[ckey] = 0;
+  cache->meth[ckey] = 0;
+  cache->proto[ckey] = 0;
+
+  if (cache->refs[ckey] == 0)
+    cache_drop_ckey (cache, hash, ckey);
+
+  if (!cache_valid_ckey (cache, rkey) || cache->refs[rkey] == 0 || --cache->refs[rkey] > 0)
+    return;
+  if (cache->hits[rkey] || !(rstr = cache->rootmap[rkey]))
+    return;
+  cache_drop_ckey (cache, ht_keymap_hash (rstr), rkey);
+}
+
+/* A surviving cache key whose maxts may have come from the evicted date. */
+typedef struct GKEvictMaxts_ {
+  uint32_t ckey;
+  uint64_t hash;
+  const char *str;
+} GKEvictMaxts;
+
+/* Recompute the maxts of a cache key out of every date but the evicted
+ * one. */
+static void
+cache_recompute_maxts (GKCacheModule *cache, GModule module, khash_t (igkh) *dates,
+                       GKHashStorage *evicted, const GKEvictMaxts *ev) {
+  GKHashStorage *store = NULL;
+  GKMetricCols *cols = NULL;
+  uint64_t maxts = 0;
+  uint32_t val = 0, row = 0;
+  khint_t k;
+
+  for (k = kh_begin (dates); k != kh_end (dates); ++k) {
+    if (!kh_exist (dates, k) || (store = get_loaded_store (dates, kh_key (dates, k))) == evicted)
+      continue;
+    val = get_keymap_str (get_hash_from_store (store, module, MTRC_KEYMAP), ev->hash, ev->str,
+                          get_hash_from_store (store, module, MTRC_DATAMAP),
+                          get_hash_from_store (store, module, MTRC_ROOTMAP));
+    if (val == 0)
+      continue;
+    cols = get_hash_from_store (store, module, MTRC_METRICS);
+    if ((row = get_imtv (cols, val)) && cols->maxts[row] > maxts)
+      maxts = cols->maxts[row];
+  }
+  cache->maxts[ev->ckey] = maxts;
+}
+
+/* Subtract the metrics of a date store from a module cache, dropping the
+ * keys found on no other date. Only the maxts of keys whose maximum came
+ * from the evicted date requires looking at the remaining dates. */
+static void
+evict_module_date (GModule module, khash_t (igkh) *dates, GKHashStorage *store) {
+  GKCacheModule *cache = get_cache_module (module);
+  GKEvictMaxts *fix = NULL;
+  const char *dstr = NULL, *rstr = NULL;
+  uint32_t ckey = 0, val = 0, row = 0, nfix = 0, capfix = 0, i;
+  khint_t k;
+
+  flat_t (u6432) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP);
+  GKMetricCols *cols = get_hash_from_store (store, module, MTRC_METRICS);
+  flat_t (ii32) * dmap = get_hash_from_store (store, module, MTRC_DATAMAP);
+  flat_t (ii32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
+
+  if (!cache || !cache->capacity || !kmap)
+    return;
+
+  for (k = fl_begin (kmap); k != fl_end (kmap); ++k) {
+    if (!fl_exist (kmap, k))
+      continue;
+
+    /* root-only keys go along with the last data key under them */
+    val = fl_val (kmap, k);
+    if (!(row = get_imtv (cols, val)))
+      continue;
+
+    dstr = get_istr (dmap, val);
+    rstr = dstr ? NULL : get_istr (rmap, val);
+    if ((ckey = cache_find_ckey (cache, fl_key (kmap, k), dstr ? dstr : rstr)) == 0)
+      continue;
+
+    cache->hits[ckey] -= MIN (cache->hits[ckey], cols->hits[row]);
+    cache->visitors[ckey] -= MIN (cache->visitors[ckey], cols->visitors[row]);
+    if (cols->touched[row] & METRIC_TOUCHED_BW)
+      cache->bw[ckey] -= MIN (cache->bw[ckey], cols->bw[row]);
+    if (cols->touched[row] & METRIC_TOUCHED_CUMTS)
+      cache->cumts[ckey] -= MIN (cache->cumts[ckey], cols->cumts[row]);
+
+    if (cache->hits[ckey] == 0) {
+      cache_unset_data (cache, fl_key (kmap, k), ckey);
+      continue;
+    }
+
+    if (!cols->maxts[row] || cols->maxts[row] < cache->maxts[ckey])
+      continue;
+    if (nfix == capfix) {
+      capfix = capfix ? capfix * 2 : 64;
+      fix = xrealloc (fix, capfix * sizeof (*fix));
+    }
+    fix[nfix].ckey = ckey;
+    fix[nfix].hash = fl_key (kmap, k);
+    fix[nfix].str = dstr ? dstr : rstr;
+    nfix++;
+  }
+
+  for (i = 0; i < nfix; ++i)
+    cache_recompute_maxts (cache, module, dates, store, &fix[i]);
+  free (fix);
+}
+
+/* Compact the string pool if due, re-pointing the strings borrowed by the
+ * module caches to their new location through their pool ids. */
+static void
+compact_strpool (void) {
+  GKCacheModule *cache = NULL;
+  GModule module;
+  uint32_t **ids = NULL, i;
+  size_t idx = 0;
+
+  if (!ht_strpool_compactable ())
+    return;
+
+  ids = xcalloc (TOTAL_MODULES, sizeof (*ids));
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    if (!(cache = get_cache_module (module)) || !cache->size)
+      continue;
+    ids[module] = xcalloc ((size_t) cache->size * 2 + 2, sizeof (uint32_t));
+    for (i = 1; i <= cache->size; ++i) {
+      ids[module][i * 2] = ht_find_str (cache->datamap[i]);
+      ids[module][i * 2 + 1] = ht_find_str (cache->rootmap[i]);
+    }
+  }
+
+  ht_compact_strpool ();
+  cache_epoch++;
+
+  idx = 0;
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    if (!ids[module])
+      continue;
+    cache = get_cache_module (module);
+    for (i = 1; i <= cache->size; ++i) {
+      cache->datamap[i] = ht_get_str (ids[module][i * 2]);
+      cache->rootmap[i] = ht_get_str (ids[module][i * 2 + 1]);
+    }
+    free (ids[module]);
+  }
+  free (ids);
+}
+
+/* Evict a date: its metrics are subtracted from the module caches and its
+ * stores are destroyed.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
 int
 invalidate_date (int date) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
   GModule module;
   size_t idx = 0;
 
-  if (!hash)
+  if (!hash || !(store = get_loaded_store (hash, date)))
     return -1;
 
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
-    cache_reset (get_cache_module (module));
+    evict_module_date (module, hash, store);
   }
 
   destroy_date_stores (date);
+  compact_strpool ();
 
   return 0;
 }
 
-/* Rebuild the cache for a module from the given date store. */
+/* Rebuild the cache for a module from the given date store.
+ *
+ * Note: the store must be loaded already, see rebuild_rawdata_cache(). */
 static int
 ins_raw_num_data (GModule module, uint32_t date) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
   GKHashStorage *store = get_store (hash, date);
   GKCacheModule *cache = get_cache_module (module);
-  khiter_t k, kr;
-  uint32_t ckey = 0, nrkey = 0;
-  char *val = NULL;
-  GKMetricVals *mv = NULL;
+  khiter_t k;
+  uint32_t ckey = 0, nrkey = 0, row = 0;
+  const char *val = NULL, *dstr = NULL, *rstr = NULL;
 
-  khash_t (ii32) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP);
-  khash_t (imtv) * metrics = get_hash_from_store (store, module, MTRC_METRICS);
-  khash_t (is32) * dmap = get_hash_from_store (store, module, MTRC_DATAMAP);
-  khash_t (is32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
+  flat_t (u6432) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP);
+  GKMetricCols *cols = get_hash_from_store (store, module, MTRC_METRICS);
+  flat_t (ii32) * dmap = get_hash_from_store (store, module, MTRC_DATAMAP);
+  flat_t (ii32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
 
   if (!kmap)
     return -1;
 
-  for (k = kh_begin (kmap); k != kh_end (kmap); ++k) {
-    if (!kh_exist (kmap, k))
+  for (k = fl_begin (kmap); k != fl_end (kmap); ++k) {
+    if (!fl_exist (kmap, k))
       continue;
-    if ((ckey = cache_ins_ckey (cache, kh_key (kmap, k))) == 0)
+
+    dstr = get_istr (dmap, fl_val (kmap, k));
+    rstr = dstr ? NULL : get_istr (rmap, fl_val (kmap, k));
+    if ((ckey = cache_ins_ckey (cache, fl_key (kmap, k), dstr ? dstr : rstr)) == 0)
       continue;
 
-    mv = get_imtv (metrics, kh_val (kmap, k));
+    row = get_imtv (cols, fl_val (kmap, k));
 
-    if (mv && mv->root) {
-      kr = kh_get (is32, rmap, mv->root);
-      if (kr != kh_end (rmap) && (val = kh_val (rmap, kr))) {
-        nrkey = cache_ins_ckey (cache, djb2 ((unsigned char *) val));
-        cache_set_rootmap (cache, nrkey, val);
-        cache_set_root (cache, ckey, nrkey);
-      }
+    if (row && cols->root[row] && (val = get_istr (rmap, cols->root[row]))) {
+      nrkey = cache_ins_ckey (cache, ht_keymap_hash (val), val);
+      cache_set_rootmap (cache, nrkey, val);
+      cache_set_root (cache, ckey, nrkey);
     }
 
-    if ((kr = kh_get (is32, dmap, kh_val (kmap, k))) != kh_end (dmap))
-      cache_set_datamap (cache, ckey, kh_val (dmap, kr));
+    if (dstr)
+      cache_set_datamap (cache, ckey, dstr);
+    else if (rstr)
+      cache_set_rootmap (cache, ckey, rstr);
 
     /* root-only keys hold no metrics of their own */
-    if (!mv)
+    if (!row)
       continue;
 
-    if (mv->hits)
-      __atomic_add_fetch (&cache->hits[ckey], mv->hits, __ATOMIC_SEQ_CST);
-    if (mv->visitors)
-      __atomic_add_fetch (&cache->visitors[ckey], mv->visitors, __ATOMIC_SEQ_CST);
-    if (mv->touched & METRIC_TOUCHED_BW) {
-      cache->bw[ckey] += mv->bw;
+    cache->hits[ckey] += cols->hits[row];
+    cache->visitors[ckey] += cols->visitors[row];
+    if (cols->touched[row] & METRIC_TOUCHED_BW) {
+      cache->bw[ckey] += cols->bw[row];
       cache->has_bw = 1;
     }
-    if (mv->touched & METRIC_TOUCHED_CUMTS) {
-      cache->cumts[ckey] += mv->cumts;
+    if (cols->touched[row] & METRIC_TOUCHED_CUMTS) {
+      cache->cumts[ckey] += cols->cumts[row];
       cache->has_cumts = 1;
     }
-    if (mv->maxts && cache->maxts[ckey] < mv->maxts)
-      cache->maxts[ckey] = mv->maxts;
-    if (mv->meth)
-      cache->meth[ckey] = mv->meth;
-    if (mv->proto)
-      cache->proto[ckey] = mv->proto;
+    if (cols->maxts[row] && cache->maxts[ckey] < cols->maxts[row])
+      cache->maxts[ckey] = cols->maxts[row];
+    if (cols->meth[row])
+      cache->meth[ckey] = cols->meth[row];
+    if (cols->proto[row])
+      cache->proto[ckey] = cols->proto[row];
   }
 
   return 0;
@@ -1601,19 +2394,402 @@ set_raw_num_data_date (GModule module) {
   return 0;
 }
 
+/* A module whose cache is rebuilt out of all of its date stores. Each
+ * module cache is owned by a single worker, so no locking is needed. */
+typedef struct GKRebuildTask_ {
+  GModule module;
+  uint64_t size;                /* keymap entries across all dates */
+} GKRebuildTask;
+
+typedef struct GKRebuildQueue_ {
+  GKRebuildTask *tasks;
+  int ntasks;
+  int next;                     /* next task to hand out */
+} GKRebuildQueue;
+
+/* Sort rebuild tasks by size in descending order. */
+static int
+cmp_rebuild_task_desc (const void *a, const void *b) {
+  const GKRebuildTask *ta = a, *tb = b;
+  return (ta->size < tb->size) - (ta->size > tb->size);
+}
+
+static void *
+rebuild_worker (void *arg) {
+  GKRebuildQueue *queue = arg;
+  int i;
+
+  while ((i = __atomic_fetch_add (&queue->next, 1, __ATOMIC_SEQ_CST)) < queue->ntasks)
+    set_raw_num_data_date (queue->tasks[i].module);
+
+  return NULL;
+}
+
+/* Rebuild the module caches out of the date stores, spreading the modules
+ * across --jobs threads. The largest modules are handed out first so that
+ * no thread is left with a big one at the end. */
 int
 rebuild_rawdata_cache (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  GKRebuildQueue queue = { 0 };
+  GKRebuildTask tasks[TOTAL_MODULES];
   GModule module;
+  pthread_t threads[TOTAL_MODULES];
+  flat_t (u6432) * kmap = NULL;
   size_t idx = 0;
+  khint_t k;
+  int i, nthreads = 0;
+
+  /* restored out of their summaries already */
+  if (cache_summarized)
+    return 2;
+
+  /* workers only read the stores, bring back the spilled and lazily
+   * restored ones beforehand so none is left out */
+  load_spilled_dates ();
 
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
-    set_raw_num_data_date (module);
+    tasks[queue.ntasks].module = module;
+    tasks[queue.ntasks].size = 0;
+    for (k = kh_begin (dates); dates && k != kh_end (dates); ++k) {
+      if (!kh_exist (dates, k))
+        continue;
+      if ((kmap = get_hash_from_store (kh_val (dates, k), module, MTRC_KEYMAP)))
+        tasks[queue.ntasks].size += fl_size (kmap);
+    }
+    queue.ntasks++;
+  }
+  qsort (tasks, queue.ntasks, sizeof (GKRebuildTask), cmp_rebuild_task_desc);
+  queue.tasks = tasks;
+
+  /* the calling thread works the queue as well */
+  nthreads = MIN (conf.jobs, queue.ntasks) - 1;
+  for (i = 0; i < nthreads; ++i) {
+    if (pthread_create (&threads[i], NULL, rebuild_worker, &queue) != 0)
+      break;
   }
+  nthreads = i;
+  rebuild_worker (&queue);
+  for (i = 0; i < nthreads; ++i)
+    pthread_join (threads[i], NULL);
 
   return 2;
 }
 
+/* Get the size of a module cache, i.e., its highest assigned ckey, along
+ * with whether bw and cumts metrics have been recorded.
+ *
+ * On success, the highest assigned ckey is returned. */
+uint32_t
+ht_get_cache_size (GModule module, uint8_t *has_bw, uint8_t *has_cumts) {
+  GKCacheModule *cache = get_cache_module (module);
+
+  *has_bw = *has_cumts = 0;
+  if (!cache)
+    return 0;
+
+  *has_bw = cache->has_bw;
+  *has_cumts = cache->has_cumts;
+  return cache->size;
+}
+
+/* Get the next entry of a module cache. The iterator starts at 0 and is
+ * advanced past the returned entry.
+ *
+ * If no entries are left, 0 is returned.
+ * On success, 1 is returned and the entry is set. */
+int
+ht_next_cache_row (GModule module, uint32_t *iter, GKCacheRow *row) {
+  GKCacheModule *cache = get_cache_module (module);
+  uint32_t ckey = 0;
+  khint_t k;
+
+  if (!cache || !cache->keymap)
+    return 0;
+
+  for (k = *iter; k < fl_end (cache->keymap); ++k) {
+    if (!fl_exist (cache->keymap, k))
+      continue;
+    if (!cache_valid_ckey (cache, (ckey = fl_val (cache->keymap, k))))
+      continue;
+
+    row->hash = fl_key (cache->keymap, k);
+    row->ckey = ckey;
+    row->data = cache->datamap[ckey];
+    row->root = cache->rootmap[ckey];
+    row->rkey = cache->root[ckey];
+    row->hits = cache->hits[ckey];
+    row->visitors = cache->visitors[ckey];
+    row->bw = cache->bw[ckey];
+    row->cumts = cache->cumts[ckey];
+    row->maxts = cache->maxts[ckey];
+    row->meth = cache->meth[ckey];
+    row->proto = cache->proto[ckey];
+    *iter = k + 1;
+    return 1;
+  }
+  *iter = k;
+
+  return 0;
+}
+
+/* Intern a string borrowed by a restored module cache, holding a reference
+ * on it until the date stores are loaded.
+ *
+ * On success, the pooled string is returned. */
+static const char *
+hold_summary_str (const char *str) {
+  uint32_t id = 0;
+
+  if (!str || !(id = ht_intern_str (str)))
+    return NULL;
+
+  if (nsummary_strs == summary_strs_cap) {
+    summary_strs_cap = summary_strs_cap ? summary_strs_cap * 2 : CACHE_INIT_CAPACITY;
+    summary_strs = xrealloc (summary_strs, summary_strs_cap * sizeof (uint32_t));
+  }
+  summary_strs[nsummary_strs++] = id;
+
+  return ht_get_str (id);
+}
+
+/* Size a module cache for the entries of its persisted summary, which
+ * keep their ckeys. */
+void
+ht_begin_cache_summary (GModule module, uint32_t size, uint8_t has_bw, uint8_t has_cumts) {
+  GKCacheModule *cache = get_cache_module (module);
+
+  if (!cache || !size)
+    return;
+
+  cache_grow (cache, size);
+  cache->size = size;
+  cache->has_bw = has_bw;
+  cache->has_cumts = has_cumts;
+}
+
+/* Set a module cache entry out of its persisted summary.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+ht_set_cache_row (GModule module, const GKCacheRow *row) {
+  GKCacheModule *cache = get_cache_module (module);
+  uint32_t ckey = row->ckey;
+  khint_t k;
+  int ret;
+
+  if (!cache_valid_ckey (cache, ckey))
+    return -1;
+
+  k = fl_put (u6432, cache->keymap, row->hash, &ret);
+  if (ret == -1)
+    return -1;
+  fl_val (cache->keymap, k) = ckey;
+
+  if (row->data)
+    cache_set_datamap (cache, ckey, hold_summary_str (row->data));
+  if (row->root)
+    cache_set_rootmap (cache, ckey, hold_summary_str (row->root));
+  cache_set_root (cache, ckey, row->rkey);
+  cache->hits[ckey] = row->hits;
+  cache->visitors[ckey] = row->visitors;
+  cache->bw[ckey] = row->bw;
+  cache->cumts[ckey] = row->cumts;
+  cache->maxts[ckey] = row->maxts;
+  cache->meth[ckey] = row->meth;
+  cache->proto[ckey] = row->proto;
+
+  return 0;
+}
+
+/* Hand over for reuse the ckeys a restored module cache left unassigned,
+ * i.e., those released before it was persisted. */
+void
+ht_end_cache_summary (GModule module) {
+  GKCacheModule *cache = get_cache_module (module);
+  uint8_t *used = NULL;
+  uint32_t ckey;
+  khint_t k;
+
+  if (!cache || !cache->size)
+    return;
+
+  used = xcalloc (cache->size + 1, sizeof (uint8_t));
+  for (k = fl_begin (cache->keymap); k != fl_end (cache->keymap); ++k) {
+    if (fl_exist (cache->keymap, k) && cache_valid_ckey (cache, fl_val (cache->keymap, k)))
+      used[fl_val (cache->keymap, k)] = 1;
+  }
+
+  for (ckey = 1; ckey <= cache->size; ++ckey) {
+    if (used[ckey])
+      continue;
+    if (cache->nfree == cache->free_capacity) {
+      cache->free_capacity = cache->free_capacity ? cache->free_capacity * 2 : CACHE_INIT_CAPACITY;
+      cache->free_ckeys =
+        xrealloc (cache->free_ckeys, cache->free_capacity * sizeof (*cache->free_ckeys));
+    }
+    cache->free_ckeys[cache->nfree++] = ckey;
+  }
+  free (used);
+}
+
+/* Unload the tables of every restored date store but the resident ones,
+ * leaving them to be read out of the restored dataset once needed. The
+ * module caches must have been restored out of their summaries. */
+void
+ht_mark_lazy_dates (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  GKHashMetric *mtrc = NULL;
+  GModule module;
+  size_t idx = 0, i;
+  khint_t k;
+
+  if (!hash)
+    return;
+
+  reset_store_cache ();
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (!kh_exist (hash, k) || (store = kh_val (hash, k))->spilled)
+      continue;
+
+    for (i = 0; i < global_metrics_len; ++i) {
+      mtrc = &store->ghash->metrics[i];
+      if (!ht_is_resident_metric (-1, mtrc->metric.storem))
+        unload_metric (store, mtrc);
+    }
+    idx = 0;
+    FOREACH_MODULE (idx, module_list) {
+      module = module_list[idx];
+      for (i = 0; i < module_metrics_len; ++i) {
+        mtrc = &store->mhash[module].metrics[i];
+        if (!ht_is_resident_metric (module, mtrc->metric.storem))
+          unload_metric (store, mtrc);
+      }
+    }
+    store->spilled = store->lazy = 1;
+    lazy_stores++;
+  }
+  cache_summarized = 1;
+}
+
+/* Discard the module caches, e.g., when their summaries turn out not to
+ * match the restored dataset. */
+void
+ht_reset_caches (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+
+  release_summary_strs ();
+  free_cache (db->cache);
+  db->cache = init_cache_modules ();
+  cache_epoch++;
+}
+
+/* Get the current epoch of the module caches. It changes whenever a cache
+ * key may have been recycled or a cached string moved. */
+uint32_t
+ht_get_cache_epoch (void) {
+  return cache_epoch;
+}
+
+/* Rebuild a module keymap of the given store out of its data and root
+ * strings, keeping the values they map to. */
+static void
+rekey_module_keymap (GKHashStorage *store, GModule module) {
+  flat_t (u6432) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP), *nmap = NULL;
+  flat_t (ii32) * dmap = get_hash_from_store (store, module, MTRC_DATAMAP);
+  flat_t (ii32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
+  GKMetricCols *cols = get_hash_from_store (store, module, MTRC_METRICS);
+  const char *str = NULL;
+  char *meth = NULL, *proto = NULL;
+  uint64_t key = 0;
+  uint32_t val = 0, row = 0;
+  khint_t k;
+
+  if (!kmap)
+    return;
+
+  nmap = new_u6432_ht ();
+  for (k = fl_begin (kmap); k != fl_end (kmap); ++k) {
+    if (!fl_exist (kmap, k))
+      continue;
+
+    val = fl_val (kmap, k);
+    if ((str = get_istr (dmap, val))) {
+      row = get_imtv (cols, val);
+      meth = row && cols->meth[row] ? get_meth_proto_str (cols->meth[row]) : NULL;
+      proto = row && cols->proto[row] ? get_meth_proto_str (cols->proto[row]) : NULL;
+      key = gen_data_key_hash (module, str, meth, proto);
+      free (meth);
+      free (proto);
+    } else if ((str = get_istr (rmap, val))) {
+      key = ht_keymap_hash (str);
+    } else {
+      /* no string, hence no way to ever reach it */
+      continue;
+    }
+    ins_keymap_str (nmap, key, str, dmap, rmap, NULL, val);
+  }
+
+  store->mhash[module].metrics[MTRC_KEYMAP].hash = nmap;
+  des_u6432 (kmap, 0);
+}
+
+/* Rebuild the user agent keymap of the given store out of its user agent
+ * strings, keeping the values they map to. */
+static void
+rekey_agent_keys (GKHashStorage *store) {
+  flat_t (u6432) * kmap = get_hash_from_store (store, -1, MTRC_AGENT_KEYS), *nmap = NULL;
+  flat_t (ii32) * vals = get_hash_from_store (store, -1, MTRC_AGENT_VALS);
+  const char *str = NULL;
+  khint_t k;
+
+  if (!kmap)
+    return;
+
+  nmap = new_u6432_ht ();
+  for (k = fl_begin (kmap); k != fl_end (kmap); ++k) {
+    if (!fl_exist (kmap, k) || !(str = get_istr (vals, fl_val (kmap, k))))
+      continue;
+    ins_keymap_str (nmap, ht_keymap_hash (str), str, vals, NULL, NULL, fl_val (kmap, k));
+  }
+
+  store->ghash->metrics[MTRC_AGENT_KEYS - MTRC_UNIQUE_KEYS].hash = nmap;
+  des_u6432 (kmap, 0);
+}
+
+/* Rebuild the keymaps of every dated store out of their strings, e.g., when
+ * restoring keymaps hashed by a previous key hash function. The module
+ * caches must be rebuilt afterwards. */
+void
+rekey_date_stores (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  GModule module;
+  khiter_t k;
+  size_t idx = 0;
+
+  if (!hash)
+    return;
+
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (!kh_exist (hash, k))
+      continue;
+    store = kh_val (hash, k);
+    rekey_agent_keys (store);
+    idx = 0;
+    FOREACH_MODULE (idx, module_list) {
+      module = module_list[idx];
+      rekey_module_keymap (store, module);
+    }
+  }
+}
+
 /* Initialize hash tables */
 void
 init_storage (void) {
@@ -1633,9 +2809,12 @@ des_igkh (void *h) {
   if (!hash)
     return;
 
+  reset_store_cache ();
   for (k = kh_begin (hash); k != kh_end (hash); ++k) {
     if (!kh_exist (hash, k))
       continue;
+    if (kh_value (hash, k)->spilled && !kh_value (hash, k)->lazy)
+      unlink_spilled_date (kh_key (hash, k));
     free_stores (kh_value (hash, k));
   }
   kh_destroy (igkh, hash);
@@ -1714,22 +2893,17 @@ get_str_raw_data (GModule module) {
   return raw_data;
 }
 
-/* Entry point to load the raw data from the data store into our
- * GRawData structure.
+/* Copy the raw data of the given module out of its cache. Data referring
+ * to the cache strings is sorted right away, the rest is sorted through
+ * sort_raw_data(), which doesn't touch the storage, e.g., once the lock
+ * is released.
  *
  * On error, NULL is returned.
- * On success the GRawData sorted is returned */
+ * On success the GRawData is returned */
 GRawData *
-parse_raw_data (GModule module) {
+extract_raw_data (GModule module) {
   GRawData *raw_data = NULL;
 
-#ifdef _DEBUG
-  clock_t begin = clock ();
-  double taken;
-  const char *modstr = NULL;
-  LOG_DEBUG (("== parse_raw_data ==\n"));
-#endif
-
   switch (module) {
   case VISITORS:
     raw_data = get_str_raw_data (module);
@@ -1738,15 +2912,29 @@ parse_raw_data (GModule module) {
     break;
   default:
     raw_data = get_u32_raw_data (module);
-    if (raw_data)
-      sort_raw_num_data (raw_data, raw_data->idx);
   }
 
-#ifdef _DEBUG
-  modstr = get_module_str (module);
-  taken = (double) (clock () - begin) / CLOCKS_PER_SEC;
-  LOG_DEBUG (("== %-30s%f\n\n", modstr, taken));
-#endif
+  return raw_data;
+}
+
+/* Sort the raw data copied out of a cache by extract_raw_data(). */
+void
+sort_raw_data (GRawData *raw_data) {
+  if (raw_data->type == U32)
+    sort_raw_num_data (raw_data, raw_data->idx);
+}
+
+/* Entry point to load the raw data from the data store into our
+ * GRawData structure.
+ *
+ * On error, NULL is returned.
+ * On success the GRawData sorted is returned */
+GRawData *
+parse_raw_data (GModule module) {
+  GRawData *raw_data = NULL;
+
+  if ((raw_data = extract_raw_data (module)))
+    sort_raw_data (raw_data);
 
   return raw_data;
 }
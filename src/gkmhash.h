@@ -34,6 +34,11 @@
 
 typedef struct GKHashMetric_ GKHashMetric;
 
+/* The low bits of a 64-bit keymap key hold the probe index used to resolve
+ * hash collisions; the remaining bits hold the hash of the key string. */
+#define KEYMAP_PROBE_BITS 4
+#define KEYMAP_PROBE_MASK ((UINT64_C (1) << KEYMAP_PROBE_BITS) - 1)
+
 /* Per-module cache backed by dense arrays indexed by cache key (ckey).
  * Defined privately in gkmhash.c. */
 typedef struct GKCacheModule_ GKCacheModule;
@@ -52,6 +57,11 @@ typedef struct GKHashGlobal_ {
 struct GKHashStorage_ {
   GKHashModule *mhash;          /* modules */
   GKHashGlobal *ghash;          /* global */
+  uint32_t *strs;               /* pool ids kept referenced while spilled */
+  uint32_t nstrs;
+  uint8_t spilled;              /* tables persisted to disk and unloaded */
+  uint8_t lazy;                 /* unloaded tables still on the restored dataset */
+  uint8_t dirty;                /* modified since last persisted */
 };
 
 /* Metrics Storage */
@@ -69,22 +79,23 @@ struct GKHashStorage_ {
  * 4123991812851215 -> 1
  * 9812851215412399 -> 2
  */
-/*khash_t(u6432) MTRC_UNIQUE_KEYS */
+/*flat_t(u6432) MTRC_UNIQUE_KEYS */
 
-/* Maps string keys made out of the user agent to an autoincremented value.
+/* Maps the 64-bit hash of the user agent to an autoincremented value.
+ * Colliding hashes are told apart by their MTRC_AGENT_VALS string.
  *
- * Debian APT-HTTP/1.3 (1.0.9.8.5)                      -> 1838302 -> 1
- * Mozilla/5.0 (compatible; MSIE 10.0; Windows NT 6.1;) -> 8723842 -> 2
+ * Debian APT-HTTP/1.3 (1.0.9.8.5)                      -> 0x9c1e...40 -> 1
+ * Mozilla/5.0 (compatible; MSIE 10.0; Windows NT 6.1;) -> 0x27a3...b0 -> 2
  */
-/*khash_t(ii32) MTRC_AGENT_KEYS */
+/*flat_t(u6432) MTRC_AGENT_KEYS */
 
-/* Maps integer keys from the autoincremented MTRC_AGENT_KEYS value to the user
- * agent.
+/* Maps integer keys from the autoincremented MTRC_AGENT_KEYS value to the
+ * string pool id of the user agent.
  *
- * 1 -> Debian APT-HTTP/1.3 (1.0.9.8.5)
- * 2 -> Mozilla/5.0 (compatible; MSIE 10.0; Windows NT 6.1; WOW64; Trident/6.0)
+ * 1 -> 12 -> Debian APT-HTTP/1.3 (1.0.9.8.5)
+ * 2 -> 37 -> Mozilla/5.0 (compatible; MSIE 10.0; Windows NT 6.1; WOW64; Trident/6.0)
  */
-/*khash_t(is32) MTRC_AGENT_VALS */
+/*flat_t(ii32) MTRC_AGENT_VALS */
 
 /* Maps a single numeric key (usually 1) to an autoincremented hits value.
  *
@@ -101,41 +112,44 @@ struct GKHashStorage_ {
 
 /* MODULE METRICS */
 /* ============== */
-/* Maps keys (string) to a hash to a numeric values (uint32_t).
+/* Maps keys (string) to a 64-bit hash to a numeric values (uint32_t).
  * this mitigates the issue of having multiple stores
  * with the same string key, and therefore, avoids unnecessary
- * memory usage (in most cases).
+ * memory usage (in most cases). Colliding hashes are told apart by the
+ * MTRC_DATAMAP/MTRC_ROOTMAP string of the key and moved to the next probe
+ * slot (see KEYMAP_PROBE_MASK).
  *
- * HEAD|/index.php -> 9872347 -> 1
- * POST|/index.php -> 3452345 -> 2
- * Windows XP      -> 2842343 -> 3
- * Ubuntu 10.10    -> 1852342 -> 4
- * GET|Ubuntu 10.10-> 4872343 -> 5
- * GNU+Linux       -> 5862347 -> 6
- * 26/Dec/2014     -> 9874347 -> 7
- * Windows         -> 3875347 -> 8
+ * HEAD|/index.php -> 0x6e2f...10 -> 1
+ * POST|/index.php -> 0x1b07...c0 -> 2
+ * Windows XP      -> 0xd4a9...70 -> 3
+ * Ubuntu 10.10    -> 0x8830...e0 -> 4
+ * GET|Ubuntu 10.10-> 0x02fc...50 -> 5
+ * GNU+Linux       -> 0x5b61...a0 -> 6
+ * 26/Dec/2014     -> 0xe913...30 -> 7
+ * Windows         -> 0x47c8...90 -> 8
  */
-/*khash_t(si32) MTRC_KEYMAP */
+/*flat_t(u6432) MTRC_KEYMAP */
 
 /* Maps integer keys of root elements from the keymap hash
- * to actual string values.
+ * to the string pool id of their values.
  *
- * 6 -> GNU+Linux
- * 8 -> Windows
+ * 6 -> 41 -> GNU+Linux
+ * 8 -> 42 -> Windows
  */
-/*khash_t(is32) MTRC_ROOTMAP */
+/*flat_t(ii32) MTRC_ROOTMAP */
 
 /* Maps integer keys of data elements from the keymap hash
- * to actual string values.
+ * to the string pool id of their values. Equal strings across dates and
+ * modules share a single pooled copy.
  *
- * 1 -> /index.php
- * 2 -> /index.php
- * 3 -> Windows xp
- * 4 -> Ubuntu 10.10
- * 5 -> Ubuntu 10.10
- * 7 -> 26/dec/2014
+ * 1 -> 10 -> /index.php
+ * 2 -> 10 -> /index.php
+ * 3 -> 11 -> Windows xp
+ * 4 -> 14 -> Ubuntu 10.10
+ * 5 -> 14 -> Ubuntu 10.10
+ * 7 -> 15 -> 26/dec/2014
  */
-/*khash_t(is32) MTRC_DATAMAP */
+/*flat_t(ii32) MTRC_DATAMAP */
 
 /* Set of uint64_t keys made out of the uint32_t data key and the uint32_t
  * unique visitor key. Used to determine whether a visitor was already
@@ -146,14 +160,14 @@ struct GKHashStorage_ {
  */
 /*khash_t(u648) MTRC_UNIQMAP */
 
-/* Maps integer keys from the keymap hash to all of its numeric metrics
- * packed into a single GKMetricVals value (hits, visitors, bandwidth,
- * cumulative/max time served, method, protocol and root key).
+/* Maps integer keys from the keymap hash to a row of numeric metric columns
+ * (hits, visitors, bandwidth, cumulative/max time served, method, protocol
+ * and root key).
  *
- * 1 -> {hits: 10934, visitors: 100, bw: 1024, ...}
- * 2 -> {hits: 3231, visitors: 56, bw: 2048, ...}
+ * 1 -> 1 -> {hits: 10934, visitors: 100, bw: 1024, ...}
+ * 7 -> 2 -> {hits: 3231, visitors: 56, bw: 2048, ...}
  */
-/*khash_t(imtv) MTRC_METRICS */
+/*GKMetricCols MTRC_METRICS */
 
 /* Maps numeric unique data keys (e.g., 192.168.0.1 => 1) to the unique user
  * agent key. Therefore, 1 IP can contain multiple user agents
@@ -168,6 +182,41 @@ struct GKHashStorage_ {
  */
 /*khash_t(igsl) MTRC_METADATA */
 
+/* Maps integer keys from the keymap hash to a HyperLogLog sketch of the
+ * visitors seen for that key, or to the fingerprint of its only visitor.
+ * Only filled in --approx-visitors mode, where it replaces MTRC_UNIQMAP and
+ * MTRC_UNIQUE_KEYS.
+ *
+ * 1 -> {p: 12, count: 100, ...}
+ * 2 -> 0x8173cf0524551b93
+ */
+/*flat_t(ihll) MTRC_SKETCHES */
+
+/* Bytes held by a date store, per global and per module metric */
+typedef struct GKMemDate_ {
+  uint32_t date;
+  uint8_t spilled;              /* tables unloaded under --mem-limit */
+  uint64_t total;               /* all metrics plus the store itself */
+  uint64_t global[GLOBAL_METRICS_TOTAL];
+  uint64_t module[TOTAL_MODULES][GSMTRC_TOTAL];
+} GKMemDate;
+
+/* A module cache entry as kept in its persisted summary */
+typedef struct GKCacheRow_ {
+  uint64_t hash;                /* keymap hash, probe bits included */
+  uint32_t ckey;
+  const char *data;
+  const char *root;
+  uint32_t rkey;                /* ckey of its root */
+  uint32_t hits;
+  uint32_t visitors;
+  uint64_t bw;
+  uint64_t cumts;
+  uint64_t maxts;
+  uint8_t meth;
+  uint8_t proto;
+} GKCacheRow;
+
 /* *INDENT-OFF* */
 extern const GKHashMetric module_metrics[];
 extern const GKHashMetric global_metrics[];
@@ -182,6 +231,8 @@ char *ht_get_root (GModule module, uint32_t key);
 uint32_t ht_get_hits (GModule module, int key);
 uint32_t ht_get_size_datamap (GModule module);
 uint32_t ht_get_size_dates (void);
+GKMemDate *ht_mem_dates (uint32_t *len);
+uint64_t ht_mem_cache (GModule module);
 uint32_t ht_sum_uniq_visitors (void);
 uint32_t ht_get_visitors (GModule module, uint32_t key);
 uint32_t ht_sum_valid (void);
@@ -210,24 +261,46 @@ int ht_insert_protocol (GModule module, uint32_t date, uint32_t key, const char
 int ht_insert_root (GModule module, uint32_t date, uint32_t key, uint32_t value, uint32_t dkey, uint32_t rkey);
 int ht_insert_rootmap (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey);
 int ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value);
+uint32_t ht_insert_sketch (GModule module, uint32_t date, uint32_t key, uint64_t value);
 uint32_t ht_inc_cnt_valid (uint32_t date, uint32_t inc);
-uint32_t ht_insert_agent_key (uint32_t date, uint32_t key);
+uint32_t ht_insert_agent_key (uint32_t date, uint64_t key, const char *agent);
 uint32_t ht_insert_hits (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey);
-uint32_t ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t * ckey);
+uint32_t ht_insert_keymap (GModule module, uint32_t date, uint64_t key, const char *str, uint32_t * ckey);
 uint32_t ht_insert_unique_key (uint32_t date, uint64_t key, int countable, int *first_count);
-void ht_inc_cnt_visitors (uint32_t date);
+void ht_inc_cnt_visitors (uint32_t date, uint32_t inc);
 uint32_t ht_insert_visitor (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey);
 int ht_insert_meta_data (GModule module, uint32_t date, const char *key, uint64_t value);
 
+int ht_next_cache_row (GModule module, uint32_t * iter, GKCacheRow * row);
+int ht_set_cache_row (GModule module, const GKCacheRow * row);
+uint32_t ht_get_cache_size (GModule module, uint8_t * has_bw, uint8_t * has_cumts);
+void ht_begin_cache_summary (GModule module, uint32_t size, uint8_t has_bw, uint8_t has_cumts);
+void ht_end_cache_summary (GModule module);
+void ht_mark_lazy_dates (void);
+int ht_has_date (uint32_t date);
+int ht_is_dirty_date (uint32_t date);
+int ht_load_date (uint32_t date);
+void ht_set_date_dirty (uint32_t date, int dirty);
+void ht_set_dates_dirty (int dirty);
+void ht_reset_caches (void);
+uint32_t ht_get_cache_epoch (void);
+
 int invalidate_date (int date);
+int ht_is_resident_metric (int module, GSMetric metric);
+void load_spilled_dates (void);
+void sort_raw_data (GRawData * raw_data);
+void spill_cold_dates (uint32_t keep);
 int rebuild_rawdata_cache (void);
+uint64_t ht_keymap_hash (const char *str);
+void rekey_date_stores (void);
 void des_igkh (void *h);
 void free_cache (GKCacheModule * cache);
 void init_storage (void);
 
+GRawData *extract_raw_data (GModule module);
 GRawData *parse_raw_data (GModule module);
 GSLList *ht_get_host_agent_list (GModule module, uint32_t key);
-GSLList *ht_get_keymap_list_from_key (GModule module, uint32_t key);
+GSLList *ht_get_keymap_list_from_str (GModule module, const char *str);
 /* *INDENT-ON* */
 
 #endif // for #ifndef GKMHASH_H
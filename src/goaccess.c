@@ -70,10 +70,13 @@
 #include "gchart.h"
 #include "gholder.h"
 #include "goaccess.h"
+#include "gstats.h"
+#include "gwatch.h"
 #include "gwsocket.h"
 #include "json.h"
 #include "options.h"
 #include "output.h"
+#include "persistence.h"
 #include "util.h"
 #include "websocket.h"
 #include "xmalloc.h"
@@ -82,6 +85,8 @@ GConf conf = {
   .append_method = 1,
   .append_protocol = 1,
   .chunk_size = 1024,
+  .dns_cache_ttl = DNS_CACHE_TTL,
+  .dns_threads = DNS_THREADS,
   .hl_header = 1,
   .jobs = 1,
   .num_tests = 10,
@@ -101,6 +106,17 @@ static GDash *dash;
 static GHolder *holder;
 /* Old signal mask */
 static sigset_t oldset;
+/* Checkpoint thread, see --persist-interval */
+static pthread_t checkpoint_thread;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t checkpoint_cond = PTHREAD_COND_INITIALIZER;
+static int checkpoint_active = 0;
+/* Logs being followed */
+static GWatch *gwatch;
+/* Real-time HTML follow thread, see tail_loop_html() */
+static pthread_mutex_t follow_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t follow_cond = PTHREAD_COND_INITIALIZER;
+static int follow_changed = 0;
 /* Curses windows */
 static WINDOW *header_win, *main_win;
 
@@ -137,14 +153,34 @@ static GScroll gscroll = {
 };
 /* *INDENT-ON* */
 
+/* Stop the checkpoint thread, waiting for a running checkpoint to complete. */
+static void
+stop_checkpoint (void) {
+  pthread_mutex_lock (&checkpoint_mutex);
+  if (!checkpoint_active) {
+    pthread_mutex_unlock (&checkpoint_mutex);
+    return;
+  }
+  checkpoint_active = 0;
+  pthread_cond_signal (&checkpoint_cond);
+  pthread_mutex_unlock (&checkpoint_mutex);
+
+  pthread_join (checkpoint_thread, NULL);
+}
+
 /* Free malloc'd holder */
 static void
 house_keeping_holder (void) {
+  /* CHECKPOINT THREAD */
+  stop_checkpoint ();
+
   /* REVERSE DNS THREAD */
-  pthread_mutex_lock (&gdns_thread.mutex);
+  gdns_lock ();
 
   /* kill dns pthread */
   active_gdns = 0;
+  /* stop searching the holder */
+  invalidate_find ();
   /* clear holder structure */
   free_holder (&holder);
   /* clear reverse dns queue */
@@ -152,7 +188,7 @@ house_keeping_holder (void) {
   /* clear the whole storage */
   free_storage ();
 
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  gdns_unlock ();
 }
 
 /* Free per-item expand state for all modules */
@@ -200,6 +236,7 @@ house_keeping (void) {
   /* CONFIGURATION */
   free_formats ();
   free_browsers_hash ();
+  free_static_files ();
   if (conf.debug_log) {
     LOG_DEBUG (("Bye.\n"));
     dbg_log_close ();
@@ -215,6 +252,8 @@ house_keeping (void) {
   free_color_lists ();
   /* free cmd arguments */
   free_cmd_args ();
+  /* log watch */
+  free_gwatch (gwatch);
   /* WebSocket writer */
   free (gwswriter);
   /* WebSocket reader */
@@ -235,6 +274,9 @@ cleanup (int ret) {
   if (ret)
     output_logerrors ();
 
+  if (conf.runtime_stats_file)
+    output_runtime_json (conf.runtime_stats_file);
+
   house_keeping ();
 }
 
@@ -322,35 +364,85 @@ daemonize (void) {
   }
 }
 
+/* Extract data from the given modules hash structures and load it into
+ * the given GHolder.
+ *
+ * The module caches are copied out under the gdns_thread.mutex and sorted
+ * without it, so parsing is only held back while copying and loading. If
+ * a cache key was recycled in between, the copies are taken again. */
+static void
+load_holder_snapshot (GHolder *h, const GModule *modules, size_t n) {
+  GRawData **raw_data = xcalloc (n, sizeof (*raw_data));
+  uint32_t max_choices = get_max_choices ();
+  uint32_t max_choices_sub = get_max_choices_sub ();
+  uint32_t epoch = 0;
+  uint64_t start = 0;
+  size_t i;
+
+  gdns_lock ();
+  start = stat_now ();
+  epoch = ht_get_cache_epoch ();
+  for (i = 0; i < n; ++i)
+    raw_data[i] = extract_raw_data (modules[i]);
+  stat_time (STAT_EXTRACT, start, n);
+  gdns_unlock ();
+
+  start = stat_now ();
+  for (i = 0; i < n; ++i) {
+    if (raw_data[i])
+      sort_raw_data (raw_data[i]);
+  }
+  stat_time (STAT_SORT, start, n);
+
+  gdns_lock ();
+  start = stat_now ();
+  for (i = 0; i < n; ++i) {
+    if (epoch != ht_get_cache_epoch ()) {
+      free_raw_data (raw_data[i]);
+      raw_data[i] = parse_raw_data (modules[i]);
+    }
+    if (!raw_data[i]) {
+      LOG_DEBUG (("raw data is NULL for module: %d.\n", modules[i]));
+      continue;
+    }
+    load_holder_data (raw_data[i], h + modules[i], modules[i], module_sort[modules[i]],
+                      max_choices, max_choices_sub);
+  }
+  stat_time (STAT_HOLDER, start, n);
+  gdns_unlock ();
+
+  free (raw_data);
+}
+
 /* Extract data from the given module hash structure and allocate +
  * load data from the hash table into an instance of GHolder */
 static void
 allocate_holder_by_module (GModule module) {
-  GRawData *raw_data;
-  uint32_t max_choices = get_max_choices ();
-  uint32_t max_choices_sub = get_max_choices_sub ();
+  load_holder_snapshot (holder, &module, 1);
+}
 
-  /* extract data from the corresponding hash table */
-  raw_data = parse_raw_data (module);
-  if (!raw_data) {
-    LOG_DEBUG (("raw data is NULL for module: %d.\n", module));
-    return;
-  }
+/* Iterate over all modules/panels and extract data from hash structures
+ * and load it into a new instance of GHolder.
+ *
+ * On success, the newly allocated GHolder is returned . */
+static GHolder *
+new_holder_snapshot (void) {
+  GHolder *h = new_gholder (TOTAL_MODULES);
+  GModule modules[TOTAL_MODULES];
+  size_t idx = 0;
+
+  FOREACH_MODULE (idx, module_list)
+    modules[idx] = module_list[idx];
 
-  load_holder_data (raw_data, holder + module, module, module_sort[module], max_choices,
-                    max_choices_sub);
+  load_holder_snapshot (h, modules, idx);
+  return h;
 }
 
 /* Iterate over all modules/panels and extract data from hash
  * structures and load it into an instance of GHolder */
 static void
 allocate_holder (void) {
-  size_t idx = 0;
-
-  holder = new_gholder (TOTAL_MODULES);
-  FOREACH_MODULE (idx, module_list) {
-    allocate_holder_by_module (module_list[idx]);
-  }
+  holder = new_holder_snapshot ();
 }
 
 /* Extract data from the modules GHolder structure and load it into
@@ -381,9 +473,9 @@ allocate_data_by_module (GModule module, uint32_t col_data) {
     dash->module[module].dash_size = DASH_COLLAPSED;
   dash->total_alloc += dash->module[module].dash_size;
 
-  pthread_mutex_lock (&gdns_thread.mutex);
+  gdns_lock ();
   load_data_to_dash (&holder[module], dash, module, &gscroll);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  gdns_unlock ();
 }
 
 /* Iterate over all modules/panels and extract data from GHolder
@@ -609,6 +701,7 @@ expand_current_module (void) {
   reset_scroll_offsets (&gscroll);
   gscroll.expanded = 1;
 
+  invalidate_find ();
   free_holder_by_module (&holder, gscroll.current);
   free_dashboard (dash);
   allocate_holder_by_module (gscroll.current);
@@ -636,6 +729,7 @@ expand_module_from_ypos (int y) {
   reset_scroll_offsets (&gscroll);
   gscroll.expanded = 1;
 
+  invalidate_find ();
   free_holder_by_module (&holder, gscroll.current);
   free_dashboard (dash);
   allocate_holder_by_module (gscroll.current);
@@ -789,9 +883,7 @@ render_search_dialog (int search) {
   if (render_find_dialog (main_win, &gscroll))
     return 1;
 
-  pthread_mutex_lock (&gdns_thread.mutex);
   search = perform_next_find (holder, &gscroll);
-  pthread_mutex_unlock (&gdns_thread.mutex);
   if (search != 0)
     return 1;
 
@@ -801,12 +893,11 @@ render_search_dialog (int search) {
   return 0;
 }
 
-/* Search for the next occurrence within the dashboard structure */
+/* Search for the next occurrence within the dashboard structure. The
+ * holder searched is only rebuilt by this thread, see tail_term(). */
 static int
 search_next_match (int search) {
-  pthread_mutex_lock (&gdns_thread.mutex);
   search = perform_next_find (holder, &gscroll);
-  pthread_mutex_unlock (&gdns_thread.mutex);
   if (search != 0)
     return 1;
 
@@ -815,13 +906,49 @@ search_next_match (int search) {
   return 0;
 }
 
+/* Write to the debug log a summary of the memory held by the storage at most
+ * once every --mem-report seconds. Date stores loaded back since the last
+ * new date are then spilled again to fit within --mem-limit.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
+static void
+log_mem_report (void) {
+  static time_t last = 0;
+  GKMemDate *mem = NULL;
+  uint64_t stores = 0, caches = 0, strings = 0, app = 0;
+  uint32_t len = 0, i;
+  size_t idx = 0;
+  time_t now = time (NULL);
+
+  if (!conf.mem_report || (last && (uint64_t) (now - last) < conf.mem_report))
+    return;
+  last = now;
+  spill_cold_dates (0);
+
+  mem = ht_mem_dates (&len);
+  for (i = 0; i < len; ++i)
+    stores += mem[i].total;
+  free (mem);
+
+  FOREACH_MODULE (idx, module_list)
+    caches += ht_mem_cache (module_list[idx]);
+  strings = ht_mem_strpool ();
+  app = ht_mem_app ();
+
+  LOG_DEBUG (("memory: %" PRIu64 " bytes (stores %" PRIu64 " in %u dates, caches %" PRIu64
+              ", strings %" PRIu64 ", app %" PRIu64 ")\n", stores + caches + strings + app,
+              stores, len, caches, strings, app));
+}
+
 /* Update holder structure and dashboard screen */
 static void
 tail_term (void) {
-  pthread_mutex_lock (&gdns_thread.mutex);
+  gdns_lock ();
+  invalidate_find ();
   free_holder (&holder);
   pthread_cond_broadcast (&gdns_thread.not_empty);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  log_mem_report ();
+  gdns_unlock ();
 
   free_dashboard (dash);
   allocate_holder ();
@@ -830,45 +957,56 @@ tail_term (void) {
   term_size (main_win, &main_win_height);
 }
 
+/* Build a new holder out of the current data and publish it in place of
+ * the one clients are fast-forwarded from, then broadcast it. Only the
+ * summary and the panel metadata are copied while holding the storage
+ * lock, the report is serialized once released. */
 static void
 tail_html (void) {
+  GJSONSnapshot snap;
+  GHolder *stale = NULL, *fresh = NULL;
   char *json = NULL;
 
-  pthread_mutex_lock (&gdns_thread.mutex);
-  free_holder (&holder);
-  pthread_cond_broadcast (&gdns_thread.not_empty);
-  pthread_mutex_unlock (&gdns_thread.mutex);
-
-  allocate_holder ();
+  fresh = new_holder_snapshot ();
 
-  pthread_mutex_lock (&gdns_thread.mutex);
-  json = get_json (holder, 1);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  gdns_lock ();
+  pthread_cond_broadcast (&gdns_thread.not_empty);
+  set_json_snapshot (&snap);
+  log_mem_report ();
+  gdns_unlock ();
 
-  if (json == NULL)
-    return;
+  json = get_json (fresh, &snap, 1);
 
+  /* fast_forward_client() serializes the published holder while holding the
+   * writer's lock */
   pthread_mutex_lock (&gwswriter->mutex);
-  broadcast_holder (gwswriter->fd, json, strlen (json));
+  stale = holder;
+  holder = fresh;
+  if (json != NULL)
+    broadcast_holder (gwswriter->fd, json, strlen (json));
   pthread_mutex_unlock (&gwswriter->mutex);
+
+  free_json_snapshot (&snap);
+  free_holder (&stale);
   free (json);
 }
 
 /* Fast-forward latest JSON data when client connection is opened. */
 static void
 fast_forward_client (int listener) {
+  GJSONSnapshot snap;
   char *json = NULL;
 
-  pthread_mutex_lock (&gdns_thread.mutex);
-  json = get_json (holder, 1);
-  pthread_mutex_unlock (&gdns_thread.mutex);
-
-  if (json == NULL)
-    return;
+  gdns_lock ();
+  set_json_snapshot (&snap);
+  gdns_unlock ();
 
   pthread_mutex_lock (&gwswriter->mutex);
-  send_holder_to_client (gwswriter->fd, listener, json, strlen (json));
+  if ((json = get_json (holder, &snap, 1)) != NULL)
+    send_holder_to_client (gwswriter->fd, listener, json, strlen (json));
   pthread_mutex_unlock (&gwswriter->mutex);
+
+  free_json_snapshot (&snap);
   free (json);
 }
 
@@ -894,10 +1032,31 @@ read_client (void *ptr_data) {
   close (reader->fd);
 }
 
-/* Parse tailed lines */
+/* Parse and process the given line of a followed log.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
 static void
-parse_tail_follow (GLog *glog, GFileHandle *fh) {
+parse_tail_line (GLog *glog, char *line) {
   GLogItem *logitem = NULL;
+
+  if ((parse_line (glog, line, 0, NULL, &logitem)) == 0 && logitem != NULL) {
+    if (conf.persist_wal)
+      log_wal_record (logitem);
+    process_log (logitem);
+  }
+  if (logitem != NULL)
+    free_glog (logitem);
+
+  /* counted along with its records, see checkpoint_last_parse() */
+  glog->bytes += strlen (line);
+  glog->lp.line = ++glog->read;
+  if (glog->props.inode)
+    glog->lp.size = glog->length + glog->bytes;
+}
+
+/* Parse tailed lines from a pipe */
+static void
+parse_tail_follow (GLog *glog, GFileHandle *fh) {
 #ifdef WITH_GETLINE
   char *buf = NULL;
 #else
@@ -911,42 +1070,86 @@ parse_tail_follow (GLog *glog, GFileHandle *fh) {
 #else
   while (gfile_gets (buf, LINE_BUFFER, fh) != NULL) {
 #endif
-    pthread_mutex_lock (&gdns_thread.mutex);
-    if ((parse_line (glog, buf, 0, &logitem)) == 0 && logitem != NULL)
-      process_log (logitem);
-    if (logitem != NULL) {
-      free_glog (logitem);
-      logitem = NULL;
-    }
-    pthread_mutex_unlock (&gdns_thread.mutex);
+    gdns_lock ();
+    parse_tail_line (glog, buf);
+    gdns_unlock ();
 
-    glog->bytes += strlen (buf);
 #ifdef WITH_GETLINE
     free (buf);
 #endif
 
     /* If the ingress rate is greater than MAX_BATCH_LINES,
      * then we break and allow to re-render the UI */
-    if (++glog->read % MAX_BATCH_LINES == 0)
+    if (glog->read % MAX_BATCH_LINES == 0)
       break;
   }
+
+  if (conf.persist_wal) {
+    gdns_lock ();
+    append_wal (glog->props.inode, &glog->lp);
+    gdns_unlock ();
+  }
 }
 
+/* Read in bulk the lines appended to the followed log past its last
+ * parsed byte and parse them, up to MAX_BATCH_LINES so the UI is
+ * re-rendered in between. The last line is left for the next follow if
+ * it's still being written, i.e., if its newline is missing. */
+static void
+read_tail (GLog *glog) {
+  size_t size = 0, len = 0, done = 0;
+  char *buf = NULL;
+  uint32_t cnt = 0;
+  ssize_t n = 0;
+  int fd = fileno (glog->tail->fp);
+
+  /* no larger than what was appended */
+  size = MIN (TAIL_READ_BYTES, MAX (glog->props.size - glog->length, READ_BYTES));
+  buf = xmalloc (size);
+
+  glog->bytes = 0;
+  while (cnt < MAX_BATCH_LINES &&
+         (n = pread (fd, buf + len, size - len, glog->length + glog->bytes + len)) > 0) {
+    len += n;
+    for (done = len; done > 0 && buf[done - 1] != '\n'; --done);
+
+    /* a single line longer than the buffer */
+    if (done == 0) {
+      if (len == size)
+        buf = xrealloc (buf, size *= 2);
+      continue;
+    }
+
+    gdns_lock ();
+    cnt += read_appended_lines (glog, buf, done);
+    gdns_unlock ();
+    memmove (buf, buf + done, len - done);
+    len -= done;
+  }
+  if (n == -1)
+    LOG_DEBUG (("Unable to read %s: %s\n", glog->props.filename, strerror (errno)));
+
+  free (buf);
+}
+
+/* Verify the followed log against the last parse. If the log got smaller, it
+ * was probably truncated so start reading from 0 and reset the snippet. If
+ * the log changed its inode, more likely the log was rotated, so we set the
+ * initial snippet for the new log for future iterations.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
 static void
 verify_inode (GFileHandle *fh, GLog *glog) {
   struct stat fdstat;
 
-  if (stat (glog->props.filename, &fdstat) == -1)
+  if (fstat (fileno (fh->fp), &fdstat) == -1)
     FATAL ("Unable to stat the specified log file '%s'. %s", glog->props.filename,
            strerror (errno));
 
   glog->props.size = fdstat.st_size;
 
-  /* Either the log got smaller, probably was truncated so start reading from 0
-   * and reset snippet.
-   * If the log changed its inode, more likely the log was rotated, so we set
-   * the initial snippet for the new log for future iterations */
-  if (fdstat.st_ino != glog->props.inode || glog->snippet[0] == '\0' || 0 == glog->props.size) {
+  if (fdstat.st_ino != glog->props.inode || glog->snippet[0] == '\0' || 0 == glog->props.size ||
+      glog->props.size < glog->length) {
     glog->length = glog->bytes = 0;
     set_initial_persisted_data (glog, fh, glog->props.filename);
   }
@@ -982,6 +1185,42 @@ is_gzipped_file_check (const char *filename) {
   return result;
 }
 
+/* Keep the given log open while following it. If a new log took its name,
+ * i.e., it was rotated, the rest of the former log is read before switching
+ * to the new one.
+ *
+ * If the log is not to be followed, 1 is returned.
+ * On success, 0 is returned. */
+static int
+open_tail (GLog *glog) {
+  struct stat st, fdst;
+
+  if (glog->tail != NULL) {
+    /* the log is gone, keep following it until a new log takes its name */
+    if (stat (glog->props.filename, &st) == -1 || fstat (fileno (glog->tail->fp), &fdst) == -1 ||
+        st.st_ino == fdst.st_ino)
+      return 0;
+
+    do {
+      read_tail (glog);
+      glog->length += glog->bytes;
+    } while (glog->bytes > 0);
+    gfile_close (glog->tail);
+    glog->tail = NULL;
+  }
+
+  /* Skip tailing gzipped files - they are static archives and should not be monitored
+   * for changes in real-time mode. Only regular log files should be tailed. */
+  if (is_gzipped_file_check (glog->props.filename))
+    return 1;
+
+  if (!(glog->tail = gfile_open (glog->props.filename, "r")))
+    FATAL ("Unable to read the specified log file '%s'. %s", glog->props.filename,
+           strerror (errno));
+
+  return 0;
+}
+
 /* Process appended log data
  *
  * If nothing changed, 0 is returned.
@@ -990,8 +1229,8 @@ static int
 perform_tail_follow (GLog *glog) {
   GFileHandle *fh = NULL;
   char buf[READ_BYTES + 1] = { 0 };
+  uint32_t read = glog->read;
   uint16_t len = 0;
-  uint64_t length = 0;
 
   if (glog->props.filename[0] == '-' && glog->props.filename[1] == '\0') {
     /* For stdin pipe, we need to wrap the FILE* into a GFileHandle */
@@ -1016,30 +1255,23 @@ perform_tail_follow (GLog *glog) {
     goto out;
   }
 
-  /* Skip tailing gzipped files - they are static archives and should not be monitored
-   * for changes in real-time mode. Only regular log files should be tailed. */
-  if (is_gzipped_file_check (glog->props.filename)) {
+  if (open_tail (glog))
     return 0;
-  }
 
-  length = file_size (glog->props.filename);
+  gdns_lock ();
+  verify_inode (glog->tail, glog);
+  gdns_unlock ();
 
   /* file hasn't changed */
   /* ###NOTE: This assumes the log file being read can be of smaller size, e.g.,
    * rotated/truncated file or larger when data is appended */
-  if (length == glog->length)
-    return 0;
+  if (glog->props.size == glog->length)
+    return read != glog->read;
 
-  if (!(fh = gfile_open (glog->props.filename, "r")))
-    FATAL ("Unable to read the specified log file '%s'. %s", glog->props.filename,
-           strerror (errno));
-
-  verify_inode (fh, glog);
-
-  len = MIN (glog->snippetlen, length);
+  len = MIN (glog->snippetlen, glog->props.size);
   /* This is not ideal, but maybe the only reliable way to know if the
    * current log looks different than our first read/parse */
-  if ((gfile_read (buf, len, 1, fh)) != 1 && gfile_error (fh))
+  if (pread (fileno (glog->tail->fp), buf, len, 0) == -1)
     FATAL ("Unable to read the specified log file '%s'", glog->props.filename);
 
   /* For the case where the log got larger since the last iteration, we attempt
@@ -1049,55 +1281,204 @@ perform_tail_follow (GLog *glog) {
   if (glog->snippet[0] != '\0' && buf[0] != '\0' && memcmp (glog->snippet, buf, len) != 0)
     glog->length = glog->bytes = 0;
 
-  if (!gfile_seek (fh, glog->length, SEEK_SET))
-    parse_tail_follow (glog, fh);
-
-  gfile_close (fh);
-
+  read_tail (glog);
   glog->length += glog->bytes;
 
-  /* insert the inode of the file parsed and the last line parsed */
+  /* insert the inode of the file parsed and the last line parsed, i.e., up
+   * to the bytes read so far, which may fall short of the log size */
   if (glog->props.inode) {
-    glog->lp.line = glog->read;
-    glog->lp.size = glog->props.size;
+    gdns_lock ();
     ht_insert_last_parse (glog->props.inode, &glog->lp);
+    gdns_unlock ();
   }
 
 out:
   return 1;
 }
 
-/* Loop over and perform a follow for the given logs */
+/* Set the last parsed line of each log to the line being parsed, so a
+ * checkpoint resumes right past the records it holds.
+ *
+ * Note: the caller must hold the gdns_thread.mutex. */
 static void
-tail_loop_html (Logs *logs) {
-  struct timespec refresh = {
-    .tv_sec = conf.html_refresh ? conf.html_refresh : HTML_REFRESH,
-    .tv_nsec = 0,
-  };
-  int i = 0, ret = 0;
+checkpoint_last_parse (Logs *logs) {
+  int i;
 
-  while (1) {
-    if (conf.stop_processing)
+  for (i = 0; i < logs->size; ++i)
+    ht_insert_last_parse (logs->glog[i].props.inode, &logs->glog[i].lp);
+}
+
+/* Persist the data parsed so far. The dates modified since the last
+ * checkpoint are written one at a time so parsing goes on in between, the
+ * latest one and the rest of the dataset last. */
+static void
+checkpoint_data (Logs *logs) {
+  int ret = 0;
+
+  do {
+    gdns_lock ();
+    ret = stage_dirty_date ();
+    gdns_unlock ();
+  } while (ret == 1 && !conf.stop_processing);
+
+  gdns_lock ();
+  checkpoint_last_parse (logs);
+  persist_data ();
+  gdns_unlock ();
+}
+
+/* Persist data every --persist-interval minutes until stopped. */
+static void *
+checkpoint_worker (void *ptr_data) {
+  Logs *logs = (Logs *) ptr_data;
+  struct timespec deadline;
+
+  pthread_mutex_lock (&checkpoint_mutex);
+  while (checkpoint_active) {
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += conf.persist_interval * 60;
+    while (checkpoint_active &&
+           pthread_cond_timedwait (&checkpoint_cond, &checkpoint_mutex, &deadline) != ETIMEDOUT);
+    if (!checkpoint_active)
       break;
 
+    pthread_mutex_unlock (&checkpoint_mutex);
+    checkpoint_data (logs);
+    LOG_DEBUG (("Checkpoint persisted\n"));
+    pthread_mutex_lock (&checkpoint_mutex);
+  }
+  pthread_mutex_unlock (&checkpoint_mutex);
+
+  return NULL;
+}
+
+/* Start the checkpoint thread for the logs being tailed. */
+static void
+start_checkpoint (Logs *logs) {
+  int th = 0;
+
+  if (!conf.persist || !conf.persist_interval || logs->load_from_disk_only)
+    return;
+
+  checkpoint_active = 1;
+  th = pthread_create (&checkpoint_thread, NULL, checkpoint_worker, logs);
+  if (th)
+    FATAL ("Return code from pthread_create(): %d", th);
+}
+
+/* Follow the given log if data may have been appended to it.
+ *
+ * If nothing changed, 0 is returned.
+ * If log file changed, 1 is returned. */
+static int
+follow_log (Logs *logs, int idx) {
+  GLog *glog = &logs->glog[idx];
+  uint32_t read = 0;
+  int ret = 0;
+
+  if (gwatch == NULL)
+    gwatch = new_gwatch (logs);
+  if (!is_gwatch_ready (gwatch, idx))
+    return 0;
+
+  read = glog->read;
+  ret = perform_tail_follow (glog);
+  /* stopped at MAX_BATCH_LINES, read the rest right after rendering */
+  if (glog->read - read >= MAX_BATCH_LINES)
+    set_gwatch_ready (gwatch, idx);
+
+  return ret;
+}
+
+/* Perform a follow for the given logs as data is appended to them until
+ * processing is stopped, flagging the report as changed. */
+static void *
+follow_worker (void *ptr_data) {
+  Logs *logs = (Logs *) ptr_data;
+  sigset_t sigset;
+  int i = 0, ret = 0;
+
+  /* signals are handled by the main thread */
+  sigemptyset (&sigset);
+  sigaddset (&sigset, SIGINT);
+  sigaddset (&sigset, SIGPIPE);
+  sigaddset (&sigset, SIGTERM);
+  sigaddset (&sigset, SIGQUIT);
+  pthread_sigmask (SIG_BLOCK, &sigset, NULL);
+
+  while (!conf.stop_processing) {
+    /* wait up to 0.2 seconds for data to be appended */
+    wait_gwatch (gwatch, logs, 200);
     for (i = 0, ret = 0; i < logs->size; ++i)
-      ret |= perform_tail_follow (&logs->glog[i]); /* 0.2 secs */
+      ret |= follow_log (logs, i);
+    if (1 != ret)
+      continue;
+
+    pthread_mutex_lock (&follow_mutex);
+    follow_changed = 1;
+    pthread_cond_signal (&follow_cond);
+    pthread_mutex_unlock (&follow_mutex);
+  }
 
-    if (1 == ret)
-      tail_html ();
+  /* wake the main thread up so it can stop as well */
+  pthread_mutex_lock (&follow_mutex);
+  pthread_cond_signal (&follow_cond);
+  pthread_mutex_unlock (&follow_mutex);
+
+  return NULL;
+}
 
-    if (nanosleep (&refresh, NULL) == -1 && errno != EINTR)
-      FATAL ("nanosleep: %s", strerror (errno));
+/* Follow the given logs on their own thread and render the report as data
+ * is appended to them, at most once every --html-refresh seconds. Parsing
+ * goes on while the report is rendered. */
+static void
+tail_loop_html (Logs *logs) {
+  int refresh = conf.html_refresh ? conf.html_refresh : HTML_REFRESH;
+  struct timespec due = { 0 }, deadline;
+  pthread_t th;
+  int changed = 0, ret = 0;
+
+  if (gwatch == NULL)
+    gwatch = new_gwatch (logs);
+
+  ret = pthread_create (&th, NULL, follow_worker, logs);
+  if (ret)
+    FATAL ("Return code from pthread_create(): %d", ret);
+
+  pthread_mutex_lock (&follow_mutex);
+  while (!conf.stop_processing) {
+    /* hold the changes back until the refresh interval is due */
+    while (!conf.stop_processing &&
+           pthread_cond_timedwait (&follow_cond, &follow_mutex, &due) != ETIMEDOUT);
+
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += refresh;
+    while (!conf.stop_processing && !follow_changed &&
+           pthread_cond_timedwait (&follow_cond, &follow_mutex, &deadline) != ETIMEDOUT);
+
+    changed = follow_changed;
+    follow_changed = 0;
+    if (!changed || conf.stop_processing)
+      continue;
+
+    pthread_mutex_unlock (&follow_mutex);
+    tail_html ();
+    clock_gettime (CLOCK_REALTIME, &due);
+    due.tv_sec += refresh;
+    pthread_mutex_lock (&follow_mutex);
   }
+  pthread_mutex_unlock (&follow_mutex);
+
+  pthread_join (th, NULL);
 }
 
 /* Entry point to start processing the HTML output */
 static void
 process_html (Logs *logs, const char *filename) {
   /* render report */
-  pthread_mutex_lock (&gdns_thread.mutex);
+  gdns_lock ();
   output_html (holder, filename);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  gdns_unlock ();
 
   /* not real time? */
   if (!conf.real_time_html)
@@ -1115,6 +1496,7 @@ process_html (Logs *logs, const char *filename) {
     return;
 
   set_ready_state ();
+  start_checkpoint (logs);
   tail_loop_html (logs);
   close (gwswriter->fd);
 }
@@ -1167,10 +1549,11 @@ static void
 render_sort_dialog (void) {
   load_sort_win (main_win, gscroll.current, &module_sort[gscroll.current]);
 
-  pthread_mutex_lock (&gdns_thread.mutex);
+  gdns_lock ();
+  invalidate_find ();
   free_holder (&holder);
   pthread_cond_broadcast (&gdns_thread.not_empty);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  gdns_unlock ();
 
   free_dashboard (dash);
   allocate_holder ();
@@ -1179,21 +1562,22 @@ render_sort_dialog (void) {
 
 static void
 term_tail_logs (Logs *logs) {
-  struct timespec ts = {.tv_sec = 0,.tv_nsec = 200000000 }; /* 0.2 seconds */
   uint32_t offset = 0;
   int i, ret;
 
+  if (gwatch == NULL)
+    gwatch = new_gwatch (logs);
+
+  /* wait up to 0.2 seconds for data to be appended */
+  wait_gwatch (gwatch, logs, 200);
   for (i = 0, ret = 0; i < logs->size; ++i)
-    ret |= perform_tail_follow (&logs->glog[i]);
+    ret |= follow_log (logs, i);
 
   if (1 == ret) {
     tail_term ();
     offset = *logs->processed - logs->offset;
     render_screens (offset);
   }
-  if (nanosleep (&ts, NULL) == -1 && errno != EINTR) {
-    FATAL ("nanosleep: %s", strerror (errno));
-  }
 }
 
 static int
@@ -1386,10 +1770,11 @@ get_keys (Logs *logs) {
       sigaction (SIGINT, &oldact, NULL);
 
       /* Rebuild dashboard with new panel order */
-      pthread_mutex_lock (&gdns_thread.mutex);
+      gdns_lock ();
+      invalidate_find ();
       free_holder (&holder);
       pthread_cond_broadcast (&gdns_thread.not_empty);
-      pthread_mutex_unlock (&gdns_thread.mutex);
+      gdns_unlock ();
 
       free_dashboard (dash);
       allocate_holder ();
@@ -1522,6 +1907,7 @@ curses_output (Logs *logs) {
 
   clean_stdscrn ();
   render_screens (0);
+  start_checkpoint (logs);
   /* will loop in here */
   get_keys (logs);
 }
@@ -1696,12 +2082,16 @@ initializer (void) {
   if (conf.username)
     drop_permissions ();
 
+  /* no other thread is running yet to read the environment */
+  gdns_set_timeout ();
+
   /* then initialize modules and set */
   gscroll.current = init_modules ();
   /* setup to use the current locale */
   set_locale ();
 
   parse_browsers_file ();
+  init_static_files ();
 
 #ifdef HAVE_GEOLOCATION
   init_geoip ();
@@ -1834,6 +2224,7 @@ main (int argc, char **argv) {
   Logs *logs = NULL;
   int quit = 0, ret = 0;
 
+  stat_init ();
   block_thread_signals ();
   setup_sigsegv_handler ();
 
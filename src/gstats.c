@@ -0,0 +1,220 @@
+/**
+ * gstats.c -- runtime counters and timings of the processing pipeline
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include "gstats.h"
+
+/* *INDENT-OFF* */
+static const struct {
+  const char *str;
+  const char *unit;
+} stages[STAT_STAGES] = {
+  [STAT_INGEST]    = {"ingest"    , "lines"},
+  [STAT_READ]      = {"read"      , "bytes"},
+  [STAT_PARSE]     = {"parse"     , "lines"},
+  [STAT_PROCESS]   = {"process"   , "lines"},
+  [STAT_EXTRACT]   = {"extract"   , "panels"},
+  [STAT_SORT]      = {"sort"      , "panels"},
+  [STAT_HOLDER]    = {"holder"    , "panels"},
+  [STAT_JSON]      = {"json"      , "bytes"},
+  [STAT_LOCK_WAIT] = {"lock_wait" , "waits"},
+};
+/* *INDENT-ON* */
+
+/* Every field below is updated with relaxed atomics, stages may run on
+ * several threads at once and the report is generated by another one. */
+static GStatTimer stage_timers[STAT_STAGES];
+static GStatTimer module_timers[TOTAL_MODULES];
+static uint64_t counters[STAT_COUNTERS];
+static uint64_t started;
+static uint32_t samples;
+static int clients;
+
+/* Get the current time of a monotonic clock.
+ *
+ * The time in nanoseconds is returned. */
+uint64_t
+stat_now (void) {
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/* Start the clock runtime statistics are reported against. */
+void
+stat_init (void) {
+  started = stat_now ();
+}
+
+/* Get the nanoseconds elapsed since stat_init(). */
+uint64_t
+stat_uptime (void) {
+  return started ? stat_now () - started : 0;
+}
+
+/* Get the name of the given stage as used by the JSON output. */
+const char *
+stat_stage_str (GStatStage stage) {
+  return stages[stage].str;
+}
+
+/* Get the unit of work of the given stage, e.g., lines. */
+const char *
+stat_stage_unit (GStatStage stage) {
+  return stages[stage].unit;
+}
+
+/* Map a duration to its histogram bucket. Bucket 0 holds runs under a
+ * microsecond and bucket N those of [2^(N-1), 2^N) microseconds. */
+static int
+stat_bucket (uint64_t ns) {
+  uint64_t us = ns / 1000;
+  int bucket = 0;
+
+  while (us && bucket < STAT_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+/* Record a run of the given duration into a timer. */
+static void
+stat_record (GStatTimer *timer, uint64_t ns, uint64_t items) {
+  uint64_t max = __atomic_load_n (&timer->max, __ATOMIC_RELAXED);
+
+  __atomic_add_fetch (&timer->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&timer->items, items, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&timer->total, ns, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&timer->hist[stat_bucket (ns)], 1, __ATOMIC_RELAXED);
+
+  while (ns > max &&
+         !__atomic_compare_exchange_n (&timer->max, &max, ns, 0, __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED));
+}
+
+/* Record a run of the given stage, started at the given stat_now()
+ * time, that handled the given units of work. */
+void
+stat_time (GStatStage stage, uint64_t start, uint64_t items) {
+  stat_record (&stage_timers[stage], stat_now () - start, items);
+}
+
+/* Record the insert of a log item into the given module, started at the
+ * given stat_now() time. */
+void
+stat_time_module (GModule module, uint64_t start) {
+  stat_record (&module_timers[module], stat_now () - start, 1);
+}
+
+/* Determine if the module inserts of the current log item should be
+ * timed. Only one in STAT_SAMPLE_RATE is, so that the clock reads stay
+ * off the hot path.
+ *
+ * If it should be timed, 1 is returned, else 0. */
+int
+stat_sample (void) {
+  return __atomic_fetch_add (&samples, 1, __ATOMIC_RELAXED) % STAT_SAMPLE_RATE == 0;
+}
+
+/* Copy a timer out field by field. */
+static void
+stat_copy (GStatTimer *dst, GStatTimer *src) {
+  int i;
+
+  dst->count = __atomic_load_n (&src->count, __ATOMIC_RELAXED);
+  dst->items = __atomic_load_n (&src->items, __ATOMIC_RELAXED);
+  dst->total = __atomic_load_n (&src->total, __ATOMIC_RELAXED);
+  dst->max = __atomic_load_n (&src->max, __ATOMIC_RELAXED);
+  for (i = 0; i < STAT_BUCKETS; ++i)
+    dst->hist[i] = __atomic_load_n (&src->hist[i], __ATOMIC_RELAXED);
+}
+
+/* Get a copy of the timings of the given stage. */
+void
+stat_get_stage (GStatTimer *timer, GStatStage stage) {
+  stat_copy (timer, &stage_timers[stage]);
+}
+
+/* Get a copy of the sampled insert timings of the given module. */
+void
+stat_get_module (GStatTimer *timer, GModule module) {
+  stat_copy (timer, &module_timers[module]);
+}
+
+/* Estimate the given percentile of a timer's runs from its histogram.
+ *
+ * The upper bound of the bucket holding it is returned in nanoseconds,
+ * capped to the slowest run. */
+uint64_t
+stat_percentile (const GStatTimer *timer, uint32_t pct) {
+  uint64_t rank = 0, seen = 0, bound = 0;
+  int i;
+
+  if (timer->count == 0)
+    return 0;
+
+  rank = (timer->count * pct + 99) / 100;
+  for (i = 0; i < STAT_BUCKETS; ++i) {
+    if ((seen += timer->hist[i]) >= rank)
+      break;
+  }
+  bound = i >= STAT_BUCKETS - 1 ? timer->max : (1000ULL << i);
+
+  return bound < timer->max ? bound : timer->max;
+}
+
+/* Add n to the given counter. */
+void
+stat_count (GStatCounter counter, uint64_t n) {
+  __atomic_add_fetch (&counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/* Get the value of the given counter. */
+uint64_t
+stat_get_counter (GStatCounter counter) {
+  return __atomic_load_n (&counters[counter], __ATOMIC_RELAXED);
+}
+
+/* Account for WebSocket clients connecting (delta > 0) or leaving. */
+void
+stat_add_clients (int delta) {
+  __atomic_add_fetch (&clients, delta, __ATOMIC_RELAXED);
+}
+
+/* Get the number of WebSocket clients currently connected. */
+int
+stat_get_clients (void) {
+  return __atomic_load_n (&clients, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,87 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GSTATS_H_INCLUDED
+#define GSTATS_H_INCLUDED
+
+#include <stdint.h>
+
+#include "commons.h"
+
+#define STAT_BUCKETS     32     /* power-of-two microsecond histogram buckets */
+#define STAT_SAMPLE_RATE 64     /* time the module inserts of one line in X */
+
+/* Pipeline stages timed at runtime */
+typedef enum GStatStage_ {
+  STAT_INGEST,                  /* a whole read/parse/process pass */
+  STAT_READ,                    /* reading lines into the parser jobs */
+  STAT_PARSE,                   /* parsing lines into log items */
+  STAT_PROCESS,                 /* storing log items, process_log() */
+  STAT_EXTRACT,                 /* copying panel data out of the storage */
+  STAT_SORT,                    /* sorting the copied panel data */
+  STAT_HOLDER,                  /* loading it into a holder */
+  STAT_JSON,                    /* generating a JSON report */
+  STAT_LOCK_WAIT,               /* waiting on a contended gdns_thread.mutex */
+  STAT_STAGES,
+} GStatStage;
+
+/* Runtime counters */
+typedef enum GStatCounter_ {
+  STAT_WS_BYTES,                /* bytes handed to the WebSocket server */
+  STAT_WS_MESSAGES,             /* reports handed to the WebSocket server */
+  STAT_WS_CONNECTIONS,          /* WebSocket clients connected so far */
+  STAT_COUNTERS,
+} GStatCounter;
+
+/* Timings of a stage, in nanoseconds */
+typedef struct GStatTimer_ {
+  uint64_t count;               /* times the stage ran */
+  uint64_t items;               /* units of work, see stat_stage_unit() */
+  uint64_t total;               /* time spent overall */
+  uint64_t max;                 /* slowest run */
+  uint64_t hist[STAT_BUCKETS];  /* runs by duration, see stat_percentile() */
+} GStatTimer;
+
+const char *stat_stage_str (GStatStage stage);
+const char *stat_stage_unit (GStatStage stage);
+int stat_get_clients (void);
+int stat_sample (void);
+uint64_t stat_get_counter (GStatCounter counter);
+uint64_t stat_now (void);
+uint64_t stat_percentile (const GStatTimer * timer, uint32_t pct);
+uint64_t stat_uptime (void);
+void stat_add_clients (int delta);
+void stat_count (GStatCounter counter, uint64_t n);
+void stat_get_module (GStatTimer * timer, GModule module);
+void stat_get_stage (GStatTimer * timer, GStatStage stage);
+void stat_init (void);
+void stat_time (GStatStage stage, uint64_t start, uint64_t items);
+void stat_time_module (GModule module, uint64_t start);
+
+#endif // for #ifndef GSTATS_H
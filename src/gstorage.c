@@ -45,6 +45,7 @@
 #include "commons.h"
 #include "error.h"
 #include "gkhash.h"
+#include "gstats.h"
 #include "opesys.h"
 #include "ui.h"
 #include "util.h"
@@ -592,11 +593,13 @@ get_mtr_str (GSMetric metric) {
     {"MTRC_PROTOCOLS", MTRC_PROTOCOLS},
     {"MTRC_AGENTS", MTRC_AGENTS},
     {"MTRC_METADATA", MTRC_METADATA},
+    {"MTRC_SKETCHES", MTRC_SKETCHES},
     {"MTRC_UNIQUE_KEYS", MTRC_UNIQUE_KEYS},
     {"MTRC_AGENT_KEYS", MTRC_AGENT_KEYS},
     {"MTRC_AGENT_VALS", MTRC_AGENT_VALS},
     {"MTRC_CNT_VALID", MTRC_CNT_VALID},
     {"MTRC_CNT_BW", MTRC_CNT_BW},
+    {"MTRC_CNT_VISITORS", MTRC_CNT_VISITORS},
   };
   return enum2str (enum_metrics, ARRAY_SIZE (enum_metrics), metric);
 }
@@ -779,7 +782,7 @@ excluded_ip (GLogItem *logitem) {
  * On success the value of the key inserted is returned */
 static int
 insert_dkeymap (GModule module, GKeyData *kdata) {
-  return ht_insert_keymap (module, kdata->numdate, kdata->dhash, &kdata->cdnkey);
+  return ht_insert_keymap (module, kdata->numdate, kdata->dhash, kdata->data, &kdata->cdnkey);
 }
 
 /* A wrapper function to insert a root keymap string key.
@@ -789,7 +792,7 @@ insert_dkeymap (GModule module, GKeyData *kdata) {
  * On success the value of the key inserted is returned */
 static int
 insert_rkeymap (GModule module, GKeyData *kdata) {
-  return ht_insert_keymap (module, kdata->numdate, kdata->rhash, &kdata->crnkey);
+  return ht_insert_keymap (module, kdata->numdate, kdata->rhash, kdata->root, &kdata->crnkey);
 }
 
 /* A wrapper function to insert a datamap uint32_t key and string value. */
@@ -808,6 +811,14 @@ insert_uniqmap (GModule module, GKeyData *kdata, uint32_t uniq_nkey) {
   return ht_insert_uniqmap (module, kdata->numdate, kdata->data_nkey, uniq_nkey);
 }
 
+/* A wrapper function to add a visitor fingerprint to the data key sketch.
+ *
+ * Returns the number of visitors the data key estimate advanced by. */
+static uint32_t
+insert_sketch (GModule module, GKeyData *kdata, uint64_t uniq_key) {
+  return ht_insert_sketch (module, kdata->numdate, kdata->data_nkey, uniq_key);
+}
+
 /* A wrapper function to insert a rootmap uint32_t key from the keymap
  * store mapped to its string value. */
 static void
@@ -834,8 +845,8 @@ insert_hit (GModule module, GKeyData *kdata) {
  * key. */
 static void
 insert_visitor (GModule module, GKeyData *kdata) {
-  ht_insert_visitor (module, kdata->numdate, kdata->data_nkey, 1, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "visitors", 1);
+  ht_insert_visitor (module, kdata->numdate, kdata->data_nkey, kdata->uniq_nkey, kdata->cdnkey);
+  ht_insert_meta_data (module, kdata->numdate, "visitors", kdata->uniq_nkey);
 }
 
 /* A wrapper function to increases bandwidth counter from an uint32_t
@@ -881,50 +892,69 @@ insert_agent (GModule module, GKeyData *kdata, uint32_t agent_nkey) {
   ht_insert_agent (module, kdata->numdate, kdata->data_nkey, agent_nkey);
 }
 
-/* The following generates a unique key to identity unique requests.
- * The key is made out of the actual request, and if available, the
- * method and the protocol.  Note that for readability, doing a simple
+/* Write the unique request key made out of the actual request, and if
+ * available and appended, the method and the protocol. If key is NULL,
+ * only its size is computed. Note that for readability, doing a simple
  * snprintf/sprintf should suffice, however, memcpy is the fastest
  * solution
  *
- * On success the new unique request key is returned */
-static char *
-gen_unique_req_key (GLogItem *logitem) {
-  char *key = NULL;
+ * On success the size of the key, including the terminating null, is
+ * returned */
+static size_t
+write_req_key (char *key, const char *req, const char *method, const char *protocol) {
   size_t s1 = 0, s2 = 0, s3 = 0, nul = 1, sep = 0;
 
-  /* nothing to do */
-  if (!conf.append_method && !conf.append_protocol)
-    return xstrdup (logitem->req);
-  /* still nothing to do */
-  if (!logitem->method && !logitem->protocol)
-    return xstrdup (logitem->req);
-
-  s1 = strlen (logitem->req);
-  if (logitem->method && conf.append_method) {
-    s2 = strlen (logitem->method);
+  s1 = strlen (req);
+  if (method && conf.append_method) {
+    s2 = strlen (method);
     nul++;
   }
-  if (logitem->protocol && conf.append_protocol) {
-    s3 = strlen (logitem->protocol);
+  if (protocol && conf.append_protocol) {
+    s3 = strlen (protocol);
     nul++;
   }
 
-  /* includes terminating null */
-  key = xcalloc (s1 + s2 + s3 + nul, sizeof (char));
+  if (!key)
+    return s1 + s2 + s3 + nul;
+
   /* append request */
-  memcpy (key, logitem->req, s1);
+  memcpy (key, req, s1);
 
-  if (logitem->method && conf.append_method) {
+  if (method && conf.append_method) {
     key[s1] = '|';
     sep++;
-    memcpy (key + s1 + sep, logitem->method, s2 + 1);
+    memcpy (key + s1 + sep, method, s2);
   }
-  if (logitem->protocol && conf.append_protocol) {
+  if (protocol && conf.append_protocol) {
     key[s1 + s2 + sep] = '|';
     sep++;
-    memcpy (key + s1 + s2 + sep, logitem->protocol, s3 + 1);
+    memcpy (key + s1 + s2 + sep, protocol, s3);
   }
+  key[s1 + s2 + s3 + sep] = '\0';
+
+  return s1 + s2 + s3 + nul;
+}
+
+/* The following generates a unique key to identity unique requests.
+ * The key is made out of the actual request, and if available, the
+ * method and the protocol.
+ *
+ * On success the new unique request key is returned */
+static char *
+gen_unique_req_key (GLogItem *logitem) {
+  char *key = NULL;
+
+  /* nothing to do */
+  if (!conf.append_method && !conf.append_protocol)
+    return logitem_strdup (logitem, logitem->req);
+  /* still nothing to do */
+  if (!logitem->method && !logitem->protocol)
+    return logitem_strdup (logitem, logitem->req);
+
+  /* includes terminating null */
+  key = logitem_alloc (logitem, write_req_key (NULL, logitem->req, logitem->method,
+                                               logitem->protocol));
+  write_req_key (key, logitem->req, logitem->method, logitem->protocol);
 
   return key;
 }
@@ -932,7 +962,7 @@ gen_unique_req_key (GLogItem *logitem) {
 /* Append the query string to the request, and therefore, it modifies
  * the original logitem->req */
 static void
-append_query_string (char **req, const char *qstr) {
+append_query_string (GLogItem *logitem, char **req, const char *qstr) {
   char *r;
   size_t s1, s2, qm = 0;
 
@@ -943,13 +973,13 @@ append_query_string (char **req, const char *qstr) {
   if (*qstr != '?')
     qm = 1;
 
-  r = xmalloc (s1 + s2 + qm + 1);
+  r = logitem_alloc (logitem, s1 + s2 + qm + 1);
   memcpy (r, *req, s1);
   if (qm)
     r[s1] = '?';
   memcpy (r + s1 + qm, qstr, s2 + 1);
 
-  free (*req);
+  logitem_free (logitem, *req);
   *req = r;
 }
 
@@ -960,7 +990,7 @@ get_kdata (GKeyData *kdata, const char *data_key, const char *data) {
   /* inserted in datamap */
   kdata->data = data;
   /* inserted in keymap */
-  kdata->dhash = djb2 ((const unsigned char *) data_key);
+  kdata->dhash = ht_keymap_hash (data_key);
 }
 
 /* A wrapper to assign the given data key and the data item to the key
@@ -970,14 +1000,14 @@ get_kroot (GKeyData *kdata, const char *root_key, const char *root) {
   /* inserted in datamap */
   kdata->root = root;
   /* inserted in keymap */
-  kdata->rhash = djb2 ((const unsigned char *) root_key);
+  kdata->rhash = ht_keymap_hash (root_key);
 }
 
 /* Generate a visitor's key given the date specificity. For instance,
  * if the specificity is set to hours, then a generated key would
  * look like: 03/Jan/2016:09 */
 static void
-set_spec_visitor_key (char **fdate, const char *ftime) {
+set_spec_visitor_key (GLogItem *logitem, char **fdate, const char *ftime) {
   size_t dlen = 0, tlen = 0, idx = 0;
   char *key = NULL, *tkey = NULL, *pch = NULL;
 
@@ -993,11 +1023,11 @@ set_spec_visitor_key (char **fdate, const char *ftime) {
   dlen = strlen (*fdate);
   tlen = strlen (tkey);
 
-  key = xmalloc (dlen + tlen + 1);
+  key = logitem_alloc (logitem, dlen + tlen + 1);
   memcpy (key, *fdate, dlen);
   memcpy (key + dlen, tkey, tlen + 1);
 
-  free (*fdate);
+  logitem_free (logitem, *fdate);
   free (tkey);
   *fdate = key;
 }
@@ -1015,7 +1045,7 @@ gen_visitor_key (GKeyData *kdata, GLogItem *logitem) {
 
   /* Append time specificity to date */
   if (conf.date_spec_hr)
-    set_spec_visitor_key (&logitem->date, logitem->time);
+    set_spec_visitor_key (logitem, &logitem->date, logitem->time);
 
   get_kdata (kdata, logitem->date, logitem->date);
   kdata->numdate = logitem->numdate;
@@ -1035,7 +1065,7 @@ gen_req_key (GKeyData *kdata, GLogItem *logitem) {
     return 1;
 
   if (logitem->qstr)
-    append_query_string (&logitem->req, logitem->qstr);
+    append_query_string (logitem, &logitem->req, logitem->qstr);
   logitem->req_key = gen_unique_req_key (logitem);
 
   get_kdata (kdata, logitem->req_key, logitem->req);
@@ -1082,6 +1112,31 @@ gen_static_request_key (GKeyData *kdata, GLogItem *logitem) {
   return 1;
 }
 
+/* Compute the keymap hash of a stored data string the way the module keys
+ * it while parsing, i.e., request panels key off the request along with its
+ * method and protocol.
+ *
+ * On success, the keymap hash is returned. */
+uint64_t
+gen_data_key_hash (GModule module, const char *data, const char *method, const char *protocol) {
+  const GParse *parse = panel_lookup (module);
+  uint64_t hash = 0;
+  char *key = NULL;
+
+  if (!parse || (!method && !protocol))
+    return ht_keymap_hash (data);
+  if (parse->key_data != gen_request_key && parse->key_data != gen_static_request_key &&
+      parse->key_data != gen_404_key)
+    return ht_keymap_hash (data);
+
+  key = xmalloc (write_req_key (NULL, data, method, protocol));
+  write_req_key (key, data, method, protocol);
+  hash = ht_keymap_hash (key);
+  free (key);
+
+  return hash;
+}
+
 /* A wrapper to generate a unique key for the virtual host panel.
  *
  * On error, 1 is returned.
@@ -1149,24 +1204,25 @@ gen_host_key (GKeyData *kdata, GLogItem *logitem) {
 /* Add browsers/OSs our logitem structure and reuse crawlers if applicable. */
 void
 set_browser_os (GLogItem *logitem) {
-  char *a1 = xstrdup (logitem->agent), *a2 = xstrdup (logitem->agent);
+  char *a1 = logitem_strdup (logitem, logitem->agent);
+  char *a2 = logitem_strdup (logitem, logitem->agent);
   char browser_type[BROWSER_TYPE_LEN] = "";
   char os_type[OPESYS_TYPE_LEN] = "";
 
-  logitem->browser = verify_browser (a1, browser_type);
-  logitem->browser_type = xstrdup (browser_type);
+  logitem->browser = logitem_own (logitem, verify_browser (a1, browser_type));
+  logitem->browser_type = logitem_strdup (logitem, browser_type);
 
   if (!strncmp (logitem->browser_type, "Crawlers", 8) ||
       !strncmp (logitem->browser_type, "Others", 6)) {
-    logitem->os = xstrdup (logitem->browser);
-    logitem->os_type = xstrdup (browser_type);
+    logitem->os = logitem_strdup (logitem, logitem->browser);
+    logitem->os_type = logitem_strdup (logitem, browser_type);
   } else {
-    logitem->os = verify_os (a2, os_type);
-    logitem->os_type = xstrdup (os_type);
+    logitem->os = logitem_own (logitem, verify_os (a2, os_type));
+    logitem->os_type = logitem_strdup (logitem, os_type);
   }
 
-  free (a1);
-  free (a2);
+  logitem_free (logitem, a1);
+  logitem_free (logitem, a2);
 }
 
 /* Generate a browser unique key for the browser's panel given a user
@@ -1318,7 +1374,7 @@ gen_tls_type_key (GKeyData *kdata, GLogItem *logitem) {
   clen = strlen (logitem->tls_cypher);
   tlen = strlen (tls);
 
-  logitem->tls_type_cypher = xmalloc (tlen + clen + 2);
+  logitem->tls_type_cypher = logitem_alloc (logitem, tlen + clen + 2);
   memcpy (logitem->tls_type_cypher, tls, tlen);
   logitem->tls_type_cypher[tlen] = '/';
   /* includes terminating null */
@@ -1416,13 +1472,13 @@ gen_geolocation_key (GKeyData *kdata, GLogItem *logitem) {
     return 1;
 
   if (country[0] != '\0')
-    logitem->country = xstrdup (country);
+    logitem->country = logitem_strdup (logitem, country);
 
   if (continent[0] != '\0')
-    logitem->continent = xstrdup (continent);
+    logitem->continent = logitem_strdup (logitem, continent);
 
   if (city[0] != '\0')
-    logitem->city = xstrdup (city);
+    logitem->city = logitem_strdup (logitem, city);
 
   /* Record the country-to-continent mapping for holder construction */
   if (logitem->country && logitem->continent)
@@ -1460,7 +1516,7 @@ gen_asn_key (GKeyData *kdata, GLogItem *logitem) {
   geoip_asn (logitem->host, asn);
 
   if (asn[0] != '\0')
-    logitem->asn = xstrdup (asn);
+    logitem->asn = logitem_strdup (logitem, asn);
 
   get_kdata (kdata, logitem->asn, logitem->asn);
   kdata->numdate = logitem->numdate;
@@ -1570,7 +1626,7 @@ set_datamap (GLogItem *logitem, GKeyData *kdata, const GParse *parse) {
   if (parse->hits)
     parse->hits (module, kdata);
   /* insert visitors */
-  if (parse->visitor && kdata->uniq_nkey == 1)
+  if (parse->visitor && kdata->uniq_nkey > 0)
     parse->visitor (module, kdata);
   /* insert bandwidth */
   if (parse->bw)
@@ -1608,17 +1664,21 @@ map_log (GLogItem *logitem, const GParse *parse, GModule module) {
 
   /* each module contains a uniq visitor key/value; when the data key derives
    * solely from the visitor key, a visitor is new to this module exactly when
-   * this is their first counted request, so no uniqmap entry is needed */
+   * this is their first counted request, so no uniqmap entry is needed.
+   * In approximate mode, the data key sketch tells by how much the estimate
+   * moved instead */
   if (parse->visitor && logitem->uniq_key && include_uniq (logitem)) {
-    if (is_vkey_data (parse))
+    if (conf.approx_visitors)
+      kdata.uniq_nkey = insert_sketch (module, &kdata, logitem->uniq_key);
+    else if (is_vkey_data (parse))
       kdata.uniq_nkey = logitem->uniq_first;
     else
       kdata.uniq_nkey = insert_uniqmap (module, &kdata, logitem->uniq_nkey);
 
     /* the per-date visitors counter is authoritative for the overall total
      * and advances exactly when the VISITORS panel counts a visitor */
-    if (module == VISITORS && kdata.uniq_nkey == 1)
-      ht_inc_cnt_visitors (kdata.numdate);
+    if (module == VISITORS && kdata.uniq_nkey > 0)
+      ht_inc_cnt_visitors (kdata.numdate, kdata.uniq_nkey);
   }
 
   /* root keys are optional */
@@ -1632,7 +1692,7 @@ map_log (GLogItem *logitem, const GParse *parse, GModule module) {
 
 static void
 ins_agent_key_val (GLogItem *logitem, uint32_t numdate) {
-  logitem->agent_nkey = ht_insert_agent_key (numdate, logitem->agent_hash);
+  logitem->agent_nkey = ht_insert_agent_key (numdate, logitem->agent_hash, logitem->agent);
   /* insert UA key and get a numeric value */
   if (logitem->agent_nkey != 0) {
     /* insert a numeric key and map it to a UA string */
@@ -1665,11 +1725,9 @@ clean_old_data_by_date (uint32_t numdate) {
     return -1;
   }
 
-  /* invalidate the first date we inserted then */
+  /* evict the first date we inserted then, new data is added upon the
+   * remaining cache */
   invalidate_date (dates[0]);
-  /* rebuild all existing dates and let new data
-   * be added upon existing cache */
-  rebuild_rawdata_cache ();
   free (dates);
 
   return 0;
@@ -1683,20 +1741,28 @@ process_log (GLogItem *logitem) {
   const GParse *parse = NULL;
   size_t idx = 0;
   uint32_t numdate = logitem->numdate;
+  uint64_t start = 0;
+  int ret = 0, sample = stat_sample ();
 
   if (conf.keep_last > 0 && clean_old_data_by_date (numdate) == -1)
     return;
 
   /* insert date and start partitioning tables */
-  if (ht_insert_date (numdate) == -1)
+  if ((ret = ht_insert_date (numdate)) == -1)
     return;
+  /* a new date partition, make room for it within the memory budget */
+  if (ret == 0 && conf.mem_limit)
+    spill_cold_dates (numdate);
 
   /* Insert one unique visitor key per request to avoid the
-   * overhead of storing one key per module */
-  logitem->uniq_nkey =
-    ht_insert_unique_key (numdate, logitem->uniq_key, include_uniq (logitem), &logitem->uniq_first);
-  if (logitem->uniq_nkey == 0)
-    return;
+   * overhead of storing one key per module. Sketches need no such key */
+  if (!conf.approx_visitors) {
+    logitem->uniq_nkey =
+      ht_insert_unique_key (numdate, logitem->uniq_key, include_uniq (logitem),
+                            &logitem->uniq_first);
+    if (logitem->uniq_nkey == 0)
+      return;
+  }
 
   /* If we need to store user agents per IP, then we store them and retrieve
    * its numeric key.
@@ -1709,7 +1775,11 @@ process_log (GLogItem *logitem) {
     module = module_list[idx];
     if (!(parse = panel_lookup (module)))
       continue;
+    if (sample)
+      start = stat_now ();
     map_log (logitem, parse, module);
+    if (sample)
+      stat_time_module (module, start);
   }
 
   count_bw (numdate, logitem->resp_size);
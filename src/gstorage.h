@@ -35,7 +35,7 @@
 
 #define DB_PATH "/tmp"
 
-#define GAMTRC_TOTAL 9
+#define GAMTRC_TOTAL 10
 /* Enumerated App Metrics */
 typedef enum GAMetric_ {
   MTRC_DATES,
@@ -47,6 +47,7 @@ typedef enum GAMetric_ {
   MTRC_METH_PROTO,
   MTRC_DB_PROPS,
   MTRC_COUNTRY_CONTINENT,
+  MTRC_HOSTNAMES_TS,
 } GAMetric;
 
 /* Enumerated Storage Metrics */
@@ -73,10 +74,12 @@ typedef enum GSMetricType_ {
   MTRC_TYPE_U648,
   /* uint64_t key - GLastParse val */
   MTRC_TYPE_IGLP,
-  /* uint32_t key - GKMetricVals val */
+  /* uint32_t key - GKMetricCols row */
   MTRC_TYPE_IMTV,
   /* uint64_t key - uint32_t val */
   MTRC_TYPE_U6432,
+  /* uint32_t key - GHLL val */
+  MTRC_TYPE_IHLL,
 } GSMetricType;
 
 /* Marks which zero-representable numeric metrics have been written for a data
@@ -91,21 +94,6 @@ typedef enum GSMetricType_ {
  * instead of a per-module uniqmap entry. */
 #define VISITOR_COUNTED_BIT 0x80000000u
 
-/* Aggregated numeric metrics for a data key within a module/date store. All
- * per-data-key numeric metrics live in a single MTRC_METRICS table entry
- * instead of one hash table per metric. */
-typedef struct GKMetricVals_ {
-  uint64_t bw;
-  uint64_t cumts;
-  uint64_t maxts;
-  uint32_t hits;
-  uint32_t visitors;
-  uint32_t root;
-  uint8_t meth;
-  uint8_t proto;
-  uint8_t touched;
-} GKMetricVals;
-
 typedef struct GKHashMetric_ {
   union {
     GSMetric storem;
@@ -125,17 +113,17 @@ typedef struct GKHashMetric_ {
  * date, IP and user agent */
 typedef struct GKeyData_ {
   const void *data;
-  uint32_t dhash;
+  uint64_t dhash;
   uint32_t data_nkey;
   uint32_t cdnkey;              /* cache data nkey */
 
-  uint32_t rhash;
+  uint64_t rhash;
   const void *root;
   const void *root_key;
   uint32_t root_nkey;
   uint32_t crnkey;              /* cache root nkey */
 
-  uint32_t uniq_nkey;
+  uint32_t uniq_nkey;           /* visitors to add to the data key */
 
   uint32_t numdate;
 } GKeyData;
@@ -180,6 +168,7 @@ const char *get_mtr_str (GSMetric metric);
 int excluded_ip (GLogItem * logitem);
 int module_vkey_data (GModule module);
 uint32_t *i322ptr (uint32_t val);
+uint64_t gen_data_key_hash (GModule module, const char *data, const char *method, const char *protocol);
 uint64_t *uint642ptr (uint64_t val);
 void count_process_and_invalid (GLog * glog, GLogItem * logitem, const char *line);
 void count_process (GLog * glog);
@@ -0,0 +1,261 @@
+/**
+ * gwatch.c -- wakes log following up as data is appended
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "gwatch.h"
+
+#include "error.h"
+#include "xmalloc.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+/* Get the directory of the given log.
+ *
+ * On success, the newly allocated directory is returned. */
+static char *
+get_log_dir (const char *filename) {
+  const char *slash = strrchr (filename, '/');
+  char *dir = NULL;
+
+  if (slash == NULL)
+    return xstrdup (".");
+  if (slash == filename)
+    return xstrdup ("/");
+
+  dir = xmalloc (slash - filename + 1);
+  memcpy (dir, filename, slash - filename);
+  dir[slash - filename] = '\0';
+
+  return dir;
+}
+
+/* Get the file name of the given log, i.e., past its directory. */
+static const char *
+get_log_basename (const char *filename) {
+  const char *slash = strrchr (filename, '/');
+
+  return slash ? slash + 1 : filename;
+}
+
+/* Watch the given log file. A truncated log is reported as modified too. */
+static int
+add_log_watch (GWatch *watch, const char *filename) {
+  return inotify_add_watch (watch->fd, filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+}
+
+/* Set up the watches of the given log, i.e., on the file and on its
+ * directory to catch the log being rotated.
+ *
+ * If the log can't be watched, it is polled instead. */
+static void
+watch_log (GWatch *watch, GLog *glog, int idx) {
+  const char *fn = glog->props.filename;
+  char *dir = NULL;
+
+  watch->wd[idx] = watch->dwd[idx] = WATCH_POLLED;
+  /* a piped log is read on every wait */
+  if (glog->piping || (fn[0] == '-' && fn[1] == '\0'))
+    return;
+
+  dir = get_log_dir (fn);
+  if ((watch->dwd[idx] = inotify_add_watch (watch->fd, dir, IN_CREATE | IN_MOVED_TO)) == -1 ||
+      (watch->wd[idx] = add_log_watch (watch, fn)) == -1) {
+    LOG_DEBUG (("Unable to watch %s, polling it: %s\n", fn, strerror (errno)));
+    watch->wd[idx] = WATCH_POLLED;
+  }
+  free (dir);
+}
+
+/* Apply the given inotify event to the logs it refers to. */
+static void
+handle_event (GWatch *watch, Logs *logs, const struct inotify_event *ev) {
+  const char *fn = NULL;
+  int i;
+
+  /* events were dropped, all logs may have changed */
+  if (ev->wd == -1 && (ev->mask & IN_Q_OVERFLOW)) {
+    for (i = 0; i < watch->size; ++i)
+      watch->ready[i] = watch->wd[i] != WATCH_GONE;
+    return;
+  }
+
+  for (i = 0; i < watch->size; ++i) {
+    fn = logs->glog[i].props.filename;
+    if (ev->wd == watch->wd[i]) {
+      if (ev->mask & IN_MODIFY)
+        watch->ready[i] = 1;
+      /* rotated or removed, follow the log to be created under its name */
+      if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+        if (!(ev->mask & IN_IGNORED))
+          inotify_rm_watch (watch->fd, watch->wd[i]);
+        watch->wd[i] = WATCH_GONE;
+      }
+    } else if (ev->wd == watch->dwd[i] && ev->len > 0 &&
+               (ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+               strcmp (ev->name, get_log_basename (fn)) == 0) {
+      if (watch->wd[i] >= 0)
+        inotify_rm_watch (watch->fd, watch->wd[i]);
+      if ((watch->wd[i] = add_log_watch (watch, fn)) == -1)
+        watch->wd[i] = WATCH_POLLED;
+      watch->ready[i] = 1;
+    }
+  }
+}
+
+/* Read and apply all pending inotify events. */
+static void
+read_events (GWatch *watch, Logs *logs) {
+  char buf[4096] __attribute__((aligned (__alignof__ (struct inotify_event))));
+  const struct inotify_event *ev = NULL;
+  ssize_t len = 0;
+  char *ptr = NULL;
+
+  while ((len = read (watch->fd, buf, sizeof (buf))) > 0) {
+    for (ptr = buf; ptr < buf + len; ptr += sizeof (struct inotify_event) + ev->len) {
+      ev = (const struct inotify_event *) ptr;
+      handle_event (watch, logs, ev);
+    }
+  }
+}
+#endif
+
+/* Instantiate a new watch for the given logs.
+ *
+ * On success, the newly allocated watch is returned. */
+GWatch *
+new_gwatch (Logs *logs) {
+  GWatch *watch = xcalloc (1, sizeof (GWatch));
+  int i;
+
+  watch->size = logs->size;
+  watch->wd = xcalloc (logs->size, sizeof (int));
+  watch->dwd = xcalloc (logs->size, sizeof (int));
+  watch->ready = xcalloc (logs->size, sizeof (uint8_t));
+
+  watch->fd = -1;
+#ifdef HAVE_SYS_INOTIFY_H
+  if ((watch->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC)) == -1)
+    LOG_DEBUG (("Unable to initialize inotify, polling logs: %s\n", strerror (errno)));
+#endif
+
+  for (i = 0; i < logs->size; ++i) {
+    watch->wd[i] = watch->dwd[i] = WATCH_POLLED;
+#ifdef HAVE_SYS_INOTIFY_H
+    if (watch->fd != -1)
+      watch_log (watch, &logs->glog[i], i);
+#endif
+    /* data may have been appended since the initial parse */
+    watch->ready[i] = 1;
+  }
+
+  return watch;
+}
+
+/* Flag the given log to be read on the next wait regardless of events,
+ * e.g., if it wasn't read to its end. */
+void
+set_gwatch_ready (GWatch *watch, int idx) {
+  watch->ready[idx] = 1;
+}
+
+/* Determine if the given log may have data appended and clear it.
+ *
+ * If so, 1 is returned, else 0. */
+int
+is_gwatch_ready (GWatch *watch, int idx) {
+  int ready = watch->ready[idx];
+
+  watch->ready[idx] = 0;
+  return ready;
+}
+
+/* Wait up to timeout milliseconds for data to be appended to any of the
+ * logs. It returns right away if a log is still flagged as ready. Polled
+ * logs are flagged on every wait.
+ *
+ * On success, the number of logs ready is returned. */
+int
+wait_gwatch (GWatch *watch, Logs *logs, int timeout) {
+  struct timespec ts = {.tv_sec = timeout / 1000,.tv_nsec = (timeout % 1000) * 1000000L };
+  int i, ready = 0;
+
+  for (i = 0; i < watch->size; ++i)
+    ready |= watch->ready[i];
+
+  if (watch->fd == -1) {
+    if (!ready && nanosleep (&ts, NULL) == -1 && errno != EINTR)
+      FATAL ("nanosleep: %s", strerror (errno));
+  }
+#ifdef HAVE_SYS_INOTIFY_H
+  else {
+    struct pollfd pfd = {.fd = watch->fd,.events = POLLIN };
+
+    if (poll (&pfd, 1, ready ? 0 : timeout) == -1 && errno != EINTR)
+      FATAL ("poll: %s", strerror (errno));
+    if (pfd.revents & POLLIN)
+      read_events (watch, logs);
+  }
+#endif
+
+  for (i = 0, ready = 0; i < watch->size; ++i) {
+    if (watch->wd[i] == WATCH_POLLED)
+      watch->ready[i] = 1;
+    ready += watch->ready[i];
+  }
+
+  return ready;
+}
+
+/* Free the watch and close its inotify instance. */
+void
+free_gwatch (GWatch *watch) {
+  if (watch == NULL)
+    return;
+
+  if (watch->fd != -1)
+    close (watch->fd);
+  free (watch->wd);
+  free (watch->dwd);
+  free (watch->ready);
+  free (watch);
+}
@@ -0,0 +1,56 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2026 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GWATCH_H_INCLUDED
+#define GWATCH_H_INCLUDED
+
+#include <stdint.h>
+
+#include "parser.h"
+
+#define WATCH_POLLED -1         /* log is polled on every wait */
+#define WATCH_GONE   -2         /* log was moved away, waiting for a new one */
+
+/* Logs being followed. Each log is watched through inotify(7) when
+ * available, otherwise it is polled on every wait. */
+typedef struct GWatch_ {
+  int fd;                       /* inotify instance, -1 if unavailable */
+  int size;                     /* num of logs */
+  int *wd;                      /* per log watch on the file or WATCH_* */
+  int *dwd;                     /* per log watch on its directory */
+  uint8_t *ready;               /* per log, data may have been appended */
+} GWatch;
+
+GWatch *new_gwatch (Logs * logs);
+int is_gwatch_ready (GWatch * watch, int idx);
+int wait_gwatch (GWatch * watch, Logs * logs, int timeout);
+void free_gwatch (GWatch * watch);
+void set_gwatch_ready (GWatch * watch, int idx);
+
+#endif // for #ifndef GWATCH_H
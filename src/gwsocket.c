@@ -40,6 +40,7 @@
 #include "commons.h"
 #include "error.h"
 #include "goaccess.h"
+#include "gstats.h"
 #include "json.h"
 #include "settings.h"
 #include "websocket.h"
@@ -124,6 +125,8 @@ broadcast_holder (int fd, const char *buf, int len) {
   write_holder (fd, p, sizeof (uint32_t) * 3);
   write_holder (fd, buf, len);
   free (p);
+  stat_count (STAT_WS_BYTES, len);
+  stat_count (STAT_WS_MESSAGES, 1);
 
   return 0;
 }
@@ -146,6 +149,8 @@ send_holder_to_client (int fd, int listener, const char *buf, int len) {
   write_holder (fd, p, sizeof (uint32_t) * 3);
   write_holder (fd, buf, len);
   free (p);
+  stat_count (STAT_WS_BYTES, len);
+  stat_count (STAT_WS_MESSAGES, 1);
 
   return 0;
 }
@@ -237,6 +242,19 @@ onopen (WSPipeOut *pipeout, WSClient *client) {
   ws_write_fifo (pipeout, client->remote_ip, INET6_ADDRSTRLEN);
   free (hdr);
 
+  stat_count (STAT_WS_CONNECTIONS, 1);
+  stat_add_clients (1);
+
+  return 0;
+}
+
+/* Callback once a connection is closed. Only clients that completed the
+ * handshake were accounted for by onopen(). */
+static int
+onclose (WSPipeOut GO_UNUSED (*pipeout), WSClient *client) {
+  if (client->headers && !client->headers->reading)
+    stat_add_clients (-1);
+
   return 0;
 }
 
@@ -414,6 +432,7 @@ start_server (void *ptr_data) {
   GWSWriter *writer = (GWSWriter *) ptr_data;
 
   writer->server->onopen = onopen;
+  writer->server->onclose = onclose;
 #ifdef HAVE_LIBSSL
   if (conf.ws_auth_secret)
     writer->server->onmessage = onmessage;
@@ -45,6 +45,7 @@
 
 #include "error.h"
 #include "gkhash.h"
+#include "gstats.h"
 #include "settings.h"
 #include "ui.h"
 #include "dialogs.h"
@@ -131,6 +132,70 @@ free_json (GJSON *json) {
   free (json);
 }
 
+/* Copy out of the storage the summary and the panel metadata a report is
+ * built from.
+ *
+ * Note: the caller must hold the gdns_thread.mutex if the storage may
+ * change meanwhile. */
+void
+set_json_snapshot (GJSONSnapshot *snap) {
+  GJSONModMeta *meta = NULL;
+  GModule module;
+  size_t idx = 0;
+  uint32_t min32 = 0, max32 = 0;
+
+  memset (snap, 0, sizeof (*snap));
+  snap->processed = ht_get_processed ();
+  snap->valid = ht_sum_valid ();
+  snap->invalid = ht_get_invalid ();
+  snap->processing_time = ht_get_processing_time ();
+  snap->visitors = ht_sum_uniq_visitors ();
+  snap->files = ht_get_size_datamap (REQUESTS);
+  snap->static_files = ht_get_size_datamap (REQUESTS_STATIC);
+  snap->not_found = ht_get_size_datamap (NOT_FOUND);
+  snap->referrers = ht_get_size_datamap (REFERRERS);
+  snap->excluded = ht_get_excluded_ips ();
+  snap->bandwidth = ht_sum_bw ();
+
+  if (ht_get_size_dates () > 0)
+    get_start_end_parsing_dates (&snap->start_date, &snap->end_date, "%d/%b/%Y");
+
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    meta = &snap->meta[module];
+
+    min32 = max32 = 0;
+    meta->hits.total = ht_get_meta_data (module, "hits");
+    ht_get_hits_min_max (module, &min32, &max32);
+    meta->hits.min = min32, meta->hits.max = max32;
+
+    min32 = max32 = 0;
+    meta->visitors.total = ht_get_meta_data (module, "visitors");
+    ht_get_visitors_min_max (module, &min32, &max32);
+    meta->visitors.min = min32, meta->visitors.max = max32;
+
+    if (conf.bandwidth) {
+      meta->bytes.total = ht_get_meta_data (module, "bytes");
+      ht_get_bw_min_max (module, &meta->bytes.min, &meta->bytes.max);
+    }
+
+    if (conf.serve_usecs) {
+      meta->cumts.total = ht_get_meta_data (module, "cumts");
+      ht_get_cumts_min_max (module, &meta->cumts.min, &meta->cumts.max);
+      meta->maxts.total = ht_get_meta_data (module, "maxts");
+      ht_get_maxts_min_max (module, &meta->maxts.min, &meta->maxts.max);
+    }
+  }
+}
+
+/* Free malloc'd GJSONSnapshot resources. */
+void
+free_json_snapshot (GJSONSnapshot *snap) {
+  free (snap->start_date);
+  free (snap->end_date);
+  snap->start_date = snap->end_date = NULL;
+}
+
 /* Set number of new lines when --json-pretty-print is used. */
 void
 set_json_nlines (int newline) {
@@ -442,84 +507,79 @@ poverall_datetime (GJSON *json, int sp) {
 /* Write to a buffer the date and time for the overall object. */
 static void
 poverall_start_end_date (GJSON *json, GHolder *h, int sp) {
-  char *start = NULL, *end = NULL;
-
-  if (h->idx == 0 || get_start_end_parsing_dates (&start, &end, "%d/%b/%Y"))
+  if (h->idx == 0 || json->snap->start_date == NULL)
     return;
 
-  pskeysval (json, OVERALL_STARTDATE, start, sp, 0);
-  pskeysval (json, OVERALL_ENDDATE, end, sp, 0);
-
-  free (end);
-  free (start);
+  pskeysval (json, OVERALL_STARTDATE, json->snap->start_date, sp, 0);
+  pskeysval (json, OVERALL_ENDDATE, json->snap->end_date, sp, 0);
 }
 
 /* Write to a buffer date and time for the overall object. */
 static void
 poverall_requests (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_REQ, ht_get_processed (), sp, 0);
+  pskeyu64val (json, OVERALL_REQ, json->snap->processed, sp, 0);
 }
 
 /* Write to a buffer the number of valid requests under the overall
  * object. */
 static void
 poverall_valid_reqs (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_VALID, ht_sum_valid (), sp, 0);
+  pskeyu64val (json, OVERALL_VALID, json->snap->valid, sp, 0);
 }
 
 /* Write to a buffer the number of invalid requests under the overall
  * object. */
 static void
 poverall_invalid_reqs (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_FAILED, ht_get_invalid (), sp, 0);
+  pskeyu64val (json, OVERALL_FAILED, json->snap->invalid, sp, 0);
 }
 
 /* Write to a buffer the total processed time under the overall
  * object. */
 static void
 poverall_processed_time (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_GENTIME, ht_get_processing_time (), sp, 0);
+  pskeyu64val (json, OVERALL_GENTIME, json->snap->processing_time, sp, 0);
 }
 
 /* Write to a buffer the total number of unique visitors under the
  * overall object. */
 static void
 poverall_visitors (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_VISITORS, ht_sum_uniq_visitors (), sp, 0);
+  pskeyu64val (json, OVERALL_VISITORS, json->snap->visitors, sp, 0);
 }
 
 /* Write to a buffer the total number of unique files under the
  * overall object. */
 static void
 poverall_files (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_FILES, ht_get_size_datamap (REQUESTS), sp, 0);
+  pskeyu64val (json, OVERALL_FILES, json->snap->files, sp, 0);
 }
 
 /* Write to a buffer the total number of excluded requests under the
  * overall object. */
 static void
 poverall_excluded (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_EXCL_HITS, ht_get_excluded_ips (), sp, 0);
+  pskeyu64val (json, OVERALL_EXCL_HITS, json->snap->excluded, sp, 0);
 }
 
 /* Write to a buffer the number of referrers under the overall object. */
 static void
 poverall_refs (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_REF, ht_get_size_datamap (REFERRERS), sp, 0);
+  pskeyu64val (json, OVERALL_REF, json->snap->referrers, sp, 0);
 }
 
 /* Write to a buffer the number of not found (404s) under the overall
  * object. */
 static void
 poverall_notfound (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_NOTFOUND, ht_get_size_datamap (NOT_FOUND), sp, 0);
+  pskeyu64val (json, OVERALL_NOTFOUND, json->snap->not_found, sp, 0);
 }
 
 /* Write to a buffer the number of static files (jpg, pdf, etc) under
  * the overall object. */
 static void
 poverall_static_files (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_STATIC, ht_get_size_datamap (REQUESTS_STATIC), sp, 0);
+  pskeyu64val (json, OVERALL_STATIC, json->snap->static_files, sp, 0);
 }
 
 /* Write to a buffer the size of the log being parsed under the
@@ -534,7 +594,7 @@ poverall_log_size (GJSON *json, int sp) {
  * object. */
 static void
 poverall_bandwidth (GJSON *json, int sp) {
-  pskeyu64val (json, OVERALL_BANDWIDTH, ht_sum_bw (), sp, 0);
+  pskeyu64val (json, OVERALL_BANDWIDTH, json->snap->bandwidth, sp, 0);
 }
 
 static void
@@ -659,58 +719,18 @@ pprotocol (GJSON *json, GMetrics *nmetrics, int sp) {
   }
 }
 
+/* Write to a buffer the total, average, maximum and minimum of a panel's
+ * metric. */
 static void
-pmeta_i64_data (GJSON *json, GHolder *h, void (*cb) (GModule, uint64_t *, uint64_t *),
-                const char *key, int show_perc, int sp) {
+pmeta_num_data (GJSON *json, GHolder *h, const GJSONMeta *meta, int show_perc, int sp) {
   int isp = 0;
-  uint64_t max = 0, min = 0, total = ht_get_meta_data (h->module, key);
+  uint64_t max = meta->max, min = meta->min, total = meta->total;
   float avg = (total == 0 ? 0 : (((float) total) / h->ht_size));
 
   /* use tabs to prettify output */
   if (conf.json_pretty_print)
     isp = sp + 1;
 
-  cb (h->module, &min, &max);
-
-  popen_obj_attr (json, "total", sp);
-  pskeyu64val (json, "value", total, isp, 1);
-  pclose_obj (json, sp, 0);
-
-  popen_obj_attr (json, "avg", sp);
-  pskeyu64val (json, "value", avg, isp, !show_perc);
-  if (show_perc) {
-    pskeyfval (json, "percent", get_percentage (total, avg), isp, 1);
-  }
-  pclose_obj (json, sp, 0);
-
-  popen_obj_attr (json, "max", sp);
-  pskeyu64val (json, "value", max, isp, !show_perc);
-  if (show_perc) {
-    pskeyfval (json, "percent", get_percentage (total, max), isp, 1);
-  }
-  pclose_obj (json, sp, 0);
-
-  popen_obj_attr (json, "min", sp);
-  pskeyu64val (json, "value", min, isp, !show_perc);
-  if (show_perc) {
-    pskeyfval (json, "percent", get_percentage (total, min), isp, 1);
-  }
-  pclose_obj (json, sp, 1);
-}
-
-static void
-pmeta_i32_data (GJSON *json, GHolder *h, void (*cb) (GModule, uint32_t *, uint32_t *),
-                const char *key, int show_perc, int sp) {
-  int isp = 0;
-  uint32_t max = 0, min = 0, total = ht_get_meta_data (h->module, key);
-  float avg = (total == 0 ? 0 : (((float) total) / h->ht_size));
-
-  /* use tabs to prettify output */
-  if (conf.json_pretty_print)
-    isp = sp + 1;
-
-  cb (h->module, &min, &max);
-
   popen_obj_attr (json, "total", sp);
   pskeyu64val (json, "value", total, isp, 1);
   pclose_obj (json, sp, 0);
@@ -765,7 +785,7 @@ pmeta_data_hits (GJSON *json, GHolder *h, int sp) {
     isp = sp + 1;
 
   popen_obj_attr (json, "hits", sp);
-  pmeta_i32_data (json, h, ht_get_hits_min_max, "hits", 1, isp);
+  pmeta_num_data (json, h, &json->snap->meta[h->module].hits, 1, isp);
   pclose_obj (json, sp, 0);
 }
 
@@ -779,7 +799,7 @@ pmeta_data_visitors (GJSON *json, GHolder *h, int sp) {
     isp = sp + 1;
 
   popen_obj_attr (json, "visitors", sp);
-  pmeta_i32_data (json, h, ht_get_visitors_min_max, "visitors", 1, isp);
+  pmeta_num_data (json, h, &json->snap->meta[h->module].visitors, 1, isp);
   pclose_obj (json, sp, 0);
 }
 
@@ -795,7 +815,7 @@ pmeta_data_bw (GJSON *json, GHolder *h, int sp) {
     isp = sp + 1;
 
   popen_obj_attr (json, "bytes", sp);
-  pmeta_i64_data (json, h, ht_get_bw_min_max, "bytes", 1, isp);
+  pmeta_num_data (json, h, &json->snap->meta[h->module].bytes, 1, isp);
   pclose_obj (json, sp, 0);
 }
 
@@ -813,8 +833,8 @@ pmeta_data_avgts (GJSON *json, GHolder *h, int sp) {
   if (conf.json_pretty_print)
     isp = sp + 1;
 
-  cumts = ht_get_meta_data (h->module, "cumts");
-  hits = ht_get_meta_data (h->module, "hits");
+  cumts = json->snap->meta[h->module].cumts.total;
+  hits = json->snap->meta[h->module].hits.total;
   if (hits > 0)
     avg = cumts / hits;
 
@@ -840,7 +860,7 @@ pmeta_data_cumts (GJSON *json, GHolder *h, int sp) {
     isp = sp + 1;
 
   popen_obj_attr (json, "cumts", sp);
-  pmeta_i64_data (json, h, ht_get_cumts_min_max, "cumts", 0, isp);
+  pmeta_num_data (json, h, &json->snap->meta[h->module].cumts, 0, isp);
   pclose_obj (json, sp, 0);
 }
 
@@ -856,7 +876,7 @@ pmeta_data_maxts (GJSON *json, GHolder *h, int sp) {
     isp = sp + 1;
 
   popen_obj_attr (json, "maxts", sp);
-  pmeta_i64_data (json, h, ht_get_maxts_min_max, "maxts", 0, isp);
+  pmeta_num_data (json, h, &json->snap->meta[h->module].maxts, 0, isp);
   pclose_obj (json, sp, 0);
 }
 
@@ -1075,9 +1095,10 @@ num_panels (void) {
   return npanels;
 }
 
-/* Write to a buffer overall data. */
+/* Write to a buffer overall data. If more is set, further sections
+ * follow it even without panels. */
 static void
-print_json_summary (GJSON *json, GHolder *holder) {
+print_json_summary (GJSON *json, GHolder *holder, int more) {
   int sp = 0, isp = 0;
 
   /* use tabs to prettify output */
@@ -1115,24 +1136,228 @@ print_json_summary (GJSON *json, GHolder *holder) {
   poverall_bandwidth (json, isp);
   /* log path */
   poverall_log (json, isp);
-  pclose_obj (json, sp, num_panels () > 0 ? 0 : 1);
+  pclose_obj (json, sp, num_panels () > 0 || more ? 0 : 1);
+}
+
+/* Write to a buffer the bytes held by a consecutive run of storage
+ * metrics. */
+static void
+pmem_metrics (GJSON *json, const char *attr, const uint64_t *bytes, GSMetric first,
+              size_t n, int sp, int last) {
+  size_t i;
+  int isp = 0;
+
+  /* use tabs to prettify output */
+  if (conf.json_pretty_print)
+    isp = sp + 1;
+
+  popen_obj_attr (json, attr, sp);
+  for (i = 0; i < n; ++i)
+    pskeyu64val (json, get_mtr_str (first + i), bytes[i], isp, i == n - 1);
+  pclose_obj (json, sp, last);
+}
+
+/* Write to a buffer the memory held by a single date store. */
+static void
+pmem_date (GJSON *json, const GKMemDate *mem, int sp, int last) {
+  GModule module;
+  size_t idx = 0, npanels = num_panels (), cnt = 0;
+  int isp = 0;
+
+  /* use tabs to prettify output */
+  if (conf.json_pretty_print)
+    isp = sp + 1;
+
+  popen_obj (json, sp);
+  pskeyu64val (json, "date", mem->date, isp, 0);
+  pskeyu64val (json, "total", mem->total, isp, 0);
+  pskeyu64val (json, "spilled", mem->spilled, isp, 0);
+  pmem_metrics (json, "global", mem->global, MTRC_UNIQUE_KEYS, GLOBAL_METRICS_TOTAL, isp,
+                npanels == 0);
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    pmem_metrics (json, module_to_id (module), mem->module[module], 0, GSMTRC_TOTAL, isp,
+                  ++cnt == npanels);
+  }
+  pclose_obj (json, sp, last);
+}
+
+/* Write to a buffer the memory held by the storage: the string pool, the
+ * app-level tables, the module caches, the per-module metrics summed over
+ * all dates and every date store on its own. */
+static void
+print_json_memory (GJSON *json, int last) {
+  GKMemDate *mem = NULL, sum = { 0 };
+  GModule module;
+  uint64_t strings = ht_mem_strpool (), app = ht_mem_app (), caches = 0, total = 0;
+  uint32_t len = 0, i, j;
+  size_t idx = 0, npanels = num_panels (), cnt = 0;
+  int sp = 0, isp = 0, iisp = 0;
+
+  /* use tabs to prettify output */
+  if (conf.json_pretty_print)
+    sp = 1, isp = 2, iisp = 3;
+
+  mem = ht_mem_dates (&len);
+  for (i = 0; i < len; ++i) {
+    sum.total += mem[i].total;
+    for (j = 0; j < GLOBAL_METRICS_TOTAL; ++j)
+      sum.global[j] += mem[i].global[j];
+    FOREACH_MODULE (idx, module_list) {
+      module = module_list[idx];
+      for (j = 0; j < GSMTRC_TOTAL; ++j)
+        sum.module[module][j] += mem[i].module[module][j];
+    }
+    idx = 0;
+  }
+  idx = 0;
+  FOREACH_MODULE (idx, module_list)
+    caches += ht_mem_cache (module_list[idx]);
+  total = strings + app + caches + sum.total;
+
+  popen_obj_attr (json, "memory", sp);
+  pskeyu64val (json, "total", total, isp, 0);
+  pskeyu64val (json, "strings", strings, isp, 0);
+  pskeyu64val (json, "app", app, isp, 0);
+  pskeyu64val (json, "dates_total", sum.total, isp, 0);
+
+  popen_obj_attr (json, "caches", isp);
+  pskeyu64val (json, "total", caches, iisp, npanels == 0);
+  idx = 0;
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    pskeyu64val (json, module_to_id (module), ht_mem_cache (module), iisp, ++cnt == npanels);
+  }
+  pclose_obj (json, isp, 0);
+
+  popen_obj_attr (json, "modules", isp);
+  pmem_metrics (json, "global", sum.global, MTRC_UNIQUE_KEYS, GLOBAL_METRICS_TOTAL, iisp,
+                npanels == 0);
+  idx = 0, cnt = 0;
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    pmem_metrics (json, module_to_id (module), sum.module[module], 0, GSMTRC_TOTAL, iisp,
+                  ++cnt == npanels);
+  }
+  pclose_obj (json, isp, 0);
+
+  popen_arr_attr (json, "dates", isp);
+  for (i = 0; i < len; ++i)
+    pmem_date (json, &mem[i], iisp, i == len - 1);
+  pclose_arr (json, isp, 1);
+
+  pclose_obj (json, sp, last);
+  free (mem);
+}
+
+/* Write to a buffer the timings of a pipeline stage or module insert,
+ * in microseconds. The histogram counts runs under 1us, then those of
+ * [1,2)us, [2,4)us and so on, up to its last non-empty bucket. */
+static void
+pruntime_timer (GJSON *json, const char *attr, const char *unit, const GStatTimer *timer,
+                int sp, int last) {
+  int isp = 0, i, n = 0;
+
+  /* use tabs to prettify output */
+  if (conf.json_pretty_print)
+    isp = sp + 1;
+
+  for (i = 0; i < STAT_BUCKETS; ++i)
+    if (timer->hist[i])
+      n = i + 1;
+
+  popen_obj_attr (json, attr, sp);
+  if (unit)
+    pskeysval (json, "unit", unit, isp, 0);
+  pskeyu64val (json, "count", timer->count, isp, 0);
+  pskeyu64val (json, "items", timer->items, isp, 0);
+  pskeyu64val (json, "total_us", timer->total / 1000, isp, 0);
+  pskeyu64val (json, "avg_us", timer->count ? timer->total / timer->count / 1000 : 0, isp, 0);
+  pskeyu64val (json, "p50_us", stat_percentile (timer, 50) / 1000, isp, 0);
+  pskeyu64val (json, "p99_us", stat_percentile (timer, 99) / 1000, isp, 0);
+  pskeyu64val (json, "max_us", timer->max / 1000, isp, 0);
+  pjson (json, "%.*s\"hist\": [", isp, TAB);
+  for (i = 0; i < n; ++i)
+    pjson (json, i ? ",%" PRIu64 : "%" PRIu64, timer->hist[i]);
+  pjson (json, "]");
+  pclose_obj (json, sp, last);
+}
+
+/* Write to a buffer the runtime statistics of the processing pipeline:
+ * the timings of every stage, the sampled insert timings of every
+ * panel and the WebSocket traffic. */
+static void
+print_json_runtime (GJSON *json, int last) {
+  GStatTimer ingest, reads, timer;
+  GModule module;
+  GStatStage stage;
+  size_t idx = 0, npanels = num_panels (), cnt = 0;
+  int sp = 0, isp = 0, iisp = 0;
+
+  /* use tabs to prettify output */
+  if (conf.json_pretty_print)
+    sp = 1, isp = 2, iisp = 3;
+
+  stat_get_stage (&ingest, STAT_INGEST);
+  stat_get_stage (&reads, STAT_READ);
+
+  popen_obj_attr (json, "runtime", sp);
+  pskeyu64val (json, "uptime_us", stat_uptime () / 1000, isp, 0);
+  pskeyu64val (json, "bytes", reads.items, isp, 0);
+  pskeyu64val (json, "lines", ingest.items, isp, 0);
+  pskeyu64val (json, "lines_per_sec",
+               ingest.total ? (uint64_t) (ingest.items * 1e9 / ingest.total) : 0, isp, 0);
+
+  popen_obj_attr (json, "stages", isp);
+  for (stage = 0; stage < STAT_STAGES; ++stage) {
+    stat_get_stage (&timer, stage);
+    pruntime_timer (json, stat_stage_str (stage), stat_stage_unit (stage), &timer, iisp,
+                    stage == STAT_STAGES - 1);
+  }
+  pclose_obj (json, isp, 0);
+
+  popen_obj_attr (json, "modules", isp);
+  pskeyu64val (json, "sample_rate", STAT_SAMPLE_RATE, iisp, npanels == 0);
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    stat_get_module (&timer, module);
+    pruntime_timer (json, module_to_id (module), NULL, &timer, iisp, ++cnt == npanels);
+  }
+  pclose_obj (json, isp, 0);
+
+  popen_obj_attr (json, "websocket", isp);
+  pskeyu64val (json, "bytes", stat_get_counter (STAT_WS_BYTES), iisp, 0);
+  pskeyu64val (json, "messages", stat_get_counter (STAT_WS_MESSAGES), iisp, 0);
+  pskeyu64val (json, "connections", stat_get_counter (STAT_WS_CONNECTIONS), iisp, 0);
+  pskeyu64val (json, "clients", stat_get_clients (), iisp, 1);
+  pclose_obj (json, isp, 1);
+
+  pclose_obj (json, sp, last);
 }
 
 /* Iterate over all panels and generate json output. */
 static GJSON *
-init_json_output (GHolder *holder) {
+init_json_output (GHolder *holder, const GJSONSnapshot *snap, int memory, int runtime) {
   GJSON *json = NULL;
   GModule module;
   GPercTotals totals;
   const GPanel *panel = NULL;
   size_t idx = 0, npanels = num_panels (), cnt = 0;
+  uint64_t start = stat_now ();
 
   json = new_gjson ();
+  json->snap = snap;
 
   popen_obj (json, 0);
-  print_json_summary (json, holder);
+  print_json_summary (json, holder, memory || runtime);
+  if (memory)
+    print_json_memory (json, npanels == 0 && !runtime);
+  if (runtime)
+    print_json_runtime (json, npanels == 0);
 
-  set_module_totals (&totals);
+  totals.hits = snap->valid;
+  totals.visitors = snap->visitors;
+  totals.bw = snap->bandwidth;
 
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
@@ -1145,26 +1370,37 @@ init_json_output (GHolder *holder) {
   }
 
   pclose_obj (json, 0, 1);
+  stat_time (STAT_JSON, start, json->offset);
 
   return json;
 }
 
-/* Open and write to a dynamically sized output buffer.
+/* Open and write to a dynamically sized output buffer. The storage
+ * figures are taken from the given snapshot or, if NULL, straight from
+ * the storage.
  *
  * On success, the newly allocated buffer is returned . */
 char *
-get_json (GHolder *holder, int escape_html) {
+get_json (GHolder *holder, const GJSONSnapshot *snap, int escape_html) {
+  GJSONSnapshot own;
   GJSON *json = NULL;
   char *buf = NULL;
 
   if (holder == NULL)
     return NULL;
 
+  if (snap == NULL) {
+    set_json_snapshot (&own);
+    snap = &own;
+  }
+
   escape_html_output = escape_html;
-  if ((json = init_json_output (holder)) && json->size > 0) {
+  if ((json = init_json_output (holder, snap, 0, conf.runtime_stats)) && json->size > 0)
     buf = xstrdup (json->buf);
-    free_json (json);
-  }
+  free_json (json);
+
+  if (snap == &own)
+    free_json_snapshot (&own);
 
   return buf;
 }
@@ -1172,6 +1408,7 @@ get_json (GHolder *holder, int escape_html) {
 /* Entry point to generate a json report writing it to the fp */
 void
 output_json (GHolder *holder, const char *filename) {
+  GJSONSnapshot snap;
   GJSON *json = NULL;
   FILE *fp;
 
@@ -1187,11 +1424,44 @@ output_json (GHolder *holder, const char *filename) {
   if (conf.json_pretty_print)
     nlines = 1;
 
-  /* spit it out */
-  if ((json = init_json_output (holder)) && json->size > 0) {
+  /* spit it out; the memory report only goes to JSON files, the HTML report
+   * and its clients expect panels only */
+  set_json_snapshot (&snap);
+  if ((json = init_json_output (holder, &snap, conf.mem_report > 0, conf.runtime_stats)) &&
+      json->size > 0)
     fprintf (fp, "%s", json->buf);
-    free_json (json);
-  }
+  free_json (json);
+  free_json_snapshot (&snap);
 
   fclose (fp);
 }
+
+/* Write the runtime statistics alone to the given file, or to stderr if
+ * it is "-", e.g., once done processing. */
+void
+output_runtime_json (const char *filename) {
+  GJSON *json = NULL;
+  FILE *fp;
+
+  if (!strcmp (filename, "-"))
+    fp = stderr;
+  else if (!(fp = fopen (filename, "w"))) {
+    LOG_DEBUG (("Unable to open runtime stats file %s: %s\n", filename, strerror (errno)));
+    return;
+  }
+
+  /* use new lines to prettify output */
+  if (conf.json_pretty_print)
+    nlines = 1;
+
+  json = new_gjson ();
+  popen_obj (json, 0);
+  print_json_runtime (json, 1);
+  pclose_obj (json, 0, 1);
+  if (json->size > 0)
+    fprintf (fp, "%s\n", json->buf);
+  free_json (json);
+
+  if (fp != stderr)
+    fclose (fp);
+}
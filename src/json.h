@@ -39,16 +39,55 @@
 
 #include "parser.h"
 
+/* Total, minimum and maximum of a panel's metric. */
+typedef struct GJSONMeta_ {
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+} GJSONMeta;
+
+/* Panel metadata copied out of the storage. */
+typedef struct GJSONModMeta_ {
+  GJSONMeta hits;
+  GJSONMeta visitors;
+  GJSONMeta bytes;
+  GJSONMeta cumts;
+  GJSONMeta maxts;
+} GJSONModMeta;
+
+/* Storage figures a report is built from. They are copied while holding
+ * the storage lock so the report can then be serialized without it. */
+typedef struct GJSONSnapshot_ {
+  uint64_t processed;           /* total requests */
+  uint64_t valid;               /* valid requests */
+  uint64_t invalid;             /* failed requests */
+  uint64_t processing_time;     /* time spent processing */
+  uint64_t visitors;            /* unique visitors */
+  uint64_t files;               /* unique requests */
+  uint64_t static_files;        /* unique static requests */
+  uint64_t not_found;           /* unique not found requests */
+  uint64_t referrers;           /* unique referrers */
+  uint64_t excluded;            /* excluded hits */
+  uint64_t bandwidth;           /* total bytes */
+  char *start_date;             /* first date parsed, if any */
+  char *end_date;               /* last date parsed, if any */
+  GJSONModMeta meta[TOTAL_MODULES];
+} GJSONSnapshot;
+
 typedef struct GJSON_ {
   char *buf;                    /* pointer to buffer */
   size_t size;                  /* size of malloc'd buffer */
   size_t offset;                /* current write offset */
+  const GJSONSnapshot *snap;    /* storage figures being reported */
 } GJSON;
 
-char *get_json (GHolder * holder, int escape_html);
+char *get_json (GHolder * holder, const GJSONSnapshot * snap, int escape_html);
 
 void output_json (GHolder * holder, const char *filename);
+void output_runtime_json (const char *filename);
 void set_json_nlines (int nl);
+void set_json_snapshot (GJSONSnapshot * snap);
+void free_json_snapshot (GJSONSnapshot * snap);
 
 void fpskeyival (FILE * fp, const char *key, int val, int sp, int last);
 void fpskeysval (FILE * fp, const char *key, const char *val, int sp, int last);
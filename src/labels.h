@@ -603,4 +603,26 @@ N_("WebSocket Status: Connected")
 #define HTML_REPORT_WEBSOCKET_STATUS_DISCONNECTED   \
 N_("WebSocket Status: Disconnected")
 
+/* Runtime Stats */
+#define HTML_REPORT_RUNTIME            \
+  N_("Runtime")
+#define HTML_REPORT_RUNTIME_STAGE      \
+  N_("Stage")
+#define HTML_REPORT_RUNTIME_RUNS       \
+  N_("Runs")
+#define HTML_REPORT_RUNTIME_WORK       \
+  N_("Work")
+#define HTML_REPORT_RUNTIME_TOTAL      \
+  N_("Total")
+#define HTML_REPORT_RUNTIME_AVG        \
+  N_("Avg.")
+#define HTML_REPORT_RUNTIME_MAX        \
+  N_("Max.")
+#define HTML_REPORT_RUNTIME_LINES_SEC  \
+  N_("lines/s")
+#define HTML_REPORT_RUNTIME_CLIENTS    \
+  N_("WebSocket clients")
+#define HTML_REPORT_RUNTIME_INSERT     \
+  N_("Insert")
+
 #endif // for #ifndef LABELS_H
@@ -39,6 +39,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #ifdef HAVE_LIBGEOIP
@@ -48,6 +49,7 @@
 #include "options.h"
 
 #include "error.h"
+#include "gdns.h"
 #include "labels.h"
 #include "util.h"
 #include "wsauth.h"
@@ -92,6 +94,7 @@ static const struct option long_opts[] = {
   {"all-static-files"     , no_argument       , 0 , 0  }  ,
   {"anonymize-ip"         , no_argument       , 0 , 0  }  ,
   {"anonymize-level"      , required_argument , 0 , 0  }  ,
+  {"approx-visitors"      , no_argument       , 0 , 0  }  ,
   {"color"                , required_argument , 0 , 0  }  ,
   {"color-scheme"         , required_argument , 0 , 0  }  ,
   {"crawlers-only"        , no_argument       , 0 , 0  }  ,
@@ -101,6 +104,9 @@ static const struct option long_opts[] = {
   {"date-format"          , required_argument , 0 , 0  }  ,
   {"date-spec"            , required_argument , 0 , 0  }  ,
   {"db-path"              , required_argument , 0 , 0  }  ,
+  {"dns-cache-ttl"        , required_argument , 0 , 0  }  ,
+  {"dns-threads"          , required_argument , 0 , 0  }  ,
+  {"dns-timeout"          , required_argument , 0 , 0  }  ,
   {"fname-as-vhost"       , required_argument , 0 , 0  }  ,
   {"dcf"                  , no_argument       , 0 , 0  }  ,
   {"double-decode"        , no_argument       , 0 , 0  }  ,
@@ -121,8 +127,10 @@ static const struct option long_opts[] = {
   {"ignore-status"        , required_argument , 0 , 0  }  ,
   {"invalid-requests"     , required_argument , 0 , 0  }  ,
   {"unknowns-log"         , required_argument , 0 , 0  }  ,
+  {"mem-report"           , required_argument , 0 , 0  }  ,
   {"json-pretty-print"    , no_argument       , 0 , 0  }  ,
   {"keep-last"            , required_argument , 0 , 0  }  ,
+  {"mem-limit"            , required_argument , 0 , 0  }  ,
   {"html-refresh"         , required_argument , 0 , 0  }  ,
   {"log-format"           , required_argument , 0 , 0  }  ,
   {"max-items"            , required_argument , 0 , 0  }  ,
@@ -139,12 +147,16 @@ static const struct option long_opts[] = {
   {"origin"               , required_argument , 0 , 0  }  ,
   {"output-format"        , required_argument , 0 , 0  }  ,
   {"persist"              , no_argument       , 0 , 0  }  ,
+  {"persist-interval"     , required_argument , 0 , 0  }  ,
+  {"persist-wal"          , no_argument       , 0 , 0  }  ,
   {"pid-file"             , required_argument , 0 , 0  }  ,
   {"port"                 , required_argument , 0 , 0  }  ,
   {"process-and-exit"     , no_argument       , 0 , 0  }  ,
   {"real-os"              , no_argument       , 0 , 0  }  ,
   {"real-time-html"       , no_argument       , 0 , 0  }  ,
   {"restore"              , no_argument       , 0 , 0  }  ,
+  {"runtime-stats"        , no_argument       , 0 , 0  }  ,
+  {"runtime-stats-file"   , required_argument , 0 , 0  }  ,
   {"sort-panel"           , required_argument , 0 , 0  }  ,
   {"static-file"          , required_argument , 0 , 0  }  ,
   {"tz"                   , required_argument , 0 , 0  }  ,
@@ -270,7 +282,15 @@ cmd_help (void)
   "                                    logs.\n"
   "  --external-assets               - Output HTML assets to external JS/CSS files.\n"
   "  --invalid-requests=<filename>   - Log invalid requests to the specified file.\n"
+  "  --mem-report=<secs>             - Add a memory usage section to the JSON\n"
+  "                                    output and log it to the debug file every\n"
+  "                                    X seconds in real-time mode.\n"
   "  --no-global-config              - Don't load global configuration file.\n"
+  "  --runtime-stats                 - Add a runtime section with the timings of\n"
+  "                                    each processing stage to the JSON and HTML\n"
+  "                                    output.\n"
+  "  --runtime-stats-file=<filename> - Write the runtime section to the given\n"
+  "                                    file on exit, or '-' for stderr.\n"
   "  --unknowns-log=<filename>       - Log unknown browsers and OSs to the\n"
   "                                    specified file.\n"
   "\n"
@@ -300,6 +320,8 @@ cmd_help (void)
   "                                    report.\n"
   "  --anonymize-level=<1|2|3>       - Anonymization levels: 1 => default, 2 =>\n"
   "                                    strong, 3 => pedantic.\n"
+  "  --approx-visitors               - Estimate unique visitors with HyperLogLog\n"
+  "                                    sketches. ~1%% error, bounded memory.\n"
   "  --chunk-size=<256-32768>        - Number of lines processed in each data chunk\n"
   "                                    for parallel execution. Default is 1024.\n"
   "  --crawlers-only                 - Parse and display only crawlers.\n"
@@ -307,6 +329,12 @@ cmd_help (void)
   "                                    (default), `hr` or `min`.\n"
   "  --db-path=<path>                - Persist data to disk on exit to the given\n"
   "                                    path or /tmp as default.\n"
+  "  --dns-cache-ttl=<days>          - Days to keep persisted hostnames. 0 to not\n"
+  "                                    persist them. Defaults to 7.\n"
+  "  --dns-threads=<1-32>            - Number of threads resolving hostnames.\n"
+  "                                    Defaults to 4.\n"
+  "  --dns-timeout=<secs>            - Give up a hostname lookup after the given\n"
+  "                                    seconds and retry it later.\n"
   "  --double-decode                 - Decode double-encoded values.\n"
   "  --enable-panel=<PANEL>          - Enable parsing/displaying the given panel.\n"
   "  --fname-as-vhost=<regex>        - Use log filename(s) as virtual host(s).\n"
@@ -326,11 +354,17 @@ cmd_help (void)
   "                                    panels.\n"
   "  --ignore-status=<CODE>          - Ignore parsing the given status code.\n"
   "  --keep-last=<NDAYS>             - Keep the last NDAYS in storage.\n"
+  "  --mem-limit=<MiB>               - Spill the oldest dates to --db-path once\n"
+  "                                    the storage exceeds the given size.\n"
   "  --no-ip-validation              - Disable client IPv4/6  validation.\n"
   "  --no-strict-status              - Disable HTTP status code validation.\n"
   "  --num-tests=<number>            - Number of lines to test. >= 0 (10 default)\n"
   "  --persist                       - Persist data to disk on exit to the given\n"
   "                                    --db-path or to /tmp.\n"
+  "  --persist-interval=<minutes>    - Persist data every given number of minutes\n"
+  "                                    while tailing logs in real time.\n"
+  "  --persist-wal                   - Log parsed batches ahead of persisting\n"
+  "                                    them, replayed by --restore.\n"
   "  --process-and-exit              - Parse log and exit without outputting data.\n"
   "  --real-os                       - Display real OS names. e.g, Windows XP,\n"
   "                                    Snow Leopard.\n"
@@ -771,6 +805,10 @@ parse_long_opt (const char *name, const char *oarg) {
   if (!strcmp ("persist", name))
     conf.persist = 1;
 
+  /* write-ahead log parsed batches */
+  if (!strcmp ("persist-wal", name))
+    conf.persist_wal = 1;
+
   /* restore data from disk */
   if (!strcmp ("restore", name))
     conf.restore = 1;
@@ -845,6 +883,23 @@ parse_long_opt (const char *name, const char *oarg) {
     unknowns_log_open (conf.unknowns_log);
   }
 
+  /* memory usage report */
+  if (!strcmp ("mem-report", name)) {
+    char *sEnd;
+    uint64_t secs = strtoull (oarg, &sEnd, 10);
+    if (oarg == sEnd || *sEnd != '\0' || errno == ERANGE)
+      return;
+    conf.mem_report = secs;
+  }
+
+  /* runtime stats */
+  if (!strcmp ("runtime-stats", name))
+    conf.runtime_stats = 1;
+
+  /* runtime stats dumped on exit */
+  if (!strcmp ("runtime-stats-file", name))
+    conf.runtime_stats_file = oarg;
+
   /* output file */
   if (!strcmp ("output-format", name))
     FATAL ("The option --output-format is deprecated, please use --output instead.");
@@ -863,6 +918,10 @@ parse_long_opt (const char *name, const char *oarg) {
   if (!strcmp ("anonymize-ip", name))
     conf.anonymize_ip = 1;
 
+  /* approximate visitors */
+  if (!strcmp ("approx-visitors", name))
+    conf.approx_visitors = 1;
+
   /* anonymization level */
   if (!strcmp ("anonymize-level", name))
     conf.anonymize_level = atoi (oarg);
@@ -895,6 +954,29 @@ parse_long_opt (const char *name, const char *oarg) {
       conf.date_spec_hr = 0;
   }
 
+  /* days to keep persisted hostnames */
+  if (!strcmp ("dns-cache-ttl", name)) {
+    conf.dns_cache_ttl = atoi (oarg);
+    if (conf.dns_cache_ttl < 0)
+      FATAL ("The hard lower limit of --dns-cache-ttl is 0.");
+  }
+
+  /* reverse DNS resolver threads */
+  if (!strcmp ("dns-threads", name)) {
+    conf.dns_threads = atoi (oarg);
+    if (conf.dns_threads < 1)
+      FATAL ("The hard lower limit of --dns-threads is 1.");
+    if (conf.dns_threads > DNS_MAX_THREADS)
+      FATAL ("The hard limit of --dns-threads is %d.", DNS_MAX_THREADS);
+  }
+
+  /* reverse DNS lookup timeout */
+  if (!strcmp ("dns-timeout", name)) {
+    conf.dns_timeout = atoi (oarg);
+    if (conf.dns_timeout < 1)
+      FATAL ("The hard lower limit of --dns-timeout is 1.");
+  }
+
   /* double decode */
   if (!strcmp ("double-decode", name))
     conf.double_decode = 1;
@@ -964,6 +1046,24 @@ parse_long_opt (const char *name, const char *oarg) {
     conf.keep_last = keeplast >= 0 ? keeplast : 0;
   }
 
+  /* storage memory budget in MiB */
+  if (!strcmp ("mem-limit", name)) {
+    char *sEnd;
+    uint64_t limit = strtoull (oarg, &sEnd, 10);
+    if (oarg == sEnd || *sEnd != '\0' || errno == ERANGE)
+      return;
+    conf.mem_limit = limit;
+  }
+
+  /* checkpoint persisted data every X minutes */
+  if (!strcmp ("persist-interval", name)) {
+    char *sEnd;
+    uint64_t interval = strtoull (oarg, &sEnd, 10);
+    if (oarg == sEnd || *sEnd != '\0' || errno == ERANGE)
+      return;
+    conf.persist_interval = interval;
+  }
+
   /* refresh html every X seconds */
   if (!strcmp ("html-refresh", name)) {
     char *sEnd;
@@ -319,6 +319,7 @@ print_html_body (FILE * fp, const char *now)
   "</header>"
   "<aside id='overall' aria-labelledby='overall-heading'></aside>"
   "<main id='panels' aria-labelledby='report-title'></main>"
+  "<article id='runtime' class='hide' aria-labelledby='runtime-heading'></article>"
   "</div>", conf.html_report_title ? conf.html_report_title : "");
   fprintf (fp, "%.*s", tpls_length, tpls);
 }
@@ -509,7 +510,7 @@ static void
 print_json_data (FILE *fp, GHolder *holder) {
   char *json = NULL;
 
-  if ((json = get_json (holder, 1)) == NULL)
+  if ((json = get_json (holder, NULL, 1)) == NULL)
     return;
 
   fprintf (fp, external_assets ? "" : "<script type='text/javascript'>");
@@ -1200,6 +1201,16 @@ print_json_i18n_def (FILE *fp) {
     {"button_settings"          , HTML_REPORT_NAV_BUTTON_SETTINGS}              ,
     {"websocket_connected"      , HTML_REPORT_WEBSOCKET_STATUS_CONNECTED}       ,
     {"websocket_disconnected"   , HTML_REPORT_WEBSOCKET_STATUS_DISCONNECTED}    ,
+    {"runtime"                  , HTML_REPORT_RUNTIME}                          ,
+    {"runtime_stage"            , HTML_REPORT_RUNTIME_STAGE}                    ,
+    {"runtime_runs"             , HTML_REPORT_RUNTIME_RUNS}                     ,
+    {"runtime_work"             , HTML_REPORT_RUNTIME_WORK}                     ,
+    {"runtime_total"            , HTML_REPORT_RUNTIME_TOTAL}                    ,
+    {"runtime_avg"              , HTML_REPORT_RUNTIME_AVG}                      ,
+    {"runtime_max"              , HTML_REPORT_RUNTIME_MAX}                      ,
+    {"runtime_lines_sec"        , HTML_REPORT_RUNTIME_LINES_SEC}                ,
+    {"runtime_clients"          , HTML_REPORT_RUNTIME_CLIENTS}                  ,
+    {"runtime_insert"           , HTML_REPORT_RUNTIME_INSERT}                   ,
   };
   /* *INDENT-ON* */
 
@@ -67,7 +67,9 @@
 #include "browsers.h"
 #include "error.h"
 #include "goaccess.h"
+#include "gstats.h"
 #include "gstorage.h"
+#include "persistence.h"
 #include "util.h"
 #include "websocket.h"
 #include "xmalloc.h"
@@ -254,18 +256,68 @@ free_logs (Logs *logs) {
     if (glog->pipe) {
       fclose (glog->pipe);
     }
+    if (glog->tail)
+      gfile_close (glog->tail);
   }
   free (logs->glog);
   free (logs);
 }
 
-/* Initialize a new GLogItem instance.
+/* Allocate memory for a member of the given logitem. If the logitem
+ * is backed by an arena, memory is carved out of it and released in
+ * one step once its chunk of lines has been processed.
+ *
+ * On success, the allocated memory is returned. */
+void *
+logitem_alloc (GLogItem *logitem, size_t size) {
+  if (logitem->arena)
+    return arena_alloc (logitem->arena, size);
+  return xmalloc (size);
+}
+
+/* Duplicate a string as a member of the given logitem.
+ *
+ * On success, the copied string is returned. */
+char *
+logitem_strdup (GLogItem *logitem, const char *s) {
+  if (logitem->arena)
+    return arena_strdup (logitem->arena, s);
+  return xstrdup (s);
+}
+
+/* Take ownership of a malloc'd string as a member of the given logitem.
+ * If the logitem is backed by an arena, the string is moved into it.
+ *
+ * On success, the string owned by the logitem is returned. */
+char *
+logitem_own (GLogItem *logitem, char *s) {
+  char *p = NULL;
+
+  if (s == NULL || logitem->arena == NULL)
+    return s;
+
+  p = arena_strdup (logitem->arena, s);
+  free (s);
+
+  return p;
+}
+
+/* Release memory allocated through logitem_alloc(). A no-op for
+ * arena-backed logitems. */
+void
+logitem_free (GLogItem *logitem, void *ptr) {
+  if (logitem->arena == NULL)
+    free (ptr);
+}
+
+/* Initialize a new GLogItem instance. If an arena is given, the
+ * logitem and all of its members are allocated from it.
  *
  * On success, the new GLogItem instance is returned. */
 GLogItem *
-init_log_item (GLog *glog) {
+init_log_item (GLog *glog, GArena *arena) {
   GLogItem *logitem;
-  logitem = xmalloc (sizeof (GLogItem));
+  logitem = arena ? arena_alloc (arena, sizeof (GLogItem)) : xmalloc (sizeof (GLogItem));
   memset (logitem, 0, sizeof *logitem);
 
   logitem->agent = NULL;
@@ -305,6 +357,7 @@ init_log_item (GLog *glog) {
 
   memset (logitem->site, 0, sizeof (logitem->site));
   logitem->dt = glog->start_time;
+  logitem->arena = arena;
 
   return logitem;
 }
@@ -315,6 +368,10 @@ free_glog (GLogItem *logitem) {
   if (!logitem)
     return;
 
+  /* released along with the rest of its arena */
+  if (logitem->arena)
+    return;
+
   if (logitem->agent != NULL)
     free (logitem->agent);
   if (logitem->browser != NULL)
@@ -379,13 +436,13 @@ free_glog (GLogItem *logitem) {
  * On success, the decoded trimmed string is assigned to the output
  * buffer. */
 static char *
-decode_url (char *url) {
+decode_url (GLogItem *logitem, char *url) {
   char *out, *decoded;
 
   if ((url == NULL) || (*url == '\0'))
     return NULL;
 
-  out = decoded = xstrdup (url);
+  out = decoded = logitem_strdup (logitem, url);
   decode_hex (url, out, 0);
   /* double encoded URL? */
   if (conf.double_decode)
@@ -402,7 +459,7 @@ decode_url (char *url) {
  * On error, 1 is returned.
  * On success, the extracted keyphrase is assigned and 0 is returned. */
 static int
-extract_keyphrase (char *ref, char **keyphrase) {
+extract_keyphrase (GLogItem *logitem, char *ref, char **keyphrase) {
   char *r, *ptr, *pch, *referer;
   int encoded = 0;
 
@@ -439,9 +496,9 @@ extract_keyphrase (char *ref, char **keyphrase) {
   else if (encoded && (ptr = strstr (r, "%26")) != NULL)
     *ptr = '\0';
 
-  referer = decode_url (r);
+  referer = decode_url (logitem, r);
   if (referer == NULL || *referer == '\0') {
-    free (referer);
+    logitem_free (logitem, referer);
     return 1;
   }
 
@@ -491,41 +548,138 @@ clean:
   return 1;
 }
 
-/* Determine if the given request is static (e.g., jpg, css, js, etc).
+/* Suffix trie of static-file extensions. Built once after the
+ * configuration has been parsed. */
+static GStaticNode *static_trie = NULL;
+static uint32_t static_trie_len = 0;
+static uint32_t static_trie_cap = 0;
+
+/* Append a node to the static-file trie.
  *
- * On error, or if not static, 0 is returned.
- * On success, the 1 is returned. */
-static int
-verify_static_content (const char *req) {
-  const char *nul = NULL;
-  const char *ext = NULL, *pch = NULL;
-  int elen = 0, i;
+ * On success, the index of the new node is returned. */
+static uint32_t
+new_static_node (unsigned char ch, uint16_t depth) {
+  GStaticNode *node = NULL;
+
+  if (static_trie_len == static_trie_cap) {
+    static_trie_cap = static_trie_cap ? static_trie_cap * 2 : 64;
+    static_trie = xrealloc (static_trie, static_trie_cap * sizeof (*static_trie));
+  }
 
-  if ((req == NULL) || (*req == '\0'))
-    return 0;
+  node = &static_trie[static_trie_len];
+  memset (node, 0, sizeof *node);
+  node->ch = ch;
+  node->depth = depth;
 
-  nul = req + strlen (req);
+  return static_trie_len++;
+}
 
+/* Find the child of the given node matching the given byte.
+ *
+ * If not found, 0 is returned.
+ * On success, the index of the child node is returned. */
+static uint32_t
+find_static_child (uint32_t node, unsigned char ch) {
+  uint32_t idx;
+
+  for (idx = static_trie[node].child; idx; idx = static_trie[idx].next)
+    if (static_trie[idx].ch == ch)
+      return idx;
+
+  return 0;
+}
+
+/* Free the static-file trie. */
+void
+free_static_files (void) {
+  free (static_trie);
+  static_trie = NULL;
+  static_trie_len = static_trie_cap = 0;
+}
+
+/* Build a reversed, lowercase suffix trie out of conf.static_files so
+ * a request can be classified by walking its tail only once,
+ * regardless of the number of extensions configured. */
+void
+init_static_files (void) {
+  const char *ext = NULL;
+  uint32_t node = 0, child = 0;
+  size_t len = 0;
+  unsigned char ch;
+  int i;
+
+  free_static_files ();
+  if (conf.static_file_idx == 0)
+    return;
+
+  new_static_node ('\0', 0);
   for (i = 0; i < conf.static_file_idx; ++i) {
     ext = conf.static_files[i];
     if (ext == NULL || *ext == '\0')
       continue;
 
-    elen = strlen (ext);
-    if (conf.all_static_files && (pch = strchr (req, '?')) != NULL && pch - req > elen) {
-      pch -= elen;
-      if (0 == strncasecmp (ext, pch, elen))
-        return 1;
-      continue;
+    node = 0;
+    for (len = strlen (ext); len > 0; --len) {
+      ch = (unsigned char) tolower ((unsigned char) ext[len - 1]);
+      if ((child = find_static_child (node, ch)) == 0) {
+        child = new_static_node (ch, static_trie[node].depth + 1);
+        static_trie[child].next = static_trie[node].child;
+        static_trie[node].child = child;
+      }
+      node = child;
     }
+    static_trie[node].term = 1;
+  }
+}
+
+/* Walk backwards from end towards req and determine if the string ends
+ * with one of the static-file extensions of at least minlen bytes. As
+ * with the original extension scan, at least one byte must precede the
+ * extension.
+ *
+ * If no extension matches, 0 is returned.
+ * On success, 1 is returned. */
+static int
+match_static_suffix (const char *req, const char *end, size_t minlen) {
+  uint32_t node = 0;
+  unsigned char ch;
 
-    if (nul - req > elen && !strncasecmp (nul - elen, ext, elen))
+  while (end > req) {
+    ch = (unsigned char) tolower ((unsigned char) *(end - 1));
+    if ((node = find_static_child (node, ch)) == 0)
+      return 0;
+    if (--end > req && static_trie[node].term && static_trie[node].depth >= minlen)
       return 1;
   }
 
   return 0;
 }
 
+/* Determine if the given request is static (e.g., jpg, css, js, etc).
+ *
+ * With --all-static-files, the extension may also precede the query
+ * string. Extensions longer than the path before the '?' are still
+ * matched against the end of the request.
+ *
+ * On error, or if not static, 0 is returned.
+ * On success, the 1 is returned. */
+static int
+verify_static_content (const char *req) {
+  const char *nul = NULL, *pch = NULL;
+
+  if (static_trie == NULL || (req == NULL) || (*req == '\0'))
+    return 0;
+
+  nul = req + strlen (req);
+  if (conf.all_static_files && (pch = strchr (req, '?')) != NULL) {
+    if (match_static_suffix (req, pch, 0))
+      return 1;
+    return match_static_suffix (req, nul, pch - req);
+  }
+
+  return match_static_suffix (req, nul, 0);
+}
+
 /* Extract the HTTP method.
  *
  * On error, or if not found, NULL is returned.
@@ -581,7 +735,7 @@ extract_protocol (const char *token) {
  * On success, the HTTP request is returned and the method and
  * protocol are assigned to the corresponding buffers. */
 static char *
-parse_req (char *line, char **method, char **protocol) {
+parse_req (GLogItem *logitem, char *line, char **method, char **protocol) {
   char *req = NULL, *request = NULL, *dreq = NULL, *ptr = NULL;
   const char *meth, *proto;
   ptrdiff_t rlen;
@@ -590,43 +744,43 @@ parse_req (char *line, char **method, char **protocol) {
 
   /* couldn't find a method, so use the whole request line */
   if (meth == NULL) {
-    request = xstrdup (line);
+    request = logitem_strdup (logitem, line);
   }
   /* method found, attempt to parse request */
   else {
     req = line + strlen (meth);
     if (!(ptr = strrchr (req, ' ')) || !(proto = extract_protocol (++ptr)))
-      return alloc_string ("-");
+      return logitem_strdup (logitem, "-");
 
     req++;
     if ((rlen = ptr - req) <= 0)
-      return alloc_string ("-");
+      return logitem_strdup (logitem, "-");
 
-    request = xmalloc (rlen + 1);
+    request = logitem_alloc (logitem, rlen + 1);
     strncpy (request, req, rlen);
     request[rlen] = 0;
 
     if (conf.append_method)
-      (*method) = strtoupper (xstrdup (meth));
+      (*method) = strtoupper (logitem_strdup (logitem, meth));
 
     if (conf.append_protocol)
-      (*protocol) = strtoupper (xstrdup (proto));
+      (*protocol) = strtoupper (logitem_strdup (logitem, proto));
   }
 
-  if (!(dreq = decode_url (request)))
+  if (!(dreq = decode_url (logitem, request)))
     return request;
   else if (*dreq == '\0') {
-    free (dreq);
+    logitem_free (logitem, dreq);
     return request;
   }
 
-  free (request);
+  logitem_free (logitem, request);
   return dreq;
 }
 
 #if defined(HAVE_LIBSSL) && defined(HAVE_CIPHER_STD_NAME)
 static int
-extract_tls_version_cipher (char *tkn, char **cipher, char **tls_version) {
+extract_tls_version_cipher (GLogItem *logitem, char *tkn, char **cipher, char **tls_version) {
   SSL_CTX *ctx = NULL;
   SSL *ssl = NULL;
   int code = 0;
@@ -665,17 +819,17 @@ extract_tls_version_cipher (char *tkn, char **cipher, char **tls_version) {
     LOG_DEBUG (("Unable to get cipher standard name to extract TLS."));
     goto fail;
   }
-  *cipher = xstrdup (sn);
-  *tls_version = xstrdup (SSL_CIPHER_get_version (c));
+  *cipher = logitem_strdup (logitem, sn);
+  *tls_version = logitem_strdup (logitem, SSL_CIPHER_get_version (c));
 
-  free (tkn);
+  logitem_free (logitem, tkn);
   SSL_free (ssl);
   SSL_CTX_free (ctx);
 
   return 0;
 
 fail:
-  free (tkn);
+  logitem_free (logitem, tkn);
   if (ssl)
     SSL_free (ssl);
   if (ctx)
@@ -700,15 +854,16 @@ get_delim (char *dest, const char *p) {
   dest[0] = *(p + 1);
 }
 
-/* Extract and malloc a token given the parsed rule.
+/* Extract and malloc a token given the parsed rule. If a logitem is
+ * given, the token is allocated as one of its members.
  *
  * On success, the malloc'd token is returned. */
 static char *
-parsed_string (const char *pch, const char **str, int move_ptr) {
+parsed_string (GLogItem *logitem, const char *pch, const char **str, int move_ptr) {
   char *p;
   size_t len = (pch - *str + 1);
 
-  p = xmalloc (len);
+  p = logitem ? logitem_alloc (logitem, len) : xmalloc (len);
   memcpy (p, *str, (len - 1));
   p[len - 1] = '\0';
   if (move_ptr)
@@ -722,7 +877,7 @@ parsed_string (const char *pch, const char **str, int move_ptr) {
  * On error, or unable to parse it, NULL is returned.
  * On success, the malloc'd token is returned. */
 static char *
-parse_string (const char **str, const char *delims, int cnt) {
+parse_string (GLogItem *logitem, const char **str, const char *delims, int cnt) {
   int idx = 0;
   const char *pch = *str, *p = NULL;
   char end;
@@ -737,7 +892,7 @@ parse_string (const char **str, const char *delims, int cnt) {
       idx++;
     /* delim found, parse string then */
     if ((*pch == end && cnt == idx) || *pch == '\0')
-      return parsed_string (pch, str, 1);
+      return parsed_string (logitem, pch, str, 1);
     /* advance to the first unescaped delim */
     if (*pch == '\\')
       pch++;
@@ -748,7 +903,7 @@ parse_string (const char **str, const char *delims, int cnt) {
 
 char *
 extract_by_delim (const char **str, const char *end) {
-  return parse_string (&(*str), end, 1);
+  return parse_string (NULL, &(*str), end, 1);
 }
 
 /* Move forward through the log string until a non-space (!isspace)
@@ -786,13 +941,13 @@ find_alpha_count (const char *str) {
  * On success, a malloc'd format is returned. */
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
 static int
-set_date (char **fdate, struct tm tm) {
+set_date (GLogItem *logitem, char **fdate, struct tm tm) {
   char buf[DATE_LEN] = "";      /* Ymd */
 
   memset (buf, 0, sizeof (buf));
   if (strftime (buf, DATE_LEN, conf.date_num_format, &tm) <= 0)
     return 1;
-  *fdate = xstrdup (buf);
+  *fdate = logitem_strdup (logitem, buf);
 
   return 0;
 }
@@ -802,13 +957,13 @@ set_date (char **fdate, struct tm tm) {
  * On error, or unable to format the given tm, 1 is returned.
  * On success, a malloc'd format is returned. */
 static int
-set_time (char **ftime, struct tm tm) {
+set_time (GLogItem *logitem, char **ftime, struct tm tm) {
   char buf[TIME_LEN] = "";
 
   memset (buf, 0, sizeof (buf));
   if (strftime (buf, TIME_LEN, "%H:%M:%S", &tm) <= 0)
     return 1;
-  *ftime = xstrdup (buf);
+  *ftime = logitem_strdup (logitem, buf);
 
   return 0;
 }
@@ -826,22 +981,22 @@ spec_err (GLogItem *logitem, int code, const char spec, const char *tkn) {
   switch (code) {
   case ERR_SPEC_TOKN_NUL:
     fmt = "Token for '%%%c' specifier is NULL.";
-    err = xmalloc (snprintf (NULL, 0, fmt, spec) + 1);
+    err = logitem_alloc (logitem, snprintf (NULL, 0, fmt, spec) + 1);
     sprintf (err, fmt, spec);
     break;
   case ERR_SPEC_TOKN_INV:
     fmt = "Token '%s' doesn't match specifier '%%%c'";
-    err = xmalloc (snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
+    err = logitem_alloc (logitem, snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
     sprintf (err, fmt, (tkn ? tkn : "-"), spec);
     break;
   case ERR_SPEC_SFMT_MIS:
     fmt = "Missing braces '%s' and ignore chars for specifier '%%%c'";
-    err = xmalloc (snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
+    err = logitem_alloc (logitem, snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
     sprintf (err, fmt, (tkn ? tkn : "-"), spec);
     break;
   case ERR_SPEC_LINE_INV:
     fmt = "Incompatible format due to early parsed line ending '\\0'.";
-    err = xmalloc (snprintf (NULL, 0, fmt, (tkn ? tkn : "-")) + 1);
+    err = logitem_alloc (logitem, snprintf (NULL, 0, fmt, (tkn ? tkn : "-")) + 1);
     sprintf (err, fmt, (tkn ? tkn : "-"));
     break;
   }
@@ -874,7 +1029,7 @@ set_numeric_date (uint32_t *numdate, const char *date) {
 
 static void
 set_agent_hash (GLogItem *logitem) {
-  logitem->agent_hash = djb2 ((unsigned char *) logitem->agent);
+  logitem->agent_hash = ht_keymap_hash (logitem->agent);
 }
 
 static int
@@ -1005,58 +1160,58 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     if ((fmtspcs = count_matches (dfmt, ' ')) && (pch = strchr (*str, ' ')))
       dspc = find_alpha_count (pch);
 
-    if (!(tkn = parse_string (&(*str), end, MAX (dspc, fmtspcs) + 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, MAX (dspc, fmtspcs) + 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
-    if (str_to_time (tkn, dfmt, &tm, 1) != 0 || set_date (&logitem->date, tm) != 0) {
+    if (str_to_time (tkn, dfmt, &tm, 1) != 0 || set_date (logitem, &logitem->date, tm) != 0) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
 
     set_numeric_date (&logitem->numdate, logitem->date);
     set_tm_dt_logitem (logitem, tm);
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* time */
   case 't':
     if (logitem->time)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
-    if (str_to_time (tkn, tfmt, &tm, 1) != 0 || set_time (&logitem->time, tm) != 0) {
+    if (str_to_time (tkn, tfmt, &tm, 1) != 0 || set_time (logitem, &logitem->time, tm) != 0) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
 
     set_tm_tm_logitem (logitem, tm);
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* date/time as decimal, i.e., timestamps, ms/us  */
   case 'x':
     if (logitem->time && logitem->date)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
-    if (str_to_time (tkn, tfmt, &tm, 1) != 0 || set_date (&logitem->date, tm) != 0 ||
-        set_time (&logitem->time, tm) != 0) {
+    if (str_to_time (tkn, tfmt, &tm, 1) != 0 || set_date (logitem, &logitem->date, tm) != 0 ||
+        set_time (logitem, &logitem->time, tm) != 0) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
     set_numeric_date (&logitem->numdate, logitem->date);
     set_tm_dt_logitem (logitem, tm);
     set_tm_tm_logitem (logitem, tm);
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* Virtual Host */
   case 'v':
     if (logitem->vhost)
       return handle_default_case_token (str, p);
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn == NULL)
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     logitem->vhost = tkn;
@@ -1065,7 +1220,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
   case 'e':
     if (logitem->userid)
       return handle_default_case_token (str, p);
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn == NULL)
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     logitem->userid = tkn;
@@ -1074,13 +1229,13 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
   case 'C':
     if (logitem->cache_status)
       return handle_default_case_token (str, p);
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn == NULL)
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     if (is_cache_hit (tkn))
       logitem->cache_status = tkn;
     else
-      free (tkn);
+      logitem_free (logitem, tkn);
     break;
     /* remote hostname (IP only) */
   case 'h':
@@ -1090,19 +1245,19 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     /* square brackets are possible */
     if (*str[0] == '[' && (*str += 1) && **str)
       end = "]";
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     if (!conf.no_ip_validation && invalid_ipaddr (tkn, &logitem->type_ip)) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
     /* require a valid host token (e.g., ord38s18-in-f14.1e100.net) even when we're
      * not validating the IP */
     if (conf.no_ip_validation && *tkn == '\0') {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
     logitem->host = tkn;
@@ -1111,101 +1266,101 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
   case 'm':
     if (logitem->method)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     {
       const char *meth = NULL;
       if (!(meth = extract_method (tkn))) {
         spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-        free (tkn);
+        logitem_free (logitem, tkn);
         return 1;
       }
-      logitem->method = xstrdup (meth);
-      free (tkn);
+      logitem->method = logitem_strdup (logitem, meth);
+      logitem_free (logitem, tkn);
     }
     break;
     /* request not including method or protocol */
   case 'U':
     if (logitem->req)
       return handle_default_case_token (str, p);
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn == NULL || *tkn == '\0') {
-      free (tkn);
+      logitem_free (logitem, tkn);
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     }
 
-    if ((logitem->req = decode_url (tkn)) == NULL) {
+    if ((logitem->req = decode_url (logitem, tkn)) == NULL) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* query string alone, e.g., ?param=goaccess&tbm=shop */
   case 'q':
     if (logitem->qstr)
       return handle_default_case_token (str, p);
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn == NULL || *tkn == '\0') {
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 0;
     }
 
-    if ((logitem->qstr = decode_url (tkn)) == NULL) {
+    if ((logitem->qstr = decode_url (logitem, tkn)) == NULL) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* request protocol */
   case 'H':
     if (logitem->protocol)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
     {
       const char *proto = NULL;
       if (!(proto = extract_protocol (tkn))) {
         spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-        free (tkn);
+        logitem_free (logitem, tkn);
         return 1;
       }
-      logitem->protocol = xstrdup (proto);
-      free (tkn);
+      logitem->protocol = logitem_strdup (logitem, proto);
+      logitem_free (logitem, tkn);
     }
     break;
     /* request, including method + protocol */
   case 'r':
     if (logitem->req)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
-    logitem->req = parse_req (tkn, &logitem->method, &logitem->protocol);
-    free (tkn);
+    logitem->req = parse_req (logitem, tkn, &logitem->method, &logitem->protocol);
+    logitem_free (logitem, tkn);
     break;
     /* Status Code */
   case 's':
     if (logitem->status >= 0)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     logitem->status = strtol (tkn, &sEnd, 10);
     if (tkn == sEnd || *sEnd != '\0' || errno == ERANGE ||
         (!conf.no_strict_status && !is_valid_http_status (logitem->status))) {
       spec_err (logitem, ERR_SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
+      logitem_free (logitem, tkn);
       return 1;
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* size of response in bytes - excluding HTTP headers */
   case 'b':
     if (logitem->resp_size)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     bandw = strtoull (tkn, &bEnd, 10);
@@ -1217,27 +1372,27 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
       __atomic_compare_exchange_n (&conf.bandwidth, &expected, 1, false, __ATOMIC_SEQ_CST,
                                    __ATOMIC_SEQ_CST);
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* referrer */
   case 'R':
     if (logitem->ref)
       return handle_default_case_token (str, p);
 
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      tkn = alloc_string ("-");
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
+      tkn = logitem_strdup (logitem, "-");
     if (*tkn == '\0') {
-      free (tkn);
-      tkn = alloc_string ("-");
+      logitem_free (logitem, tkn);
+      tkn = logitem_strdup (logitem, "-");
     }
     if (strcmp (tkn, "-") != 0) {
-      extract_keyphrase (tkn, &logitem->keyphrase);
+      extract_keyphrase (logitem, tkn, &logitem->keyphrase);
       extract_referer_site (tkn, logitem->site);
 
       /* hide referrers from report */
       if (hide_referer (logitem->site)) {
         logitem->site[0] = '\0';
-        free (tkn);
+        logitem_free (logitem, tkn);
       } else
         logitem->ref = tkn;
       break;
@@ -1250,22 +1405,22 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     if (logitem->agent)
       return handle_default_case_token (str, p);
 
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem, &(*str), end, 1);
     if (tkn != NULL && *tkn != '\0') {
       /* Make sure the user agent is decoded (i.e.: CloudFront) */
-      logitem->agent = decode_url (tkn);
+      logitem->agent = decode_url (logitem, tkn);
 
       set_browser_os (logitem);
       set_agent_hash (logitem);
-      free (tkn);
+      logitem_free (logitem, tkn);
       break;
     } else if (tkn != NULL && *tkn == '\0') {
-      free (tkn);
-      tkn = alloc_string ("-");
+      logitem_free (logitem, tkn);
+      tkn = logitem_strdup (logitem, "-");
     }
     /* must be null */
     else {
-      tkn = alloc_string ("-");
+      tkn = logitem_strdup (logitem, "-");
     }
     logitem->agent = tkn;
     set_agent_hash (logitem);
@@ -1275,7 +1430,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     serve_secs = strtoull (tkn, &bEnd, 10);
@@ -1291,7 +1446,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
                                    __ATOMIC_SEQ_CST);
     }
 
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* time taken to serve the request, in seconds with a milliseconds
      * resolution */
@@ -1299,7 +1454,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     if (strchr (tkn, '.') != NULL)
@@ -1318,14 +1473,14 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
       __atomic_compare_exchange_n (&conf.serve_usecs, &expected, 1, false, __ATOMIC_SEQ_CST,
                                    __ATOMIC_SEQ_CST);
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* time taken to serve the request, in microseconds */
   case 'D':
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     serve_time = strtoull (tkn, &bEnd, 10);
@@ -1339,14 +1494,14 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
       __atomic_compare_exchange_n (&conf.serve_usecs, &expected, 1, false, __ATOMIC_SEQ_CST,
                                    __ATOMIC_SEQ_CST);
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* time taken to serve the request, in nanoseconds */
   case 'n':
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     serve_time = strtoull (tkn, &bEnd, 10);
@@ -1362,14 +1517,14 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
       __atomic_compare_exchange_n (&conf.serve_usecs, &expected, 1, false, __ATOMIC_SEQ_CST,
                                    __ATOMIC_SEQ_CST);
     }
-    free (tkn);
+    logitem_free (logitem, tkn);
     break;
     /* UMS: Krypto (TLS) "ECDHE-RSA-AES128-GCM-SHA256" */
   case 'k':
     /* error to set this twice */
     if (logitem->tls_cypher)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
 #if defined(HAVE_LIBSSL) && defined(HAVE_CIPHER_STD_NAME)
@@ -1377,7 +1532,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
       char *tmp = NULL;
       for (tmp = tkn; isdigit ((unsigned char) *tmp); tmp++);
       if (!strlen (tmp))
-        extract_tls_version_cipher (tkn, &logitem->tls_cypher, &logitem->tls_type);
+        extract_tls_version_cipher (logitem, tkn, &logitem->tls_cypher, &logitem->tls_type);
       else
         logitem->tls_cypher = tkn;
     }
@@ -1392,7 +1547,7 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     /* error to set this twice */
     if (logitem->tls_type)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     logitem->tls_type = tkn;
@@ -1403,15 +1558,15 @@ parse_specifier (GLogItem *logitem, const char **str, const char *p, const char
     /* error to set this twice */
     if (logitem->mime_type)
       return handle_default_case_token (str, p);
-    if (!(tkn = parse_string (&(*str), end, 1)))
+    if (!(tkn = parse_string (logitem, &(*str), end, 1)))
       return spec_err (logitem, ERR_SPEC_TOKN_NUL, *p, NULL);
 
     normalize_mime_type (tkn, norm_mime, sizeof (norm_mime));
     if (norm_mime[0] != '\0')
-      logitem->mime_type = strdup (norm_mime);
+      logitem->mime_type = logitem_strdup (logitem, norm_mime);
     else
       logitem->mime_type = NULL;
-    free (tkn);
+    logitem_free (logitem, tkn);
 
     break;
     /* move forward through str until not a space */
@@ -1491,20 +1646,20 @@ set_xff_host (GLogItem *logitem, const char *str, const char *skips, int out) {
 
     ptr += len;
     /* extract possible IP */
-    if (!(tkn = parsed_string (ptr, &str, 0)))
+    if (!(tkn = parsed_string (logitem, ptr, &str, 0)))
       break;
 
     invalid_ip = invalid_ipaddr (tkn, &type_ip);
     /* done, already have IP and current token is not a host */
     if (logitem->host && invalid_ip) {
-      free ((void *) tkn);
+      logitem_free (logitem, (void *) tkn);
       break;
     }
     if (!logitem->host && !invalid_ip) {
-      logitem->host = xstrdup (tkn);
+      logitem->host = logitem_strdup (logitem, tkn);
       logitem->type_ip = type_ip;
     }
-    free ((void *) tkn);
+    logitem_free (logitem, (void *) tkn);
     idx = 0;
 
     /* found the client IP, break then */
@@ -1536,11 +1691,11 @@ find_xff_host (GLogItem *logitem, const char **str, const char **p) {
   if (!strchr (skips, **p) && strchr (*str, **p)) {
     *pch = **p;
     *(pch + 1) = '\0';
-    if (!(extract = parse_string (&(*str), pch, 1)))
+    if (!(extract = parse_string (logitem, &(*str), pch, 1)))
       goto clean;
 
     res = set_xff_host (logitem, extract, skips, 1);
-    free (extract);
+    logitem_free (logitem, extract);
     (*str)++;   /* move a char forward from the trailing delim */
   } else {
     res = set_xff_host (logitem, *str, skips, 0);
@@ -1700,16 +1855,16 @@ verify_missing_fields (GLogItem *logitem) {
   /* must have the following fields */
   if (logitem->host == NULL)
     logitem->errstr =
-      xstrdup
-      ("IPv4/6 is required. You have to add format specifier '%h' [host (the client IP address, either IPv4 or IPv6)] to your log-format.");
+      logitem_strdup
+      (logitem, "IPv4/6 is required. You have to add format specifier '%h' [host (the client IP address, either IPv4 or IPv6)] to your log-format.");
   else if (logitem->date == NULL)
     logitem->errstr =
-      xstrdup
-      ("A valid date is required. You have to add format specifier '%x' [Datetime] or '%d' [Date] and '%t' [Time] to your log-format.");
+      logitem_strdup
+      (logitem, "A valid date is required. You have to add format specifier '%x' [Datetime] or '%d' [Date] and '%t' [Time] to your log-format.");
   else if (logitem->req == NULL)
     logitem->errstr =
-      xstrdup
-      ("A request is required. Your log-format is missing format specifier '%r' [The request line from the client] or combination of special format specifiers such as '%m', '%U', '%q' and '%H' to parse individual fields.");
+      logitem_strdup
+      (logitem, "A request is required. Your log-format is missing format specifier '%r' [The request line from the client] or combination of special format specifiers such as '%m', '%U', '%q' and '%H' to parse individual fields.");
 
   return logitem->errstr != NULL;
 }
@@ -2051,7 +2206,7 @@ static int
 apply_post_parse_processing (GLog *glog, GLogItem *logitem) {
   /* Apply vhost from filename if configured */
   if (!glog->piping && conf.fname_as_vhost && glog->fname_as_vhost)
-    logitem->vhost = xstrdup (glog->fname_as_vhost);
+    logitem->vhost = logitem_strdup (logitem, glog->fname_as_vhost);
 
   /* Update timestamp atomically */
   if (atomic_lpts_update (glog, logitem) == -1)
@@ -2070,7 +2225,7 @@ static void
 enrich_logitem (GLogItem *logitem) {
   /* agent will be null in cases where %u is not specified */
   if (logitem->agent == NULL) {
-    logitem->agent = alloc_string ("-");
+    logitem->agent = logitem_strdup (logitem, "-");
     set_agent_hash (logitem);
   }
 
@@ -2085,13 +2240,13 @@ enrich_logitem (GLogItem *logitem) {
   if (conf.concat_vhost_req) {
     size_t vhost_len = logitem->vhost ? strlen (logitem->vhost) : 0;
     size_t req_len = logitem->req ? strlen (logitem->req) : 0;
-    char *new_req = xmalloc (vhost_len + req_len + 1);
+    char *new_req = logitem_alloc (logitem, vhost_len + req_len + 1);
     if (vhost_len)
       memcpy (new_req, logitem->vhost, vhost_len);
     if (req_len)
       memcpy (new_req + vhost_len, logitem->req, req_len);
     new_req[vhost_len + req_len] = '\0';
-    free (logitem->req);
+    logitem_free (logitem, logitem->req);
     logitem->req = new_req;
   }
 
@@ -2104,7 +2259,7 @@ enrich_logitem (GLogItem *logitem) {
  *
  * On error, logitem->errstr will contains the error message. */
 int
-parse_line (GLog *glog, char *line, int dry_run, GLogItem **logitem_out) {
+parse_line (GLog *glog, char *line, int dry_run, GArena *arena, GLogItem **logitem_out) {
   int ret = 0;
   GLogItem *logitem = NULL;
 
@@ -2112,7 +2267,7 @@ parse_line (GLog *glog, char *line, int dry_run, GLogItem **logitem_out) {
   if (valid_line (line))
     return -1;
 
-  logitem = init_log_item (glog);
+  logitem = init_log_item (glog, arena);
 
   /* Validate and parse the log format */
   ret = validate_and_parse_line (line, logitem);
@@ -2152,11 +2307,11 @@ parse_line (GLog *glog, char *line, int dry_run, GLogItem **logitem_out) {
  * On error, NULL is returned.
  * On success or soft ignores, GLogItem is returned. */
 static GLogItem *
-read_line (GLog *glog, char *line, int *test, uint32_t *cnt, int dry_run) {
+read_line (GLog *glog, char *line, int *test, uint32_t *cnt, int dry_run, GArena *arena) {
   GLogItem *logitem = NULL;
   int ret = 0;
 
-  if ((ret = parse_line (glog, line, dry_run, &logitem)) == 0)
+  if ((ret = parse_line (glog, line, dry_run, arena, &logitem)) == 0)
     *test = 0;
 
   if (ret == -1)
@@ -2179,6 +2334,7 @@ read_lines_thread (void *arg) {
   GJob *job = (GJob *) arg;
   int i = 0;
   uint32_t local_cnt = atomic_load (&job->cnt);
+  uint64_t start = stat_now ();
 
   for (i = 0; i < job->p; i++) {
     /* Check stop_processing atomically */
@@ -2187,7 +2343,8 @@ read_lines_thread (void *arg) {
 
     /* ensure we don't process more than we should when testing for log format */
     if (!job->test || (job->test && local_cnt < conf.num_tests)) {
-      job->logitems[i] = read_line (job->glog, job->lines[i], &job->test, &local_cnt, job->dry_run);
+      job->logitems[i] =
+        read_line (job->glog, job->lines[i], &job->test, &local_cnt, job->dry_run, job->arena);
     } else {
       atomic_store (&conf.stop_processing, 1);
       break;
@@ -2200,6 +2357,8 @@ read_lines_thread (void *arg) {
 
   /* Update shared counter atomically */
   atomic_store (&job->cnt, local_cnt);
+  if (!job->dry_run)
+    stat_time (STAT_PARSE, start, i);
 
   return (void *) 0;
 }
@@ -2257,17 +2416,34 @@ void *
 process_lines_thread (void *arg) {
   GJob *job = (GJob *) arg;
   int i = 0;
+  uint64_t start = stat_now ();
 
   for (i = 0; i < job->p; i++) {
     if (job->logitems[i] != NULL && !job->dry_run && job->logitems[i]->errstr == NULL) {
+      if (conf.persist_wal)
+        log_wal_record (job->logitems[i]);
       process_log (job->logitems[i]);
       free_glog (job->logitems[i]);
       job->logitems[i] = NULL;
     }
   }
+  if (!job->dry_run)
+    stat_time (STAT_PROCESS, start, job->p);
+
   return (void *) 0;
 }
 
+/* Release every logitem of the given job at once by rewinding its
+ * arena. No logitem of the chunk may be referenced afterwards. */
+static void
+reset_job_logitems (GJob *job) {
+  int i = 0;
+
+  for (i = 0; i < job->p; i++)
+    job->logitems[i] = NULL;
+  arena_reset (job->arena);
+}
+
 /* Initialize jobs */
 static void
 init_jobs (GJob jobs[2][conf.jobs], GLog *glog, int dry_run, int test) {
@@ -2291,8 +2467,10 @@ init_jobs (GJob jobs[2][conf.jobs], GLog *glog, int dry_run, int test) {
       jobs[b][k].test = test;
       jobs[b][k].dry_run = dry_run;
       jobs[b][k].running = 0;
+      jobs[b][k].bytes = 0;
       jobs[b][k].logitems = xcalloc (conf.chunk_size, sizeof (GLogItem));
       jobs[b][k].lines = xcalloc (conf.chunk_size, sizeof (char *));
+      jobs[b][k].arena = new_arena (ARENA_BLOCK_SIZE);
 #ifndef WITH_GETLINE
       for (i = 0; i < conf.chunk_size; i++)
         jobs[b][k].lines[i] = xcalloc (LINE_BUFFER, sizeof (char));
@@ -2313,6 +2491,7 @@ read_lines_from_file (GFileHandle *fh, GLog *glog, GJob jobs[2][conf.jobs], int
 #else
     while ((*s = gfile_gets (jobs[b][k].lines[jobs[b][k].p], LINE_BUFFER, fh)) != NULL) {
 #endif
+      jobs[b][k].bytes += strlen (jobs[b][k].lines[jobs[b][k].p]);
       glog->bytes += strlen (jobs[b][k].lines[jobs[b][k].p]);
       if (++(jobs[b][k].p) >= conf.chunk_size)
         break;  // goto next chunk
@@ -2320,23 +2499,74 @@ read_lines_from_file (GFileHandle *fh, GLog *glog, GJob jobs[2][conf.jobs], int
   }
 }
 
-/* Processes lines using threads from the GJob array, updating counters. */
+/* Read lines from the given buffer of newline-terminated lines, copying
+ * them into the jobs as read_lines_from_file() does. */
+static void
+read_lines_from_buf (const char **buf, const char *end, GLog *glog, GJob jobs[2][conf.jobs], int b,
+                     char **s) {
+  const char *nl = NULL;
+  size_t len = 0;
+  int k = 0;
+
+  *s = NULL;
+  for (k = 0; k < conf.jobs && *buf < end; k++) {
+    while (*buf < end) {
+      nl = memchr (*buf, '\n', end - *buf);
+      len = nl ? (size_t) (nl - *buf) + 1 : (size_t) (end - *buf);
+#ifdef WITH_GETLINE
+      *s = xmalloc (len + 1);
+      jobs[b][k].lines[jobs[b][k].p] = *s;
+      memcpy (*s, *buf, len);
+      (*s)[len] = '\0';
+#else
+      /* as fgets() would, a line longer than the buffer is truncated */
+      *s = jobs[b][k].lines[jobs[b][k].p];
+      memcpy (*s, *buf, MIN (len, (size_t) LINE_BUFFER - 1));
+      (*s)[MIN (len, (size_t) LINE_BUFFER - 1)] = '\0';
+#endif
+
+      jobs[b][k].bytes += len;
+      glog->bytes += len;
+      *buf += len;
+      if (++(jobs[b][k].p) >= conf.chunk_size)
+        break;  // goto next chunk
+    }
+  }
+
+  /* end of the buffer */
+  if (*buf >= end)
+    *s = NULL;
+}
+
+/* Log the batch just processed ahead of persisting it, along with the lines
+ * and bytes of the log processed so far. */
+static void
+append_wal_batch (GLog *glog, const GLastParse *done) {
+  GLastParse lp = glog->lp;
+
+  lp.ts = __atomic_load_n (&glog->lp.ts, __ATOMIC_SEQ_CST);
+  lp.line = done->line;
+  lp.size = done->size;
+  lp.snippetlen = glog->snippetlen;
+  memcpy (lp.snippet, glog->snippet, glog->snippetlen);
+
+  append_wal (glog->props.inode, &lp);
+}
+
+/* Processes lines using threads from the GJob array, updating counters and
+ * the lines and bytes of the log processed so far. */
 static void
-process_lines (GJob jobs[2][conf.jobs], uint32_t *cnt, int *test, int b) {
+process_lines (GJob jobs[2][conf.jobs], uint32_t *cnt, int *test, int b, GLastParse *lp) {
   int k = 0;
   for (k = 0; k < conf.jobs; k++) {
     process_lines_thread (&jobs[b][k]);
+    lp->line += jobs[b][k].p;
+    lp->size += jobs[b][k].bytes;
+    jobs[b][k].bytes = 0;
 
-    /* If interrupted, free any remaining logitems that weren't processed */
-    if (atomic_load (&conf.stop_processing)) {
-      int i;
-      for (i = 0; i < jobs[b][k].p; i++) {
-        if (jobs[b][k].logitems[i] != NULL) {
-          free_glog (jobs[b][k].logitems[i]);
-          jobs[b][k].logitems[i] = NULL;
-        }
-      }
-    }
+    /* free all logitems of the chunk, including those that weren't
+     * processed if interrupted */
+    reset_job_logitems (&jobs[b][k]);
 
     /* Read atomic counter */
     *cnt += atomic_load (&jobs[b][k].cnt);
@@ -2363,36 +2593,45 @@ free_jobs (GJob jobs[2][conf.jobs]) {
 #endif
       free (jobs[b][k].logitems);
       free (jobs[b][k].lines);
+      free_arena (jobs[b][k].arena);
     }
   }
 }
 
-/* Reads lines from the given file pointer `fp` and processes them using
- * parallel threads.
+/* Reads lines from the given file pointer `fp`, or from the given buffer of
+ * lines if no file is given, and processes them using parallel threads.
  *
  * On error or when interrupted by a signal (SIGINT), the function returns 0.
  * On success, it returns 1 if the number of processed lines is greater than or
  * equal to the configured number of tests (NUM_TESTS), otherwise 0.
  */
 static int
-read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
-  int b = 0, k = 0, test = conf.num_tests > 0 ? 1 : 0;
+read_lines_src (GFileHandle *fh, const char *buf, const char *end, GLog *glog, int dry_run,
+                int test) {
+  int b = 0, k = 0;
   uint32_t cnt = 0;
+  uint64_t bytes = 0, start = stat_now (), read = glog->read, tick = 0;
   void *status = NULL;
+  GLastParse lp = {.line = glog->read,.size = glog->length + glog->bytes };
   char *s = NULL;
   GJob jobs[2][conf.jobs];
   pthread_t threads[conf.jobs];
 
-  glog->bytes = 0;
-
   init_jobs (jobs, glog, dry_run, test);
 
   b = 0;
   while (1) {   /* b = 0 or 1 */
-    read_lines_from_file (fh, glog, jobs, b, &s);
+    bytes = glog->bytes;
+    tick = stat_now ();
+    if (fh)
+      read_lines_from_file (fh, glog, jobs, b, &s);
+    else
+      read_lines_from_buf (&buf, end, glog, jobs, b, &s);
+    if (!dry_run && glog->bytes != bytes)
+      stat_time (STAT_READ, tick, glog->bytes - bytes);
 
     /* if nothing was read from the log, skip it for now */
-    if (!glog->bytes) {
+    if (glog->bytes == bytes) {
       test = 0;
       break;
     }
@@ -2410,7 +2649,9 @@ read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
     if (conf.jobs > 1)
       b = b ^ 1;
 
-    process_lines (jobs, &cnt, &test, b);
+    process_lines (jobs, &cnt, &test, b, &lp);
+    if (conf.persist_wal && !dry_run)
+      append_wal_batch (glog, &lp);
 
     /* flip from block B/A to A/B */
     if (conf.jobs > 1)
@@ -2451,6 +2692,10 @@ read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
 
       if (jobs[b][k].p) {
         process_lines_thread (&jobs[b][k]);
+        lp.line += jobs[b][k].p;
+        lp.size += jobs[b][k].bytes;
+        jobs[b][k].bytes = 0;
+        reset_job_logitems (&jobs[b][k]);
         cnt += jobs[b][k].cnt;
         jobs[b][k].cnt = 0;
         test &= jobs[b][k].test;
@@ -2460,6 +2705,10 @@ read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
   }
 
   free_jobs (jobs);
+  if (conf.persist_wal && !dry_run)
+    append_wal_batch (glog, &lp);
+  if (!dry_run && glog->read != read)
+    stat_time (STAT_INGEST, start, glog->read - read);
 
   /* if no data was available to read from (probably from a pipe) and still in
    * test mode and still below the test count, we simply return until data
@@ -2470,6 +2719,34 @@ read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
   return test;
 }
 
+/* Reads lines from the given file and processes them, see read_lines_src(). */
+static int
+read_lines (GFileHandle *fh, GLog *glog, int dry_run) {
+  glog->bytes = 0;
+  return read_lines_src (fh, NULL, NULL, glog, dry_run, conf.num_tests > 0 ? 1 : 0);
+}
+
+/* Parse and process the given newline-terminated lines appended to a
+ * followed log, past the bytes of it read so far, using the parser jobs as
+ * the initial parse does.
+ *
+ * Note: the caller must hold the gdns_thread.mutex, parsing touches the
+ * storage as well.
+ *
+ * The number of lines read is returned. */
+uint32_t
+read_appended_lines (GLog *glog, const char *lines, size_t len) {
+  uint32_t read = glog->read;
+
+  read_lines_src (NULL, lines, lines + len, glog, 0, 0);
+
+  glog->lp.line = glog->read;
+  if (glog->props.inode)
+    glog->lp.size = glog->length + glog->bytes;
+
+  return glog->read - read;
+}
+
 /* Read the given log file and attempt to mmap a fixed number of bytes so we
  * can compare its content on future runs.
  *
@@ -2598,8 +2875,14 @@ parse_log (Logs *logs, int dry_run) {
     FATAL ("%s", err_log);
 
   /* no data piped, no logs passed, load from disk only then */
-  if (conf.restore && !logs->restored)
+  if (conf.restore && !logs->restored) {
     logs->restored = rebuild_rawdata_cache ();
+    /* on top of the restored caches */
+    replay_wal ();
+  }
+  /* a fresh dataset doesn't carry on the log of an earlier one */
+  if (!conf.restore && conf.persist_wal)
+    clear_wal ();
 
   /* no data piped, no logs passed, load from disk only then */
   if (conf.restore && !conf.filenames_idx && !conf.read_stdin) {
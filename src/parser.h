@@ -37,6 +37,7 @@
 #define MAX_LOG_ERRORS  20
 #define READ_BYTES      4096u
 #define MAX_BATCH_LINES 8192u /* max number of lines to read per batch before a reflow */
+#define TAIL_READ_BYTES 4194304u /* bulk read size of a followed log */
 #define MAX_MIME_OUT    256
 
 #define LINE_LEN          23
@@ -57,6 +58,7 @@
 #include <pthread.h>
 
 #include "commons.h"
+#include "garena.h"
 #include "gslist.h"
 #include "fileio.h"
 
@@ -100,7 +102,7 @@ typedef struct GLogItem_ {
   uint64_t serve_time;
 
   uint32_t numdate;
-  uint32_t agent_hash;
+  uint64_t agent_hash;
   int ignorelevel;
   int type_ip;
   int is_404;
@@ -117,6 +119,8 @@ typedef struct GLogItem_ {
 
   char *errstr;
   struct tm dt;
+
+  GArena *arena;                /* owner of all members, NULL if malloc'd */
 } GLogItem;
 
 typedef struct GLastParse_ {
@@ -145,6 +149,7 @@ typedef struct GLog_ {
   char *fname_as_vhost;
   char **errors;
   FILE *pipe;
+  GFileHandle *tail;            /* log kept open while following it */
   pthread_mutex_t error_mutex;  // Add mutex for error array
 } GLog;
 
@@ -164,11 +169,23 @@ typedef struct Logs_ {
 typedef struct GJob_ {
   _Atomic uint32_t cnt;         // Make atomic
   int p, test, dry_run, running;
+  uint64_t bytes;               /* length of the lines of the chunk */
   GLog *glog;
   GLogItem **logitems;
   char **lines;
+  GArena *arena;                /* backs the logitems of the chunk */
 } GJob;
 
+/* Static-file extensions, stored reversed and lowercased in a suffix
+ * trie. Indices are offsets into the node array; 0 (the root) means none. */
+typedef struct GStaticNode_ {
+  unsigned char ch;             /* byte matched at this node */
+  uint8_t term;                 /* an extension ends at this node */
+  uint16_t depth;               /* length of the suffix matched so far */
+  uint32_t child;               /* first child */
+  uint32_t next;                /* next sibling */
+} GStaticNode;
+
 /* Raw data field type */
 typedef enum {
   U32,
@@ -195,9 +212,12 @@ typedef struct GRawData_ {
 
 
 char *extract_by_delim (const char **str, const char *end);
+char *logitem_own (GLogItem * logitem, char *s);
+char *logitem_strdup (GLogItem * logitem, const char *s);
 char *gfile_getline (GFileHandle * fh);
 char **test_format (Logs * logs, int *len);
-int parse_line (GLog * glog, char *line, int dry_run, GLogItem ** logitem_out);
+int parse_line (GLog * glog, char *line, int dry_run, GArena * arena, GLogItem ** logitem_out);
+uint32_t read_appended_lines (GLog * glog, const char *lines, size_t len);
 int parse_log (Logs * logs, int dry_run);
 int set_glog (Logs * logs, const char *filename);
 int set_initial_persisted_data (GLog * glog, GFileHandle * fh, const char *fn);
@@ -206,11 +226,15 @@ void free_glog (GLogItem * logitem);
 void free_logerrors (GLog * glog);
 void free_logs (Logs * logs);
 void free_raw_data (GRawData * raw_data);
+void free_static_files (void);
+void logitem_free (GLogItem * logitem, void *ptr);
+void *logitem_alloc (GLogItem * logitem, size_t size);
+void init_static_files (void);
 void output_logerrors (void);
 void *process_lines_thread (void *arg);
 void reset_struct (Logs * logs);
 
-GLogItem *init_log_item (GLog * glog);
+GLogItem *init_log_item (GLog * glog, GArena * arena);
 GRawDataItem *new_grawdata_item (unsigned int size);
 GRawData *new_grawdata (void);
 Logs *init_logs (int size);
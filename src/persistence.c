@@ -32,12 +32,17 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "persistence.h"
 
 #include "error.h"
 #include "gkhash.h"
+#include "gstorage.h"
 #include "sort.h"
 #include "tpl.h"
 #include "util.h"
@@ -46,6 +51,53 @@
 static uint32_t *persisted_dates = NULL;
 static uint32_t persisted_dates_len = 0;
 
+/* Set while persisting or restoring the tables of a single date. They live
+ * in their own directory, a date-<date> partition of the dataset or a
+ * spill-<date> one under --mem-limit, and only that date is persisted or
+ * restored. */
+static char *part_dir = NULL;
+static khash_t (igkh) * part_dates = NULL;
+/* Write-ahead log of the batches parsed since the dataset was persisted,
+ * see --persist-wal */
+#define WAL_FILE    "WAL.db"
+#define WAL_CNT_LEN 3
+/* string members of a record, its referring site last */
+static const size_t wal_str_fields[] = {
+  offsetof (GLogItem, agent), offsetof (GLogItem, browser),
+  offsetof (GLogItem, browser_type), offsetof (GLogItem, continent),
+  offsetof (GLogItem, country), offsetof (GLogItem, city),
+  offsetof (GLogItem, asn), offsetof (GLogItem, date),
+  offsetof (GLogItem, host), offsetof (GLogItem, keyphrase),
+  offsetof (GLogItem, method), offsetof (GLogItem, os),
+  offsetof (GLogItem, os_type), offsetof (GLogItem, protocol),
+  offsetof (GLogItem, qstr), offsetof (GLogItem, ref),
+  offsetof (GLogItem, req), offsetof (GLogItem, req_key),
+  offsetof (GLogItem, time), offsetof (GLogItem, vhost),
+  offsetof (GLogItem, userid), offsetof (GLogItem, cache_status),
+  offsetof (GLogItem, mime_type), offsetof (GLogItem, tls_type),
+  offsetof (GLogItem, tls_cypher), offsetof (GLogItem, tls_type_cypher),
+};
+#define WAL_STR_LEN (ARRAY_SIZE (wal_str_fields) + 1)
+static tpl_node *wal_tn = NULL;
+static khash_t (si32) * wal_str_idx = NULL;
+static GLogItem wal_item;
+static GLastParse wal_lp;
+static char *wal_str = NULL;
+static uint64_t wal_inode = 0;
+static uint32_t wal_strs[WAL_STR_LEN];
+static uint32_t wal_cnt[WAL_CNT_LEN], wal_base[WAL_CNT_LEN];
+static int wal_fd = -1, wal_replayed = 0;
+/* Dates written ahead of the next persist by stage_dirty_date() */
+static uint32_t *staged_dates = NULL;
+static uint32_t staged_len = 0, staged_cap = 0;
+
+/* Tables of a date store to persist or restore */
+typedef enum GPartTables_ {
+  PART_ALL,
+  PART_RESIDENT,                /* kept in memory when spilled */
+  PART_UNLOADED,                /* unloaded when spilled */
+} GPartTables;
+
 /* Determine the path for the given database file.
  *
  * On error, a fatal error is thrown.
@@ -71,19 +123,70 @@ set_db_path (const char *fn) {
   else if (!(info.st_mode & S_IFDIR))
     FATAL ("Database path is not a directory.");
 
-  path = xmalloc (snprintf (NULL, 0, "%s/%s", rpath, fn) + 1);
-  sprintf (path, "%s/%s", rpath, fn);
+  if (part_dir) {
+    path = xmalloc (snprintf (NULL, 0, "%s/%s/%s", rpath, part_dir, fn) + 1);
+    sprintf (path, "%s/%s/%s", rpath, part_dir, fn);
+  } else {
+    path = xmalloc (snprintf (NULL, 0, "%s/%s", rpath, fn) + 1);
+    sprintf (path, "%s/%s", rpath, fn);
+  }
   free (rpath);
 
   return path;
 }
 
+/* Get the dates to persist, i.e., only the one of the open partition.
+ *
+ * On success, the dates hash is returned. */
+static khash_t (igkh) *
+get_persist_dates (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+
+  if (part_dates)
+    return part_dates;
+  return get_hdb (db, MTRC_DATES);
+}
+
+/* Point the database paths at the directory of a single date, e.g.,
+ * date-20240101, and restrict persisting and restoring to that date. */
+static void
+open_part (const char *prefix, uint32_t date, const char *suffix) {
+  int ret = 0;
+
+  part_dir = xmalloc (snprintf (NULL, 0, "%s-%u%s", prefix, date, suffix) + 1);
+  sprintf (part_dir, "%s-%u%s", prefix, date, suffix);
+  part_dates = kh_init (igkh);
+  kh_put (igkh, part_dates, date, &ret);
+}
+
+/* Point the database paths back at the dataset directory. */
+static void
+close_part (void) {
+  free (part_dir);
+  part_dir = NULL;
+  kh_destroy (igkh, part_dates);
+  part_dates = NULL;
+}
+
+/* Determine whether a partition holds the given table.
+ *
+ * If it does, 1 is returned, else 0. */
+static int
+part_has_metric (int module, GSMetric metric, GPartTables which) {
+  if (which == PART_ALL)
+    return 1;
+  return ht_is_resident_metric (module, metric) == (which == PART_RESIDENT);
+}
+
 /* Dump to disk the database file and frees its memory. The data is written
  * to a temporary file first and renamed into place so an interrupted write
  * never truncates an existing database. */
 /* Set when any database write of the current persist pass fails; the version
  * metadata is then withheld so the dataset is not marked complete. */
 static int persist_error = 0;
+/* Set when legacy keymaps were restored under provisional keys; they are
+ * rebuilt out of the restored strings once every store is restored. */
+static int rekey_keymaps = 0;
 
 static void
 close_tpl (tpl_node *tn, const char *fn) {
@@ -128,22 +231,60 @@ unlink_migrated_files (void) {
   migrated_files_len = 0;
 }
 
-/* Get the on-disk database version of the restored dataset.
+/* Get the given property of the restored dataset.
  *
- * If no version was persisted, 1 is returned (pre-versioning database).
- * On success, the persisted version is returned. */
+ * If the property was not persisted, def is returned.
+ * On success, the persisted value is returned. */
 static uint32_t
-get_db_version (void) {
+get_db_prop (const char *key, uint32_t def) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * db_props = get_hdb (db, MTRC_DB_PROPS);
   khint_t k;
 
-  k = kh_get (si32, db_props, "version");
+  k = kh_get (si32, db_props, key);
   if (k == kh_end (db_props))
-    return 1;
+    return def;
   return kh_val (db_props, k);
 }
 
+/* Set the given property of the dataset, replacing a restored one. */
+static void
+set_db_prop (const char *key, uint32_t val) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (si32) * db_props = get_hdb (db, MTRC_DB_PROPS);
+  khint_t k;
+  int ret;
+
+  k = kh_put (si32, db_props, key, &ret);
+  if (ret > 0)
+    kh_key (db_props, k) = xstrdup (key);
+  kh_val (db_props, k) = val;
+}
+
+/* Get the on-disk database version of the restored dataset.
+ *
+ * If no version was persisted, 1 is returned (pre-versioning database).
+ * On success, the persisted version is returned. */
+static uint32_t
+get_db_version (void) {
+  return get_db_prop ("version", 1);
+}
+
+/* Ensure the restored dataset counts visitors the way this run does. Its
+ * sketches and exact unique keys can't be mixed, datasets persisted before
+ * the mode was recorded are exact. */
+static void
+verify_db_visitors_mode (void) {
+  uint32_t approx = get_db_prop ("approx_visitors", 0);
+
+  if (approx && !conf.approx_visitors)
+    FATAL ("The dataset in the db-path was persisted with --approx-visitors, "
+           "restore it with --approx-visitors as well.");
+  if (!approx && conf.approx_visitors)
+    FATAL ("The dataset in the db-path was persisted without --approx-visitors, "
+           "restore it without --approx-visitors as well.");
+}
+
 /* Given a database filename, restore a string key, uint32_t value back to the
  * storage */
 static void
@@ -270,6 +411,59 @@ persist_global_ss32 (khash_t (ss32) *hash, const char *fn) {
   close_tpl (tn, fn);
 }
 
+/* Restore the resolved hostnames along with the time they were resolved
+ * at, dropping those older than --dns-cache-ttl days. */
+static void
+restore_global_hostnames (const char *fn) {
+  tpl_node *tn;
+  char *key = NULL, *val = NULL;
+  uint64_t resolved = 0, now = (uint64_t) time (NULL);
+  uint64_t ttl = (uint64_t) conf.dns_cache_ttl * 86400;
+  char fmt[] = "A(ssU)";
+
+  tn = tpl_map (fmt, &key, &val, &resolved);
+  tpl_load (tn, TPL_FILE, fn);
+  while (tpl_unpack (tn, 1) > 0) {
+    if (resolved + ttl > now)
+      ht_insert_hostname_at (key, val, resolved);
+    free (key);
+    free (val);
+  }
+  tpl_free (tn);
+}
+
+/* Persist to disk the resolved hostnames that haven't expired yet along
+ * with the time they were resolved at. If none were resolved, a file
+ * left by a previous run is removed so it isn't restored again. */
+static void
+persist_global_hostnames (khash_t (ss32) *hash, khash_t (su64) *ts, const char *fn) {
+  tpl_node *tn;
+  khint_t k;
+  const char *key = NULL, *val = NULL;
+  uint64_t resolved = 0, now = (uint64_t) time (NULL);
+  uint64_t ttl = (uint64_t) conf.dns_cache_ttl * 86400;
+  char fmt[] = "A(ssU)";
+
+  if (!hash || kh_size (hash) == 0) {
+    if (unlink (fn) == -1 && errno != ENOENT)
+      LOG_DEBUG (("Unable to remove %s: %s\n", fn, strerror (errno)));
+    return;
+  }
+
+  tn = tpl_map (fmt, &key, &val, &resolved);
+  for (k = 0; k < kh_end (hash); ++k) {
+    if (!kh_exist (hash, k) || !(key = kh_key (hash, k)) || !(val = kh_value (hash, k)))
+      continue;
+    if (!(resolved = get_su64 (ts, key)))
+      resolved = now;
+    if (resolved + ttl <= now)
+      continue;
+    tpl_pack (tn, 1);
+  }
+
+  close_tpl (tn, fn);
+}
+
 /* Given a database filename, restore a uint64_t key, GLastParse value back to
  * the storage */
 static void
@@ -365,6 +559,10 @@ static int
 insert_restored_date (uint32_t date) {
   uint32_t i, len = 0;
 
+  /* a partition holds a single date, past --keep-last already */
+  if (part_dates)
+    return kh_get (igkh, part_dates, date) != kh_end (part_dates) ? ht_insert_date (date) : 2;
+
   /* no keep last, simply insert the restored date to our storage */
   if (!conf.keep_last || persisted_dates_len < conf.keep_last)
     return ht_insert_date (date);
@@ -407,16 +605,17 @@ restore_si32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
-/* Given a database filename, restore a string key, uint32_t value back to
- * the storage */
+/* Given a legacy string keyed keymap database, restore its values back to
+ * the storage under provisional keys, to be rekeyed by rekey_date_stores() */
 static int
-migrate_si32_to_ii32 (GSMetric metric, const char *path, int module) {
-  khash_t (ii32) * hash = NULL;
+migrate_si32_to_u6432 (GSMetric metric, const char *path, int module) {
+  flat_t (u6432) * hash = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(su))";
   int date = 0, ret = 0;
   char *key = NULL;
   uint32_t val = 0;
+  khint_t k;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -429,7 +628,9 @@ migrate_si32_to_ii32 (GSMetric metric, const char *path, int module) {
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      ins_ii32 (hash, djb2 ((const unsigned char *) key), val);
+      k = fl_put (u6432, hash, ht_keymap_hash (key), &ret);
+      if (ret > 0)
+        fl_val (hash, k) = val;
       free (key);
     }
   }
@@ -438,6 +639,39 @@ migrate_si32_to_ii32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
+/* Given a legacy 32-bit hash keyed keymap database, restore its values back
+ * to the storage under provisional keys, to be rekeyed by
+ * rekey_date_stores() */
+static int
+migrate_ii32_to_u6432 (GSMetric metric, const char *path, int module) {
+  flat_t (u6432) * hash = NULL;
+  tpl_node *tn;
+  char fmt[] = "A(iA(uu))";
+  int date = 0, ret = 0;
+  uint32_t key = 0, val = 0;
+  khint_t k;
+
+  if (!(tn = tpl_map (fmt, &date, &key, &val)))
+    return 1;
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    if ((ret = insert_restored_date (date)) == 2)
+      continue;
+    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+      break;
+
+    while (tpl_unpack (tn, 2) > 0) {
+      k = fl_put (u6432, hash, key, &ret);
+      if (ret > 0)
+        fl_val (hash, k) = val;
+    }
+  }
+  tpl_free (tn);
+
+  return 0;
+}
+
 /* Parse a legacy "DATE|HOST|AGENT" unique visitor key into a fingerprint.
  * v1 keys carry the raw user agent while v2 keys carry the agent hash as a
  * hex string.
@@ -449,17 +683,18 @@ legacy_uniq_key_fingerprint (const char *key, uint32_t dbver) {
   const char *host = NULL, *agent = NULL;
   char *hostcp = NULL;
   size_t len = 0;
-  uint32_t agent_hash = 0;
-  uint64_t fp = 0;
+  uint64_t agent_hash = 0, fp = 0;
 
   if (!key || !(host = strchr (key, '|')) || !(agent = strchr (host + 1, '|')))
     return 0;
   host++;
 
+  /* v2 keys only carry the legacy 32-bit agent hash, which can no longer
+   * match the agent hash of newly parsed records */
   if (dbver >= 2)
     agent_hash = (uint32_t) strtoul (agent + 1, NULL, 16);
   else
-    agent_hash = djb2 ((const unsigned char *) (agent + 1));
+    agent_hash = ht_keymap_hash (agent + 1);
 
   len = agent - host;
   hostcp = xmalloc (len + 1);
@@ -605,7 +840,7 @@ load_counted_visitors (void) {
  * On success, 0 is returned. */
 static int
 migrate_unique_keys (const char *path, uint32_t dbver) {
-  khash_t (u6432) * hash = NULL;
+  flat_t (u6432) * hash = NULL;
   khash_t (u648) * counted = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(su))";
@@ -635,9 +870,9 @@ migrate_unique_keys (const char *path, uint32_t dbver) {
         if (counted && kh_get (u648, counted, ((uint64_t) date << 32) | val) != kh_end (counted))
           sval |= VISITOR_COUNTED_BIT;
 
-        k = kh_put (u6432, hash, fp, &is_new);
+        k = fl_put (u6432, hash, fp, &is_new);
         if (is_new > 0)
-          kh_val (hash, k) = sval;
+          fl_val (hash, k) = sval;
       }
       free (key);
     }
@@ -715,7 +950,7 @@ migrate_visitors_uniqmap (const char *path) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
   khash_t (u648) * hash = NULL;
-  khash_t (ii32) * cnt = NULL;
+  flat_t (ii32) * cnt = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(Uv))";
   const char *modstr = NULL;
@@ -767,8 +1002,7 @@ migrate_visitors_uniqmap (const char *path) {
 /* Given a hash and a filename, persist to disk a string key, uint32_t value */
 static int
 persist_si32 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (igkh) * dates = get_persist_dates ();
 
   khash_t (si32) * hash = NULL;
   tpl_node *tn = NULL;
@@ -821,120 +1055,60 @@ static const struct {
 };
 /* *INDENT-ON* */
 
-/* Extract the uint32_t field for the given metric from a merged entry.
+/* Get the uint32_t column holding the given metric.
  *
- * If the field is present, non-zero is returned and the value is set.
- * If the field is absent, 0 is returned. */
-static int
-imtv_u32_field (const GKMetricVals *mv, GSMetric metric, uint32_t *val) {
+ * On success, the column is returned.
+ * If the metric is not a uint32_t field, NULL is returned. */
+static uint32_t *
+imtv_u32_col (GKMetricCols *cols, GSMetric metric) {
   switch (metric) {
   case MTRC_HITS:
-    *val = mv->hits;
-    break;
+    return cols->hits;
   case MTRC_VISITORS:
-    *val = mv->visitors;
-    break;
+    return cols->visitors;
   case MTRC_ROOT:
-    *val = mv->root;
-    break;
+    return cols->root;
   default:
-    return 0;
+    return NULL;
   }
-  return *val != 0;
 }
 
-/* Extract the uint64_t field for the given metric from a merged entry.
- * Bandwidth and cumulative time can hold a present zero value, hence their
- * presence is carried by the touched bits.
+/* Get the uint64_t column holding the given metric. Bandwidth and
+ * cumulative time can hold a present zero value, hence their presence is
+ * carried by the touched bit set in touch.
  *
- * If the field is present, non-zero is returned and the value is set.
- * If the field is absent, 0 is returned. */
-static int
-imtv_u64_field (const GKMetricVals *mv, GSMetric metric, uint64_t *val) {
+ * On success, the column is returned.
+ * If the metric is not a uint64_t field, NULL is returned. */
+static uint64_t *
+imtv_u64_col (GKMetricCols *cols, GSMetric metric, uint8_t *touch) {
+  *touch = 0;
   switch (metric) {
   case MTRC_BW:
-    *val = mv->bw;
-    return (mv->touched & METRIC_TOUCHED_BW) != 0;
+    *touch = METRIC_TOUCHED_BW;
+    return cols->bw;
   case MTRC_CUMTS:
-    *val = mv->cumts;
-    return (mv->touched & METRIC_TOUCHED_CUMTS) != 0;
+    *touch = METRIC_TOUCHED_CUMTS;
+    return cols->cumts;
   case MTRC_MAXTS:
-    *val = mv->maxts;
-    return mv->maxts != 0;
+    return cols->maxts;
   default:
-    return 0;
+    return NULL;
   }
 }
 
-/* Extract the uint8_t field for the given metric from a merged entry.
+/* Get the uint8_t column holding the given metric.
  *
- * If the field is present, non-zero is returned and the value is set.
- * If the field is absent, 0 is returned. */
-static int
-imtv_u08_field (const GKMetricVals *mv, GSMetric metric, uint16_t *val) {
-  switch (metric) {
-  case MTRC_METHODS:
-    *val = mv->meth;
-    break;
-  case MTRC_PROTOCOLS:
-    *val = mv->proto;
-    break;
-  default:
-    return 0;
-  }
-  return *val != 0;
-}
-
-/* Set the uint32_t field for the given metric on a merged entry. */
-static void
-imtv_set_u32_field (GKMetricVals *mv, GSMetric metric, uint32_t val) {
-  switch (metric) {
-  case MTRC_HITS:
-    mv->hits = val;
-    break;
-  case MTRC_VISITORS:
-    mv->visitors = val;
-    break;
-  case MTRC_ROOT:
-    mv->root = val;
-    break;
-  default:
-    break;
-  }
-}
-
-/* Set the uint64_t field for the given metric on a merged entry. */
-static void
-imtv_set_u64_field (GKMetricVals *mv, GSMetric metric, uint64_t val) {
-  switch (metric) {
-  case MTRC_BW:
-    mv->bw = val;
-    mv->touched |= METRIC_TOUCHED_BW;
-    break;
-  case MTRC_CUMTS:
-    mv->cumts = val;
-    mv->touched |= METRIC_TOUCHED_CUMTS;
-    break;
-  case MTRC_MAXTS:
-    mv->maxts = val;
-    break;
-  default:
-    break;
-  }
-}
-
-/* Set the uint8_t field for the given metric on a merged entry. */
-static void
-imtv_set_u08_field (GKMetricVals *mv, GSMetric metric, uint8_t val) {
+ * On success, the column is returned.
+ * If the metric is not a uint8_t field, NULL is returned. */
+static uint8_t *
+imtv_u08_col (GKMetricCols *cols, GSMetric metric) {
   switch (metric) {
   case MTRC_METHODS:
-    mv->meth = val;
-    break;
+    return cols->meth;
   case MTRC_PROTOCOLS:
-    mv->proto = val;
-    break;
+    return cols->proto;
   default:
-    break;
+    return NULL;
   }
 }
 
@@ -942,14 +1116,14 @@ imtv_set_u08_field (GKMetricVals *mv, GSMetric metric, uint8_t val) {
  * the merged metrics storage */
 static int
 migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
-  khash_t (imtv) * hash = NULL;
+  GKMetricCols *cols = NULL;
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
-  GKMetricVals *mv = NULL;
+  uint8_t *col = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(us))";
   int date = 0, ret = 0;
-  uint32_t key = 0;
+  uint32_t key = 0, row = 0;
   char *val = NULL;
   khint_t k;
 
@@ -960,7 +1134,7 @@ migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, MTRC_METRICS)))
+    if (ret == -1 || !(cols = get_hash (module, date, MTRC_METRICS)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -970,8 +1144,8 @@ migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
         free (val);
         continue;
       }
-      if ((mv = ins_imtv (hash, key)))
-        imtv_set_u08_field (mv, metric, kh_val (mtpr, k));
+      if ((row = ins_imtv (cols, key)) && (col = imtv_u08_col (cols, metric)))
+        col[row] = kh_val (mtpr, k);
       free (val);
     }
   }
@@ -981,15 +1155,15 @@ migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
 }
 
 /* Given a database filename, restore a uint32_t key, string value back to
- * the storage */
+ * the storage. Strings are interned into the string pool. */
 static int
 restore_is32 (GSMetric metric, const char *path, int module) {
-  khash_t (is32) * hash = NULL;
+  flat_t (ii32) * hash = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(us))";
   int date = 0, ret = 0;
   uint32_t key = 0;
-  char *val = NULL, *dupval = NULL;
+  char *val = NULL;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -1002,9 +1176,7 @@ restore_is32 (GSMetric metric, const char *path, int module) {
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      dupval = xstrdup (val);
-      if (ins_is32 (hash, key, dupval) != 0)
-        free (dupval);
+      ins_istr (hash, key, val);
       free (val);
     }
   }
@@ -1013,17 +1185,17 @@ restore_is32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
-/* Given a hash and a filename, persist to disk a uint32_t key, string value */
+/* Given a hash and a filename, persist to disk a uint32_t key, string value.
+ * Pooled string ids are resolved so the on-disk format holds the strings. */
 static int
 persist_is32 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (is32) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  flat_t (ii32) * hash = NULL;
   tpl_node *tn = NULL;
   int date = 0;
   char fmt[] = "A(iA(us))";
   char *val = NULL;
-  uint32_t key = 0;
+  uint32_t key = 0, id = 0;
 
   if (!dates || !(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -1032,7 +1204,11 @@ persist_is32 (GSMetric metric, const char *path, int module) {
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
       return -1;
-    kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
+    fl_foreach (hash, key, id, {
+      if (!(val = (char *) ht_get_str (id)))
+        continue;
+      tpl_pack (tn, 2);
+    });
     tpl_pack (tn, 1);
   });
   /* *INDENT-ON* */
@@ -1041,12 +1217,103 @@ persist_is32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
+/* Given a database filename, restore a uint32_t key, HyperLogLog sketch
+ * value back to the storage. Inline fingerprints are stored as their raw
+ * eight bytes. */
+static int
+restore_ihll (GSMetric metric, const char *path, int module) {
+  flat_t (ihll) * hash = NULL;
+  GHLL *hll = NULL;
+  tpl_node *tn;
+  tpl_bin val;
+  char fmt[] = "A(iA(uB))";
+  int date = 0, ret = 0;
+  uint32_t key = 0;
+  uint64_t fp = 0;
+  khint_t k;
+
+  if (!(tn = tpl_map (fmt, &date, &key, &val)))
+    return 1;
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    if ((ret = insert_restored_date (date)) == 2)
+      continue;
+    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+      break;
+
+    while (tpl_unpack (tn, 2) > 0) {
+      hll = NULL;
+      fp = 0;
+      if (val.sz == sizeof (fp))
+        memcpy (&fp, val.addr, sizeof (fp));
+      else
+        hll = hll_unpack (val.addr, val.sz);
+      free (val.addr);
+      if (!hll && !IHLL_INLINE (fp))
+        continue;
+
+      k = fl_put (ihll, hash, key, &ret);
+      if (ret == -1) {
+        free_hll (hll);
+        continue;
+      }
+      if (ret == 0 && !IHLL_INLINE (fl_val (hash, k)))
+        free_hll (IHLL_SKETCH (fl_val (hash, k)));
+      fl_val (hash, k) = hll ? (uint64_t) (uintptr_t) hll : fp;
+    }
+  }
+  tpl_free (tn);
+
+  return 0;
+}
+
+/* Given a hash and a filename, persist to disk a uint32_t key, HyperLogLog
+ * sketch value. */
+static int
+persist_ihll (GSMetric metric, const char *path, int module) {
+  khash_t (igkh) * dates = get_persist_dates ();
+  flat_t (ihll) * hash = NULL;
+  tpl_node *tn = NULL;
+  tpl_bin val;
+  int date = 0;
+  char fmt[] = "A(iA(uB))";
+  uint32_t key = 0;
+  uint64_t ref = 0;
+  size_t len = 0;
+
+  if (!dates || !(tn = tpl_map (fmt, &date, &key, &val)))
+    return 1;
+
+  /* *INDENT-OFF* */
+  HT_FOREACH_KEY (dates, date, {
+    if (!(hash = get_hash (module, date, metric)))
+      return -1;
+    fl_foreach (hash, key, ref, {
+      if (IHLL_INLINE (ref)) {
+        val.addr = &ref;
+        val.sz = sizeof (ref);
+        tpl_pack (tn, 2);
+        continue;
+      }
+      val.addr = hll_pack (IHLL_SKETCH (ref), &len);
+      val.sz = len;
+      tpl_pack (tn, 2);
+      free (val.addr);
+    });
+    tpl_pack (tn, 1);
+  });
+  /* *INDENT-ON* */
+  close_tpl (tn, path);
+
+  return 0;
+}
 
 /* Given a database filename, restore a uint32_t key, uint32_t value back to
  * the storage */
 static int
 restore_ii32 (GSMetric metric, const char *path, int module) {
-  khash_t (ii32) * hash = NULL;
+  flat_t (ii32) * hash = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(uu))";
   int date = 0, ret = 0;
@@ -1074,9 +1341,8 @@ restore_ii32 (GSMetric metric, const char *path, int module) {
 /* Given a hash and a filename, persist to disk a uint32_t key, uint32_t value */
 static int
 persist_ii32 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (ii32) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  flat_t (ii32) * hash = NULL;
   tpl_node *tn = NULL;
   int date = 0;
   char fmt[] = "A(iA(uu))";
@@ -1089,7 +1355,7 @@ persist_ii32 (GSMetric metric, const char *path, int module) {
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
       return -1;
-    kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
+    fl_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
   /* *INDENT-ON* */
@@ -1132,8 +1398,7 @@ restore_u648 (GSMetric metric, const char *path, int module) {
  * value byte of 1 is written to keep the legacy on-disk format. */
 static int
 persist_u648 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (igkh) * dates = get_persist_dates ();
   khash_t (u648) * hash = NULL;
   tpl_node *tn = NULL;
   khint_t k;
@@ -1179,12 +1444,12 @@ persist_u648 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 restore_imtv_u32 (GSMetric metric, const char *path, int module) {
-  khash_t (imtv) * hash = NULL;
-  GKMetricVals *mv = NULL;
+  GKMetricCols *cols = NULL;
+  uint32_t *col = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(uu))";
   int date = 0, ret = 0;
-  uint32_t key = 0, val = 0;
+  uint32_t key = 0, val = 0, row = 0;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -1193,12 +1458,12 @@ restore_imtv_u32 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, MTRC_METRICS)))
+    if (ret == -1 || !(cols = get_hash (module, date, MTRC_METRICS)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      if ((mv = ins_imtv (hash, key)))
-        imtv_set_u32_field (mv, metric, val);
+      if ((row = ins_imtv (cols, key)) && (col = imtv_u32_col (cols, metric)))
+        col[row] = val;
     }
   }
   tpl_free (tn);
@@ -1213,12 +1478,13 @@ restore_imtv_u32 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 restore_imtv_u64 (GSMetric metric, const char *path, int module) {
-  khash_t (imtv) * hash = NULL;
-  GKMetricVals *mv = NULL;
+  GKMetricCols *cols = NULL;
+  uint64_t *col = NULL;
+  uint8_t touch = 0;
   tpl_node *tn;
   char fmt[] = "A(iA(uU))";
   int date = 0, ret = 0;
-  uint32_t key = 0;
+  uint32_t key = 0, row = 0;
   uint64_t val = 0;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
@@ -1228,12 +1494,14 @@ restore_imtv_u64 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, MTRC_METRICS)))
+    if (ret == -1 || !(cols = get_hash (module, date, MTRC_METRICS)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      if ((mv = ins_imtv (hash, key)))
-        imtv_set_u64_field (mv, metric, val);
+      if (!(row = ins_imtv (cols, key)) || !(col = imtv_u64_col (cols, metric, &touch)))
+        continue;
+      col[row] = val;
+      cols->touched[row] |= touch;
     }
   }
   tpl_free (tn);
@@ -1248,12 +1516,12 @@ restore_imtv_u64 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 restore_imtv_u08 (GSMetric metric, const char *path, int module) {
-  khash_t (imtv) * hash = NULL;
-  GKMetricVals *mv = NULL;
+  GKMetricCols *cols = NULL;
+  uint8_t *col = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(uv))";
   int date = 0, ret = 0;
-  uint32_t key = 0;
+  uint32_t key = 0, row = 0;
   uint16_t val = 0;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
@@ -1263,12 +1531,12 @@ restore_imtv_u08 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, MTRC_METRICS)))
+    if (ret == -1 || !(cols = get_hash (module, date, MTRC_METRICS)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      if ((mv = ins_imtv (hash, key)))
-        imtv_set_u08_field (mv, metric, val);
+      if ((row = ins_imtv (cols, key)) && (col = imtv_u08_col (cols, metric)))
+        col[row] = val;
     }
   }
   tpl_free (tn);
@@ -1283,11 +1551,11 @@ restore_imtv_u08 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 persist_imtv_u32 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (imtv) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  GKMetricCols *cols = NULL;
+  uint32_t *col = NULL;
   tpl_node *tn = NULL;
-  khint_t k;
+  uint32_t row = 0;
   int date = 0;
   char fmt[] = "A(iA(uu))";
   uint32_t key = 0, val = 0;
@@ -1297,12 +1565,14 @@ persist_imtv_u32 (GSMetric metric, const char *path, int module) {
 
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
-    if (!(hash = get_hash (module, date, MTRC_METRICS)))
+    if (!(cols = get_hash (module, date, MTRC_METRICS)))
       return -1;
-    for (k = kh_begin (hash); k != kh_end (hash); ++k) {
-      if (!kh_exist (hash, k) || !imtv_u32_field (&kh_val (hash, k), metric, &val))
+    col = imtv_u32_col (cols, metric);
+    for (row = 1; col && row <= cols->size; ++row) {
+      if (!col[row])
         continue;
-      key = kh_key (hash, k);
+      key = cols->keys[row];
+      val = col[row];
       tpl_pack (tn, 2);
     }
     tpl_pack (tn, 1);
@@ -1320,11 +1590,12 @@ persist_imtv_u32 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 persist_imtv_u64 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (imtv) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  GKMetricCols *cols = NULL;
+  uint64_t *col = NULL;
+  uint8_t touch = 0;
   tpl_node *tn = NULL;
-  khint_t k;
+  uint32_t row = 0;
   int date = 0;
   char fmt[] = "A(iA(uU))";
   uint32_t key = 0;
@@ -1335,12 +1606,14 @@ persist_imtv_u64 (GSMetric metric, const char *path, int module) {
 
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
-    if (!(hash = get_hash (module, date, MTRC_METRICS)))
+    if (!(cols = get_hash (module, date, MTRC_METRICS)))
       return -1;
-    for (k = kh_begin (hash); k != kh_end (hash); ++k) {
-      if (!kh_exist (hash, k) || !imtv_u64_field (&kh_val (hash, k), metric, &val))
+    col = imtv_u64_col (cols, metric, &touch);
+    for (row = 1; col && row <= cols->size; ++row) {
+      if (!col[row] && !(cols->touched[row] & touch))
         continue;
-      key = kh_key (hash, k);
+      key = cols->keys[row];
+      val = col[row];
       tpl_pack (tn, 2);
     }
     tpl_pack (tn, 1);
@@ -1358,11 +1631,11 @@ persist_imtv_u64 (GSMetric metric, const char *path, int module) {
  * On success, 0 is returned */
 static int
 persist_imtv_u08 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (imtv) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  GKMetricCols *cols = NULL;
+  uint8_t *col = NULL;
   tpl_node *tn = NULL;
-  khint_t k;
+  uint32_t row = 0;
   int date = 0;
   char fmt[] = "A(iA(uv))";
   uint32_t key = 0;
@@ -1373,12 +1646,14 @@ persist_imtv_u08 (GSMetric metric, const char *path, int module) {
 
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
-    if (!(hash = get_hash (module, date, MTRC_METRICS)))
+    if (!(cols = get_hash (module, date, MTRC_METRICS)))
       return -1;
-    for (k = kh_begin (hash); k != kh_end (hash); ++k) {
-      if (!kh_exist (hash, k) || !imtv_u08_field (&kh_val (hash, k), metric, &val))
+    col = imtv_u08_col (cols, metric);
+    for (row = 1; col && row <= cols->size; ++row) {
+      if (!col[row])
         continue;
-      key = kh_key (hash, k);
+      key = cols->keys[row];
+      val = col[row];
       tpl_pack (tn, 2);
     }
     tpl_pack (tn, 1);
@@ -1467,7 +1742,7 @@ persist_imtv (GModule module) {
  * the storage */
 static int
 restore_u6432 (GSMetric metric, const char *path, int module) {
-  khash_t (u6432) * hash = NULL;
+  flat_t (u6432) * hash = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(Uu))";
   int date = 0, ret = 0;
@@ -1486,9 +1761,9 @@ restore_u6432 (GSMetric metric, const char *path, int module) {
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      k = kh_put (u6432, hash, key, &ret);
+      k = fl_put (u6432, hash, key, &ret);
       if (ret > 0)
-        kh_val (hash, k) = val;
+        fl_val (hash, k) = val;
     }
   }
   tpl_free (tn);
@@ -1500,9 +1775,8 @@ restore_u6432 (GSMetric metric, const char *path, int module) {
  * value */
 static int
 persist_u6432 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (u6432) * hash = NULL;
+  khash_t (igkh) * dates = get_persist_dates ();
+  flat_t (u6432) * hash = NULL;
   tpl_node *tn = NULL;
   khint_t k;
   int date = 0;
@@ -1517,11 +1791,11 @@ persist_u6432 (GSMetric metric, const char *path, int module) {
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
       return -1;
-    for (k = kh_begin (hash); k != kh_end (hash); ++k) {
-      if (!kh_exist (hash, k))
+    for (k = fl_begin (hash); k != fl_end (hash); ++k) {
+      if (!fl_exist (hash, k))
         continue;
-      key = kh_key (hash, k);
-      val = kh_val (hash, k);
+      key = fl_key (hash, k);
+      val = fl_val (hash, k);
       tpl_pack (tn, 2);
     }
     tpl_pack (tn, 1);
@@ -1565,8 +1839,7 @@ restore_iu64 (GSMetric metric, const char *path, int module) {
 /* Given a hash and a filename, persist to disk a uint32_t key, uint64_t value */
 static int
 persist_iu64 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (igkh) * dates = get_persist_dates ();
   khash_t (iu64) * hash = NULL;
   tpl_node *tn = NULL;
   int date = 0;
@@ -1624,8 +1897,7 @@ restore_su64 (GSMetric metric, const char *path, int module) {
 /* Given a hash and a filename, persist to disk a string key, uint64_t value */
 static int
 persist_su64 (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (igkh) * dates = get_persist_dates ();
   khash_t (su64) * hash = NULL;
   tpl_node *tn = NULL;
   int date = 0;
@@ -1681,8 +1953,7 @@ restore_igsl (GSMetric metric, const char *path, int module) {
 /* Given a hash and a filename, persist to disk a uint32_t key, GSLList value */
 static int
 persist_igsl (GSMetric metric, const char *path, int module) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (igkh) * dates = get_persist_dates ();
   khash_t (igsl) * hash = NULL;
   GSLList *node;
   tpl_node *tn = NULL;
@@ -1745,6 +2016,9 @@ restore_by_type (GKHashMetric mtrc, const char *fn, int module) {
   case MTRC_TYPE_IGSL:
     restore_igsl (mtrc.metric.storem, path, module);
     break;
+  case MTRC_TYPE_IHLL:
+    restore_ihll (mtrc.metric.storem, path, module);
+    break;
   default:
     break;
   }
@@ -1762,6 +2036,9 @@ restore_metric_type (GModule module, GKHashMetric mtrc) {
     restore_imtv (module);
     return;
   }
+  /* sketches only exist in approximate visitors mode */
+  if (mtrc.type == MTRC_TYPE_IHLL && !conf.approx_visitors)
+    return;
 
   fn = get_filename (module, mtrc);
   restore_by_type (mtrc, fn, module);
@@ -1836,15 +2113,18 @@ migrate_metric (GModule module, GKHashMetric mtrc, int *skip_restore) {
     ret++;
     break;
   case MTRC_KEYMAP:
-    if (dbver >= 2)
-      break;
     if (!(modstr = get_module_str (module)))
       FATAL ("Unable to allocate module name.");
-    fn = build_filename ("SI32", modstr, "MTRC_KEYMAP");
+    /* keyed by the string (v1) or its 32-bit hash (v2, v3) */
+    fn = build_filename (dbver >= 2 ? "II32" : "SI32", modstr, "MTRC_KEYMAP");
     if (!(path = check_restore_path (fn)))
       break;
-    if (migrate_si32_to_ii32 (mtrc.metric.storem, path, module) != 0)
+    if (dbver >= 2 && migrate_ii32_to_u6432 (mtrc.metric.storem, path, module) != 0)
+      break;
+    if (dbver < 2 && migrate_si32_to_u6432 (mtrc.metric.storem, path, module) != 0)
       break;
+    *skip_restore = 1;
+    rekey_keymaps = 1;
     defer_migrated_unlink (path);
     ret++;
     break;
@@ -1854,17 +2134,21 @@ migrate_metric (GModule module, GKHashMetric mtrc, int *skip_restore) {
     ret = migrate_imtv (module);
     break;
   case MTRC_AGENT_KEYS:
-    if (dbver >= 2)
+    /* keyed by the user agent (v1) or its 32-bit hash (v2, v3) */
+    if (!(path = check_restore_path (dbver >= 2 ? "II32_AGENT_KEYS.db" : "SI32_AGENT_KEYS.db")))
       break;
-    if (!(path = check_restore_path ("SI32_AGENT_KEYS.db")))
+    if (dbver >= 2 && migrate_ii32_to_u6432 (mtrc.metric.storem, path, -1) != 0)
       break;
-    if (migrate_si32_to_ii32 (mtrc.metric.storem, path, -1) != 0)
+    if (dbver < 2 && migrate_si32_to_u6432 (mtrc.metric.storem, path, -1) != 0)
       break;
+    *skip_restore = 1;
+    rekey_keymaps = 1;
     defer_migrated_unlink (path);
     ret++;
     break;
   case MTRC_UNIQMAP:
-    if (dbver < 2)
+    /* only v2 holds the order-normalized pair encoding */
+    if (dbver != 2)
       break;
     if (!(modstr = get_module_str (module)))
       FATAL ("Unable to allocate module name.");
@@ -1940,6 +2224,9 @@ persist_by_type (GKHashMetric mtrc, const char *fn, int module) {
   case MTRC_TYPE_IGSL:
     ret = persist_igsl (mtrc.metric.storem, path, module);
     break;
+  case MTRC_TYPE_IHLL:
+    ret = persist_ihll (mtrc.metric.storem, path, module);
+    break;
   default:
     break;
   }
@@ -1958,6 +2245,9 @@ persist_metric_type (GModule module, GKHashMetric mtrc) {
     persist_imtv (module);
     return;
   }
+  /* sketches only exist in approximate visitors mode */
+  if (mtrc.type == MTRC_TYPE_IHLL && !conf.approx_visitors)
+    return;
 
   fn = get_filename (module, mtrc);
   persist_by_type (mtrc, fn, module);
@@ -2030,6 +2320,7 @@ restore_global (void) {
 
   if ((path = check_restore_path ("SI32_DB_PROPS.db"))) {
     restore_global_si32 (db_props, path);
+    verify_db_visitors_mode ();
     free (path);
   }
 
@@ -2054,6 +2345,10 @@ restore_global (void) {
     restore_global_ss32 (get_hdb (db, MTRC_COUNTRY_CONTINENT), path);
     free (path);
   }
+  if (conf.dns_cache_ttl && (path = check_restore_path ("SSU64_HOSTNAMES.db"))) {
+    restore_global_hostnames (path);
+    free (path);
+  }
 }
 
 static void
@@ -2086,6 +2381,11 @@ persist_global (void) {
     persist_global_ss32 (get_hdb (db, MTRC_COUNTRY_CONTINENT), path);
     free (path);
   }
+  if (conf.dns_cache_ttl && (path = set_db_path ("SSU64_HOSTNAMES.db"))) {
+    persist_global_hostnames (get_hdb (db, MTRC_HOSTNAMES), get_hdb (db, MTRC_HOSTNAMES_TS),
+                              path);
+    free (path);
+  }
 }
 
 /* Persist the database properties, marking the on-disk dataset as complete
@@ -2096,14 +2396,10 @@ persist_db_props (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * db_props = get_hdb (db, MTRC_DB_PROPS);
   char *path = NULL;
-  khint_t k;
-  int ret;
 
-  /* upsert: the restored props may carry an older version value */
-  k = kh_put (si32, db_props, "version", &ret);
-  if (ret > 0)
-    kh_key (db_props, k) = xstrdup ("version");
-  kh_val (db_props, k) = DB_VERSION;
+  /* the restored props may carry an older version value */
+  set_db_prop ("version", DB_VERSION);
+  set_db_prop ("approx_visitors", conf.approx_visitors ? 1 : 0);
 
   if ((path = set_db_path ("SI32_DB_PROPS.db"))) {
     persist_global_si32 (db_props, path);
@@ -2111,26 +2407,783 @@ persist_db_props (void) {
   }
 }
 
+/* Persist the module cache into its summary, which lets a later restore
+ * skip reading the date stores until they are needed.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned */
+static int
+persist_cache_summary (GModule module) {
+  GKCacheRow row = { 0 };
+  tpl_node *tn = NULL;
+  char *fn = NULL, *path = NULL, *data = NULL, *root = NULL;
+  char fmt[] = "uuvuA(UussuuuUUUvv)";
+  uint32_t ndates = ht_get_size_dates (), processed = ht_get_processed (), size = 0, iter = 0;
+  uint16_t flags = 0, meth = 0, proto = 0;
+  uint8_t has_bw = 0, has_cumts = 0;
+
+  fn = build_filename ("CACHE", get_module_str (module), "SUMMARY");
+  path = set_db_path (fn);
+  free (fn);
+
+  size = ht_get_cache_size (module, &has_bw, &has_cumts);
+  flags = has_bw | (has_cumts << 1);
+
+  if (!(tn = tpl_map (fmt, &ndates, &processed, &flags, &size, &row.hash, &row.ckey, &data,
+                      &root, &row.rkey, &row.hits, &row.visitors, &row.bw, &row.cumts,
+                      &row.maxts, &meth, &proto))) {
+    free (path);
+    return 1;
+  }
+  tpl_pack (tn, 0);
+
+  while (ht_next_cache_row (module, &iter, &row)) {
+    data = (char *) row.data;
+    root = (char *) row.root;
+    meth = row.meth;
+    proto = row.proto;
+    tpl_pack (tn, 1);
+  }
+  close_tpl (tn, path);
+  free (path);
+
+  return 0;
+}
+
+/* Restore the module cache out of its summary. The summary must have been
+ * persisted along with the restored dataset, i.e., cover the same dates
+ * and processed requests.
+ *
+ * On error or mismatch, 1 is returned.
+ * On success, 0 is returned */
+static int
+restore_cache_summary (GModule module) {
+  GKCacheRow row = { 0 };
+  tpl_node *tn = NULL;
+  char *fn = NULL, *path = NULL, *data = NULL, *root = NULL;
+  char fmt[] = "uuvuA(UussuuuUUUvv)";
+  uint32_t ndates = 0, processed = 0, size = 0;
+  uint16_t flags = 0, meth = 0, proto = 0;
+  int ret = 0;
+
+  fn = build_filename ("CACHE", get_module_str (module), "SUMMARY");
+  path = check_restore_path (fn);
+  free (fn);
+  if (!path)
+    return 1;
+
+  if (!(tn = tpl_map (fmt, &ndates, &processed, &flags, &size, &row.hash, &row.ckey, &data,
+                      &root, &row.rkey, &row.hits, &row.visitors, &row.bw, &row.cumts,
+                      &row.maxts, &meth, &proto)) || tpl_load (tn, TPL_FILE, path) != 0) {
+    if (tn)
+      tpl_free (tn);
+    free (path);
+    return 1;
+  }
+  free (path);
+
+  tpl_unpack (tn, 0);
+  if (ndates != persisted_dates_len || processed != ht_get_processed ()) {
+    tpl_free (tn);
+    return 1;
+  }
+
+  ht_begin_cache_summary (module, size, flags & 1, (flags >> 1) & 1);
+  while (tpl_unpack (tn, 1) > 0) {
+    row.data = data;
+    row.root = root;
+    row.meth = meth;
+    row.proto = proto;
+    if (ht_set_cache_row (module, &row) != 0)
+      ret = 1;
+    free (data);
+    free (root);
+    data = root = NULL;
+  }
+  ht_end_cache_summary (module);
+  tpl_free (tn);
+
+  return ret;
+}
+
+/* Persist or restore the given tables of the open partition. */
+static void
+persist_part_tables (GPartTables which) {
+  GModule module;
+  size_t idx = 0, i;
+
+  for (i = 0; i < global_metrics_len; ++i) {
+    if (part_has_metric (-1, global_metrics[i].metric.storem, which))
+      persist_by_type (global_metrics[i], global_metrics[i].filename, -1);
+  }
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    for (i = 0; i < module_metrics_len; ++i) {
+      if (part_has_metric (module, module_metrics[i].metric.storem, which))
+        persist_metric_type (module, module_metrics[i]);
+    }
+  }
+}
+
+static void
+restore_part_tables (GPartTables which) {
+  GModule module;
+  size_t idx = 0, i;
+
+  for (i = 0; i < global_metrics_len; ++i) {
+    if (part_has_metric (-1, global_metrics[i].metric.storem, which))
+      restore_by_type (global_metrics[i], global_metrics[i].filename, -1);
+  }
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    for (i = 0; i < module_metrics_len; ++i) {
+      if (part_has_metric (module, module_metrics[i].metric.storem, which))
+        restore_metric_type (module, module_metrics[i]);
+    }
+  }
+}
+
+/* Create the directory of the open partition.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+create_part (void) {
+  char *dir = set_db_path ("");
+
+  if (mkdir (dir, 0700) == -1 && errno != EEXIST) {
+    LOG_DEBUG (("Unable to create directory %s: %s\n", dir, strerror (errno)));
+    free (dir);
+    return -1;
+  }
+  free (dir);
+
+  return 0;
+}
+
+/* Remove the directory of the open partition along with its database
+ * files. */
+static void
+remove_part (void) {
+  struct dirent *ent = NULL;
+  char *dir = NULL, *path = NULL;
+  DIR *dp = NULL;
+
+  dir = set_db_path ("");
+  if ((dp = opendir (dir))) {
+    while ((ent = readdir (dp))) {
+      if (!strcmp (ent->d_name, ".") || !strcmp (ent->d_name, ".."))
+        continue;
+      path = set_db_path (ent->d_name);
+      unlink (path);
+      free (path);
+    }
+    closedir (dp);
+  }
+  rmdir (dir);
+  free (dir);
+}
+
+/* Get the path of a date partition directory.
+ *
+ * On success, the path is returned. */
+static char *
+get_part_path (const char *prefix, uint32_t date, const char *suffix) {
+  char *path = NULL;
+
+  open_part (prefix, date, suffix);
+  path = set_db_path ("");
+  close_part ();
+
+  return path;
+}
+
+/* Remove a date partition directory. */
+static void
+unlink_part (const char *prefix, uint32_t date, const char *suffix) {
+  open_part (prefix, date, suffix);
+  remove_part ();
+  close_part ();
+}
+
+/* Write all tables of a date into a fresh date-<date>.tmp partition, to take
+ * the place of the current one through swap_date_part().
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+write_date_part (uint32_t date) {
+  int ret = 0;
+
+  /* leftovers of an interrupted persist */
+  unlink_part ("date", date, ".tmp");
+
+  open_part ("date", date, ".tmp");
+  if ((ret = create_part ()) == 0) {
+    persist_error = 0;
+    persist_part_tables (PART_ALL);
+    if ((ret = persist_error ? -1 : 0) != 0)
+      remove_part ();
+  }
+  persist_error = 0;
+  close_part ();
+
+  return ret;
+}
+
+/* Swap a written date-<date>.tmp partition in, so a partition is never left
+ * half-written. A crash between both renames leaves the previous partition
+ * as date-<date>.old.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+swap_date_part (uint32_t date) {
+  char *tmp = NULL, *cur = NULL, *old = NULL;
+  int ret = 0;
+
+  tmp = get_part_path ("date", date, ".tmp");
+  cur = get_part_path ("date", date, "");
+  old = get_part_path ("date", date, ".old");
+
+  /* an .old partition is only current if the partition itself is gone */
+  if (access (cur, F_OK) != -1) {
+    unlink_part ("date", date, ".old");
+    if (rename (cur, old) == -1)
+      ret = -1;
+  }
+  if (ret == 0 && rename (tmp, cur) == -1) {
+    rename (old, cur);
+    ret = -1;
+  }
+  if (ret == 0)
+    unlink_part ("date", date, ".old");
+  else
+    unlink_part ("date", date, ".tmp");
+
+  free (tmp);
+  free (cur);
+  free (old);
+
+  return ret;
+}
+
+/* Persist all tables of a date into its date-<date> partition.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+persist_date_part (uint32_t date) {
+  if (write_date_part (date) != 0)
+    return -1;
+  return swap_date_part (date);
+}
+
+/* Write the partition of the oldest dirty date but the latest one, e.g., while
+ * checkpointing, and flag it as clean. It is swapped in by the next
+ * persist_data() unless modified in the meantime, along with the rest of the
+ * dataset it belongs to.
+ *
+ * If no date is left to stage, 0 is returned.
+ * On error, -1 is returned.
+ * On success 1 is returned */
+int
+stage_dirty_date (void) {
+  uint32_t *dates = NULL, len = 0, i;
+  int ret = 0;
+
+  dates = get_sorted_dates (&len);
+  for (i = 0; i + 1 < len; ++i) {
+    if (ht_is_dirty_date (dates[i]))
+      break;
+  }
+  if (i + 1 >= len)
+    goto out;
+
+  ret = -1;
+  if (ht_load_date (dates[i]) != 0 || write_date_part (dates[i]) != 0) {
+    LOG_DEBUG (("Unable to stage date %u\n", dates[i]));
+    goto out;
+  }
+  if (staged_len == staged_cap) {
+    staged_cap = staged_cap ? staged_cap * 2 : 16;
+    staged_dates = xrealloc (staged_dates, staged_cap * sizeof (*staged_dates));
+  }
+  staged_dates[staged_len++] = dates[i];
+  ht_set_date_dirty (dates[i], 0);
+  ret = 1;
+
+out:
+  free (dates);
+  return ret;
+}
+
+/* Swap in the partitions written by stage_dirty_date() of dates not modified
+ * since; the others are flagged back as dirty. */
+static void
+swap_staged_dates (void) {
+  uint32_t i, date;
+
+  for (i = 0; i < staged_len; ++i) {
+    date = staged_dates[i];
+    if (!ht_has_date (date) || ht_is_dirty_date (date))
+      continue;
+    if (swap_date_part (date) != 0) {
+      LOG_DEBUG (("Unable to swap staged date %u\n", date));
+      ht_set_date_dirty (date, 1);
+    }
+  }
+  free (staged_dates);
+  staged_dates = NULL;
+  staged_len = staged_cap = 0;
+}
+
+/* Open the partition of a restored date, falling back to the previous one
+ * left by an interrupted persist.
+ *
+ * If the date has no partition, -1 is returned.
+ * On success 0 is returned */
+static int
+open_restore_part (uint32_t date) {
+  const char *suffix[] = { "", ".old" };
+  char *dir = NULL;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (suffix); ++i) {
+    open_part ("date", date, suffix[i]);
+    dir = set_db_path ("");
+    if (access (dir, F_OK) != -1) {
+      free (dir);
+      return 0;
+    }
+    free (dir);
+    close_part ();
+  }
+
+  return -1;
+}
+
+/* Restore the given tables of a date out of its partition.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+restore_date_part (uint32_t date, GPartTables which) {
+  if (open_restore_part (date) != 0) {
+    LOG_DEBUG (("No partition for date %u\n", date));
+    return -1;
+  }
+  restore_part_tables (which);
+  close_part ();
+
+  return 0;
+}
+
+/* Determine whether a date has a current partition.
+ *
+ * If it does, 1 is returned, else 0. */
+static int
+has_part (uint32_t date) {
+  char *dir = get_part_path ("date", date, "");
+  int ret = access (dir, F_OK) != -1;
+
+  free (dir);
+  return ret;
+}
+
+/* Remove the partitions of dates no longer in the storage, e.g., evicted
+ * through --keep-last, along with leftovers of an interrupted persist. */
+static void
+unlink_stale_parts (void) {
+  struct dirent *ent = NULL;
+  char *dir = NULL, suffix[8] = "";
+  uint32_t date = 0;
+  DIR *dp = NULL;
+  int n = 0;
+
+  dir = set_db_path ("");
+  if (!(dp = opendir (dir))) {
+    free (dir);
+    return;
+  }
+  while ((ent = readdir (dp))) {
+    suffix[0] = '\0';
+    n = sscanf (ent->d_name, "date-%u%7s", &date, suffix);
+    if (n < 1 || (n == 1 && ht_has_date (date)))
+      continue;
+    if (n == 2 && strcmp (suffix, ".tmp") && strcmp (suffix, ".old"))
+      continue;
+    /* the previous partition is the only one left of a current date */
+    if (n == 2 && !strcmp (suffix, ".old") && ht_has_date (date) && !has_part (date))
+      continue;
+    unlink_part ("date", date, n == 2 ? suffix : "");
+  }
+  closedir (dp);
+  free (dir);
+}
+
+/* Remove the per-metric database files of the dataset layout prior to date
+ * partitions, once migrated. */
+static void
+unlink_legacy_tables (void) {
+  const char *modstr = NULL, *mtrstr = NULL;
+  GModule module;
+  char *fn = NULL, *path = NULL;
+  size_t idx = 0, i, j;
+
+  for (i = 0; i < global_metrics_len; ++i) {
+    path = set_db_path (global_metrics[i].filename);
+    unlink (path);
+    free (path);
+  }
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    modstr = get_module_str (module);
+    for (i = 0; i < module_metrics_len; ++i) {
+      if (module_metrics[i].type != MTRC_TYPE_IMTV) {
+        fn = get_filename (module, module_metrics[i]);
+        path = set_db_path (fn);
+        unlink (path);
+        free (path);
+        free (fn);
+        continue;
+      }
+      for (j = 0; j < ARRAY_SIZE (imtv_fields); ++j) {
+        if (!(mtrstr = get_mtr_str (imtv_fields[j].metric)))
+          continue;
+        fn = build_filename (imtv_fields[j].type, modstr, mtrstr);
+        path = set_db_path (fn);
+        unlink (path);
+        free (path);
+        free (fn);
+      }
+    }
+  }
+}
+
+/* Map a write-ahead log batch: the overall counters and the last parsed line
+ * of the log as of the batch, the strings of its records and its records,
+ * which refer to them by index. */
+static tpl_node *
+map_wal (char **str) {
+  char fmt[] = "uuuUS(uIUvc#)A(s)A(u#iiiiiUUUUu)";
+
+  /* *INDENT-OFF* */
+  return tpl_map (fmt, &wal_cnt[0], &wal_cnt[1], &wal_cnt[2], &wal_inode,
+                  &wal_lp, READ_BYTES, str, wal_strs, WAL_STR_LEN,
+                  &wal_item.status, &wal_item.ignorelevel, &wal_item.type_ip,
+                  &wal_item.is_404, &wal_item.is_static, &wal_item.resp_size,
+                  &wal_item.serve_time, &wal_item.uniq_key,
+                  &wal_item.agent_hash, &wal_item.numdate);
+  /* *INDENT-ON* */
+}
+
+/* Get the overall counters a batch accounts for beyond its records. */
+static void
+get_wal_counters (uint32_t cnt[WAL_CNT_LEN]) {
+  cnt[0] = ht_get_processed ();
+  cnt[1] = ht_get_invalid ();
+  cnt[2] = ht_get_excluded_ips ();
+}
+
+/* Get the index of a string within the current batch, packing it the first
+ * time it is seen.
+ *
+ * If the string is NULL, 0 is returned.
+ * On success, the 1-based index of the string is returned. */
+static uint32_t
+get_wal_str (const char *str) {
+  khint_t k;
+  int ret = 0;
+
+  if (!str)
+    return 0;
+
+  k = kh_put (si32, wal_str_idx, str, &ret);
+  if (ret == 0)
+    return kh_val (wal_str_idx, k);
+
+  kh_key (wal_str_idx, k) = xstrdup (str);
+  kh_val (wal_str_idx, k) = kh_size (wal_str_idx);
+  wal_str = (char *) str;
+  tpl_pack (wal_tn, 1);
+
+  return kh_val (wal_str_idx, k);
+}
+
+/* Free the current batch. */
+static void
+free_wal_batch (void) {
+  khint_t k;
+
+  if (wal_tn)
+    tpl_free (wal_tn);
+  wal_tn = NULL;
+  if (!wal_str_idx)
+    return;
+  for (k = kh_begin (wal_str_idx); k != kh_end (wal_str_idx); ++k) {
+    if (kh_exist (wal_str_idx, k))
+      free ((char *) kh_key (wal_str_idx, k));
+  }
+  kh_destroy (si32, wal_str_idx);
+  wal_str_idx = NULL;
+}
+
+/* Start a new batch if none is open. */
+static void
+open_wal_batch (void) {
+  if (wal_tn)
+    return;
+  wal_tn = map_wal (&wal_str);
+  wal_str_idx = kh_init (si32);
+}
+
+/* Queue a parsed record into the current write-ahead log batch. It must be
+ * queued before being processed. */
+void
+log_wal_record (GLogItem *logitem) {
+  size_t i;
+
+  if (!conf.persist || !conf.persist_wal)
+    return;
+
+  open_wal_batch ();
+  for (i = 0; i < ARRAY_SIZE (wal_str_fields); ++i)
+    wal_strs[i] = get_wal_str (*(char **) ((char *) logitem + wal_str_fields[i]));
+  wal_strs[WAL_STR_LEN - 1] = get_wal_str (logitem->site);
+
+  wal_item = *logitem;
+  tpl_pack (wal_tn, 2);
+}
+
+/* Append the current batch to the write-ahead log, along with the last parsed
+ * line of the given log, and flush it to disk. */
+void
+append_wal (uint64_t inode, const GLastParse *lp) {
+  uint32_t cnt[WAL_CNT_LEN], len = 0, i;
+  void *img = NULL;
+  size_t sz = 0;
+  char *path = NULL;
+
+  if (!conf.persist || !conf.persist_wal)
+    return;
+
+  get_wal_counters (cnt);
+  for (i = 0; i < WAL_CNT_LEN; ++i)
+    if (cnt[i] != wal_base[i])
+      break;
+  /* nothing parsed since the last batch */
+  if (!wal_tn && i == WAL_CNT_LEN)
+    return;
+
+  open_wal_batch ();
+  for (i = 0; i < WAL_CNT_LEN; ++i)
+    wal_cnt[i] = cnt[i] - wal_base[i];
+  wal_inode = inode;
+  wal_lp = *lp;
+  tpl_pack (wal_tn, 0);
+
+  if (wal_fd == -1) {
+    path = set_db_path (WAL_FILE);
+    if ((wal_fd = open (path, O_WRONLY | O_CREAT | O_APPEND, 0600)) == -1)
+      LOG_DEBUG (("Unable to open %s: %s\n", path, strerror (errno)));
+    free (path);
+  }
+
+  /* each batch is prefixed by its length, a torn one is dropped on replay */
+  if (wal_fd != -1 && tpl_dump (wal_tn, TPL_MEM, &img, &sz) == 0) {
+    len = sz;
+    if (write (wal_fd, &len, sizeof (len)) != sizeof (len) ||
+        write (wal_fd, img, sz) != (ssize_t) sz || fsync (wal_fd) == -1)
+      LOG_DEBUG (("Unable to append to the write-ahead log: %s\n", strerror (errno)));
+    free (img);
+  }
+  free_wal_batch ();
+
+  memcpy (wal_base, cnt, sizeof (wal_base));
+}
+
+/* Drop the write-ahead log, e.g., once its batches were persisted. */
+static void
+reset_wal (void) {
+  char *path = NULL;
+
+  free_wal_batch ();
+  if (wal_fd != -1)
+    close (wal_fd);
+  wal_fd = -1;
+
+  path = set_db_path (WAL_FILE);
+  unlink (path);
+  free (path);
+
+  get_wal_counters (wal_base);
+}
+
+/* Remove a write-ahead log left by an earlier run when not restoring. Its
+ * batches belong to the dataset persisted next to it, not to the one this
+ * run starts from scratch. */
+void
+clear_wal (void) {
+  if (wal_replayed)
+    return;
+  wal_replayed = 1;
+
+  reset_wal ();
+}
+
+/* Apply a write-ahead log batch to the storage.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+static int
+replay_wal_batch (void *img, uint32_t len) {
+  GLogItem *logitem = NULL;
+  tpl_node *tn = NULL;
+  char *str = NULL, **strs = NULL;
+  uint32_t nstrs = 0, i, id;
+  size_t j;
+  int ret = -1;
+
+  tn = map_wal (&str);
+  if (tpl_load (tn, TPL_MEM | TPL_EXCESS_OK, img, (size_t) len) != 0 || tpl_unpack (tn, 0) < 0)
+    goto out;
+
+  nstrs = tpl_Alen (tn, 1);
+  strs = xcalloc (nstrs + 1, sizeof (char *));
+  for (i = 1; i <= nstrs && tpl_unpack (tn, 1) > 0; ++i)
+    strs[i] = str;
+
+  while (tpl_unpack (tn, 2) > 0) {
+    logitem = xcalloc (1, sizeof (GLogItem));
+    *logitem = wal_item;
+    logitem->arena = NULL;
+    logitem->errstr = NULL;
+    for (j = 0; j < ARRAY_SIZE (wal_str_fields); ++j) {
+      id = wal_strs[j];
+      *(char **) ((char *) logitem + wal_str_fields[j]) =
+        id && id <= nstrs && strs[id] ? xstrdup (strs[id]) : NULL;
+    }
+    id = wal_strs[WAL_STR_LEN - 1];
+    snprintf (logitem->site, sizeof (logitem->site), "%s",
+              id && id <= nstrs && strs[id] ? strs[id] : "");
+    process_log (logitem);
+    free_glog (logitem);
+  }
+
+  ht_inc_cnt_overall ("total_requests", wal_cnt[0]);
+  ht_inc_cnt_overall ("failed_requests", wal_cnt[1]);
+  ht_inc_cnt_overall ("excluded_ip", wal_cnt[2]);
+  ht_insert_last_parse (wal_inode, &wal_lp);
+  ret = 0;
+
+out:
+  for (i = 1; strs && i <= nstrs; ++i)
+    free (strs[i]);
+  free (strs);
+  tpl_free (tn);
+  return ret;
+}
+
+/* Replay the write-ahead log on top of the restored dataset, i.e., the
+ * batches parsed since it was last persisted. A torn batch at its end, e.g.,
+ * on a power loss, is dropped. Must run once the module caches are in
+ * place. */
+void
+replay_wal (void) {
+  struct stat st;
+  char *path = NULL, *buf = NULL;
+  uint32_t len = 0, batches = 0;
+  off_t off = 0;
+  int fd = -1;
+
+  if (wal_replayed)
+    return;
+  wal_replayed = 1;
+
+  path = set_db_path (WAL_FILE);
+  if ((fd = open (path, O_RDWR)) == -1 || fstat (fd, &st) == -1 || st.st_size == 0)
+    goto out;
+
+  buf = xmalloc (st.st_size);
+  if (read (fd, buf, st.st_size) != st.st_size)
+    goto out;
+
+  while (off + (off_t) sizeof (len) <= st.st_size) {
+    memcpy (&len, buf + off, sizeof (len));
+    if (len > st.st_size - off - sizeof (len))
+      break;
+    if (replay_wal_batch (buf + off + sizeof (len), len) != 0)
+      break;
+    off += sizeof (len) + len;
+    batches++;
+  }
+  if (off < st.st_size && ftruncate (fd, off) == -1)
+    LOG_DEBUG (("Unable to truncate %s: %s\n", path, strerror (errno)));
+  LOG_DEBUG (("Replayed %u write-ahead log batches\n", batches));
+
+out:
+  if (fd != -1)
+    close (fd);
+  free (buf);
+  free (path);
+  get_wal_counters (wal_base);
+}
+
+/* Remove the module cache summaries. */
+static void
+unlink_cache_summaries (void) {
+  GModule module;
+  char *fn = NULL, *path = NULL;
+  size_t idx = 0;
+
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    fn = build_filename ("CACHE", get_module_str (module), "SUMMARY");
+    path = set_db_path (fn);
+    unlink (path);
+    free (path);
+    free (fn);
+  }
+}
+
+/* Persist the dataset. Only the partitions of dates modified since they
+ * were restored or last persisted are written, hence the cost of a persist
+ * is proportional to the data that changed. */
 void
 persist_data (void) {
   GModule module;
-  int i, n = 0;
+  uint32_t *dates = NULL, len = 0, i;
   size_t idx = 0;
+  int failed = 0;
 
-  persist_error = 0;
-  persist_global ();
+  /* the summaries only hold along with the dataset they were persisted
+   * with, a restore falls back to the partitions until they are rewritten */
+  unlink_cache_summaries ();
 
-  n = global_metrics_len;
-  for (i = 0; i < n; ++i)
-    persist_by_type (global_metrics[i], global_metrics[i].filename, -1);
+  swap_staged_dates ();
+  dates = get_sorted_dates (&len);
+  for (i = 0; i < len; ++i) {
+    if (!ht_is_dirty_date (dates[i]))
+      continue;
+    if (ht_load_date (dates[i]) != 0 || persist_date_part (dates[i]) != 0) {
+      LOG_DEBUG (("Unable to persist date %u\n", dates[i]));
+      failed = 1;
+      continue;
+    }
+    ht_set_date_dirty (dates[i], 0);
+  }
+  free (dates);
+
+  persist_error = failed;
+  persist_global ();
 
-  n = module_metrics_len;
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
-    for (i = 0; i < n; ++i) {
-      persist_metric_type (module, module_metrics[i]);
-    }
+    if (persist_cache_summary (module) != 0)
+      persist_error = 1;
   }
+  unlink_stale_parts ();
 
   /* the version metadata is written last so an interrupted or failed persist
    * never marks an incomplete dataset as current */
@@ -2138,18 +3191,68 @@ persist_data (void) {
     persist_db_props ();
   else
     LOG_DEBUG (("Failed to write one or more database files; version metadata withheld\n"));
+
+  /* the batches are part of the dataset now, unless yet to be replayed */
+  if (persist_error == 0 && (!conf.restore || wal_replayed))
+    reset_wal ();
 }
 
-/* Entry function to restore hashes */
-void
-restore_data (void) {
+/* Restore the dataset lazily: the module caches out of their summaries and
+ * only the resident tables of each date, e.g., its counters. All other
+ * tables of a date are read out of its partition once needed.
+ *
+ * If the dataset can't be restored lazily, 0 is returned.
+ * On success, 1 is returned. */
+static int
+restore_lazily (void) {
+  size_t idx = 0;
+  uint32_t j;
+
+  if (!persisted_dates_len)
+    return 0;
+  /* dropped dates would still be in the summaries */
+  if (conf.keep_last && persisted_dates_len > conf.keep_last)
+    return 0;
+
+  FOREACH_MODULE (idx, module_list) {
+    if (restore_cache_summary (module_list[idx]) != 0) {
+      ht_reset_caches ();
+      return 0;
+    }
+  }
+
+  for (j = 0; j < persisted_dates_len; ++j) {
+    ht_insert_date (persisted_dates[j]);
+    restore_date_part (persisted_dates[j], PART_RESIDENT);
+  }
+  ht_mark_lazy_dates ();
+
+  return 1;
+}
+
+/* Restore the partitions of the persisted dates, the most recent ones only
+ * under --keep-last. */
+static void
+restore_date_parts (void) {
+  uint32_t i, len = persisted_dates_len;
+
+  if (conf.keep_last && len > conf.keep_last)
+    len = conf.keep_last;
+  for (i = 0; i < len; ++i)
+    restore_date_part (persisted_dates[i], PART_ALL);
+}
+
+/* Restore a dataset persisted prior to date partitions, migrating its
+ * tables if needed.
+ *
+ * On success, the number of migrated tables is returned. */
+static int
+restore_legacy (void) {
   int migrated = 0, skip = 0;
   GModule module;
   int i, n = 0;
   size_t idx = 0;
 
-  restore_global ();
-
   n = global_metrics_len;
   for (i = 0; i < n; ++i) {
     migrated += migrate_metric (-1, global_metrics[i], &skip);
@@ -2167,19 +3270,126 @@ restore_data (void) {
     }
   }
 
-  if (migrated) {
-    /* persist the migrated data in the current format before removing the
-     * legacy files, so an interrupted or failed migration simply runs
-     * again */
-    persist_data ();
-    if (persist_error == 0)
-      unlink_migrated_files ();
-    if (!conf.persist)
-      conf.persist = 1;
+  /* migrated keymaps hold provisional keys until rebuilt out of the restored
+   * strings */
+  if (rekey_keymaps)
+    rekey_date_stores ();
+
+  return migrated;
+}
+
+/* Entry function to restore hashes */
+void
+restore_data (void) {
+  int migrated = 0;
+
+  restore_global ();
+  if (get_db_version () == DB_VERSION) {
+    if (!restore_lazily ())
+      restore_date_parts ();
+    /* restored dates are on disk already */
+    ht_set_dates_dirty (0);
+    return;
+  }
+
+  migrated = restore_legacy ();
+  ht_set_dates_dirty (0);
+  if (!migrated && !persisted_dates_len)
+    return;
+
+  /* persist the migrated data in the current format before removing the
+   * legacy files, so an interrupted or failed migration simply runs again */
+  ht_set_dates_dirty (1);
+  persist_data ();
+  if (persist_error == 0) {
+    unlink_migrated_files ();
+    unlink_legacy_tables ();
+  }
+  if (!conf.persist)
+    conf.persist = 1;
+}
+
+/* Remove the spill directory of the given date along with its database
+ * files. */
+void
+unlink_spilled_date (uint32_t date) {
+  unlink_part ("spill", date, "");
+}
+
+/* Persist all but the resident tables of a date store into its own spill
+ * directory.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+persist_spilled_date (uint32_t date) {
+  int ret = 0;
+
+  open_part ("spill", date, "");
+  if (create_part () != 0) {
+    close_part ();
+    return -1;
+  }
+
+  persist_error = 0;
+  persist_part_tables (PART_UNLOADED);
+  ret = persist_error ? -1 : 0;
+  persist_error = 0;
+  if (ret != 0)
+    remove_part ();
+  close_part ();
+
+  return ret;
+}
+
+/* Restore all but the resident tables of the given lazily restored dates
+ * out of their partitions.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+restore_lazy_dates (const uint32_t *dates, uint32_t len) {
+  uint32_t j;
+  int ret = 0;
+
+  for (j = 0; j < len; ++j) {
+    if (restore_date_part (dates[j], PART_UNLOADED) != 0)
+      ret = -1;
+  }
+
+  return ret;
+}
+
+/* Restore the spilled tables of a date store out of its spill directory,
+ * which is removed afterwards.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+restore_spilled_date (uint32_t date) {
+  char *dir = NULL;
+
+  open_part ("spill", date, "");
+  dir = set_db_path ("");
+  if (access (dir, F_OK) == -1) {
+    free (dir);
+    close_part ();
+    return -1;
   }
+  free (dir);
+
+  restore_part_tables (PART_UNLOADED);
+  remove_part ();
+  close_part ();
+
+  return 0;
 }
 
 void
 free_persisted_data (void) {
   free (persisted_dates);
+  free (staged_dates);
+  free_wal_batch ();
+  if (wal_fd != -1)
+    close (wal_fd);
 }
@@ -30,8 +30,21 @@
 #ifndef PERSISTENCE_H_INCLUDED
 #define PERSISTENCE_H_INCLUDED
 
+#include <stdint.h>
+
+#include "parser.h"
+
+int persist_spilled_date (uint32_t date);
+int restore_lazy_dates (const uint32_t * dates, uint32_t len);
+int restore_spilled_date (uint32_t date);
 void restore_data (void);
+int stage_dirty_date (void);
+void append_wal (uint64_t inode, const GLastParse * lp);
+void clear_wal (void);
+void log_wal_record (GLogItem * logitem);
+void replay_wal (void);
 void persist_data (void);
 void free_persisted_data (void);
+void unlink_spilled_date (uint32_t date);
 
 #endif // for #ifndef PERSISTENCE_H
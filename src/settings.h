@@ -131,6 +131,7 @@ typedef struct GConf_
   const char *invalid_requests_log; /* invalid lines log path */
   const char *unknowns_log;         /* unknown browsers/OSs log path */
   const char *pidfile;              /* daemonize pid file path */
+  const char *runtime_stats_file;   /* runtime stats path, dumped on exit */
   const char *browsers_file;        /* browser's file path */
   const char *db_path;              /* db path to files */
   const char *fname_as_vhost;       /* filenames as vhost/server blocks */
@@ -158,12 +159,16 @@ typedef struct GConf_
   int anonymize_level;              /* anonymization level */
   int append_method;                /* append method to the req key */
   int append_protocol;              /* append protocol to the req key */
+  int approx_visitors;              /* estimate visitors with sketches */
   int client_err_to_unique_count;   /* count 400s as visitors */
   int code444_as_404;               /* 444 as 404s? */
   int color_scheme;                 /* color scheme */
   int chunk_size;                   /* chunk size for each thread */
   int crawlers_only;                /* crawlers only */
   int daemonize;                    /* run program as a Unix daemon */
+  int dns_threads;                  /* reverse DNS resolver threads */
+  int dns_timeout;                  /* reverse DNS lookup timeout in secs */
+  int dns_cache_ttl;                /* days to keep persisted hostnames */
   const char *username;             /* user to run program as */
   int double_decode;                /* need to double decode */
   int external_assets;              /* write JS/CSS assets to external files */
@@ -192,16 +197,21 @@ typedef struct GConf_
   int no_tab_scroll;                /* don't scroll dashboard on tab */
   int output_stdout;                /* outputting to stdout */
   int persist;                      /* ensure to persist data on exit */
+  int persist_wal;                  /* write-ahead log parsed batches */
   int process_and_exit;             /* parse and exit without outputting */
   int real_os;                      /* show real OSs */
   int real_time_html;               /* enable real-time HTML output */
   int restore;                      /* reload data from db-path */
+  int runtime_stats;                /* add runtime stats to the reports */
   int skip_term_resolver;           /* no terminal resolver */
   int is_json_log_format;           /* is a json log format */
   uint32_t keep_last;               /* number of days to keep in storage */
   uint32_t num_tests;               /* number of lines to test */
   uint64_t html_refresh;            /* refresh html report every X of seconds */
   uint64_t log_size;                /* log size override */
+  uint64_t mem_report;              /* log memory usage every X of seconds */
+  uint64_t mem_limit;               /* storage memory budget in MiB */
+  uint64_t persist_interval;        /* checkpoint data every X of minutes */
   int concat_vhost_req;             /* concatenate vhost and request */
 
   /* Internal flags */
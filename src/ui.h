@@ -142,15 +142,33 @@
 #include "color.h"
 #include "sort.h"
 
+/* A search match: a root item, or one of its sub items */
+typedef struct GFindMatch_ {
+  GModule module;
+  int parent_idx; /* root item index */
+  int sub_idx; /* 0 for the root item, else 1 + flat sub item index */
+} GFindMatch;
+
 typedef struct GFind_ {
   GModule module;
   char *pattern;
   int next_idx;
   int next_parent_idx;
   int next_sub_idx;
-  int look_in_sub;
-  int done;
   int icase;
+
+  /* match index, filled in by the search thread */
+  GHolder *holder; /* holder being indexed, NULL if none */
+  GFindMatch *matches;
+  int matches_size; /* allocated matches */
+  int matches_idx; /* matches found so far */
+  int cur; /* next match to visit */
+  int done; /* whole holder scanned */
+  int cancel; /* ask the search thread to stop */
+  int error; /* regexec(3) error, if any */
+
+  GFindMatch last; /* last visited match */
+  int resume; /* skip up to the last match once re-indexed */
 } GFind;
 
 /* Helper: snapshot current spinner state (avoids holding mutex too long) */
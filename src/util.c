@@ -187,22 +187,97 @@ count_matches (const char *s1, char c) {
   return n;
 }
 
-/* Simple but efficient uint32_t hashing. */
-#if defined(__clang__) && defined(__clang_major__) && (__clang_major__ >= 4)
-__attribute__((no_sanitize ("unsigned-integer-overflow")))
-#if (__clang_major__ >= 12)
-  __attribute__((no_sanitize ("unsigned-shift-base")))
-#endif
+/* hash64 mixing constants */
+#define HASH64_P0 0x2d358dccaa6c78a5ULL
+#define HASH64_P1 0x8bb84b93962eacc9ULL
+#define HASH64_P2 0x4b33a62ed433d4a3ULL
+#define HASH64_P3 0x4d5a2da51de1aa47ULL
+
+/* Multiply two 64-bit words into a 128-bit product, leaving its low half
+ * in a and its high half in b. */
+static inline void
+hash64_mum (uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t) * a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) * a, lb = (uint32_t) * b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+  uint64_t c = t < rl, lo = t + (rm1 << 32);
+
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
 #endif
-  uint32_t
-djb2 (const unsigned char *str) {
-  uint32_t hash = 5381;
-  int c;
+}
+
+/* Fold the 128-bit product of two words back into 64 bits. */
+static inline uint64_t
+hash64_mix (uint64_t a, uint64_t b) {
+  hash64_mum (&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t
+hash64_r8 (const unsigned char *p) {
+  uint64_t v;
+  memcpy (&v, p, 8);
+  return v;
+}
+
+static inline uint64_t
+hash64_r4 (const unsigned char *p) {
+  uint32_t v;
+  memcpy (&v, p, 4);
+  return v;
+}
+
+/* 64-bit hashing of the given bytes. Input is consumed a word at a time
+ * using the multiply-fold scheme of wyhash, so long strings such as
+ * request paths and user agents hash several times faster than
+ * byte-at-a-time schemes, with a collision rate fit for 64-bit keys.
+ *
+ * On success, the 64-bit hash is returned. */
+uint64_t
+hash64 (const void *key, size_t len) {
+  const unsigned char *p = key;
+  uint64_t seed = hash64_mix (HASH64_P0, HASH64_P1), a = 0, b = 0, s1, s2;
+  size_t i = len;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (hash64_r4 (p) << 32) | hash64_r4 (p + ((len >> 3) << 2));
+      b = (hash64_r4 (p + len - 4) << 32) | hash64_r4 (p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+    }
+  } else {
+    if (i > 48) {
+      s1 = s2 = seed;
+      do {
+        seed = hash64_mix (hash64_r8 (p) ^ HASH64_P1, hash64_r8 (p + 8) ^ seed);
+        s1 = hash64_mix (hash64_r8 (p + 16) ^ HASH64_P2, hash64_r8 (p + 24) ^ s1);
+        s2 = hash64_mix (hash64_r8 (p + 32) ^ HASH64_P3, hash64_r8 (p + 40) ^ s2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= s1 ^ s2;
+    }
+    while (i > 16) {
+      seed = hash64_mix (hash64_r8 (p) ^ HASH64_P1, hash64_r8 (p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = hash64_r8 (p + i - 16);
+    b = hash64_r8 (p + i - 8);
+  }
 
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+  a ^= HASH64_P1;
+  b ^= seed;
+  hash64_mum (&a, &b);
 
-  return hash;
+  return hash64_mix (a ^ HASH64_P0 ^ len, b ^ HASH64_P1);
 }
 
 /* String matching where one string contains wildcard characters.
@@ -798,14 +873,14 @@ u64encode (uint32_t x, uint32_t y) {
 #define FNV64_PRIME  0x100000001B3ULL
 
 /* Build a 64-bit fingerprint identifying a unique visitor from the host and
- * the user agent hash. The date is not part of the fingerprint since visitor
- * tables are already partitioned by date. Only fields recoverable from the
- * legacy "DATE|IP|UA-hex" key strings may participate, so persisted
- * databases can be migrated exactly.
+ * the 64-bit user agent hash. The date is not part of the fingerprint since
+ * visitor tables are already partitioned by date. Only fields recoverable
+ * from the legacy "DATE|IP|UA" key strings may participate, so persisted
+ * databases can be migrated.
  *
  * On success, the non-zero visitor fingerprint is returned. */
 uint64_t
-visitor_fingerprint (const char *host, uint32_t agent_hash) {
+visitor_fingerprint (const char *host, uint64_t agent_hash) {
   uint64_t h = FNV64_OFFSET;
   const char *p;
 
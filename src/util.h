@@ -104,9 +104,9 @@ int str_to_time (const char *str, const char *fmt, struct tm *tm, int tz);
 int valid_output_type (const char *filename);
 off_t file_size (const char *filename);
 size_t append_str (char **dest, const char *src);
-uint32_t djb2 (const unsigned char *str);
+uint64_t hash64 (const void *key, size_t len);
 uint64_t u64encode (uint32_t x, uint32_t y);
-uint64_t visitor_fingerprint (const char *host, uint32_t agent_hash);
+uint64_t visitor_fingerprint (const char *host, uint64_t agent_hash);
 void decode_hex(char *url, char *out, int decode_plus);
 void genstr (char *dest, size_t len);
 void set_tz (void);